@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include "reedsolomon/rs.h"
+#include "reedsolomon/fft_rs.h"
 #include "../app/src/main/cpp/bindings.h"
 
 enum ALVR_PACKET_TYPE {
@@ -15,6 +16,14 @@ enum ALVR_PACKET_TYPE {
 enum ALVR_CODEC {
 	ALVR_CODEC_H264 = 0,
 	ALVR_CODEC_H265 = 1,
+	ALVR_CODEC_AV1 = 2,
+};
+
+enum ALVR_FEC_CODEC {
+	// GF(2^8) Reed-Solomon, up to ALVR_FEC_SHARDS_MAX shards of multiple packets
+	ALVR_FEC_CODEC_RS8 = 0,
+	// GF(2^16) FFT Reed-Solomon, one packet per shard
+	ALVR_FEC_CODEC_RS16 = 1,
 };
 
 enum ALVR_LOST_FRAME_TYPE {
@@ -105,7 +114,8 @@ enum ALVR_TRACKING_SPACE {
 };
 #define ALVR_BUTTON_FLAG(input) (1ULL << input)
 
-static const int ALVR_MAX_VIDEO_BUFFER_SIZE = 1400;
+// Video packet size used when it is not negotiated at connection time
+static const int ALVR_DEFAULT_VIDEO_BUFFER_SIZE = 1400;
 
 static const int ALVR_FEC_SHARDS_MAX = 20;
 
@@ -115,14 +125,14 @@ inline int CalculateParityShards(int dataShards, int fecPercentage) {
 }
 
 // Calculate how many packet is needed for make signal shard.
-inline int CalculateFECShardPackets(int len, int fecPercentage) {
+inline int CalculateFECShardPackets(int len, int fecPercentage, int packetSize) {
 	// This reed solomon implementation accept only 255 shards.
-	// Normally, we use ALVR_MAX_VIDEO_BUFFER_SIZE as block_size and single packet becomes single shard.
+	// Normally, we use packetSize as block_size and single packet becomes single shard.
 	// If we need more than maxDataShards packets, we need to combine multiple packet to make single shrad.
 	// NOTE: Moonlight seems to use only 255 shards for video frame.
 	int maxDataShards = ((ALVR_FEC_SHARDS_MAX - 2) * 100 + 99 + fecPercentage) / (100 + fecPercentage);
 	int minBlockSize = (len + maxDataShards - 1) / maxDataShards;
-	int shardPackets = (minBlockSize + ALVR_MAX_VIDEO_BUFFER_SIZE - 1) / ALVR_MAX_VIDEO_BUFFER_SIZE;
+	int shardPackets = (minBlockSize + packetSize - 1) / packetSize;
 	assert(maxDataShards + CalculateParityShards(maxDataShards, fecPercentage) <= ALVR_FEC_SHARDS_MAX);
 	return shardPackets;
 }
@@ -33,6 +33,16 @@ extern "C" {
 	 * */
 	int reed_solomon_encode(reed_solomon* rs, unsigned char** shards, int nr_shards, int block_size);
 
+	/**
+	 * encode only parity shards [first_parity, first_parity + nr_parity) of a single set of
+	 * shards, so that parity rows and byte ranges can be computed in parallel
+	 * input:
+	 * rs
+	 * data[rs->data_shards][block_size]
+	 * parity[nr_parity][block_size]
+	 * */
+	int reed_solomon_encode_parity(reed_solomon* rs, unsigned char** data, unsigned char** parity, int first_parity, int nr_parity, int block_size);
+
 	/**
 	 * reconstruct a big size of buffer
 	 * input:
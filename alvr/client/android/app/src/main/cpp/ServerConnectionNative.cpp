@@ -30,7 +30,7 @@ namespace {
 }
 
 void initializeSocket(void *v_env, void *v_instance, void *v_nalClass, unsigned int codec,
-                      bool enableFEC) {
+                      bool enableFEC, unsigned int fecCodec, unsigned int videoPacketSize) {
     auto *env = (JNIEnv *) v_env;
     auto *instance = (jobject) v_instance;
     auto *nalClass = (jclass) v_nalClass;
@@ -45,7 +45,8 @@ void initializeSocket(void *v_env, void *v_instance, void *v_nalClass, unsigned
     g_socket.mOnDisconnectedMethodID = env->GetMethodID(clazz, "onDisconnected", "()V");
     env->DeleteLocalRef(clazz);
 
-    g_socket.m_nalParser = std::make_shared<NALParser>(env, instance, nalClass, enableFEC);
+    g_socket.m_nalParser = std::make_shared<NALParser>(env, instance, nalClass, enableFEC, fecCodec,
+                                                        videoPacketSize);
     g_socket.m_nalParser->setCodec(codec);
 
     LatencyCollector::Instance().resetAll();
@@ -157,6 +158,12 @@ void sendTimeSync() {
 
     timeSync.fps = LatencyCollector::Instance().getFramesInSecond();
 
+    LOG("Tracking sample to send latency: average=%lu us max=%lu us",
+        LatencyCollector::Instance().getTrackingSendLatency(),
+        LatencyCollector::Instance().getTrackingSendLatencyMax());
+    LOG("Late frames skipped: %lu in the last second",
+        LatencyCollector::Instance().getLateFramesSkippedInSecond());
+
     timeSyncSend(timeSync);
 }
 
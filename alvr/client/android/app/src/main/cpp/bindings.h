@@ -171,6 +171,7 @@ struct StreamConfig {
     float foveationEdgeRatioY;
     int trackingSpaceType;
     bool extraLatencyMode;
+    bool dropLateFrames;
 };
 
 extern "C" void decoderInput(long long frameIndex);
@@ -180,7 +181,8 @@ extern "C" OnCreateResult onCreate(void *env, void *activity, void *assetManager
 extern "C" void destroyNative(void *env);
 extern "C" void renderNative(long long renderedFrameIndex);
 extern "C" void renderLoadingNative();
-extern "C" void onTrackingNative(bool clientsidePrediction);
+// Returns the time in seconds from now to a predicted display time, NaN if not in VR mode
+extern "C" double onTrackingNative(bool clientsidePrediction);
 extern "C" OnResumeResult onResumeNative(void *surface, bool darkMode);
 extern "C" void setStreamConfig(StreamConfig config);
 extern "C" void onStreamStartNative();
@@ -193,7 +195,13 @@ extern "C" void onBatteryChangedNative(int battery, int plugged);
 extern "C" GuardianData getGuardianData();
 
 extern "C" void
-initializeSocket(void *env, void *instance, void *nalClass, unsigned int codec, bool enableFEC);
+initializeSocket(void *env,
+                 void *instance,
+                 void *nalClass,
+                 unsigned int codec,
+                 bool enableFEC,
+                 unsigned int fecCodec,
+                 unsigned int videoPacketSize);
 extern "C" void legacyReceive(const unsigned char *packet, unsigned int packetSize);
 extern "C" void sendTimeSync();
 extern "C" unsigned char isConnectedNative();
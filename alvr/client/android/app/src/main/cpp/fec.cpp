@@ -8,12 +8,17 @@
 
 bool FECQueue::reed_solomon_initialized = false;
 
-FECQueue::FECQueue() {
+FECQueue::FECQueue(size_t packetSize, int fecCodec)
+    : m_packetSize(packetSize), m_fecCodec(fecCodec) {
     m_currentFrame.videoFrameIndex = UINT64_MAX;
     m_recovered = true;
     m_fecFailure = false;
 
-    if (!reed_solomon_initialized) {
+    if (m_fecCodec == ALVR_FEC_CODEC_RS16) {
+        // One packet per shard, shards must have an even size (same as the server)
+        m_packetSize &= ~(size_t) 1;
+        fft_rs_init();
+    } else if (!reed_solomon_initialized) {
         reed_solomon_init();
         reed_solomon_initialized = true;
     }
@@ -54,11 +59,14 @@ void FECQueue::addVideoPacket(const VideoFrame *packet, int packetSize, bool &fe
             reed_solomon_release(m_rs);
         }
 
-        uint32_t fecDataPackets = (packet->frameByteSize + ALVR_MAX_VIDEO_BUFFER_SIZE - 1) /
-                                  ALVR_MAX_VIDEO_BUFFER_SIZE;
-        m_shardPackets = CalculateFECShardPackets(m_currentFrame.frameByteSize,
-                                                  m_currentFrame.fecPercentage);
-        m_blockSize = m_shardPackets * ALVR_MAX_VIDEO_BUFFER_SIZE;
+        uint32_t fecDataPackets = (packet->frameByteSize + m_packetSize - 1) / m_packetSize;
+        if (m_fecCodec == ALVR_FEC_CODEC_RS16) {
+            m_shardPackets = 1;
+        } else {
+            m_shardPackets = CalculateFECShardPackets(m_currentFrame.frameByteSize,
+                                                      m_currentFrame.fecPercentage, m_packetSize);
+        }
+        m_blockSize = m_shardPackets * m_packetSize;
 
         m_totalDataShards = (m_currentFrame.frameByteSize + m_blockSize - 1) / m_blockSize;
         m_totalParityShards = CalculateParityShards(m_totalDataShards,
@@ -75,9 +83,11 @@ void FECQueue::addVideoPacket(const VideoFrame *packet, int packetSize, bool &fe
 
         m_shards.resize(m_totalShards);
 
-        m_rs = reed_solomon_new(m_totalDataShards, m_totalParityShards);
-        if (m_rs == NULL) {
-            return;
+        if (m_fecCodec != ALVR_FEC_CODEC_RS16) {
+            m_rs = reed_solomon_new(m_totalDataShards, m_totalParityShards);
+            if (m_rs == NULL) {
+                return;
+            }
         }
 
         m_marks.resize(m_shardPackets);
@@ -150,13 +160,18 @@ void FECQueue::addVideoPacket(const VideoFrame *packet, int packetSize, bool &fe
         m_receivedParityShards[packetIndex]++;
     }
 
-    std::byte *p = &m_frameBuffer[packet->fecIndex * ALVR_MAX_VIDEO_BUFFER_SIZE];
+    std::byte *p = &m_frameBuffer[packet->fecIndex * m_packetSize];
     char *payload = ((char *) packet) + sizeof(VideoFrame);
-    int payloadSize = packetSize - sizeof(VideoFrame);
+    size_t payloadSize = packetSize - sizeof(VideoFrame);
+    if (payloadSize > m_packetSize) {
+        LOGE("Video packet bigger than the negotiated size. size=%zu packetSize=%zu", payloadSize,
+             m_packetSize);
+        payloadSize = m_packetSize;
+    }
     memcpy(p, payload, payloadSize);
-    if (payloadSize != ALVR_MAX_VIDEO_BUFFER_SIZE) {
+    if (payloadSize != m_packetSize) {
         // Fill padding
-        memset(p + payloadSize, 0, ALVR_MAX_VIDEO_BUFFER_SIZE - payloadSize);
+        memset(p + payloadSize, 0, m_packetSize - payloadSize);
     }
 }
 
@@ -178,10 +193,8 @@ bool FECQueue::reconstruct() {
             m_recoveredPacket[packet] = true;
             continue;
         }
-        m_rs->shards = m_receivedDataShards[packet] +
-                       m_receivedParityShards[packet]; //Don't let RS complain about missing parity packets
-
-        if (m_rs->shards < (int) m_totalDataShards) {
+        size_t receivedShards = m_receivedDataShards[packet] + m_receivedParityShards[packet];
+        if (receivedShards < m_totalDataShards) {
             // Not enough parity data
             ret = false;
             continue;
@@ -192,13 +205,20 @@ bool FECQueue::reconstruct() {
                  packet, m_receivedDataShards[packet], m_totalDataShards,
                  m_receivedParityShards[packet], m_totalParityShards);
 
-        for (size_t i = 0; i < m_totalShards; i++) {
-            m_shards[i] = &m_frameBuffer[(i * m_shardPackets + packet) * ALVR_MAX_VIDEO_BUFFER_SIZE];
-        }
+        int result;
+        if (m_fecCodec == ALVR_FEC_CODEC_RS16) {
+            result = reconstructFFT();
+        } else {
+            m_rs->shards = receivedShards; //Don't let RS complain about missing parity packets
+
+            for (size_t i = 0; i < m_totalShards; i++) {
+                m_shards[i] = &m_frameBuffer[(i * m_shardPackets + packet) * m_packetSize];
+            }
 
-        int result = reed_solomon_reconstruct(m_rs, (unsigned char **) &m_shards[0],
+            result = reed_solomon_reconstruct(m_rs, (unsigned char **) &m_shards[0],
                                               &m_marks[packet][0],
-                                              m_totalShards, ALVR_MAX_VIDEO_BUFFER_SIZE);
+                                              m_totalShards, m_packetSize);
+        }
         m_recoveredPacket[packet] = true;
         // We should always provide enough parity to recover the missing data successfully.
         // If this fails, something is probably wrong with our FEC state.
@@ -208,7 +228,7 @@ bool FECQueue::reconstruct() {
         }
         /*
         for(int i = 0; i < m_totalShards * m_shardPackets; i++) {
-            char *p = &frameBuffer[ALVR_MAX_VIDEO_BUFFER_SIZE * i];
+            char *p = &frameBuffer[m_packetSize * i];
             LOGI("Reconstructed packets. i=%d shardIndex=%d buffer=[%02X %02X %02X %02X %02X ...]", i, i / m_shardPackets, p[0], p[1], p[2], p[3], p[4]);
         }*/
     }
@@ -219,6 +239,50 @@ bool FECQueue::reconstruct() {
     return ret;
 }
 
+// With the GF(2^16) code there is a single shard column: the missing data packets are decoded
+// into the work buffers and copied back into the frame buffer.
+int FECQueue::reconstructFFT() {
+    std::vector<const unsigned char *> data(m_totalDataShards);
+    std::vector<const unsigned char *> parity(m_totalParityShards);
+    for (size_t i = 0; i < m_totalShards; i++) {
+        auto *shard = (const unsigned char *) &m_frameBuffer[i * m_packetSize];
+        bool received = m_marks[0][i] == 0;
+        if (i < m_totalDataShards) {
+            data[i] = received ? shard : nullptr;
+        } else {
+            parity[i - m_totalDataShards] = received ? shard : nullptr;
+        }
+    }
+
+    int workCount = fft_rs_decode_work_count(m_totalDataShards, m_totalParityShards);
+    if (m_fftWork.size() < workCount * m_packetSize) {
+        m_fftWork.resize(workCount * m_packetSize);
+    }
+    std::vector<unsigned char *> work(workCount);
+    for (int i = 0; i < workCount; i++) {
+        work[i] = &m_fftWork[i * m_packetSize];
+    }
+
+    // allocated once, the decoder clears it on each call
+    if (m_fftScratch.empty()) {
+        m_fftScratch.resize(FFT_RS_DECODE_SCRATCH_SIZE);
+    }
+
+    int result = fft_rs_decode(m_totalDataShards, m_totalParityShards, m_packetSize, &data[0],
+                               &parity[0], &work[0], &m_fftScratch[0]);
+    if (result != 0) {
+        return result;
+    }
+
+    for (size_t i = 0; i < m_totalDataShards; i++) {
+        if (data[i] == nullptr) {
+            memcpy(&m_frameBuffer[i * m_packetSize], work[i], m_packetSize);
+        }
+    }
+
+    return 0;
+}
+
 const std::byte *FECQueue::getFrameBuffer() {
     return &m_frameBuffer[0];
 }
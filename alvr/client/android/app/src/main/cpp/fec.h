@@ -8,7 +8,7 @@
 
 class FECQueue {
 public:
-    FECQueue();
+    FECQueue(size_t packetSize, int fecCodec);
     ~FECQueue();
 
     void addVideoPacket(const VideoFrame *packet, int packetSize, bool &fecFailure);
@@ -19,7 +19,11 @@ public:
     bool fecFailure();
     void clearFecFailure();
 private:
+    int reconstructFFT();
 
+    // Payload size of the video packets, negotiated when the stream starts
+    size_t m_packetSize;
+    int m_fecCodec;
     VideoFrame m_currentFrame;
     size_t m_shardPackets;
     size_t m_blockSize;
@@ -36,6 +40,8 @@ private:
     bool m_recovered;
     bool m_fecFailure;
     reed_solomon *m_rs = NULL;
+    std::vector<unsigned char> m_fftWork;
+    std::vector<unsigned short> m_fftScratch;
 
     static bool reed_solomon_initialized;
 };
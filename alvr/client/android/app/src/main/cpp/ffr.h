@@ -1,10 +1,7 @@
 #pragma once
 
-#include <memory>
-#include <vector>
-
-#include "gl_render_utils/render_pipeline.h"
-#include "packet_types.h"
+#include <cstdint>
+#include <string>
 
 struct FFRData {
     bool enabled;
@@ -18,20 +15,30 @@ struct FFRData {
     float edgeRatioY;
 };
 
-class FFR {
-public:
-    FFR(gl_render_utils::Texture *inputSurface);
-
-    void Initialize(FFRData ffrData);
+// Foveation parameters aligned the same way as the server does, so that the foveated frame
+// layout matches the encoded one. No GL state is involved, this can run on the host.
+struct FoveationVars {
+    uint32_t targetEyeWidth;
+    uint32_t targetEyeHeight;
+    uint32_t optimizedEyeWidth;
+    uint32_t optimizedEyeHeight;
 
-    void Render() const;
+    float eyeWidthRatio;
+    float eyeHeightRatio;
 
-    gl_render_utils::Texture *GetOutputTexture() { return mExpandedTexture.get(); }
+    float centerSizeX;
+    float centerSizeY;
+    float centerShiftX;
+    float centerShiftY;
+    float edgeRatioX;
+    float edgeRatioY;
+};
 
-private:
+FoveationVars CalculateFoveationVars(FFRData data);
 
-    gl_render_utils::Texture *mInputSurface;
-    std::unique_ptr<gl_render_utils::Texture> mExpandedTexture;
-    std::unique_ptr<gl_render_utils::RenderState> mExpandedTextureState;
-    std::unique_ptr<gl_render_utils::RenderPipeline> mDecompressAxisAlignedPipeline;
-};
+// GLSL ES 3.00 source, without #version and extensions, defining
+// vec2 DecompressAxisAlignedUV(vec2 uv)
+// which maps a UV of the full resolution frame (both eyes side by side) to the UV of the foveated
+// frame. The eye rendering samples the decoded frame through it, so every output pixel reads the
+// decoded frame once, without an intermediate full resolution texture.
+std::string GetFFRDecompressShader(FFRData data);
@@ -0,0 +1,174 @@
+#include "haptics_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+HapticsScheduler::HapticsScheduler(HapticsOutput &output) : m_output(output) {}
+
+HapticsScheduler::~HapticsScheduler() {
+    Stop();
+}
+
+void HapticsScheduler::SetDevice(int hand, const HapticsDevice &newDevice) {
+    auto device = newDevice;
+    if (device.mode == HapticsDevice::BUFFERED &&
+        (device.samplesMax == 0 || device.sampleDurationMs == 0)) {
+        device.mode = HapticsDevice::SIMPLE;
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+
+    auto &h = m_hands[hand];
+    if (h.device.mode == device.mode && h.device.deviceId == device.deviceId &&
+        h.device.samplesMax == device.samplesMax &&
+        h.device.sampleDurationMs == device.sampleDurationMs) {
+        return;
+    }
+
+    // The previous device is gone, an ongoing vibration continues on the new one
+    h.device = device;
+    h.samples.assign(device.mode == HapticsDevice::BUFFERED ? device.samplesMax : 0, 0);
+    h.queuedUntil = 0;
+    h.playing = false;
+
+    m_pending = true;
+    m_wakeup.notify_one();
+}
+
+void HapticsScheduler::Request(int hand, float durationS, float amplitude) {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto &h = m_hands[hand];
+    h.requested = true;
+    h.requestedDurationS = durationS;
+    h.amplitude = min(max(amplitude, 0.f), 1.f);
+
+    m_pending = true;
+    m_wakeup.notify_one();
+}
+
+void HapticsScheduler::Start() {
+    if (m_thread.joinable()) {
+        return;
+    }
+    m_running = true;
+    m_thread = thread(&HapticsScheduler::Run, this);
+}
+
+void HapticsScheduler::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_running = false;
+        m_wakeup.notify_one();
+    }
+    m_thread.join();
+
+    lock_guard<mutex> lock(m_mutex);
+    double now = m_output.GetTime();
+    for (auto &h : m_hands) {
+        h.requested = false;
+        StopHand(h, now);
+    }
+}
+
+void HapticsScheduler::StopHand(Hand &h, double now) {
+    if (h.playing) {
+        if (h.device.mode == HapticsDevice::BUFFERED) {
+            uint8_t silence = 0;
+            m_output.SetBuffer(h.device.deviceId, now, &silence, 1, true);
+        } else if (h.device.mode == HapticsDevice::SIMPLE) {
+            m_output.SetSimple(h.device.deviceId, 0);
+        }
+    }
+    h.playing = false;
+    h.active = false;
+}
+
+double HapticsScheduler::Update(double now) {
+    lock_guard<mutex> lock(m_mutex);
+
+    double next = -1;
+    for (auto &h : m_hands) {
+        if (h.requested) {
+            h.requested = false;
+            if (h.requestedDurationS <= 0 || h.amplitude <= 0) {
+                StopHand(h, now);
+                continue;
+            }
+            h.active = true;
+            h.endTime = now + h.requestedDurationS;
+            // the new request replaces what is still queued
+            h.queuedUntil = now;
+            if (h.device.mode == HapticsDevice::SIMPLE) {
+                h.playing = false;
+            }
+        }
+
+        if (!h.active) {
+            continue;
+        }
+        if (h.device.mode == HapticsDevice::NONE || now >= h.endTime) {
+            StopHand(h, now);
+            continue;
+        }
+
+        double due = h.endTime;
+        if (h.device.mode == HapticsDevice::BUFFERED) {
+            double sampleDuration = h.device.sampleDurationMs * 1e-3;
+            double halfBuffer = h.samples.size() * sampleDuration / 2;
+
+            // same expression as the update time below, so that the refill is not missed when
+            // Update() is called exactly at that time
+            if (now >= h.queuedUntil - halfBuffer) {
+                double from = max(h.queuedUntil, now);
+                // top up to one device buffer ahead of now
+                double room = now + h.samples.size() * sampleDuration - from;
+                double count = min(floor(room / sampleDuration + 1e-6),
+                                   ceil((h.endTime - from) / sampleDuration));
+                if (count >= 1) {
+                    auto samples = (uint32_t)count;
+                    fill_n(h.samples.begin(), samples, (uint8_t)(255 * h.amplitude));
+                    m_output.SetBuffer(h.device.deviceId, from, h.samples.data(), samples, false);
+                    h.queuedUntil = from + samples * sampleDuration;
+                    h.playing = true;
+                }
+            }
+            if (h.queuedUntil < h.endTime) {
+                due = min(due, h.queuedUntil - halfBuffer);
+            }
+        } else if (!h.playing) {
+            m_output.SetSimple(h.device.deviceId, h.amplitude);
+            h.playing = true;
+        }
+
+        next = next < 0 ? due : min(next, due);
+    }
+
+    return next;
+}
+
+void HapticsScheduler::Run() {
+    unique_lock<mutex> lock(m_mutex);
+    while (m_running) {
+        m_pending = false;
+
+        lock.unlock();
+        double now = m_output.GetTime();
+        double next = Update(now);
+        lock.lock();
+
+        auto pendingOrStopped = [this] { return m_pending || !m_running; };
+        if (next < 0) {
+            m_wakeup.wait(lock, pendingOrStopped);
+        } else {
+            m_wakeup.wait_for(lock, chrono::duration<double>(max(next - now, 0.)),
+                              pendingOrStopped);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Haptics capabilities of a controller, as reported by the runtime
+struct HapticsDevice {
+    enum Mode {
+        NONE,
+        SIMPLE,
+        BUFFERED,
+    };
+
+    Mode mode = NONE;
+    uint32_t deviceId = 0;
+    uint32_t samplesMax = 0;
+    uint32_t sampleDurationMs = 0;
+};
+
+// Where the scheduler sends the vibrations. Implemented on top of vrapi on the headset; a fake can
+// be used to run the scheduler on the host.
+class HapticsOutput {
+public:
+    virtual ~HapticsOutput() = default;
+
+    // Seconds, on the same clock as bufferTime
+    virtual double GetTime() = 0;
+    // samples are amplitudes (0-255) lasting the sample duration of the device each, starting at
+    // bufferTime
+    virtual void SetBuffer(uint32_t deviceId, double bufferTime, const uint8_t *samples,
+                           uint32_t count, bool terminated) = 0;
+    virtual void SetSimple(uint32_t deviceId, float amplitude) = 0;
+};
+
+// Plays the haptics requested by the server at the pace of the controllers instead of the frame
+// rate. Buffered devices are fed one device buffer ahead, refilled when half of it has been played,
+// so vibrations have no gaps and stop within one sample of the requested duration.
+// Request() and SetDevice() can be called from any thread. Update() is called by the scheduler
+// thread between Start() and Stop(), or directly when driving the scheduler with a fake clock.
+class HapticsScheduler {
+public:
+    // 0: right hand, 1: left hand
+    static const int HANDS = 2;
+
+    explicit HapticsScheduler(HapticsOutput &output);
+    ~HapticsScheduler();
+
+    void SetDevice(int hand, const HapticsDevice &device);
+    void Request(int hand, float durationS, float amplitude);
+
+    void Start();
+    // Stops the thread and the ongoing vibrations
+    void Stop();
+
+    // Submits the samples due at time now. Returns the time of the next needed update, or a
+    // negative value when nothing is playing.
+    double Update(double now);
+
+private:
+    struct Hand {
+        HapticsDevice device;
+        // device.samplesMax samples, reallocated only when the device changes
+        std::vector<uint8_t> samples;
+
+        bool requested = false;
+        float requestedDurationS = 0;
+        float amplitude = 0;
+
+        bool active = false;
+        double endTime = 0;
+        // end of the samples submitted so far, for buffered devices
+        double queuedUntil = 0;
+        // a buffer or a simple vibration is playing and must be terminated
+        bool playing = false;
+    };
+
+    void StopHand(Hand &hand, double now);
+    void Run();
+
+    HapticsOutput &m_output;
+
+    std::mutex m_mutex;
+    Hand m_hands[HANDS];
+
+    std::thread m_thread;
+    std::condition_variable m_wakeup;
+    bool m_running = false;
+    bool m_pending = false;
+};
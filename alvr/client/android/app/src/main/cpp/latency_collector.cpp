@@ -1,4 +1,5 @@
 #include <jni.h>
+#include <algorithm>
 #include "latency_collector.h"
 #include "utils.h"
 #include "bindings.h"
@@ -25,6 +26,14 @@ void LatencyCollector::setTotalLatency(uint32_t latency) {
 void LatencyCollector::tracking(uint64_t frameIndex) {
     getFrame(frameIndex).tracking = getTimestampUs();
 }
+void LatencyCollector::trackingSent(uint64_t sampleTime) {
+    checkAndResetSecond();
+
+    uint64_t latency = getTimestampUs() - sampleTime;
+    m_TrackingSendLatencyInSecond += latency;
+    m_TrackingSendLatencyMaxInSecond = std::max(m_TrackingSendLatencyMaxInSecond, latency);
+    m_TrackingSentInSecond++;
+}
 void LatencyCollector::estimatedSent(uint64_t frameIndex, uint64_t offset) {
     getFrame(frameIndex).estimatedSent = getTimestampUs() + offset;
 }
@@ -91,6 +100,9 @@ void LatencyCollector::resetAll() {
     m_FecFailureInSecond = 0;
     m_FecFailurePrevious = 0;
 
+    m_LateFramesSkippedInSecond = 0;
+    m_LateFramesSkippedPrevious = 0;
+
     m_FramesInSecond = 0;
 
     m_StatisticsTime = getTimestampUs() / USECS_IN_SEC;
@@ -106,6 +118,16 @@ void LatencyCollector::resetSecond(){
 
     m_FecFailurePrevious = m_FecFailureInSecond;
     m_FecFailureInSecond = 0;
+
+    m_LateFramesSkippedPrevious = m_LateFramesSkippedInSecond;
+    m_LateFramesSkippedInSecond = 0;
+
+    m_TrackingSendLatency =
+            m_TrackingSentInSecond ? m_TrackingSendLatencyInSecond / m_TrackingSentInSecond : 0;
+    m_TrackingSendLatencyMax = m_TrackingSendLatencyMaxInSecond;
+    m_TrackingSendLatencyInSecond = 0;
+    m_TrackingSendLatencyMaxInSecond = 0;
+    m_TrackingSentInSecond = 0;
 }
 
 void LatencyCollector::checkAndResetSecond() {
@@ -130,6 +152,12 @@ void LatencyCollector::fecFailure() {
     m_FecFailureInSecond++;
 }
 
+void LatencyCollector::lateFrameSkipped() {
+    checkAndResetSecond();
+
+    m_LateFramesSkippedInSecond++;
+}
+
 void LatencyCollector::submitNewFrame() {
     checkAndResetSecond();
 }
@@ -156,6 +184,15 @@ uint64_t LatencyCollector::getFecFailureTotal() {
 uint64_t LatencyCollector::getFecFailureInSecond() {
     return m_FecFailurePrevious;
 }
+uint64_t LatencyCollector::getLateFramesSkippedInSecond() {
+    return m_LateFramesSkippedPrevious;
+}
+uint64_t LatencyCollector::getTrackingSendLatency() {
+    return m_TrackingSendLatency;
+}
+uint64_t LatencyCollector::getTrackingSendLatencyMax() {
+    return m_TrackingSendLatencyMax;
+}
 float LatencyCollector::getFramesInSecond() {
     return m_FramesInSecond;
 }
@@ -15,13 +15,21 @@ public:
     uint64_t getFecFailureTotal();
     uint64_t getFecFailureInSecond();
     float getFramesInSecond();
+    // Average and maximum of the previous second, in microseconds
+    uint64_t getTrackingSendLatency();
+    uint64_t getTrackingSendLatencyMax();
+    uint64_t getLateFramesSkippedInSecond();
 
     void packetLoss(int64_t lost);
     void fecFailure();
+    // A decoded frame was not rendered because it could not be displayed in time anymore
+    void lateFrameSkipped();
 
     void setTotalLatency(uint32_t latency);
 
     void tracking(uint64_t frameIndex);
+    // The tracking packet sampled at sampleTime was handed to the network
+    void trackingSent(uint64_t sampleTime);
     void estimatedSent(uint64_t frameIndex, uint64_t offset);
     void received(uint64_t frameIndex);
     void receivedFirst(uint64_t frameIndex);
@@ -68,9 +76,18 @@ private:
     uint64_t m_FecFailureTotal = 0;
     uint64_t m_FecFailureInSecond = 0;
     uint64_t m_FecFailurePrevious = 0;
+    uint64_t m_LateFramesSkippedInSecond = 0;
+    uint64_t m_LateFramesSkippedPrevious = 0;
 
     uint32_t m_ServerTotalLatency = 0;
 
+    // Tracking sample to send latency. Written by the tracking thread only.
+    uint64_t m_TrackingSendLatencyInSecond = 0;
+    uint64_t m_TrackingSendLatencyMaxInSecond = 0;
+    uint64_t m_TrackingSentInSecond = 0;
+    uint64_t m_TrackingSendLatency = 0;
+    uint64_t m_TrackingSendLatencyMax = 0;
+
     // Total/Transport/Decode/Idle latency
     uint64_t m_Latency[5];
 
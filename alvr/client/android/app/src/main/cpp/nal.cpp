@@ -13,9 +13,62 @@ static const std::byte NAL_TYPE_SPS = static_cast<const std::byte>(7);
 
 static const std::byte H265_NAL_TYPE_VPS = static_cast<const std::byte>(32);
 
+static const int AV1_OBU_SEQUENCE_HEADER = 1;
+static const int AV1_OBU_FRAME_HEADER = 3;
+static const int AV1_OBU_FRAME = 6;
+static const int AV1_KEY_FRAME = 0;
+
+// A temporal unit is a keyframe when it contains a new frame (not show_existing_frame) of type
+// KEY_FRAME. The sequence header can't be used for this, encoders are free to repeat it.
+static bool isAV1KeyFrame(const std::byte *buffer, int size)
+{
+    auto data = reinterpret_cast<const uint8_t *>(buffer);
+    auto end = data + size;
+    bool reducedStillPictureHeader = false;
+    while (data < end) {
+        int obuType = (data[0] >> 3) & 0xF;
+        bool hasExtension = data[0] & 0x4;
+        bool hasSize = data[0] & 0x2;
+
+        auto payload = data + 1 + hasExtension;
+        uint64_t payloadSize = 0;
+        if (hasSize) {
+            // leb128
+            for (int i = 0; i < 8 && payload < end; i++) {
+                uint8_t byte = *payload++;
+                payloadSize |= uint64_t(byte & 0x7F) << (7 * i);
+                if (!(byte & 0x80))
+                    break;
+            }
+        } else if (payload <= end) {
+            payloadSize = end - payload;
+        }
+        if (payload >= end || payloadSize > uint64_t(end - payload))
+            return false;
+
+        if (obuType == AV1_OBU_SEQUENCE_HEADER) {
+            // seq_profile (3 bits), still_picture (1), reduced_still_picture_header (1)
+            reducedStillPictureHeader = payload[0] & 0x8;
+        } else if (obuType == AV1_OBU_FRAME_HEADER || obuType == AV1_OBU_FRAME) {
+            // all the frames of a reduced still picture stream are keyframes
+            if (reducedStillPictureHeader)
+                return true;
+            // show_existing_frame (1 bit), frame_type (2)
+            bool showExistingFrame = payload[0] & 0x80;
+            int frameType = (payload[0] >> 5) & 0x3;
+            if (!showExistingFrame && frameType == AV1_KEY_FRAME)
+                return true;
+        }
+
+        data = payload + payloadSize;
+    }
+    return false;
+}
 
-NALParser::NALParser(JNIEnv *env, jobject udpManager, jclass nalClass, bool enableFEC)
-    : m_enableFEC(enableFEC)
+
+NALParser::NALParser(JNIEnv *env, jobject udpManager, jclass nalClass, bool enableFEC,
+                     int fecCodec, size_t videoPacketSize)
+    : m_enableFEC(enableFEC), m_queue(videoPacketSize, fecCodec)
 {
     LOGE("NALParser initialized %p", this);
 
@@ -63,6 +116,19 @@ bool NALParser::processPacket(VideoFrame *packet, int packetSize, bool &fecFailu
             frameByteSize = packetSize - sizeof(VideoFrame);
         }
 
+        if (m_codec == ALVR_CODEC_AV1)
+        {
+            // AV1 frames are OBUs without start codes. The sequence header is kept in band: the
+            // decoder is configured from the keyframe itself.
+            if (isAV1KeyFrame(frameBuffer, frameByteSize))
+            {
+                LOGI("Got AV1 keyframe, size=%d", frameByteSize);
+                m_queue.clearFecFailure();
+            }
+            push(&frameBuffer[0], frameByteSize, packet->trackingFrameIndex);
+            return true;
+        }
+
         std::byte NALType;
         if (m_codec == ALVR_CODEC_H264)
             NALType = frameBuffer[4] & std::byte(0x1F);
@@ -9,7 +9,8 @@
 
 class NALParser {
 public:
-    NALParser(JNIEnv *env, jobject udpManager, jclass nalClass, bool enableFEC);
+    NALParser(JNIEnv *env, jobject udpManager, jclass nalClass, bool enableFEC, int fecCodec,
+              size_t videoPacketSize);
     ~NALParser();
 
     void setCodec(int codec);
@@ -9,6 +9,7 @@
 #include <VrApi_Input.h>
 #include <memory>
 #include <chrono>
+#include <cmath>
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
 #include <android/input.h>
@@ -19,10 +20,12 @@
 #include <GLES2/gl2ext.h>
 #include <string>
 #include <map>
+#include <algorithm>
 #include <vector>
 #include "utils.h"
 #include "render.h"
 #include "latency_collector.h"
+#include "haptics_scheduler.h"
 #include "packet_types.h"
 #include "asset.h"
 #include <inttypes.h>
@@ -48,6 +51,8 @@ uint64_t RIGHT_CONTROLLER_HAPTICS_PATH;
 const chrono::duration<float> MENU_BUTTON_LONG_PRESS_DURATION = 5s;
 const uint32_t ovrButton_Unknown1 = 0x01000000;
 const int MAXIMUM_TRACKING_FRAMES = 360;
+// VrApi has no connection events for input devices, the device list is polled at this interval
+const double INPUT_DEVICES_REFRESH_INTERVAL_S = 0.5;
 
 struct TrackingFrame {
     ovrTracking2 tracking;
@@ -56,6 +61,25 @@ struct TrackingFrame {
     double displayTime;
 };
 
+struct InputDevice {
+    ovrInputCapabilityHeader header;
+    // valid if header.Type == ovrControllerType_Hand
+    ovrInputHandCapabilities handCapabilities;
+    // valid if header.Type == ovrControllerType_TrackedRemote
+    ovrInputTrackedRemoteCapabilities remoteCapabilities;
+    // The bind pose of a hand does not change, it is fetched with the capabilities
+    ovrHandSkeleton handSkeleton;
+    bool hasHandSkeleton;
+};
+
+class VrapiHapticsOutput : public HapticsOutput {
+public:
+    double GetTime() override;
+    void SetBuffer(uint32_t deviceId, double bufferTime, const uint8_t *samples, uint32_t count,
+                   bool terminated) override;
+    void SetSimple(uint32_t deviceId, float amplitude) override;
+};
+
 class OvrContext {
 public:
     ANativeWindow *window = nullptr;
@@ -85,6 +109,12 @@ public:
     TRACKING_FRAME_MAP trackingFrameMap;
     std::mutex trackingFrameMutex;
 
+    // Average time between the predicted display time of the frames and their rendering, in
+    // seconds. Used by the render thread only.
+    double renderLateness = 0;
+    bool hasRenderLateness = false;
+    bool lastFrameSkipped = false;
+
     bool darkMode;
     ovrRenderer Renderer;
 
@@ -98,18 +128,13 @@ public:
     ovrTracking lastTrackingRot[2];
     ovrTracking lastTrackingPos[2];
 
-    struct HapticsState {
-        uint64_t startUs;
-        uint64_t endUs;
-        float amplitude;
-        float frequency;
-        bool fresh;
-        bool buffered;
-    };
-    // mHapticsState[0]: right hand state
-    // mHapticsState[1]: left hand state
-    HapticsState mHapticsState[2]{};
+    // Capabilities are queried once per connected device, not every frame
+    vector<InputDevice> inputDevices;
+    double inputDevicesRefreshTime = 0;
+    bool inputDevicesStale = true;
 
+    VrapiHapticsOutput hapticsOutput;
+    HapticsScheduler haptics{hapticsOutput};
 
     std::chrono::system_clock::time_point mMenuNotPressedLastInstant;
     bool mMenuLongPressActivated = false;
@@ -119,6 +144,31 @@ namespace {
     OvrContext g_ctx;
 }
 
+double VrapiHapticsOutput::GetTime() {
+    return vrapi_GetTimeInSeconds();
+}
+
+void VrapiHapticsOutput::SetBuffer(uint32_t deviceId, double bufferTime, const uint8_t *samples,
+                                   uint32_t count, bool terminated) {
+    ovrHapticBuffer buffer;
+    buffer.BufferTime = bufferTime;
+    buffer.HapticBuffer = const_cast<uint8_t *>(samples);
+    buffer.NumSamples = count;
+    buffer.Terminated = terminated;
+
+    auto result = vrapi_SetHapticVibrationBuffer(g_ctx.Ovr, deviceId, &buffer);
+    if (result != ovrSuccess) {
+        LOGI("vrapi_SetHapticVibrationBuffer: Failed. result=%d", result);
+    }
+}
+
+void VrapiHapticsOutput::SetSimple(uint32_t deviceId, float amplitude) {
+    auto result = vrapi_SetHapticVibrationSimple(g_ctx.Ovr, deviceId, amplitude);
+    if (result != ovrSuccess) {
+        LOGI("vrapi_SetHapticVibrationSimple: Failed. result=%d", result);
+    }
+}
+
 OnCreateResult onCreate(void *v_env, void *v_activity, void *v_assetManager) {
     auto *env = (JNIEnv *) v_env;
     auto activity = (jobject) v_activity;
@@ -184,8 +234,6 @@ OnCreateResult onCreate(void *v_env, void *v_activity, void *v_assetManager) {
                     GL_CLAMP_TO_EDGE);
 
 
-    memset(g_ctx.mHapticsState, 0, sizeof(g_ctx.mHapticsState));
-
     //ovrPlatformInitializeResult res = ovr_PlatformInitializeAndroid("", activity, env);
     //LOGI("ovrPlatformInitializeResult %s", ovrPlatformInitializeResult_ToString(res));
     //ovrRequest req;
@@ -297,32 +345,106 @@ uint64_t mapButtons(ovrInputTrackedRemoteCapabilities *remoteCapabilities,
 }
 
 
+// Called from TrackingThread
+void refreshInputDevices() {
+    double now = vrapi_GetTimeInSeconds();
+    if (!g_ctx.inputDevicesStale &&
+        now - g_ctx.inputDevicesRefreshTime < INPUT_DEVICES_REFRESH_INTERVAL_S) {
+        return;
+    }
+    g_ctx.inputDevicesStale = false;
+    g_ctx.inputDevicesRefreshTime = now;
+
+    vector<InputDevice> devices;
+    ovrInputCapabilityHeader header;
+    for (uint32_t deviceIndex = 0;
+         vrapi_EnumerateInputDevices(g_ctx.Ovr, deviceIndex, &header) >= 0; deviceIndex++) {
+        auto known = find_if(g_ctx.inputDevices.begin(), g_ctx.inputDevices.end(),
+                             [&](const InputDevice &device) {
+                                 return device.header.DeviceID == header.DeviceID &&
+                                        device.header.Type == header.Type;
+                             });
+        if (known != g_ctx.inputDevices.end()) {
+            devices.push_back(*known);
+            continue;
+        }
+
+        InputDevice device = {};
+        device.header = header;
+        ovrResult result;
+        if (header.Type == ovrControllerType_Hand) {
+            device.handCapabilities.Header = header;
+            result = vrapi_GetInputDeviceCapabilities(g_ctx.Ovr, &device.handCapabilities.Header);
+        } else if (header.Type == ovrControllerType_TrackedRemote) {
+            device.remoteCapabilities.Header = header;
+            result = vrapi_GetInputDeviceCapabilities(g_ctx.Ovr,
+                                                      &device.remoteCapabilities.Header);
+        } else {
+            continue;
+        }
+        if (result != ovrSuccess) {
+            continue;
+        }
+
+        if (header.Type == ovrControllerType_Hand) {
+            ovrHandedness handedness =
+                    device.handCapabilities.HandCapabilities & ovrHandCaps_LeftHand ? VRAPI_HAND_LEFT
+                                                                                    : VRAPI_HAND_RIGHT;
+            device.handSkeleton.Header.Version = ovrHandVersion_1;
+            device.hasHandSkeleton = vrapi_GetHandSkeleton(g_ctx.Ovr, handedness,
+                                                           &device.handSkeleton.Header) == ovrSuccess;
+            if (!device.hasHandSkeleton) {
+                LOG("VrHands - failed to get hand skeleton");
+            }
+        }
+
+        LOGI("Input device connected: Type=%d ID=%d", header.Type, header.DeviceID);
+        devices.push_back(device);
+    }
+    g_ctx.inputDevices = devices;
+
+    HapticsDevice hapticsDevices[HapticsScheduler::HANDS];
+    for (auto &device : g_ctx.inputDevices) {
+        if (device.header.Type != ovrControllerType_TrackedRemote) {
+            continue;
+        }
+        auto &caps = device.remoteCapabilities;
+        auto &h = hapticsDevices[(caps.ControllerCapabilities & ovrControllerCaps_LeftHand) ? 1
+                                                                                           : 0];
+        h.deviceId = device.header.DeviceID;
+        if (caps.ControllerCapabilities & ovrControllerCaps_HasBufferedHapticVibration) {
+            // Note: HapticSamplesMax=25 HapticSampleDurationMS=2 on Quest
+            h.mode = HapticsDevice::BUFFERED;
+            h.samplesMax = caps.HapticSamplesMax;
+            h.sampleDurationMs = caps.HapticSampleDurationMS;
+        } else if (caps.ControllerCapabilities & ovrControllerCaps_HasSimpleHapticVibration) {
+            h.mode = HapticsDevice::SIMPLE;
+        }
+    }
+    for (int hand = 0; hand < HapticsScheduler::HANDS; hand++) {
+        g_ctx.haptics.SetDevice(hand, hapticsDevices[hand]);
+    }
+}
+
 void setControllerInfo(TrackingInfo *packet, double displayTime) {
-    ovrInputCapabilityHeader curCaps;
     ovrResult result;
     int controller = 0;
 
-    for (uint32_t deviceIndex = 0;
-         vrapi_EnumerateInputDevices(g_ctx.Ovr, deviceIndex, &curCaps) >= 0; deviceIndex++) {
-        LOG("Device %d: Type=%d ID=%d", deviceIndex, curCaps.Type, curCaps.DeviceID);
+    refreshInputDevices();
+
+    for (auto &device : g_ctx.inputDevices) {
+        auto &curCaps = device.header;
         if (curCaps.Type == ovrControllerType_Hand) {  //A3
             // Oculus Quest Hand Tracking
             if (controller >= 2) {
-                LOG("Device %d: Ignore.", deviceIndex);
+                LOG("Device ID=%d: Ignore.", curCaps.DeviceID);
                 continue;
             }
 
             auto &c = packet->controller[controller];
 
-            ovrInputHandCapabilities handCapabilities;
+            auto &handCapabilities = device.handCapabilities;
             ovrInputStateHand inputStateHand;
-            handCapabilities.Header = curCaps;
-
-            result = vrapi_GetInputDeviceCapabilities(g_ctx.Ovr, &handCapabilities.Header);
-
-            if (result != ovrSuccess) {
-                continue;
-            }
 
             if ((handCapabilities.HandCapabilities & ovrHandCaps_LeftHand) != 0) {
                 c.flags |= TrackingInfo::Controller::FLAG_CONTROLLER_LEFTHAND;
@@ -332,6 +454,8 @@ void setControllerInfo(TrackingInfo *packet, double displayTime) {
             result = vrapi_GetCurrentInputState(g_ctx.Ovr, handCapabilities.Header.DeviceID,
                                                 &inputStateHand.Header);
             if (result != ovrSuccess) {
+                // disconnected, enumerate again next time
+                g_ctx.inputDevicesStale = true;
                 continue;
             }
 
@@ -344,17 +468,10 @@ void setControllerInfo(TrackingInfo *packet, double displayTime) {
             memcpy(&c.position, &inputStateHand.PointerPose.Position,
                    sizeof(inputStateHand.PointerPose.Position));
 
-            ovrHandedness handedness =
-                    handCapabilities.HandCapabilities & ovrHandCaps_LeftHand ? VRAPI_HAND_LEFT
-                                                                             : VRAPI_HAND_RIGHT;
-            ovrHandSkeleton handSkeleton;
-            handSkeleton.Header.Version = ovrHandVersion_1;
-            if (vrapi_GetHandSkeleton(g_ctx.Ovr, handedness, &handSkeleton.Header) != ovrSuccess) {
-                LOG("VrHands - failed to get hand skeleton");
-            } else {
+            if (device.hasHandSkeleton) {
                 for (int i = 0; i < ovrHandBone_MaxSkinnable; i++) {
-                    memcpy(&c.bonePositionsBase[i], &handSkeleton.BonePoses[i].Position,
-                           sizeof(handSkeleton.BonePoses[i].Position));
+                    memcpy(&c.bonePositionsBase[i], &device.handSkeleton.BonePoses[i].Position,
+                           sizeof(device.handSkeleton.BonePoses[i].Position));
                 }
             }
 
@@ -399,25 +516,22 @@ void setControllerInfo(TrackingInfo *packet, double displayTime) {
         if (curCaps.Type == ovrControllerType_TrackedRemote) {
             // Gear VR / Oculus Go 3DoF Controller / Oculus Quest Touch Controller
             if (controller >= 2) {
-                LOG("Device %d: Ignore.", deviceIndex);
+                LOG("Device ID=%d: Ignore.", curCaps.DeviceID);
                 continue;
             }
 
             auto &c = packet->controller[controller];
 
-            ovrInputTrackedRemoteCapabilities remoteCapabilities;
+            auto &remoteCapabilities = device.remoteCapabilities;
             ovrInputStateTrackedRemote remoteInputState;
 
-            remoteCapabilities.Header = curCaps;
-            result = vrapi_GetInputDeviceCapabilities(g_ctx.Ovr, &remoteCapabilities.Header);
-            if (result != ovrSuccess) {
-                continue;
-            }
             remoteInputState.Header.ControllerType = remoteCapabilities.Header.Type;
 
             result = vrapi_GetCurrentInputState(g_ctx.Ovr, remoteCapabilities.Header.DeviceID,
                                                 &remoteInputState.Header);
             if (result != ovrSuccess) {
+                // disconnected, enumerate again next time
+                g_ctx.inputDevicesStale = true;
                 continue;
             }
 
@@ -544,16 +658,13 @@ void setControllerInfo(TrackingInfo *packet, double displayTime) {
     }
 }
 
-float getIPD() {
-    ovrTracking2 tracking = vrapi_GetPredictedTracking2(g_ctx.Ovr, 0.0);
+float getIPD(const ovrTracking2 &tracking) {
     float ipd = vrapi_GetInterpupillaryDistance(&tracking);
     return ipd;
 }
 
 // return fov in OpenXR convention
-std::pair<EyeFov, EyeFov> getFov() {
-    ovrTracking2 tracking = vrapi_GetPredictedTracking2(g_ctx.Ovr, 0.0);
-
+std::pair<EyeFov, EyeFov> getFov(const ovrTracking2 &tracking) {
     EyeFov fov[2];
 
     for (int eye = 0; eye < 2; eye++) {
@@ -581,7 +692,8 @@ std::pair<EyeFov, EyeFov> getFov() {
     return {fov[0], fov[1]};
 }
 
-// Called from TrackingThread
+// Called from the tracking thread. The head pose is sampled first, all values come from a single
+// predicted tracking.
 void sendTrackingInfo(bool clientsidePrediction) {
     std::shared_ptr<TrackingFrame> frame(new TrackingFrame());
 
@@ -594,9 +706,6 @@ void sendTrackingInfo(bool clientsidePrediction) {
     frame->displayTime = vrapi_GetTimeInSeconds() + LatencyCollector::Instance().getTrackingPredictionLatency() * 1e-6;
     frame->tracking = vrapi_GetPredictedTracking2(g_ctx.Ovr, frame->displayTime);
 
-    // sort of hacky, SteamVR will predict the position while the orientation is predicted from the client
-    ovrTracking2 trackingRaw = vrapi_GetPredictedTracking2(g_ctx.Ovr, 0.);
-
     {
         std::lock_guard<decltype(g_ctx.trackingFrameMutex)> lock(g_ctx.trackingFrameMutex);
         g_ctx.trackingFrameMap.insert(
@@ -627,8 +736,11 @@ void sendTrackingInfo(bool clientsidePrediction) {
 
     inputSend(info);
 
-    float new_ipd = getIPD();
-    auto new_fov = getFov();
+    LatencyCollector::Instance().trackingSent(frame->fetchTime);
+
+    // The eye poses do not depend on the prediction time
+    float new_ipd = getIPD(frame->tracking);
+    auto new_fov = getFov(frame->tracking);
     if (abs(new_ipd - g_ctx.lastIpd) > 0.001 || abs(new_fov.first.left - g_ctx.lastFov.left) > 0.001) {
         EyeFov fov[2] = { new_fov.first, new_fov.second };
         viewsConfigSend(fov, new_ipd);
@@ -670,6 +782,10 @@ OnResumeResult onResumeNative(void *v_surface, bool darkMode) {
 
     vrapi_SetTrackingSpace(g_ctx.Ovr, g_ctx.m_UsedTrackingSpace);
 
+    g_ctx.inputDevices.clear();
+    g_ctx.inputDevicesStale = true;
+    g_ctx.haptics.Start();
+
     auto eyeWidth = vrapi_GetSystemPropertyInt(&g_ctx.java, VRAPI_SYS_PROP_DISPLAY_PIXELS_WIDE) / 2;
     auto eyeHeight = vrapi_GetSystemPropertyInt(&g_ctx.java,
                                                 VRAPI_SYS_PROP_DISPLAY_PIXELS_HIGH);
@@ -711,6 +827,8 @@ OnResumeResult onResumeNative(void *v_surface, bool darkMode) {
 
 void setStreamConfig(StreamConfig config) {
     g_ctx.streamConfig = config;
+    g_ctx.hasRenderLateness = false;
+    g_ctx.lastFrameSkipped = false;
 }
 
 void onStreamStartNative() {
@@ -763,6 +881,8 @@ void onStreamStartNative() {
 }
 
 void onPauseNative() {
+    g_ctx.haptics.Stop();
+
     ovrRenderer_Destroy(&g_ctx.Renderer);
 
     LOGI("Leaving VR mode.");
@@ -777,112 +897,27 @@ void onPauseNative() {
     g_ctx.window = nullptr;
 }
 
-void finishHapticsBuffer(ovrDeviceID DeviceID) {
-    uint8_t hapticBuffer[1] = {0};
-    ovrHapticBuffer buffer;
-    buffer.BufferTime = vrapi_GetPredictedDisplayTime(g_ctx.Ovr, g_ctx.FrameIndex);
-    buffer.HapticBuffer = &hapticBuffer[0];
-    buffer.NumSamples = 1;
-    buffer.Terminated = true;
-
-    auto result = vrapi_SetHapticVibrationBuffer(g_ctx.Ovr, DeviceID, &buffer);
-    if (result != ovrSuccess) {
-        LOGI("vrapi_SetHapticVibrationBuffer: Failed. result=%d", result);
-    }
-}
-
-void updateHapticsState() {
-    ovrInputCapabilityHeader curCaps;
-    ovrResult result;
-
-    for (uint32_t deviceIndex = 0;
-         vrapi_EnumerateInputDevices(g_ctx.Ovr, deviceIndex, &curCaps) >= 0; deviceIndex++) {
-        if (curCaps.Type == ovrControllerType_Gamepad) continue;
-        ovrInputTrackedRemoteCapabilities remoteCapabilities;
-
-        remoteCapabilities.Header = curCaps;
-        result = vrapi_GetInputDeviceCapabilities(g_ctx.Ovr, &remoteCapabilities.Header);
-        if (result != ovrSuccess) {
-            continue;
-        }
-
-        int curHandIndex = (remoteCapabilities.ControllerCapabilities & ovrControllerCaps_LeftHand)
-                           ? 1 : 0;
-        auto &s = g_ctx.mHapticsState[curHandIndex];
-
-        uint64_t currentUs = getTimestampUs();
-
-        if (s.fresh) {
-            s.startUs = s.startUs + currentUs;
-            s.endUs = s.startUs + s.endUs;
-            s.fresh = false;
-        }
-
-        if (s.startUs <= 0) {
-            // No requested haptics for this hand.
-            if (s.buffered) {
-                finishHapticsBuffer(curCaps.DeviceID);
-                s.buffered = false;
-            }
-            continue;
-        }
-
-        if (currentUs >= s.endUs) {
-            // No more haptics is needed.
-            s.startUs = 0;
-            if (s.buffered) {
-                finishHapticsBuffer(curCaps.DeviceID);
-                s.buffered = false;
-            }
-            continue;
-        }
-
-        if (remoteCapabilities.ControllerCapabilities &
-            ovrControllerCaps_HasBufferedHapticVibration) {
-            // Note: HapticSamplesMax=25 HapticSampleDurationMS=2 on Quest
-
-            // First, call with buffer.Terminated = false and when haptics is no more needed call with buffer.Terminated = true (to stop haptics?).
-            LOG("Send haptic buffer. HapticSamplesMax=%d HapticSampleDurationMS=%d",
-                remoteCapabilities.HapticSamplesMax, remoteCapabilities.HapticSampleDurationMS);
-
-            auto requiredHapticsBuffer = static_cast<uint32_t >((s.endUs - currentUs) /
-                                                                (remoteCapabilities.HapticSampleDurationMS *
-                                                                1000));
-
-            std::vector<uint8_t> hapticBuffer(remoteCapabilities.HapticSamplesMax);
-            ovrHapticBuffer buffer;
-            buffer.BufferTime = vrapi_GetPredictedDisplayTime(g_ctx.Ovr, g_ctx.FrameIndex);
-            buffer.HapticBuffer = &hapticBuffer[0];
-            buffer.NumSamples = std::min(remoteCapabilities.HapticSamplesMax,
-                                         requiredHapticsBuffer);
-            buffer.Terminated = false;
-
-            for (uint32_t i = 0; i < buffer.NumSamples; i++) {
-                if (s.amplitude > 1.0f)
-                    hapticBuffer[i] = 255;
-                else
-                    hapticBuffer[i] = static_cast<uint8_t>(255 * s.amplitude);
-            }
-
-            result = vrapi_SetHapticVibrationBuffer(g_ctx.Ovr, curCaps.DeviceID, &buffer);
-            if (result != ovrSuccess) {
-                LOGI("vrapi_SetHapticVibrationBuffer: Failed. result=%d", result);
-            }
-            s.buffered = true;
-        } else if (remoteCapabilities.ControllerCapabilities &
-                   ovrControllerCaps_HasSimpleHapticVibration) {
-            LOG("Send simple haptic. amplitude=%f", s.amplitude);
-            vrapi_SetHapticVibrationSimple(g_ctx.Ovr, curCaps.DeviceID, s.amplitude);
-        }
-    }
+// Every frame is decoded, so that the next ones have their references. A frame later than usual by
+// more than a frame interval is not rendered though: the next one is about to be ready, and VrApi
+// keeps showing the previous one meanwhile. Never two in a row, so that the average catches up
+// when the frames stay late.
+bool skipLateFrame(const TrackingFrame &frame) {
+    double lateness = vrapi_GetTimeInSeconds() - frame.displayTime;
+    double interval = 1. / g_ctx.streamConfig.refreshRate;
+
+    bool skip = g_ctx.hasRenderLateness && !g_ctx.lastFrameSkipped &&
+                lateness > g_ctx.renderLateness + interval;
+    g_ctx.renderLateness =
+            g_ctx.hasRenderLateness ? g_ctx.renderLateness * 0.9 + lateness * 0.1 : lateness;
+    g_ctx.hasRenderLateness = true;
+    g_ctx.lastFrameSkipped = skip;
+    return skip;
 }
 
 void renderNative(long long renderedFrameIndex) {
     LatencyCollector::Instance().rendered1(renderedFrameIndex);
     FrameLog(renderedFrameIndex, "Got frame for render.");
 
-    updateHapticsState();
-
     uint64_t oldestFrame = 0;
     uint64_t mostRecentFrame = 0;
     std::shared_ptr<TrackingFrame> frame;
@@ -908,6 +943,12 @@ void renderNative(long long renderedFrameIndex) {
     FrameLog(renderedFrameIndex, "Frame latency is %lu us.",
              getTimestampUs() - frame->fetchTime);
 
+    if (g_ctx.streamConfig.dropLateFrames && skipLateFrame(*frame)) {
+        LatencyCollector::Instance().lateFrameSkipped();
+        FrameLog(renderedFrameIndex, "Skipped late frame.");
+        return;
+    }
+
 // Render eye images and setup the primary layer using ovrTracking2.
     const ovrLayerProjection2 worldLayer =
             ovrRenderer_RenderFrame(&g_ctx.Renderer, &frame->tracking, false);
@@ -983,13 +1024,7 @@ void onHapticsFeedbackNative(unsigned long long path,
                             float frequency,
                             float amplitude) {
     int curHandIndex = (path == RIGHT_CONTROLLER_HAPTICS_PATH ? 0 : 1);
-    auto &s = g_ctx.mHapticsState[curHandIndex];
-    s.startUs = 0;
-    s.endUs = (uint64_t)(duration_s * 1000'000);
-    s.amplitude = amplitude;
-    s.frequency = frequency;
-    s.fresh = true;
-    s.buffered = false;
+    g_ctx.haptics.Request(curHandIndex, duration_s, amplitude);
 }
 
 void onBatteryChangedNative(int battery, int plugged) {
@@ -1037,8 +1072,12 @@ GuardianData getGuardianData() {
     return g_ctx.m_guardianData;
 }
 
-void onTrackingNative(bool clientsidePrediction) {
-    if (g_ctx.Ovr != nullptr) {
-        sendTrackingInfo(clientsidePrediction);
+double onTrackingNative(bool clientsidePrediction) {
+    if (g_ctx.Ovr == nullptr) {
+        return NAN;
     }
+    sendTrackingInfo(clientsidePrediction);
+
+    // Display times are one display period apart, any of them gives the phase of the next ones
+    return vrapi_GetPredictedDisplayTime(g_ctx.Ovr, g_ctx.FrameIndex) - vrapi_GetTimeInSeconds();
 }
@@ -99,13 +99,14 @@ void main()
 static const char FRAGMENT_SHADER[] = R"glsl(
 #extension GL_OES_EGL_image_external_essl3 : enable
 #extension GL_OES_EGL_image_external : enable
-in lowp vec2 uv;
+in highp vec2 uv;
 in lowp vec4 fragmentColor;
 out lowp vec4 outColor;
-uniform %s Texture0;
+uniform samplerExternalOES Texture0;
+%s
 void main()
 {
-    outColor = texture(Texture0, uv);
+    outColor = texture(Texture0, %s);
 }
 )glsl";
 
@@ -655,12 +656,7 @@ void ovrRenderer_Create(ovrRenderer *renderer, int width, int height, Texture *s
                         int LoadingTexture, FFRData ffrData) {
     renderer->NumBuffers = VRAPI_FRAME_LAYER_EYE_MAX;
 
-    renderer->enableFFR = ffrData.enabled;
-    if (renderer->enableFFR) {
-        renderer->ffrSourceTexture = streamTexture;
-        renderer->ffr = std::make_unique<FFR>(renderer->ffrSourceTexture);
-        renderer->ffr->Initialize(ffrData);
-    }
+    renderer->ffrData = ffrData;
 
 #ifdef OVR_SDK
     // Create the frame buffers.
@@ -683,8 +679,14 @@ void ovrRenderer_CreateScene(ovrRenderer *renderer, bool darkMode) {
     }
 
     std::string fragment_shader;
-    fragment_shader = string_format(FRAGMENT_SHADER,
-                                    renderer->enableFFR ? "sampler2D" : "samplerExternalOES");
+    // With FFR the foveated frame is expanded while drawing the eyes, in the same pass
+    if (renderer->ffrData.enabled) {
+        fragment_shader = string_format(FRAGMENT_SHADER,
+                                        GetFFRDecompressShader(renderer->ffrData).c_str(),
+                                        "DecompressAxisAlignedUV(uv)");
+    } else {
+        fragment_shader = string_format(FRAGMENT_SHADER, "", "uv");
+    }
     ovrProgram_Create(&renderer->Program, VERTEX_SHADER, fragment_shader.c_str());
 
     fragment_shader = string_format(FRAGMENT_SHADER_LOADING,
@@ -718,10 +720,6 @@ void ovrRenderer_Destroy(ovrRenderer *renderer) {
 
 ovrLayerProjection2 ovrRenderer_RenderFrame(ovrRenderer *renderer, const ovrTracking2 *tracking,
                                             bool loading) {
-    if (renderer->enableFFR) {
-        renderer->ffr->Render();
-    }
-
     const ovrTracking2 &updatedTracking = *tracking;
 
     ovrLayerProjection2 layer = vrapi_DefaultLayerProjection2();
@@ -837,12 +835,7 @@ void renderEye(int eye, ovrMatrix4f mvpMatrix[2], Recti *viewport, ovrRenderer *
 
         GL(glUniform1f(renderer->Program.UniformLocation[UNIFORM_ALPHA], 2.0f));
         GL(glActiveTexture(GL_TEXTURE0));
-        if (renderer->enableFFR) {
-            GL(glBindTexture(GL_TEXTURE_2D,
-                             renderer->ffr->GetOutputTexture()->GetGLTexture()));
-        } else {
-            GL(glBindTexture(GL_TEXTURE_EXTERNAL_OES, renderer->streamTexture->GetGLTexture()));
-        }
+        GL(glBindTexture(GL_TEXTURE_EXTERNAL_OES, renderer->streamTexture->GetGLTexture()));
 
         GL(glDrawElements(GL_TRIANGLES, renderer->Panel.IndexCount, GL_UNSIGNED_SHORT, NULL));
 
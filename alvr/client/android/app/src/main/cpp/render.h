@@ -12,6 +12,7 @@
 #include "gltf_model.h"
 #include "utils.h"
 #include "ffr.h"
+#include "gl_render_utils/texture.h"
 #include "vr_gui.h"
 
 
@@ -137,9 +138,7 @@ typedef struct {
     gl_render_utils::Texture *streamTexture;
     GLuint LoadingTexture;
     GltfModel *loadingScene;
-    std::unique_ptr<FFR> ffr;
-    gl_render_utils::Texture *ffrSourceTexture;
-    bool enableFFR;
+    FFRData ffrData;
 } ovrRenderer;
 
 void ovrRenderer_Create(ovrRenderer *renderer, int width, int height,
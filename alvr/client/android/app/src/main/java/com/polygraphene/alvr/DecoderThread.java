@@ -20,11 +20,13 @@ public class DecoderThread extends ThreadBase implements Handler.Callback {
 
     private static final int CODEC_H264 = 0;
     private static final int CODEC_H265 = 1;
+    private static final int CODEC_AV1 = 2;
     private int mCodec = CODEC_H265;
     private int mPriority = 0;
 
     private static final String VIDEO_FORMAT_H264 = "video/avc";
     private static final String VIDEO_FORMAT_H265 = "video/hevc";
+    private static final String VIDEO_FORMAT_AV1 = "video/av01";
     private String mFormat = VIDEO_FORMAT_H265;
 
     private MediaCodec mDecoder = null;
@@ -55,6 +57,11 @@ public class DecoderThread extends ThreadBase implements Handler.Callback {
     private static final int H265_NAL_TYPE_IDR_W_RADL = 19;
     private static final int H265_NAL_TYPE_VPS = 32;
 
+    private static final int AV1_OBU_SEQUENCE_HEADER = 1;
+    private static final int AV1_OBU_FRAME_HEADER = 3;
+    private static final int AV1_OBU_FRAME = 6;
+    private static final int AV1_KEY_FRAME = 0;
+
     private final Queue<Integer> mAvailableInputs = new LinkedList<>();
 
     public DecoderThread(Surface surface, DecoderCallback callback) {
@@ -86,8 +93,10 @@ public class DecoderThread extends ThreadBase implements Handler.Callback {
 
                 // find an SPS nal to initialize decoder
                 // in fact it will contain all config nals concatenated
+                // AV1 has no config buffers, the sequence header is part of the keyframes
                 if (mDecoder == null) {
-                  if (nal.type != NAL_TYPE_SPS)
+                  int configType = mCodec == CODEC_AV1 ? NAL_TYPE_IDR : NAL_TYPE_SPS;
+                  if (nal.type != configType)
                   {
                     mNalQueue.recycle(nal);
                     return true;
@@ -98,7 +107,9 @@ public class DecoderThread extends ThreadBase implements Handler.Callback {
                   format.setInteger("vendor.qti-ext-dec-low-latency.enable", 1); //Qualcomm low latency mode
                   format.setInteger(MediaFormat.KEY_OPERATING_RATE, Short.MAX_VALUE);
                   format.setInteger(MediaFormat.KEY_PRIORITY, mPriority);
-                  format.setByteBuffer("csd-0", ByteBuffer.wrap(nal.buf, 0, nal.buf.length));
+                  if (mCodec != CODEC_AV1) {
+                    format.setByteBuffer("csd-0", ByteBuffer.wrap(nal.buf, 0, nal.buf.length));
+                  }
                   MediaCodecList codecs = new MediaCodecList(MediaCodecList.REGULAR_CODECS);
                   String codec = codecs.findDecoderForFormat(format);
                   try {
@@ -253,6 +264,8 @@ public class DecoderThread extends ThreadBase implements Handler.Callback {
             mPriority = priority;
             if (mCodec == CODEC_H264) {
                 mFormat = VIDEO_FORMAT_H264;
+            } else if (mCodec == CODEC_AV1) {
+                mFormat = VIDEO_FORMAT_AV1;
             } else {
                 mFormat = VIDEO_FORMAT_H265;
             }
@@ -292,6 +305,10 @@ public class DecoderThread extends ThreadBase implements Handler.Callback {
         } else if (nal.type == NAL_TYPE_IDR) {
             // IDR-Frame
             Utils.frameLog(nal.frameIndex, () -> "Feed IDR-Frame. Size=" + nal.length + " PresentationTime=" + presentationTime);
+            if (mCodec == CODEC_AV1) {
+                // the sequence header came with the keyframe
+                mWaitNextIDR = false;
+            }
             setWaitingNextIDR(false);
 
             DecoderInput(nal.frameIndex);
@@ -318,9 +335,69 @@ public class DecoderThread extends ThreadBase implements Handler.Callback {
         }
     }
 
+    // Same as isAV1KeyFrame() of nal.cpp. A temporal unit is a keyframe when it contains a new
+    // frame (not show_existing_frame) of type KEY_FRAME. Encoders are free to repeat the sequence
+    // header, it doesn't mark keyframes.
+    private static boolean isAV1KeyFrame(byte[] buf, int length) {
+        int offset = 0;
+        boolean reducedStillPictureHeader = false;
+        while (offset < length) {
+            int header = buf[offset] & 0xFF;
+            int obuType = (header >> 3) & 0xF;
+            boolean hasExtension = (header & 0x4) != 0;
+            boolean hasSize = (header & 0x2) != 0;
+
+            int payload = offset + 1 + (hasExtension ? 1 : 0);
+            long payloadSize = 0;
+            if (hasSize) {
+                // leb128
+                for (int i = 0; i < 8 && payload < length; i++) {
+                    int b = buf[payload++] & 0xFF;
+                    payloadSize |= (long) (b & 0x7F) << (7 * i);
+                    if ((b & 0x80) == 0) {
+                        break;
+                    }
+                }
+            } else if (payload <= length) {
+                payloadSize = length - payload;
+            }
+            if (payload >= length || payloadSize > length - payload) {
+                return false;
+            }
+
+            int first = buf[payload] & 0xFF;
+            if (obuType == AV1_OBU_SEQUENCE_HEADER) {
+                // seq_profile (3 bits), still_picture (1), reduced_still_picture_header (1)
+                reducedStillPictureHeader = (first & 0x8) != 0;
+            } else if (obuType == AV1_OBU_FRAME_HEADER || obuType == AV1_OBU_FRAME) {
+                // all the frames of a reduced still picture stream are keyframes
+                if (reducedStillPictureHeader) {
+                    return true;
+                }
+                // show_existing_frame (1 bit), frame_type (2)
+                boolean showExistingFrame = (first & 0x80) != 0;
+                int frameType = (first >> 5) & 0x3;
+                if (!showExistingFrame && frameType == AV1_KEY_FRAME) {
+                    return true;
+                }
+            }
+
+            offset = payload + (int) payloadSize;
+        }
+        return false;
+    }
+
     private void detectNALType(NAL nal) {
         int NALType;
 
+        if (mCodec == CODEC_AV1) {
+            boolean keyFrame = isAV1KeyFrame(nal.buf, nal.length);
+            Utils.frameLog(nal.frameIndex, () -> "Got AV1 frame KeyFrame=" + keyFrame + " Length=" + nal.length + " QueueSize=" + mNalQueue.size());
+
+            nal.type = keyFrame ? NAL_TYPE_IDR : NAL_TYPE_P;
+            return;
+        }
+
         if (mCodec == CODEC_H264) {
             NALType = nal.buf[4] & 0x1F;
         } else {
@@ -0,0 +1,213 @@
+// Host test of the foveated frame expansion. DecompressAxisAlignedUV() of ffr.cpp is mirrored in
+// C++ and checked:
+// - against the compression of the server (CompressAxisAlignedPixelShader.hlsl): expanding a
+//   compressed frame gives back the same UVs
+// - against the previous client path, which expanded the frame into an eye resolution texture
+//   sampled again while drawing the eyes: both read the decoded frame at the same places, within a
+//   small fraction of a pixel
+// Not part of the app build. From this directory:
+//   c++ -std=c++17 -O2 -I../../main/cpp ffr_test.cpp ../../main/cpp/ffr.cpp -o /tmp/ffr_test
+//   /tmp/ffr_test
+
+#include "ffr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+struct vec2 {
+    double x, y;
+
+    vec2(double v = 0) : x(v), y(v) {}
+    vec2(double x, double y) : x(x), y(y) {}
+};
+
+vec2 operator+(vec2 a, vec2 b) { return {a.x + b.x, a.y + b.y}; }
+vec2 operator-(vec2 a, vec2 b) { return {a.x - b.x, a.y - b.y}; }
+vec2 operator*(vec2 a, vec2 b) { return {a.x * b.x, a.y * b.y}; }
+vec2 operator/(vec2 a, vec2 b) { return {a.x / b.x, a.y / b.y}; }
+vec2 operator-(vec2 a) { return {-a.x, -a.y}; }
+vec2 sqrt(vec2 a) { return {std::sqrt(a.x), std::sqrt(a.y)}; }
+
+// under*a+in*b+over*c of the shaders. The branches not taken can be NaN (sqrt of a negative
+// value), which the GPUs don't propagate through the multiplication by 0.
+vec2 SelectRegion(vec2 under, vec2 a, vec2 in, vec2 b, vec2 over, vec2 c) {
+    auto select = [](double under, double a, double in, double b, double over, double c) {
+        return (under != 0 ? a : 0) + (in != 0 ? b : 0) + (over != 0 ? c : 0);
+    };
+    return {select(under.x, a.x, in.x, b.x, over.x, c.x), select(under.y, a.y, in.y, b.y, over.y, c.y)};
+}
+
+struct Foveation {
+    vec2 eyeSizeRatio, centerSize, centerShift, edgeRatio;
+    vec2 targetResolution, optimizedResolution;
+
+    explicit Foveation(const FoveationVars &fv)
+        : eyeSizeRatio(fv.eyeWidthRatio, fv.eyeHeightRatio),
+          centerSize(fv.centerSizeX, fv.centerSizeY),
+          centerShift(fv.centerShiftX, fv.centerShiftY),
+          edgeRatio(fv.edgeRatioX, fv.edgeRatioY),
+          targetResolution(fv.targetEyeWidth * 2, fv.targetEyeHeight),
+          optimizedResolution(fv.optimizedEyeWidth * 2, fv.optimizedEyeHeight) {}
+};
+
+vec2 TextureToEyeUV(vec2 textureUV, bool isRightEye) {
+    return {(textureUV.x + float(isRightEye) * (1. - 2. * textureUV.x)) * 2., textureUV.y};
+}
+
+vec2 EyeToTextureUV(vec2 eyeUV, bool isRightEye) {
+    return {eyeUV.x / 2. + float(isRightEye) * (1. - eyeUV.x), eyeUV.y};
+}
+
+// DECOMPRESS_AXIS_ALIGNED_SHADER_FORMAT of ffr.cpp: UV of the full frame to UV of the foveated frame
+vec2 DecompressAxisAlignedUV(const Foveation &f, vec2 uv) {
+    const vec2 CENTER_SIZE = f.centerSize, CENTER_SHIFT = f.centerShift, EDGE_RATIO = f.edgeRatio;
+
+    bool isRightEye = uv.x > 0.5;
+    vec2 alignedUV = TextureToEyeUV(uv, isRightEye);
+
+    vec2 c0 = (1.-CENTER_SIZE)/2.;
+    vec2 c1 = (EDGE_RATIO-1.)*c0*(CENTER_SHIFT+1.)/EDGE_RATIO;
+    vec2 c2 = (EDGE_RATIO-1.)*CENTER_SIZE+1.;
+
+    vec2 loBound = c0*(CENTER_SHIFT+1.);
+    vec2 hiBound = c0*(CENTER_SHIFT-1.)+1.;
+    vec2 underBound = vec2(alignedUV.x<loBound.x,alignedUV.y<loBound.y);
+    vec2 inBound = vec2(loBound.x<alignedUV.x&&alignedUV.x<hiBound.x,loBound.y<alignedUV.y&&alignedUV.y<hiBound.y);
+    vec2 overBound = vec2(alignedUV.x>hiBound.x,alignedUV.y>hiBound.y);
+
+    vec2 d1 = (alignedUV-c1)*EDGE_RATIO/c2;
+
+    vec2 center = d1;
+    vec2 loBoundC = c0*(CENTER_SHIFT+1.)/c2;
+    vec2 hiBoundC = c0*(CENTER_SHIFT-1.)/c2+1.;
+    vec2 leftEdge = (-(c1+c2*loBoundC)/loBoundC+sqrt(((c1+c2*loBoundC)/loBoundC)*((c1+c2*loBoundC)/loBoundC)+4.*c2*(1.-EDGE_RATIO)/(EDGE_RATIO*loBoundC)*alignedUV))/(2.*c2*(1.-EDGE_RATIO))*(EDGE_RATIO*loBoundC);
+    vec2 rightEdge = (-(c2-EDGE_RATIO*c1-2.*EDGE_RATIO*c2+c2*EDGE_RATIO*(1.-hiBoundC)+EDGE_RATIO)/(EDGE_RATIO*(1.-hiBoundC))+sqrt(((c2-EDGE_RATIO*c1-2.*EDGE_RATIO*c2+c2*EDGE_RATIO*(1.-hiBoundC)+EDGE_RATIO)/(EDGE_RATIO*(1.-hiBoundC)))*((c2-EDGE_RATIO*c1-2.*EDGE_RATIO*c2+c2*EDGE_RATIO*(1.-hiBoundC)+EDGE_RATIO)/(EDGE_RATIO*(1.-hiBoundC)))-4.*((c2*EDGE_RATIO-c2)*(c1-hiBoundC+hiBoundC*c2)/(EDGE_RATIO*(1.-hiBoundC)*(1.-hiBoundC))-alignedUV*(c2*EDGE_RATIO-c2)/(EDGE_RATIO*(1.-hiBoundC)))))/(2.*c2*(EDGE_RATIO-1.))*(EDGE_RATIO*(1.-hiBoundC));
+
+    vec2 uncompressedUV = SelectRegion(underBound, leftEdge, inBound, center, overBound, rightEdge);
+
+    return EyeToTextureUV(uncompressedUV * f.eyeSizeRatio, isRightEye);
+}
+
+// CompressAxisAlignedPixelShader.hlsl of the server: UV of the foveated frame to UV of the full frame
+vec2 CompressAxisAlignedUV(const Foveation &f, vec2 uv) {
+    const vec2 centerSize = f.centerSize, centerShift = f.centerShift, edgeRatio = f.edgeRatio;
+
+    bool isRightEye = uv.x > 0.5;
+    vec2 eyeUV = TextureToEyeUV(uv, isRightEye);
+
+    vec2 alignedUV = eyeUV / f.eyeSizeRatio;
+
+    vec2 c0 = (1.-centerSize)/2.;
+    vec2 c1 = (edgeRatio-1.)*c0*(centerShift+1.)/edgeRatio;
+    vec2 c2 = (edgeRatio-1.)*centerSize+1.;
+
+    vec2 loBound = c0*(centerShift+1.)/c2;
+    vec2 hiBound = c0*(centerShift-1.)/c2+1.;
+    vec2 underBound = vec2(alignedUV.x<loBound.x,alignedUV.y<loBound.y);
+    vec2 inBound = vec2(loBound.x<alignedUV.x&&alignedUV.x<hiBound.x,loBound.y<alignedUV.y&&alignedUV.y<hiBound.y);
+    vec2 overBound = vec2(alignedUV.x>hiBound.x,alignedUV.y>hiBound.y);
+
+    vec2 d1 = alignedUV*c2/edgeRatio+c1;
+    vec2 d2 = alignedUV*c2;
+    vec2 d3 = (alignedUV-1.)*c2+1.;
+    vec2 g1 = alignedUV/loBound;
+    vec2 g2 = (1.-alignedUV)/(1.-hiBound);
+
+    vec2 center = d1;
+    vec2 leftEdge = g1*d1+(1.-g1)*d2;
+    vec2 rightEdge = g2*d1+(1.-g2)*d3;
+
+    vec2 compressedUV = SelectRegion(underBound, leftEdge, inBound, center, overBound, rightEdge);
+
+    return EyeToTextureUV(compressedUV, isRightEye);
+}
+
+// The previous client path: the expansion pass wrote DecompressAxisAlignedUV() of each texel center
+// of an eye resolution texture, then the eye pass sampled that texture bilinearly at uv. Returns
+// where the decoded frame is effectively read.
+vec2 TwoPassUV(const Foveation &f, vec2 uv) {
+    vec2 texel = uv * f.targetResolution - 0.5;
+    double x0 = std::floor(texel.x), y0 = std::floor(texel.y);
+    double wx = texel.x - x0, wy = texel.y - y0;
+    auto at = [&](double x, double y) {
+        return DecompressAxisAlignedUV(f, (vec2(x, y) + 0.5) / f.targetResolution);
+    };
+    return at(x0, y0) * ((1 - wx) * (1 - wy)) + at(x0 + 1, y0) * (wx * (1 - wy)) +
+           at(x0, y0 + 1) * ((1 - wx) * wy) + at(x0 + 1, y0 + 1) * (wx * wy);
+}
+
+int failures = 0;
+
+void check(bool condition, const char *what, vec2 uv, double error) {
+    if (!condition) {
+        printf("FAIL: %s at uv (%f, %f), error %g pixels\n", what, uv.x, uv.y, error);
+        failures++;
+    }
+}
+
+// distance in pixels of the foveated frame
+double Pixels(const Foveation &f, vec2 a, vec2 b) {
+    vec2 d = (a - b) * f.optimizedResolution;
+    return std::max(std::abs(d.x), std::abs(d.y));
+}
+
+void TestFoveation(const FFRData &data) {
+    Foveation f(CalculateFoveationVars(data));
+    const int GRID = 256;
+
+    // The client expansion inverts the server compression
+    double maxRoundTrip = 0;
+    for (int i = 0; i < GRID; i++) {
+        for (int j = 0; j < GRID; j++) {
+            vec2 uv((i + 0.5) / GRID, (j + 0.5) / GRID);
+            // the foveated frame is padded to a multiple of 32 pixels, the padding is not shown
+            vec2 alignedUV = TextureToEyeUV(uv, uv.x > 0.5) / f.eyeSizeRatio;
+            if (alignedUV.x > 1 || alignedUV.y > 1) {
+                continue;
+            }
+            vec2 roundTrip = DecompressAxisAlignedUV(f, CompressAxisAlignedUV(f, uv));
+            double error = Pixels(f, roundTrip, uv);
+            maxRoundTrip = std::max(maxRoundTrip, error);
+            check(error < 1e-3, "round trip", uv, error);
+        }
+    }
+
+    // The single pass reads the decoded frame where the two passes did
+    double maxTwoPass = 0;
+    vec2 texelSize = 1. / f.targetResolution;
+    for (int i = 0; i < GRID; i++) {
+        for (int j = 0; j < GRID; j++) {
+            vec2 uv((i + 0.5) / GRID, (j + 0.5) / GRID);
+            // the two passes blended the eyes on the seam and clamped on the frame border
+            double eyeX = std::min(std::abs(uv.x - 0.5), std::min(uv.x, 1 - uv.x));
+            if (eyeX < texelSize.x || std::min(uv.y, 1 - uv.y) < texelSize.y) {
+                continue;
+            }
+            double error = Pixels(f, TwoPassUV(f, uv), DecompressAxisAlignedUV(f, uv));
+            maxTwoPass = std::max(maxTwoPass, error);
+            check(error < 0.05, "two passes", uv, error);
+        }
+    }
+
+    printf("eye %ux%u center %.2fx%.2f edge ratio %.0fx%.0f: round trip %.2g px, two passes %.2g px\n",
+           data.eyeWidth, data.eyeHeight, data.centerSizeX, data.centerSizeY, data.edgeRatioX,
+           data.edgeRatioY, maxRoundTrip, maxTwoPass);
+}
+} // namespace
+
+int main() {
+    // the default settings, a stronger foveation and a centered one
+    TestFoveation({true, 1832, 1920, 0.4f, 0.35f, 0.4f, 0.1f, 4.f, 5.f});
+    TestFoveation({true, 1440, 1584, 0.3f, 0.3f, 0.f, 0.f, 6.f, 6.f});
+    TestFoveation({true, 2064, 2208, 0.5f, 0.5f, -0.2f, 0.3f, 2.f, 3.f});
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("all passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+// Host test of the haptics scheduler. HapticsScheduler is driven by a fake clock through Update(),
+// as its thread does, and plays on a fake output that records the vrapi calls. Checked:
+// - buffered devices are refilled when half of the device buffer is left, without gaps
+// - a new request replaces the queued samples
+// - vibrations stop within one sample of the requested duration
+// - buffered devices that report no buffer are driven as simple devices
+// Not part of the app build. From this directory:
+//   c++ -std=c++17 -O2 -pthread -I../../main/cpp haptics_scheduler_test.cpp ../../main/cpp/haptics_scheduler.cpp -o /tmp/haptics_scheduler_test
+//   /tmp/haptics_scheduler_test
+
+#include "haptics_scheduler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+struct Call {
+    enum Type {
+        BUFFER,
+        SIMPLE,
+    };
+
+    Type type;
+    // time of the call
+    double time;
+    uint32_t deviceId;
+    double bufferTime;
+    std::vector<uint8_t> samples;
+    bool terminated;
+    float amplitude;
+};
+
+class FakeOutput : public HapticsOutput {
+public:
+    double now = 0;
+    std::vector<Call> calls;
+
+    double GetTime() override { return now; }
+
+    void SetBuffer(uint32_t deviceId, double bufferTime, const uint8_t *samples, uint32_t count,
+                   bool terminated) override {
+        calls.push_back({Call::BUFFER, now, deviceId, bufferTime,
+                         std::vector<uint8_t>(samples, samples + count), terminated, 0});
+    }
+
+    void SetSimple(uint32_t deviceId, float amplitude) override {
+        calls.push_back({Call::SIMPLE, now, deviceId, 0, {}, false, amplitude});
+    }
+};
+
+int failures = 0;
+
+void check(bool condition, const char *what, double time) {
+    if (!condition) {
+        printf("FAIL: %s at %f s\n", what, time);
+        failures++;
+    }
+}
+
+// Same as the devices of Quest 2 and 3: 500 Hz, 40 ms buffer
+const HapticsDevice BUFFERED_DEVICE = {HapticsDevice::BUFFERED, 7, 20, 2};
+const double SAMPLE_DURATION = 0.002;
+const double HALF_BUFFER = 20 * SAMPLE_DURATION / 2;
+const double EPS = 1e-9;
+
+// Calls Update() at the times it asks for, as the scheduler thread does, until nothing is playing
+// or until the end time
+void RunUntil(HapticsScheduler &scheduler, FakeOutput &output, double end) {
+    for (int i = 0; i < 10000; i++) {
+        double next = scheduler.Update(output.now);
+        if (next < 0 || next > end) {
+            output.now = end;
+            return;
+        }
+        check(next > output.now, "next update in the future", output.now);
+        output.now = std::max(next, output.now);
+    }
+    check(false, "too many updates", output.now);
+}
+
+// The buffers submitted from the given call on, until the terminating one
+struct Playback {
+    double start = 0;
+    double end = 0;
+    bool gaps = false;
+    bool halfBufferRefills = true;
+    uint8_t amplitude = 0;
+    bool sameAmplitude = true;
+    double stopTime = -1;
+};
+
+Playback Played(const FakeOutput &output, size_t firstCall) {
+    Playback playback;
+    bool first = true;
+    for (size_t i = firstCall; i < output.calls.size(); i++) {
+        auto &call = output.calls[i];
+        if (call.type != Call::BUFFER) {
+            continue;
+        }
+        if (call.terminated) {
+            playback.stopTime = call.bufferTime;
+            break;
+        }
+        if (first) {
+            playback.start = call.bufferTime;
+            playback.amplitude = call.samples[0];
+            first = false;
+        } else {
+            playback.gaps |= std::abs(call.bufferTime - playback.end) > EPS;
+            // submitted when half of the buffer is left
+            playback.halfBufferRefills &= std::abs(playback.end - call.time - HALF_BUFFER) < EPS;
+        }
+        for (auto sample : call.samples) {
+            playback.sameAmplitude &= sample == playback.amplitude;
+        }
+        playback.end = call.bufferTime + call.samples.size() * SAMPLE_DURATION;
+    }
+    return playback;
+}
+
+void TestBufferedRefill() {
+    FakeOutput output;
+    HapticsScheduler scheduler(output);
+    scheduler.SetDevice(0, BUFFERED_DEVICE);
+
+    // 0.5 s is 250 samples, more than 12 device buffers, and ends in the middle of a sample
+    output.now = 10;
+    scheduler.Request(0, 0.5013f, 0.6f);
+    RunUntil(scheduler, output, 20);
+
+    auto playback = Played(output, 0);
+    double requestedEnd = 10 + double(0.5013f);
+    check(playback.start == 10, "starts at the request", playback.start);
+    check(!playback.gaps, "no gaps between the buffers", playback.end);
+    check(playback.halfBufferRefills, "refilled at half buffer", playback.end);
+    check(playback.sameAmplitude && playback.amplitude == uint8_t(255 * 0.6f), "amplitude", playback.end);
+    check(playback.end >= requestedEnd - EPS && playback.end < requestedEnd + SAMPLE_DURATION,
+          "ends within one sample of the duration", playback.end);
+    check(std::abs(playback.stopTime - requestedEnd) < EPS, "terminated at the end", playback.stopTime);
+
+    int buffers = 0;
+    for (auto &call : output.calls) {
+        check(call.type == Call::BUFFER && call.deviceId == BUFFERED_DEVICE.deviceId, "buffered device", call.time);
+        buffers += !call.terminated;
+    }
+    // one full buffer, then half a buffer per refill
+    check(buffers == 1 + (int)std::ceil((0.5013 - 0.04) / HALF_BUFFER), "refill count", output.now);
+}
+
+void TestBufferedReplace() {
+    FakeOutput output;
+    HapticsScheduler scheduler(output);
+    scheduler.SetDevice(1, BUFFERED_DEVICE);
+
+    output.now = 1;
+    scheduler.Request(1, 1.f, 1.f);
+    RunUntil(scheduler, output, 1.1);
+
+    // a weaker and shorter vibration replaces the queued samples from now on
+    size_t replaced = output.calls.size();
+    output.now = 1.1053;
+    scheduler.Request(1, 0.03f, 0.25f);
+    RunUntil(scheduler, output, 5);
+
+    auto playback = Played(output, replaced);
+    double requestedEnd = 1.1053 + double(0.03f);
+    check(std::abs(playback.start - 1.1053) < EPS, "replacement starts at the request", playback.start);
+    check(playback.sameAmplitude && playback.amplitude == uint8_t(255 * 0.25f), "replacement amplitude", playback.start);
+    check(playback.end >= requestedEnd - EPS && playback.end < requestedEnd + SAMPLE_DURATION,
+          "replacement ends within one sample of its duration", playback.end);
+    check(std::abs(playback.stopTime - requestedEnd) < EPS, "replacement terminated at its end", playback.stopTime);
+
+    // a zero amplitude request stops right away
+    output.now = 6;
+    scheduler.Request(1, 1.f, 1.f);
+    RunUntil(scheduler, output, 6.2);
+    size_t stopped = output.calls.size();
+    scheduler.Request(1, 1.f, 0.f);
+    RunUntil(scheduler, output, 7);
+    check(output.calls.size() == stopped + 1 && output.calls.back().terminated &&
+              std::abs(output.calls.back().bufferTime - 6.2) < EPS,
+          "stopped by a zero amplitude request", output.now);
+}
+
+void TestSimpleDowngrade() {
+    FakeOutput output;
+    HapticsScheduler scheduler(output);
+    // a buffered device that reports no buffer
+    scheduler.SetDevice(0, {HapticsDevice::BUFFERED, 3, 0, 2});
+
+    output.now = 2;
+    scheduler.Request(0, 0.25f, 0.5f);
+    RunUntil(scheduler, output, 10);
+
+    check(output.calls.size() == 2, "one start and one stop", output.now);
+    if (output.calls.size() == 2) {
+        auto &start = output.calls[0], &stop = output.calls[1];
+        check(start.type == Call::SIMPLE && start.deviceId == 3 && start.amplitude == 0.5f &&
+                  start.time == 2,
+              "simple vibration started", start.time);
+        check(stop.type == Call::SIMPLE && stop.amplitude == 0 &&
+                  std::abs(stop.time - (2 + double(0.25f))) < EPS,
+              "simple vibration stopped at the end", stop.time);
+    }
+}
+} // namespace
+
+int main() {
+    TestBufferedRefill();
+    TestBufferedReplace();
+    TestSimpleDowngrade();
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("all passed\n");
+    return EXIT_SUCCESS;
+}
@@ -15,12 +15,13 @@ use alvr_common::{
     Haptics, ALVR_NAME, ALVR_VERSION, LEFT_HAND_HAPTIC_ID,
 >>>>>>> libalvr
 };
-use alvr_session::{CodecType, SessionDesc, TrackingSpace};
+use alvr_session::{FecCodec, SessionDesc, TrackingSpace};
 use alvr_sockets::{
     spawn_cancelable, ClientConfigPacket, ClientControlPacket, ClientHandshakePacket, Haptics,
     HeadsetInfoPacket, PeerType, PlayspaceSyncPacket, PrivateIdentity, ProtoControlSocket,
-    ServerControlPacket, ServerHandshakePacket, StreamSocketBuilder, VideoFrameHeaderPacket, AUDIO,
-    HAPTICS, INPUT, VIDEO,
+    RedundantPose, ServerControlPacket, ServerHandshakePacket, StreamSocketBuilder,
+    VideoHeaderDecoder, AUDIO, HAPTICS, INPUT, LEGACY_VIDEO_HEADER_VERSION, MTU_PROBE_MAX_DURATION,
+    VIDEO,
 };
 use futures::future::BoxFuture;
 use jni::{
@@ -30,11 +31,13 @@ use jni::{
 use serde_json as json;
 use settings_schema::Switch;
 use std::{
+    collections::VecDeque,
     future, mem, ptr, slice,
     sync::{
         atomic::{AtomicBool, Ordering},
         mpsc as smpsc, Arc,
     },
+    thread,
     time::Duration,
 };
 use tokio::{
@@ -64,6 +67,8 @@ const RETRY_CONNECT_MIN_INTERVAL: Duration = Duration::from_secs(1);
 const PLAYSPACE_SYNC_INTERVAL: Duration = Duration::from_millis(500);
 const NETWORK_KEEPALIVE_INTERVAL: Duration = Duration::from_secs(1);
 const CLEANUP_PAUSE: Duration = Duration::from_millis(500);
+// Added to the server MTU probe time, for the control packet to arrive
+const VIDEO_PACKET_SIZE_TIMEOUT_MARGIN: Duration = Duration::from_secs(2);
 
 // close stream on Drop (manual disconnection or execution canceling)
 struct StreamCloseGuard {
@@ -170,6 +175,9 @@ async fn connection_pipeline(
 
     trace_err!(proto_socket.send(&(headset_info, server_ip)).await)?;
     let config_packet = trace_err!(proto_socket.recv::<ClientConfigPacket>().await)?;
+    // old servers do not set the video header version
+    let video_header_version = alvr_sockets::video_header_from_str(&config_packet.reserved)
+        .unwrap_or(LEGACY_VIDEO_HEADER_VERSION);
 
     let (control_sender, mut control_receiver) = proto_socket.split();
     let control_sender = Arc::new(Mutex::new(control_sender));
@@ -240,6 +248,32 @@ async fn connection_pipeline(
     };
     let stream_socket = Arc::new(stream_socket);
 
+    // The server probes the path MTU, then always sends the chosen video packet size. Both sides
+    // must use the same size, so there is no fallback.
+    let video_packet_size = tokio::select! {
+        Err(e) = stream_socket.answer_mtu_probes() => return Err(e),
+        control_packet = control_receiver.recv() => match control_packet {
+            Ok(ServerControlPacket::Reserved(data)) => {
+                trace_none!(alvr_sockets::video_packet_size_from_str(&data))?
+            }
+            Ok(_) => return fmt_e!("Got unexpected packet waiting for video packet size"),
+            Err(e) => {
+                info!("Server disconnected. Cause: {e}");
+                set_loading_message(
+                    &*java_vm,
+                    &*activity_ref,
+                    hostname,
+                    SERVER_DISCONNECTED_MESSAGE,
+                )?;
+                return Ok(());
+            }
+        },
+        _ = time::sleep(MTU_PROBE_MAX_DURATION + VIDEO_PACKET_SIZE_TIMEOUT_MARGIN) => {
+            return fmt_e!("Timeout while waiting for the video packet size");
+        }
+    };
+    info!("Video packet size: {video_packet_size}");
+
     info!("Connected to server");
 
     let is_connected = Arc::new(AtomicBool::new(true));
@@ -310,16 +344,19 @@ async fn connection_pipeline(
             },
             trackingSpaceType: matches!(settings.headset.tracking_space, TrackingSpace::Stage) as _,
             extraLatencyMode: settings.headset.extra_latency_mode,
+            dropLateFrames: settings.video.drop_late_frames,
         });
     }
 
+    let fps = config_packet.fps;
+
     trace_err!(trace_err!(java_vm.attach_current_thread())?.call_method(
         &*activity_ref,
         "onServerConnected",
         "(FIZLjava/lang/String;)V",
         &[
             config_packet.fps.into(),
-            (matches!(settings.video.codec, CodecType::HEVC) as i32).into(),
+            (settings.video.codec as i32).into(),
             settings.video.client_request_realtime_decoder.into(),
             trace_err!(trace_err!(java_vm.attach_current_thread())?
                 .new_string(config_packet.dashboard_url))?
@@ -331,6 +368,7 @@ async fn connection_pipeline(
         Switch::Enabled(controllers) => controllers.clientside_prediction,
         Switch::Disabled => false,
     };
+    let tracking_rate = settings.headset.tracking_rate;
 
     // setup stream loops
 
@@ -353,10 +391,33 @@ async fn connection_pipeline(
 
     let input_send_loop = {
         let mut socket_sender = stream_socket.request_stream(INPUT).await?;
+        let tracking_redundancy = settings.connection.tracking_redundancy as usize;
         async move {
             let (data_sender, mut data_receiver) = tmpsc::unbounded_channel();
             *INPUT_SENDER.lock() = Some(data_sender);
-            while let Some(input) = data_receiver.recv().await {
+            let mut recent_poses = VecDeque::with_capacity(tracking_redundancy);
+            while let Some(mut input) = data_receiver.recv().await {
+                if tracking_redundancy > 0 {
+                    input.redundant_poses = recent_poses.iter().cloned().collect();
+
+                    if let Some((_, head_motion)) = input
+                        .device_motions
+                        .iter()
+                        .find(|(id, _)| *id == *alvr_common::HEAD_ID)
+                    {
+                        if recent_poses.len() == tracking_redundancy {
+                            recent_poses.pop_front();
+                        }
+                        recent_poses.push_back(RedundantPose {
+                            frame_index: input.legacy.frame_index,
+                            client_time: input.legacy.client_time,
+                            target_timestamp: input.target_timestamp,
+                            orientation: head_motion.orientation,
+                            position: head_motion.position,
+                        });
+                    }
+                }
+
                 socket_sender
                     .send_buffer(socket_sender.new_buffer(&input, 0)?)
                     .await
@@ -441,32 +502,34 @@ async fn connection_pipeline(
     let legacy_receive_data_sender = Arc::new(Mutex::new(legacy_receive_data_sender));
 
     let video_receive_loop = {
-        let mut receiver = stream_socket
-            .subscribe_to_stream::<VideoFrameHeaderPacket>(VIDEO)
-            .await?;
+        // The header is parsed by VideoHeaderDecoder, the stream header is empty
+        let mut receiver = stream_socket.subscribe_to_stream::<()>(VIDEO).await?;
+        let mut header_decoder = VideoHeaderDecoder::new(video_header_version);
         let legacy_receive_data_sender = legacy_receive_data_sender.clone();
         async move {
             loop {
                 let packet = receiver.recv().await?;
 
-                let mut buffer = vec![0_u8; mem::size_of::<VideoFrame>() + packet.buffer.len()];
-                let header = VideoFrame {
-                    type_: 9, // ALVR_PACKET_TYPE_VIDEO_FRAME
-                    packetCounter: packet.header.packet_counter,
-                    trackingFrameIndex: packet.header.tracking_frame_index,
-                    videoFrameIndex: packet.header.video_frame_index,
-                    sentTime: packet.header.sent_time,
-                    frameByteSize: packet.header.frame_byte_size,
-                    fecIndex: packet.header.fec_index,
-                    fecPercentage: packet.header.fec_percentage,
-                };
+                for (header, payload) in header_decoder.decode(packet.buffer)? {
+                    let mut buffer = vec![0_u8; mem::size_of::<VideoFrame>() + payload.len()];
+                    let header = VideoFrame {
+                        type_: 9, // ALVR_PACKET_TYPE_VIDEO_FRAME
+                        packetCounter: header.packet_counter,
+                        trackingFrameIndex: header.tracking_frame_index,
+                        videoFrameIndex: header.video_frame_index,
+                        sentTime: header.sent_time,
+                        frameByteSize: header.frame_byte_size,
+                        fecIndex: header.fec_index,
+                        fecPercentage: header.fec_percentage,
+                    };
 
-                buffer[..mem::size_of::<VideoFrame>()].copy_from_slice(unsafe {
-                    &mem::transmute::<_, [u8; mem::size_of::<VideoFrame>()]>(header)
-                });
-                buffer[mem::size_of::<VideoFrame>()..].copy_from_slice(&packet.buffer);
+                    buffer[..mem::size_of::<VideoFrame>()].copy_from_slice(unsafe {
+                        &mem::transmute::<_, [u8; mem::size_of::<VideoFrame>()]>(header)
+                    });
+                    buffer[mem::size_of::<VideoFrame>()..].copy_from_slice(&payload);
 
-                legacy_receive_data_sender.lock().await.send(buffer).ok();
+                    legacy_receive_data_sender.lock().await.send(buffer).ok();
+                }
             }
         }
     };
@@ -516,6 +579,7 @@ async fn connection_pipeline(
         let nal_class_ref = Arc::clone(&nal_class_ref);
         let codec = settings.video.codec;
         let enable_fec = settings.connection.enable_fec;
+        let fec_codec = settings.connection.fec_codec;
         move || -> StrResult {
             let env = trace_err!(java_vm.attach_current_thread())?;
             let env_ptr = env.get_native_interface() as _;
@@ -527,8 +591,10 @@ async fn connection_pipeline(
                     env_ptr,
                     *activity_obj as _,
                     **nal_class as _,
-                    matches!(codec, CodecType::HEVC) as _,
+                    codec as _,
                     enable_fec,
+                    matches!(fec_codec, FecCodec::ReedSolomon16) as _,
+                    video_packet_size,
                 );
 
                 let mut idr_request_deadline = None;
@@ -557,14 +623,59 @@ async fn connection_pipeline(
         }
     });
 
-    let tracking_interval = Duration::from_secs_f32(1_f32 / 360_f32);
+    // Poses are sampled on a dedicated thread, so their timing does not depend on the load of the
+    // runtime. The rate is rounded to a whole number of samples per display frame, and every
+    // sample is scheduled from the display time predicted by vrapi, so the samples keep the same
+    // phase relative to the display times.
+    let samples_per_frame = f32::max((tracking_rate as f32 / fps).round(), 1_f32);
+    let tracking_interval = Duration::from_secs_f32(1_f32 / (fps * samples_per_frame));
     let tracking_loop = async move {
-        let mut deadline = Instant::now();
-        loop {
-            unsafe { crate::onTrackingNative(tracking_clientside_prediction) };
-            deadline += tracking_interval;
-            time::sleep_until(deadline).await;
+        // The thread is joined on a blocking task, so that dropping the loop does not block the
+        // runtime
+        struct StopOnDrop(Arc<AtomicBool>, Option<thread::JoinHandle<()>>);
+        impl Drop for StopOnDrop {
+            fn drop(&mut self) {
+                self.0.store(false, Ordering::Relaxed);
+                if let Some(thread) = self.1.take() {
+                    task::spawn_blocking(move || thread.join().ok());
+                }
+            }
         }
+
+        let running = Arc::new(AtomicBool::new(true));
+        let thread = thread::spawn({
+            let running = Arc::clone(&running);
+            move || {
+                let interval_s = tracking_interval.as_secs_f64();
+                let mut deadline = std::time::Instant::now();
+                while running.load(Ordering::Relaxed) {
+                    let display_offset_s =
+                        unsafe { crate::onTrackingNative(tracking_clientside_prediction) };
+
+                    let now = std::time::Instant::now();
+                    let previous_deadline = deadline;
+                    deadline = if display_offset_s.is_finite() {
+                        // The first sample time after now that is a whole number of intervals
+                        // from the display time. If late, the missed samples are skipped instead
+                        // of being sent in a burst.
+                        now + Duration::from_secs_f64(display_offset_s.rem_euclid(interval_s))
+                    } else {
+                        (previous_deadline + tracking_interval).max(now)
+                    };
+                    // A sample that ran early must not be repeated in the same slot
+                    while deadline < previous_deadline + tracking_interval / 2 {
+                        deadline += tracking_interval;
+                    }
+
+                    if deadline > now {
+                        thread::sleep(deadline - now);
+                    }
+                }
+            }
+        });
+        let _stop = StopOnDrop(running, Some(thread));
+
+        future::pending::<StrResult>().await
     };
 
     unsafe impl Send for crate::GuardianData {}
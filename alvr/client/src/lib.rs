@@ -278,6 +278,7 @@ pub unsafe extern "system" fn Java_com_polygraphene_alvr_OvrActivity_onCreateNat
                         data.controller[1].handFingerConfidences,
                     ],
                 },
+                redundant_poses: vec![], // filled by the send loop
             };
 
             sender.send(input).ok();
@@ -444,7 +445,11 @@ pub unsafe extern "system" fn Java_com_polygraphene_alvr_OvrActivity_onResumeNat
             recommended_eye_height: result.recommendedEyeHeight as _,
             available_refresh_rates,
             preferred_refresh_rate,
-            reserved: format!("{}", *ALVR_VERSION),
+            reserved: format!(
+                "{} {}",
+                *ALVR_VERSION,
+                alvr_sockets::video_header_to_string(alvr_sockets::VIDEO_HEADER_VERSION)
+            ),
         };
 
         let private_identity = PrivateIdentity {
@@ -46,6 +46,9 @@ define({
         fecFailureInSecond: "Fec failure / s",
         clientFPS: "Client FPS",
         serverFPS: "Server FPS",
+        lateFramesDropped: "Late frames dropped / s",
+        droppedBeforeEncoding: "before encoding",
+        droppedBeforeSending: "before sending",
         packets: "Packets",
         packetss: "Packets / s",
         batteries: "Batteries",
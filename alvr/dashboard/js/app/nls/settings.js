@@ -22,6 +22,24 @@ define({
         "_root_video_secondsFromVsyncToPhotons.name": "Seconds from VSync to image", // adv
         "_root_video_secondsFromVsyncToPhotons.description":
             "The time elapsed from the virtual VSync until the image is visible on the viewer screen", // adv
+        "_root_video_serverReprojection.name": "Server reprojection (Linux)", // adv
+        "_root_video_serverReprojection.description":
+            "When the game misses a frame, rotate the last frame to the newest head pose and stream it, so the headset keeps receiving frames at the display rate", // adv
+        "_root_video_frameSizeCap.name": "Frame size cap (Linux)", // adv
+        "_root_video_frameSizeCap_enabled.description":
+            "Limit the size of every single frame instead of only the average bitrate, and skip frames while the network is still sending an oversized one. This bounds the latency added by large frames", // adv
+        "_root_video_frameSizeCap_content_maxFrameIntervals.name": "Max frame intervals", // adv
+        "_root_video_frameSizeCap_content_maxFrameIntervals.description":
+            "Longest time a single frame can take to be sent at the current bitrate, in frame intervals", // adv
+        "_root_video_infiniteGop.name": "Infinite GOP (Linux)", // adv
+        "_root_video_infiniteGop.description":
+            "Only send keyframes when the headset lost a frame or stopped decoding, instead of periodically. This removes the periodic bitrate spikes", // adv
+        "_root_video_encoderInFlightFrames.name": "Encoder in-flight frames (Linux)", // adv
+        "_root_video_encoderInFlightFrames.description":
+            "Frames prepared ahead of the encoder. 1 gives the lowest latency, more can keep up with higher resolutions or refresh rates when the encoder is the bottleneck", // adv
+        "_root_video_dropLateFrames.name": "Drop late frames", // adv
+        "_root_video_dropLateFrames.description":
+            "Skip the frames that would be displayed too late, instead of letting every stage add their delay to the next frames. On Linux the server also drops them before encoding or sending them", // adv
         "_root_video_foveatedRendering.name": "Foveated encoding",
         // "_root_video_foveatedRendering.description": use "_root_video_foveatedRendering_enabled.description"
         "_root_video_foveatedRendering_enabled.description":
@@ -65,9 +83,10 @@ define({
             "Sharpness: emphasizes the edges of the image.",
         "_root_video_codec-choice-.name": "Video codec",
         "_root_video_codec-choice-.description":
-            "HEVC is preferred to achieve better visual quality on lower bitrates. AMD video cards work best with HEVC.",
+            "HEVC is preferred to achieve better visual quality on lower bitrates. AMD video cards work best with HEVC. AV1 compresses better than HEVC, but it is only available on Linux and needs a headset that can decode it.",
         "_root_video_codec_H264-choice-.name": "h264",
         "_root_video_codec_HEVC-choice-.name": "HEVC (h265)",
+        "_root_video_codec_AV1-choice-.name": "AV1",
         "_root_video_clientRequestRealtimeDecoder.name":
             "Request realtime decoder priority (client)", // adv
         "_root_video_use10bitEncoder.name": "Reduce color banding (newer nVidia cards only)",
@@ -175,6 +194,9 @@ define({
             "Registered device type of the emulated headset", // adv
         "_root_headset_trackingFrameOffset.name": "Tracking frame offset",
         "_root_headset_trackingFrameOffset.description": "Offset for the pose prediction algorithm",
+        "_root_headset_trackingRate.name": "Tracking rate", // adv
+        "_root_headset_trackingRate.description":
+            "Head and controller poses sent by the headset per second. Rounded to a whole number of samples per frame.", // adv
         "_root_headset_positionOffset.name": "Headset position offset", // adv
         "_root_headset_positionOffset.description":
             "Headset position offset used by the position prediction algorithm.", // adv
@@ -309,6 +331,21 @@ define({
         "_root_connection_onDisconnectScript.name": "On disconnect script",
         "_root_connection_onDisconnectScript.description":
             "This script/executable will be run asynchronously when headset disconnects and on SteamVR shutdown.\nEnvironment variable ACTION will be set to &#34;disconnect&#34; (without quotes).",
+        "_root_connection_fecCodec-choice-.name": "FEC codec", // adv
+        "_root_connection_fecCodec-choice-.description":
+            "Reed-Solomon GF(2^8) groups large frames into at most 20 shards of multiple packets.\nReed-Solomon GF(2^16) uses one packet per shard, so every lost packet can be recovered by any parity packet, at a higher CPU cost.", // adv
+        "_root_connection_fecCodec_reedSolomon8-choice-.name": "Reed-Solomon GF(2^8)", // adv
+        "_root_connection_fecCodec_reedSolomon16-choice-.name": "Reed-Solomon GF(2^16)", // adv
+        "_root_connection_videoPacketSize-choice-.name": "Video packet size", // adv
+        "_root_connection_videoPacketSize-choice-.description":
+            "Size of the video packets sent over UDP. Auto measures the largest packet that reaches the client when the stream starts.\nLower the maximum MTU if the network drops fragmented packets (for example when using a VPN).", // adv
+        "_root_connection_videoPacketSize_auto-choice-.name": "Auto", // adv
+        "_root_connection_videoPacketSize_auto_maxMtu.name": "Maximum MTU", // adv
+        "_root_connection_videoPacketSize_custom-choice-.name": "Custom", // adv
+        "_root_connection_videoPacketSize_custom.name": "Packet size", // adv
+        "_root_connection_trackingRedundancy.name": "Tracking redundancy", // adv
+        "_root_connection_trackingRedundancy.description":
+            "Number of previous head poses repeated in every tracking packet. On a lossy network, the server recovers the poses of the lost packets from the next ones. 0 disables it", // adv
         // Extra tab
         "_root_extra_tab.name": "Extra",
         "_root_extra_theme-choice-.name": "Theme",
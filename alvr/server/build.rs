@@ -1,6 +1,8 @@
 #[cfg(target_os = "linux")]
 use pkg_config;
 use std::{env, path::PathBuf};
+#[cfg(target_os = "linux")]
+use std::{path::Path, process::Command};
 
 // this code must be executed BEFORE the actual cpp build when using bundled ffmpeg,
 // as it adds definitions and include flags
@@ -51,6 +53,40 @@ fn do_ffmpeg_pkg_config(build: &mut cc::Build) {
     }
 }
 
+// Compile the compute shaders to SPIR-V headers, included by the linux compositor
+#[cfg(target_os = "linux")]
+fn compile_linux_shaders(build: &mut cc::Build, out_dir: &Path) {
+    let shader_paths = walkdir::WalkDir::new("cpp/platform/linux/shader")
+        .into_iter()
+        .filter_map(|maybe_entry| maybe_entry.ok())
+        .map(|entry| entry.into_path())
+        .filter(|path| path.extension().filter(|ext| *ext == "comp").is_some());
+
+    for path in shader_paths {
+        let file_name = path.file_name().unwrap().to_string_lossy().to_string();
+        let var_name = file_name.replace('.', "_").to_uppercase() + "_SPV";
+
+        let status = Command::new("glslangValidator")
+            .args(["-V", "--vn", &var_name, "-o"])
+            .arg(out_dir.join(file_name + ".h"))
+            .arg(&path)
+            .status()
+            .unwrap_or_else(|e| {
+                panic!(
+                    "glslangValidator is needed to compile the Linux compositor shaders ({e}). \
+                    Install glslang-tools (Debian, Ubuntu) or glslang (Fedora, Arch, Nix)."
+                )
+            });
+        assert!(
+            status.success(),
+            "failed to compile {}",
+            path.to_string_lossy()
+        );
+    }
+
+    build.include(out_dir);
+}
+
 fn main() {
     let out_dir = PathBuf::from(env::var("OUT_DIR").unwrap());
     let cpp_dir = PathBuf::from(env::var("CARGO_MANIFEST_DIR").unwrap()).join("cpp");
@@ -108,6 +144,9 @@ fn main() {
     // #[cfg(debug_assertions)]
     // build.define("ALVR_DEBUG_LOG", None);
 
+    #[cfg(target_os = "linux")]
+    compile_linux_shaders(&mut build, &out_dir);
+
     #[cfg(all(target_os = "linux", feature = "bundled_ffmpeg"))]
     do_ffmpeg_pkg_config(&mut build);
 
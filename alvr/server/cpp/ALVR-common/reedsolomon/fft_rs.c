@@ -0,0 +1,409 @@
+/*
+ * fft_rs.c -- Reed-Solomon erasure code over GF(2^16) based on the additive FFT
+ *
+ * The algorithm is the one described in:
+ *   S.-J. Lin, T. Y. Al-Naffouri, Y. S. Han and W.-H. Chung,
+ *   "Novel Polynomial Basis With Fast Fourier Transform and Its Application to Reed-Solomon
+ *   Erasure Codes", IEEE Trans. on Information Theory, 2016.
+ * The field representation, the FFT skew factors and the data layout follow the Leopard-RS library
+ * by Christopher A. Taylor (BSD license), simplified to a portable radix-2 implementation.
+ *
+ * Shard layout: the recovery (parity) symbols occupy the first m = next_pow2(parity_shards)
+ * positions of the codeword, the data symbols the following data_shards positions.
+ */
+
+#include <string.h>
+
+#include "fft_rs.h"
+
+typedef unsigned short ffe_t;
+
+#define FF_BITS 16
+#define FF_ORDER 65536
+#define FF_MODULUS 65535
+#define FF_POLYNOMIAL 0x1002D
+
+static const ffe_t cantor_basis[FF_BITS] = {
+	0x0001, 0xACCA, 0x3C0E, 0x163E,
+	0xC582, 0xED2E, 0x914C, 0x4012,
+	0x6C98, 0x10D8, 0x6A72, 0xB900,
+	0xFDB8, 0xFB34, 0xFF38, 0x991E
+};
+
+static ffe_t exp_lut[FF_ORDER];
+static ffe_t log_lut[FF_ORDER];
+/* twisted factors used in the FFT, log form. FF_MODULUS means the factor is 0 */
+static ffe_t fft_skew[FF_MODULUS];
+/* FWHT of the log table, used to evaluate the error locator polynomial */
+static ffe_t log_walsh[FF_ORDER];
+
+static int initialized = 0;
+
+/* a + b mod FF_MODULUS, with partial reduction: FF_MODULUS can be returned in place of 0 */
+static ffe_t add_mod(ffe_t a, ffe_t b)
+{
+	unsigned sum = (unsigned)a + b;
+	return (ffe_t)(sum + (sum >> FF_BITS));
+}
+
+/* a - b mod FF_MODULUS, with partial reduction */
+static ffe_t sub_mod(ffe_t a, ffe_t b)
+{
+	unsigned dif = (unsigned)a - b;
+	return (ffe_t)(dif + (dif >> FF_BITS));
+}
+
+/* a * exp(log_b) */
+static ffe_t mul_log(ffe_t a, ffe_t log_b)
+{
+	if (a == 0)
+		return 0;
+	return exp_lut[add_mod(log_lut[a], log_b)];
+}
+
+static unsigned next_pow2(unsigned n)
+{
+	unsigned p = 1;
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+/* Fast Walsh-Hadamard transform mod FF_MODULUS. Only blocks starting before m_truncated are
+ * processed, the rest of the input must be zero. */
+static void fwht(ffe_t *data, unsigned m, unsigned m_truncated)
+{
+	unsigned width, r, i;
+
+	for (width = 1; width < m; width <<= 1) {
+		for (r = 0; r < m_truncated; r += width * 2) {
+			for (i = r; i < r + width; i++) {
+				ffe_t sum = add_mod(data[i], data[i + width]);
+				ffe_t dif = sub_mod(data[i], data[i + width]);
+				data[i] = sum;
+				data[i + width] = dif;
+			}
+		}
+	}
+}
+
+static void init_tables(void)
+{
+	unsigned state = 1;
+	unsigned i, j;
+
+	/* LFSR table generation */
+	for (i = 0; i < FF_MODULUS; i++) {
+		exp_lut[state] = (ffe_t)i;
+		state <<= 1;
+		if (state >= FF_ORDER)
+			state ^= FF_POLYNOMIAL;
+	}
+	exp_lut[0] = FF_MODULUS;
+
+	/* conversion to the Cantor basis */
+	log_lut[0] = 0;
+	for (i = 0; i < FF_BITS; i++) {
+		unsigned width = 1u << i;
+		for (j = 0; j < width; j++)
+			log_lut[j + width] = log_lut[j] ^ cantor_basis[i];
+	}
+	for (i = 0; i < FF_ORDER; i++)
+		log_lut[i] = exp_lut[log_lut[i]];
+	for (i = 0; i < FF_ORDER; i++)
+		exp_lut[log_lut[i]] = (ffe_t)i;
+	exp_lut[FF_MODULUS] = exp_lut[0];
+}
+
+static void init_fft(void)
+{
+	ffe_t temp[FF_BITS - 1];
+	unsigned i, j, m;
+
+	for (i = 1; i < FF_BITS; i++)
+		temp[i - 1] = (ffe_t)(1u << i);
+
+	for (m = 0; m < FF_BITS - 1; m++) {
+		unsigned step = 1u << (m + 1);
+
+		fft_skew[(1u << m) - 1] = 0;
+
+		for (i = m; i < FF_BITS - 1; i++) {
+			unsigned s = 1u << (i + 1);
+			for (j = (1u << m) - 1; j < s; j += step)
+				fft_skew[j + s] = fft_skew[j] ^ temp[i];
+		}
+
+		temp[m] = FF_MODULUS - log_lut[mul_log(temp[m], log_lut[temp[m] ^ 1])];
+
+		for (i = m + 1; i < FF_BITS - 1; i++) {
+			ffe_t sum = add_mod(log_lut[temp[i] ^ 1], temp[m]);
+			temp[i] = mul_log(temp[i], sum);
+		}
+	}
+
+	for (i = 0; i < FF_MODULUS; i++)
+		fft_skew[i] = log_lut[fft_skew[i]];
+
+	for (i = 0; i < FF_ORDER; i++)
+		log_walsh[i] = log_lut[i];
+	log_walsh[0] = 0;
+
+	fwht(log_walsh, FF_ORDER, FF_ORDER);
+}
+
+void fft_rs_init(void)
+{
+	if (initialized)
+		return;
+
+	init_tables();
+	init_fft();
+
+	initialized = 1;
+}
+
+/* x ^= y */
+static void xor_mem(unsigned char *x, const unsigned char *y, int bytes)
+{
+	int i;
+	for (i = 0; i < bytes; i++)
+		x[i] ^= y[i];
+}
+
+/* Symbols are stored little endian. Multiplication by a constant is linear over GF(2): the product
+ * of a symbol is the xor of the products of its low and high bytes, which are looked up in two
+ * tables built from 16 products. */
+typedef struct {
+	ffe_t lo[256];
+	ffe_t hi[256];
+} mul_table;
+
+static void build_mul_table(mul_table *table, ffe_t log_m)
+{
+	unsigned i, j;
+
+	table->lo[0] = 0;
+	table->hi[0] = 0;
+	for (i = 0; i < 8; i++) {
+		unsigned bit = 1u << i;
+		ffe_t lo = mul_log((ffe_t)bit, log_m);
+		ffe_t hi = mul_log((ffe_t)(bit << 8), log_m);
+		for (j = 0; j < bit; j++) {
+			table->lo[j + bit] = table->lo[j] ^ lo;
+			table->hi[j + bit] = table->hi[j] ^ hi;
+		}
+	}
+}
+
+/* x ^= y * m */
+static void mul_add_mem(unsigned char *x, const unsigned char *y, const mul_table *table, int bytes)
+{
+	int i;
+
+	for (i = 0; i < bytes; i += 2) {
+		ffe_t product = table->lo[y[i]] ^ table->hi[y[i + 1]];
+		x[i] ^= (unsigned char)product;
+		x[i + 1] ^= (unsigned char)(product >> 8);
+	}
+}
+
+/* x = y * exp(log_m) */
+static void mul_mem(unsigned char *x, const unsigned char *y, ffe_t log_m, int bytes)
+{
+	mul_table table;
+	int i;
+
+	build_mul_table(&table, log_m);
+	for (i = 0; i < bytes; i += 2) {
+		ffe_t product = table.lo[y[i]] ^ table.hi[y[i + 1]];
+		x[i] = (unsigned char)product;
+		x[i + 1] = (unsigned char)(product >> 8);
+	}
+}
+
+/* Inverse FFT, decimation in time. The factor of the butterfly between elements i and i + dist
+ * of the block starting at r is fft_skew[skew_offset + r + dist - 1]. */
+static void ifft_dit(unsigned char **work, unsigned m_truncated, unsigned m, unsigned skew_offset,
+					 int bytes)
+{
+	unsigned dist, r, i;
+
+	for (dist = 1; dist < m; dist <<= 1) {
+		for (r = 0; r < m_truncated; r += dist * 2) {
+			ffe_t log_m = fft_skew[skew_offset + r + dist - 1];
+			mul_table table;
+
+			if (log_m != FF_MODULUS)
+				build_mul_table(&table, log_m);
+
+			for (i = r; i < r + dist; i++) {
+				xor_mem(work[i + dist], work[i], bytes);
+				if (log_m != FF_MODULUS)
+					mul_add_mem(work[i], work[i + dist], &table, bytes);
+			}
+		}
+	}
+}
+
+/* FFT, decimation in time. Only the first m_truncated outputs are computed. */
+static void fft_dit(unsigned char **work, unsigned m_truncated, unsigned m, unsigned skew_offset,
+					int bytes)
+{
+	unsigned dist, r, i;
+
+	for (dist = m >> 1; dist > 0; dist >>= 1) {
+		for (r = 0; r < m_truncated; r += dist * 2) {
+			ffe_t log_m = fft_skew[skew_offset + r + dist - 1];
+			mul_table table;
+
+			if (log_m != FF_MODULUS)
+				build_mul_table(&table, log_m);
+
+			for (i = r; i < r + dist; i++) {
+				if (log_m != FF_MODULUS)
+					mul_add_mem(work[i], work[i + dist], &table, bytes);
+				xor_mem(work[i + dist], work[i], bytes);
+			}
+		}
+	}
+}
+
+int fft_rs_encode_work_count(int data_shards, int parity_shards)
+{
+	unsigned m = next_pow2(parity_shards);
+	return (int)(data_shards > (int)m ? m * 2 : m);
+}
+
+int fft_rs_decode_work_count(int data_shards, int parity_shards)
+{
+	return (int)next_pow2(next_pow2(parity_shards) + data_shards);
+}
+
+int fft_rs_encode(int data_shards, int parity_shards, int block_size,
+				  const unsigned char **data, unsigned char **work)
+{
+	unsigned m, i, j, count;
+	unsigned skew_offset;
+
+	if (!initialized || data_shards <= 0 || parity_shards <= 0 || block_size % 2 != 0)
+		return -1;
+
+	m = next_pow2(parity_shards);
+	if (m + data_shards > FFT_RS_SHARDS_MAX)
+		return -1;
+
+	/* work <- IFFT(data) for each set of m data shards, xored together */
+	for (i = 0, skew_offset = m; i < (unsigned)data_shards; i += m, skew_offset += m) {
+		unsigned char **dest = i == 0 ? work : work + m;
+
+		count = data_shards - i < m ? data_shards - i : m;
+		for (j = 0; j < count; j++)
+			memcpy(dest[j], data[i + j], block_size);
+		for (j = count; j < m; j++)
+			memset(dest[j], 0, block_size);
+
+		ifft_dit(dest, count, m, skew_offset, block_size);
+
+		if (i != 0) {
+			for (j = 0; j < m; j++)
+				xor_mem(work[j], dest[j], block_size);
+		}
+	}
+
+	/* work <- FFT(work) */
+	fft_dit(work, parity_shards, m, 0, block_size);
+
+	return 0;
+}
+
+int fft_rs_decode(int data_shards, int parity_shards, int block_size,
+				  const unsigned char **data, const unsigned char **parity,
+				  unsigned char **work, unsigned short *scratch)
+{
+	unsigned m, n, i, width;
+	int present = 0, missing = 0;
+	ffe_t *error_locations = scratch;
+
+	if (!initialized || data_shards <= 0 || parity_shards <= 0 || block_size % 2 != 0)
+		return -1;
+
+	m = next_pow2(parity_shards);
+	n = next_pow2(m + data_shards);
+	if (m + data_shards > FFT_RS_SHARDS_MAX)
+		return -1;
+
+	for (i = 0; i < (unsigned)data_shards; i++) {
+		if (data[i])
+			present++;
+		else
+			missing++;
+	}
+	if (missing == 0)
+		return 0;
+	for (i = 0; i < (unsigned)parity_shards; i++) {
+		if (parity[i])
+			present++;
+	}
+	if (present < data_shards)
+		return -1;
+
+	memset(error_locations, 0, FF_ORDER * sizeof(ffe_t));
+
+	/* Evaluate the error locator polynomial */
+	for (i = 0; i < (unsigned)parity_shards; i++) {
+		if (!parity[i])
+			error_locations[i] = 1;
+	}
+	for (i = parity_shards; i < m; i++)
+		error_locations[i] = 1;
+	for (i = 0; i < (unsigned)data_shards; i++) {
+		if (!data[i])
+			error_locations[i + m] = 1;
+	}
+
+	fwht(error_locations, FF_ORDER, m + data_shards);
+	for (i = 0; i < FF_ORDER; i++)
+		error_locations[i] = (ffe_t)(((unsigned)error_locations[i] * log_walsh[i]) % FF_MODULUS);
+	fwht(error_locations, FF_ORDER, FF_ORDER);
+
+	/* work <- received shards, multiplied by the error locator */
+	for (i = 0; i < (unsigned)parity_shards; i++) {
+		if (parity[i])
+			mul_mem(work[i], parity[i], error_locations[i], block_size);
+		else
+			memset(work[i], 0, block_size);
+	}
+	for (i = parity_shards; i < m; i++)
+		memset(work[i], 0, block_size);
+	for (i = 0; i < (unsigned)data_shards; i++) {
+		if (data[i])
+			mul_mem(work[m + i], data[i], error_locations[m + i], block_size);
+		else
+			memset(work[m + i], 0, block_size);
+	}
+	for (i = m + data_shards; i < n; i++)
+		memset(work[i], 0, block_size);
+
+	/* work <- IFFT(work) */
+	ifft_dit(work, m + data_shards, n, 0, block_size);
+
+	/* work <- formal derivative of work */
+	for (i = 1; i < n; i++) {
+		unsigned j;
+		width = ((i ^ (i - 1)) + 1) >> 1;
+		for (j = 0; j < width; j++)
+			xor_mem(work[i - width + j], work[i + j], block_size);
+	}
+
+	/* work <- FFT(work), only the data positions are needed */
+	fft_dit(work, m + data_shards, n, 0, block_size);
+
+	/* reveal the erasures */
+	for (i = 0; i < (unsigned)data_shards; i++) {
+		if (!data[i])
+			mul_mem(work[i], work[i + m], FF_MODULUS - error_locations[i + m], block_size);
+	}
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef __FFT_RS_H_
+#define __FFT_RS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/*
+	 * Reed-Solomon erasure code over GF(2^16), encoded and decoded with the additive FFT of
+	 * Lin, Han and Chung ("Novel Polynomial Basis and Its Application to Reed-Solomon Erasure
+	 * Codes", 2014), in the same way as the Leopard-RS library.
+	 * Encoding and decoding are O(n log n), so a codeword can span a whole video frame with one
+	 * packet per shard.
+	 *
+	 * Shards are arrays of 16 bit symbols: block_size must be a multiple of 2.
+	 * data_shards + next_pow2(parity_shards) must not exceed FFT_RS_SHARDS_MAX.
+	 */
+#define FFT_RS_SHARDS_MAX 65536
+	/* number of 16 bit symbols of the scratch buffer of fft_rs_decode() */
+#define FFT_RS_DECODE_SCRATCH_SIZE 65536
+
+	/**
+	 * MUST initial one time
+	 * */
+	void fft_rs_init(void);
+
+	/**
+	 * number of work buffers of block_size bytes needed by fft_rs_encode()
+	 * */
+	int fft_rs_encode_work_count(int data_shards, int parity_shards);
+
+	/**
+	 * number of work buffers of block_size bytes needed by fft_rs_decode()
+	 * */
+	int fft_rs_decode_work_count(int data_shards, int parity_shards);
+
+	/**
+	 * input:
+	 * data[data_shards][block_size]
+	 * work[fft_rs_encode_work_count()][block_size]
+	 * output:
+	 * parity shards in work[0..parity_shards)
+	 * */
+	int fft_rs_encode(int data_shards, int parity_shards, int block_size,
+					  const unsigned char **data, unsigned char **work);
+
+	/**
+	 * input:
+	 * data[data_shards][block_size], NULL for missing shards
+	 * parity[parity_shards][block_size], NULL for missing shards
+	 * work[fft_rs_decode_work_count()][block_size]
+	 * scratch[FFT_RS_DECODE_SCRATCH_SIZE], reused across calls by the caller
+	 * output:
+	 * missing data shard i in work[i]
+	 * returns -1 if less than data_shards shards are present
+	 * */
+	int fft_rs_decode(int data_shards, int parity_shards, int block_size,
+					  const unsigned char **data, const unsigned char **parity,
+					  unsigned char **work, unsigned short *scratch);
+
+#ifdef __cplusplus
+};
+#endif
+#endif
@@ -576,6 +576,13 @@ int reed_solomon_encode(reed_solomon* rs, unsigned char** shards, int nr_shards,
     return 0;
 }
 
+int reed_solomon_encode_parity(reed_solomon* rs, unsigned char** data, unsigned char** parity, int first_parity, int nr_parity, int block_size) {
+    if (first_parity < 0 || nr_parity < 0 || first_parity + nr_parity > rs->parity_shards)
+        return -1;
+
+    return code_some_shards(rs->parity + first_parity * rs->data_shards, data, parity, rs->data_shards, nr_parity, block_size);
+}
+
 /**
  * reconstruct a big size of buffer
  * input:
@@ -1,4 +1,5 @@
 #include "ClientConnection.h"
+#include <atomic>
 #include <mutex>
 #include <string.h>
 
@@ -9,12 +10,15 @@
 #include "Settings.h"
 
 const int64_t STATISTICS_TIMEOUT_US = 100 * 1000;
+// Smallest amount of frame data encoded by a single FEC task
+const int MIN_FEC_GROUP_SIZE = 64 * 1024;
 
 ClientConnection::ClientConnection() : m_LastStatisticsUpdate(0) {
 
 	m_Statistics = std::make_shared<Statistics>();
 
 	reed_solomon_init();
+	m_fecPool = std::make_unique<WorkerPool>();
 	
 	videoPacketCounter = 0;
 	m_fecPercentage = INITIAL_FEC_PERCENTAGE;
@@ -22,10 +26,16 @@ ClientConnection::ClientConnection() : m_LastStatisticsUpdate(0) {
 	m_Statistics->ResetAll();
 }
 
+// Parity is computed on the FEC worker pool in groups of packets, while the data packets are
+// sent. Every byte column of the shards is encoded independently, so a group is a range of
+// packets of one parity shard. Parity packets are sent in order as soon as their group is ready.
 void ClientConnection::FECSend(uint8_t *buf, int len, uint64_t frameIndex, uint64_t videoFrameIndex) {
-	int shardPackets = CalculateFECShardPackets(len, m_fecPercentage);
+	uint64_t encodeStartUs = GetTimestampUs();
 
-	int blockSize = shardPackets * ALVR_MAX_VIDEO_BUFFER_SIZE;
+	int packetSize = Settings::Instance().m_videoPacketSize;
+	int shardPackets = CalculateFECShardPackets(len, m_fecPercentage, packetSize);
+
+	int blockSize = shardPackets * packetSize;
 
 	int dataShards = (len + blockSize - 1) / blockSize;
 	int totalParityShards = CalculateParityShards(dataShards, m_fecPercentage);
@@ -43,24 +53,50 @@ void ClientConnection::FECSend(uint8_t *buf, int len, uint64_t frameIndex, uint6
 	for (int i = 0; i < dataShards; i++) {
 		shards[i] = buf + i * blockSize;
 	}
+	std::vector<uint8_t> lastShard;
 	if (len % blockSize != 0) {
 		// Padding
-		shards[dataShards - 1] = new uint8_t[blockSize];
-		memset(shards[dataShards - 1], 0, blockSize);
-		memcpy(shards[dataShards - 1], buf + (dataShards - 1) * blockSize, len % blockSize);
+		lastShard.resize(blockSize, 0);
+		memcpy(lastShard.data(), buf + (dataShards - 1) * blockSize, len % blockSize);
+		shards[dataShards - 1] = lastShard.data();
 	}
+	m_fecWork.resize((size_t)totalParityShards * blockSize);
 	for (int i = 0; i < totalParityShards; i++) {
-		shards[dataShards + i] = new uint8_t[blockSize];
+		shards[dataShards + i] = m_fecWork.data() + (size_t)i * blockSize;
 	}
 
-	int ret = reed_solomon_encode(rs, &shards[0], totalShards, blockSize);
-	assert(ret == 0);
+	int groupPackets = std::max(1, MIN_FEC_GROUP_SIZE / (dataShards * packetSize));
+	groupPackets = std::min(groupPackets, shardPackets);
+	int shardGroups = (shardPackets + groupPackets - 1) / groupPackets;
+	int groupCount = totalParityShards * shardGroups;
 
-	reed_solomon_release(rs);
+	std::unique_ptr<std::atomic_bool[]> groupDone(new std::atomic_bool[groupCount]);
+	for (int group = 0; group < groupCount; group++) {
+		groupDone[group] = false;
+
+		int parityShard = group / shardGroups;
+		int firstPacket = (group % shardGroups) * groupPackets;
+		int packetCount = std::min(groupPackets, shardPackets - firstPacket);
+
+		m_fecPool->Push([&, group, parityShard, firstPacket, packetCount] {
+			size_t offset = (size_t)firstPacket * packetSize;
 
-	uint8_t packetBuffer[2000];
-	VideoFrame *header = (VideoFrame *)packetBuffer;
-	uint8_t *payload = packetBuffer + sizeof(VideoFrame);
+			std::vector<uint8_t *> data(dataShards);
+			for (int i = 0; i < dataShards; i++) {
+				data[i] = shards[i] + offset;
+			}
+			uint8_t *parity = shards[dataShards + parityShard] + offset;
+
+			int ret = reed_solomon_encode_parity(rs, data.data(), &parity, parityShard, 1, packetCount * packetSize);
+			assert(ret == 0);
+
+			groupDone[group] = true;
+		});
+	}
+
+	std::vector<uint8_t> packetBuffer(sizeof(VideoFrame) + packetSize);
+	VideoFrame *header = (VideoFrame *)packetBuffer.data();
+	uint8_t *payload = packetBuffer.data() + sizeof(VideoFrame);
 	int dataRemain = len;
 
 	Debug("Sending video frame. trackingFrameIndex=%llu videoFrameIndex=%llu size=%d\n", frameIndex, videoFrameIndex, len);
@@ -74,45 +110,156 @@ void ClientConnection::FECSend(uint8_t *buf, int len, uint64_t frameIndex, uint6
 	header->fecPercentage = (uint16_t)m_fecPercentage;
 	for (int i = 0; i < dataShards; i++) {
 		for (int j = 0; j < shardPackets; j++) {
-			int copyLength = std::min(ALVR_MAX_VIDEO_BUFFER_SIZE, dataRemain);
+			int copyLength = std::min(packetSize, dataRemain);
 			if (copyLength <= 0) {
 				break;
 			}
-			memcpy(payload, shards[i] + j * ALVR_MAX_VIDEO_BUFFER_SIZE, copyLength);
-			dataRemain -= ALVR_MAX_VIDEO_BUFFER_SIZE;
+			memcpy(payload, shards[i] + j * packetSize, copyLength);
+			dataRemain -= packetSize;
 
 			header->packetCounter = videoPacketCounter;
 			videoPacketCounter++;
-			VideoSend(*header, (unsigned char *)packetBuffer + sizeof(VideoFrame), copyLength);
+			VideoSend(*header, payload, copyLength);
 			m_Statistics->CountPacket(sizeof(VideoFrame) + copyLength);
 			header->fecIndex++;
 		}
 	}
 	header->fecIndex = dataShards * shardPackets;
-	for (int i = 0; i < totalParityShards; i++) {
-		for (int j = 0; j < shardPackets; j++) {
-			int copyLength = ALVR_MAX_VIDEO_BUFFER_SIZE;
-			memcpy(payload, shards[dataShards + i] + j * ALVR_MAX_VIDEO_BUFFER_SIZE, copyLength);
+	for (int group = 0; group < groupCount; group++) {
+		m_fecPool->RunUntil([&] { return groupDone[group].load(); });
+
+		int parityShard = group / shardGroups;
+		int firstPacket = (group % shardGroups) * groupPackets;
+		int packetCount = std::min(groupPackets, shardPackets - firstPacket);
+		for (int j = firstPacket; j < firstPacket + packetCount; j++) {
+			int copyLength = packetSize;
+			memcpy(payload, shards[dataShards + parityShard] + j * packetSize, copyLength);
 
 			header->packetCounter = videoPacketCounter;
 			videoPacketCounter++;
 			
-			VideoSend(*header, (unsigned char *)packetBuffer + sizeof(VideoFrame), copyLength);
+			VideoSend(*header, payload, copyLength);
 			m_Statistics->CountPacket(sizeof(VideoFrame) + copyLength);
 			header->fecIndex++;
 		}
 	}
 
-	if (len % blockSize != 0) {
-		delete[] shards[dataShards - 1];
+	reed_solomon_release(rs);
+
+	Debug("FEC sent. size=%d groups=%d threads=%d latency=%lluus\n", len, groupCount,
+		m_fecPool->GetThreadCount(), GetTimestampUs() - encodeStartUs);
+}
+
+// Every packet is a shard of a single GF(2^16) codeword spanning the whole frame, so each lost
+// packet can be recovered by any parity packet. Shards must have an even size.
+// The codeword is split in ranges of symbols which are encoded on the FEC worker pool while the
+// data packets are sent. All parity shards depend on all data shards, so parity packets are sent
+// once every range is done.
+void ClientConnection::FFTFECSend(uint8_t *buf, int len, uint64_t frameIndex, uint64_t videoFrameIndex) {
+	uint64_t encodeStartUs = GetTimestampUs();
+
+	// no-op after the first call
+	fft_rs_init();
+
+	int shardSize = Settings::Instance().m_videoPacketSize & ~1;
+
+	int dataShards = (len + shardSize - 1) / shardSize;
+	int parityShards = CalculateParityShards(dataShards, m_fecPercentage);
+
+	std::vector<const uint8_t *> data(dataShards);
+	for (int i = 0; i < dataShards; i++) {
+		data[i] = buf + i * shardSize;
 	}
-	for (int i = 0; i < totalParityShards; i++) {
-		delete[] shards[dataShards + i];
+	std::vector<uint8_t> lastShard;
+	if (len % shardSize != 0) {
+		// Padding
+		lastShard.resize(shardSize, 0);
+		memcpy(lastShard.data(), buf + (dataShards - 1) * shardSize, len % shardSize);
+		data[dataShards - 1] = lastShard.data();
+	}
+
+	int workCount = fft_rs_encode_work_count(dataShards, parityShards);
+	m_fecWork.resize((size_t)workCount * shardSize);
+	std::vector<uint8_t *> work(workCount);
+	for (int i = 0; i < workCount; i++) {
+		work[i] = m_fecWork.data() + (size_t)i * shardSize;
 	}
+
+	// One range per thread (workers and this one), with at least MIN_FEC_GROUP_SIZE bytes of data
+	// each. Ranges must have an even size.
+	int rangeCount = std::max(1, std::min(len / MIN_FEC_GROUP_SIZE, m_fecPool->GetThreadCount() + 1));
+	int rangeSize = ((shardSize + rangeCount - 1) / rangeCount + 1) & ~1;
+	rangeCount = (shardSize + rangeSize - 1) / rangeSize;
+
+	std::atomic_int rangesRemaining(rangeCount);
+	std::atomic_bool encodeFailed(false);
+	for (int offset = 0; offset < shardSize; offset += rangeSize) {
+		int size = std::min(rangeSize, shardSize - offset);
+
+		m_fecPool->Push([&, offset, size] {
+			std::vector<const uint8_t *> rangeData(dataShards);
+			for (int i = 0; i < dataShards; i++) {
+				rangeData[i] = data[i] + offset;
+			}
+			std::vector<uint8_t *> rangeWork(workCount);
+			for (int i = 0; i < workCount; i++) {
+				rangeWork[i] = work[i] + offset;
+			}
+
+			if (fft_rs_encode(dataShards, parityShards, size, rangeData.data(), rangeWork.data()) != 0) {
+				encodeFailed = true;
+			}
+
+			rangesRemaining--;
+		});
+	}
+
+	Debug("Sending video frame. trackingFrameIndex=%llu videoFrameIndex=%llu size=%d dataShards=%d parityShards=%d\n",
+		frameIndex, videoFrameIndex, len, dataShards, parityShards);
+
+	VideoFrame header = {};
+	header.type = ALVR_PACKET_TYPE_VIDEO_FRAME;
+	header.trackingFrameIndex = frameIndex;
+	header.videoFrameIndex = videoFrameIndex;
+	header.sentTime = GetTimestampUs();
+	header.frameByteSize = len;
+	header.fecPercentage = (uint16_t)m_fecPercentage;
+
+	// Data packets are sent straight from the frame buffer
+	for (int i = 0; i < dataShards; i++) {
+		int copyLength = std::min(shardSize, len - i * shardSize);
+
+		header.packetCounter = videoPacketCounter;
+		videoPacketCounter++;
+		header.fecIndex = i;
+		VideoSend(header, buf + i * shardSize, copyLength);
+		m_Statistics->CountPacket(sizeof(VideoFrame) + copyLength);
+	}
+
+	m_fecPool->RunUntil([&] { return rangesRemaining == 0; });
+
+	if (encodeFailed) {
+		Error("fft_rs_encode failed. dataShards=%d parityShards=%d shardSize=%d\n",
+			dataShards, parityShards, shardSize);
+		parityShards = 0;
+	}
+
+	for (int i = 0; i < parityShards; i++) {
+		header.packetCounter = videoPacketCounter;
+		videoPacketCounter++;
+		header.fecIndex = dataShards + i;
+		VideoSend(header, work[i], shardSize);
+		m_Statistics->CountPacket(sizeof(VideoFrame) + shardSize);
+	}
+
+	Debug("FEC sent. size=%d ranges=%d threads=%d latency=%lluus\n", len, rangeCount,
+		m_fecPool->GetThreadCount(), GetTimestampUs() - encodeStartUs);
 }
 
 void ClientConnection::SendVideo(uint8_t *buf, int len, uint64_t frameIndex) {
-	if (Settings::Instance().m_enableFec) {
+	if (Settings::Instance().m_enableFec && Settings::Instance().m_fecCodec == ALVR_FEC_CODEC_RS16) {
+		FFTFECSend(buf, len, frameIndex, mVideoFrameIndex);
+	} else if (Settings::Instance().m_enableFec) {
 		FECSend(buf, len, frameIndex, mVideoFrameIndex);
 	} else {
 		VideoFrame header = {};
@@ -129,6 +276,9 @@ void ClientConnection::SendVideo(uint8_t *buf, int len, uint64_t frameIndex) {
 		this->videoPacketCounter++;
 	}
 
+	// the packets of the frame are sent together
+	VideoFlush();
+
 	mVideoFrameIndex++;
 }
 
@@ -184,6 +334,10 @@ void ClientConnection::ProcessTimeSync(TimeSync data) {
 			OnFecFailure();
 		}
 
+		if (Settings::Instance().m_infiniteGop) {
+			CheckClientDecoding(*timeSync, Current);
+		}
+
 		m_Statistics->Add(sendBuf.serverTotalLatency / 1000.0, 
 			(double)(m_Statistics->GetEncodeLatencyAverage()) / US_TO_MS,
 			m_reportedStatistics.averageTransportLatency / 1000.0,
@@ -213,6 +367,8 @@ void ClientConnection::ProcessTimeSync(TimeSync data) {
 				"\"fecFailureInSecond\": %llu, "
 				"\"clientFPS\": %.3f, "
 				"\"serverFPS\": %.3f, "
+				"\"framesDroppedEncode\": %u, "
+				"\"framesDroppedSend\": %u, "
 				"\"batteryHMD\": %d, "
 				"\"batteryLeft\": %d, "
 				"\"batteryRight\": %d"
@@ -234,6 +390,8 @@ void ClientConnection::ProcessTimeSync(TimeSync data) {
 				m_reportedStatistics.fecFailureInSecond,
 				m_Statistics->Get(4),  //clientFPS
 				m_Statistics->GetFPS(),
+				m_Statistics->GetFramesDroppedEncodeInSecond(),
+				m_Statistics->GetFramesDroppedSendInSecond(),
 				(int)(m_Statistics->m_hmdBattery * 100),
 				(int)(m_Statistics->m_leftControllerBattery * 100),
 				(int)(m_Statistics->m_rightControllerBattery * 100));
@@ -273,6 +431,34 @@ float ClientConnection::GetPoseTimeOffset() {
 	return -(double)(m_Statistics->GetTotalLatencyAverage()) / 1000.0 / 1000.0;
 }
 
+void ClientConnection::CheckClientDecoding(const TimeSync &timeSync, uint64_t now) {
+	// The client reports the frames it displayed in the last second. It is only expected to
+	// display frames while the server sends them.
+	if (m_lastClientDecode == 0 || timeSync.fps > 0 || m_Statistics->GetFPS() == 0) {
+		m_lastClientDecode = now;
+		return;
+	}
+	if (now - m_lastClientDecode > CLIENT_DECODE_TIMEOUT_US) {
+		Warn("Client stopped decoding for %llu ms\n", (now - m_lastClientDecode) / 1000);
+		RequestKeyframe("client stopped decoding");
+		m_lastClientDecode = now;
+	}
+}
+
+void ClientConnection::RequestKeyframe(const char *reason) {
+	std::unique_lock lock(m_keyframeMutex);
+
+	uint64_t now = GetTimestampUs();
+	if (now - m_lastKeyframeRequest < MIN_KEYFRAME_REQUEST_INTERVAL_US) {
+		Debug("Keyframe request (%s) merged with the previous one\n", reason);
+		return;
+	}
+	m_lastKeyframeRequest = now;
+
+	Info("Requesting a keyframe: %s\n", reason);
+	RequestIDR();
+}
+
 void ClientConnection::OnFecFailure() {
 	Debug("Listener::OnFecFailure()\n");
 	if (GetTimestampUs() - m_lastFecFailure < CONTINUOUS_FEC_FAILURE) {
@@ -4,20 +4,26 @@
 #include <memory>
 #include <fstream>
 #include <mutex>
+#include <vector>
 
 #include "ALVR-common/packet_types.h"
 #include "Settings.h"
+#include "WorkerPool.h"
 
 #include "openvr_driver.h"
 
 class Statistics;
 
+// Video, tracking and statistics of the single client. Encoded frames are not shared with other
+// receivers: streaming one encode to several clients or spectators would need per-client FEC,
+// packet counters and loss feedback, and a server connection that accepts more than one client.
 class ClientConnection {
 public:
 
 	ClientConnection();
 
 	void FECSend(uint8_t *buf, int len, uint64_t frameIndex, uint64_t videoFrameIndex);
+	void FFTFECSend(uint8_t *buf, int len, uint64_t frameIndex, uint64_t videoFrameIndex);
 	void SendVideo(uint8_t *buf, int len, uint64_t frameIndex);
 	void ProcessTrackingInfo(TrackingInfo data);
  	void ProcessTimeSync(TimeSync data);
@@ -25,6 +31,11 @@ public:
 	void OnFecFailure();
 	std::shared_ptr<Statistics> GetStatistics();
 private:
+	void CheckClientDecoding(const TimeSync &timeSync, uint64_t now);
+	// Keyframe requests of the server side checks are merged, a single keyframe serves all of them.
+	// The IDR requests of the client go straight to the encoder.
+	void RequestKeyframe(const char *reason);
+
 	std::shared_ptr<Statistics> m_Statistics;
 
 	uint32_t videoPacketCounter = 0;
@@ -41,5 +52,18 @@ private:
 
 	uint64_t mVideoFrameIndex = 1;
 
+	// Without periodic keyframes, a client that stopped decoding only recovers with a requested one
+	static const uint64_t CLIENT_DECODE_TIMEOUT_US = 1000 * 1000;
+	uint64_t m_lastClientDecode = 0;
+
+	// Same as the minimum interval of IDRScheduler: a keyframe is already on its way
+	static const uint64_t MIN_KEYFRAME_REQUEST_INTERVAL_US = 100 * 1000;
+	std::mutex m_keyframeMutex;
+	uint64_t m_lastKeyframeRequest = 0;
+
+	// Parity (and GF(2^16) encoder work) buffers, kept between frames
+	std::vector<uint8_t> m_fecWork;
+	std::unique_ptr<WorkerPool> m_fecPool;
+
 	uint64_t m_LastStatisticsUpdate;
 };
@@ -4,6 +4,7 @@
 #include "Settings.h"
 #include "Utils.h"
 #include "include/openvr_math.h"
+#include "include/pose_math.h"
 #include <algorithm>
 #include <cstring>
 #include <string_view>
@@ -590,39 +591,6 @@ int OvrController::getControllerIndex() { return device_path == LEFT_HAND_PATH ?
 
 vr::VRInputComponentHandle_t OvrController::getHapticComponent() { return m_compHaptic; }
 
-vr::HmdQuaternion_t QuatMultiply(const vr::HmdQuaternion_t *q1, const vr::HmdQuaternion_t *q2) {
-    vr::HmdQuaternion_t result;
-    result.x = q1->w * q2->x + q1->x * q2->w + q1->y * q2->z - q1->z * q2->y;
-    result.y = q1->w * q2->y - q1->x * q2->z + q1->y * q2->w + q1->z * q2->x;
-    result.z = q1->w * q2->z + q1->x * q2->y - q1->y * q2->x + q1->z * q2->w;
-    result.w = q1->w * q2->w - q1->x * q2->x - q1->y * q2->y - q1->z * q2->z;
-    return result;
-}
-vr::HmdQuaternionf_t QuatMultiply(const vr::HmdQuaternion_t *q1, const vr::HmdQuaternionf_t *q2) {
-    vr::HmdQuaternionf_t result;
-    result.x = (float)(q1->w * q2->x + q1->x * q2->w + q1->y * q2->z - q1->z * q2->y);
-    result.y = (float)(q1->w * q2->y - q1->x * q2->z + q1->y * q2->w + q1->z * q2->x);
-    result.z = (float)(q1->w * q2->z + q1->x * q2->y - q1->y * q2->x + q1->z * q2->w);
-    result.w = (float)(q1->w * q2->w - q1->x * q2->x - q1->y * q2->y - q1->z * q2->z);
-    return result;
-}
-vr::HmdQuaternionf_t QuatMultiply(const vr::HmdQuaternionf_t *q1, const vr::HmdQuaternion_t *q2) {
-    vr::HmdQuaternionf_t result;
-    result.x = (float)(q1->w * q2->x + q1->x * q2->w + q1->y * q2->z - q1->z * q2->y);
-    result.y = (float)(q1->w * q2->y - q1->x * q2->z + q1->y * q2->w + q1->z * q2->x);
-    result.z = (float)(q1->w * q2->z + q1->x * q2->y - q1->y * q2->x + q1->z * q2->w);
-    result.w = (float)(q1->w * q2->w - q1->x * q2->x - q1->y * q2->y - q1->z * q2->z);
-    return result;
-}
-vr::HmdQuaternionf_t QuatMultiply(const vr::HmdQuaternionf_t *q1, const vr::HmdQuaternionf_t *q2) {
-    vr::HmdQuaternionf_t result;
-    result.x = q1->w * q2->x + q1->x * q2->w + q1->y * q2->z - q1->z * q2->y;
-    result.y = q1->w * q2->y - q1->x * q2->z + q1->y * q2->w + q1->z * q2->x;
-    result.z = q1->w * q2->z + q1->x * q2->y - q1->y * q2->x + q1->z * q2->w;
-    result.w = q1->w * q2->w - q1->x * q2->x - q1->y * q2->y - q1->z * q2->z;
-    return result;
-}
-
 bool OvrController::onPoseUpdate(int controllerIndex, const TrackingInfo &info) {
 
     if (this->object_id == vr::k_unTrackedDeviceIndexInvalid) {
@@ -641,7 +609,7 @@ bool OvrController::onPoseUpdate(int controllerIndex, const TrackingInfo &info)
                                                 TrackingInfo::Controller::FLAG_CONTROLLER_LEFTHAND
                                             ? HmdQuaternion_Init(-0.5, 0.5, 0.5, -0.5)
                                             : HmdQuaternion_Init(0.5, 0.5, 0.5, 0.5);
-        this->pose.qRotation = QuatMultiply(&rootBoneRot, &boneFixer);
+        this->pose.qRotation = posemath::multiply<vr::HmdQuaternion_t>(rootBoneRot, boneFixer);
         this->pose.vecPosition[0] = info.controller[controllerIndex].boneRootPosition.x;
         this->pose.vecPosition[1] = info.controller[controllerIndex].boneRootPosition.y;
         this->pose.vecPosition[2] = info.controller[controllerIndex].boneRootPosition.z;
@@ -991,8 +959,8 @@ bool OvrController::onPoseUpdate(int controllerIndex, const TrackingInfo &info)
 
         vr::HmdQuaternion_t boneFixer = HmdQuaternion_Init(0, 0, 0.924, -0.383);
         COPY4(c.boneRotations[alvrHandBone_WristRoot], m_boneTransform[HSB_Wrist].orientation);
-        m_boneTransform[HSB_Wrist].orientation =
-            QuatMultiply(&m_boneTransform[HSB_Wrist].orientation, &boneFixer);
+        m_boneTransform[HSB_Wrist].orientation = posemath::multiply<vr::HmdQuaternionf_t>(
+            m_boneTransform[HSB_Wrist].orientation, boneFixer);
 
         COPY4(c.boneRotations[alvrHandBone_Thumb0], m_boneTransform[HSB_Thumb0].orientation);
         COPY4(c.boneRotations[alvrHandBone_Thumb1], m_boneTransform[HSB_Thumb1].orientation);
@@ -1123,16 +1091,16 @@ bool OvrController::onPoseUpdate(int controllerIndex, const TrackingInfo &info)
         // Rotate thumb0 and pinky0 properly.
         if (this->device_path == LEFT_HAND_PATH) {
             vr::HmdQuaternion_t fixer = HmdQuaternion_Init(0.5, 0.5, -0.5, 0.5);
-            m_boneTransform[HSB_Thumb0].orientation =
-                QuatMultiply(&fixer, &m_boneTransform[HSB_Thumb0].orientation);
-            m_boneTransform[HSB_PinkyFinger0].orientation =
-                QuatMultiply(&fixer, &m_boneTransform[HSB_PinkyFinger0].orientation);
+            m_boneTransform[HSB_Thumb0].orientation = posemath::multiply<vr::HmdQuaternionf_t>(
+                fixer, m_boneTransform[HSB_Thumb0].orientation);
+            m_boneTransform[HSB_PinkyFinger0].orientation = posemath::multiply<vr::HmdQuaternionf_t>(
+                fixer, m_boneTransform[HSB_PinkyFinger0].orientation);
         } else {
             vr::HmdQuaternion_t fixer = HmdQuaternion_Init(0.5, -0.5, 0.5, 0.5);
-            m_boneTransform[HSB_Thumb0].orientation =
-                QuatMultiply(&fixer, &m_boneTransform[HSB_Thumb0].orientation);
-            m_boneTransform[HSB_PinkyFinger0].orientation =
-                QuatMultiply(&fixer, &m_boneTransform[HSB_PinkyFinger0].orientation);
+            m_boneTransform[HSB_Thumb0].orientation = posemath::multiply<vr::HmdQuaternionf_t>(
+                fixer, m_boneTransform[HSB_Thumb0].orientation);
+            m_boneTransform[HSB_PinkyFinger0].orientation = posemath::multiply<vr::HmdQuaternionf_t>(
+                fixer, m_boneTransform[HSB_PinkyFinger0].orientation);
         }
 
         vr::VRDriverInput()->UpdateSkeletonComponent(
@@ -2346,14 +2314,8 @@ void OvrController::GetBoneTransform(bool withController,
     // thumb
     GetThumbBoneTransform(withController, isLeftHand, lastPoseButtons, boneTransform1);
     GetThumbBoneTransform(withController, isLeftHand, c.buttons, boneTransform2);
-    for (int boneIdx = 2; boneIdx < 6; boneIdx++) {
-        outBoneTransform[boneIdx].position = Lerp(boneTransform1[boneIdx].position,
-                                                  boneTransform2[boneIdx].position,
-                                                  thumbAnimationProgress);
-        outBoneTransform[boneIdx].orientation = Slerp(boneTransform1[boneIdx].orientation,
-                                                      boneTransform2[boneIdx].orientation,
-                                                      thumbAnimationProgress);
-    }
+    posemath::blendBones(
+        &boneTransform1[2], &boneTransform2[2], &outBoneTransform[2], 4, thumbAnimationProgress);
 
     // trigger (index to pinky)
     if (c.triggerValue > 0) {
@@ -2361,43 +2323,31 @@ void OvrController::GetBoneTransform(bool withController,
             withController, isLeftHand, ALVR_BUTTON_FLAG(ALVR_INPUT_TRIGGER_TOUCH), boneTransform1);
         GetTriggerBoneTransform(
             withController, isLeftHand, ALVR_BUTTON_FLAG(ALVR_INPUT_TRIGGER_CLICK), boneTransform2);
-        for (int boneIdx = 6; boneIdx < SKELETON_BONE_COUNT; boneIdx++) {
-            outBoneTransform[boneIdx].position = Lerp(
-                boneTransform1[boneIdx].position, boneTransform2[boneIdx].position, c.triggerValue);
-            outBoneTransform[boneIdx].orientation = Slerp(boneTransform1[boneIdx].orientation,
-                                                          boneTransform2[boneIdx].orientation,
-                                                          c.triggerValue);
-        }
+        posemath::blendBones(&boneTransform1[6],
+                             &boneTransform2[6],
+                             &outBoneTransform[6],
+                             SKELETON_BONE_COUNT - 6,
+                             c.triggerValue);
     } else {
         GetTriggerBoneTransform(withController, isLeftHand, lastPoseButtons, boneTransform1);
         GetTriggerBoneTransform(withController, isLeftHand, c.buttons, boneTransform2);
-        for (int boneIdx = 6; boneIdx < SKELETON_BONE_COUNT; boneIdx++) {
-            outBoneTransform[boneIdx].position = Lerp(boneTransform1[boneIdx].position,
-                                                      boneTransform2[boneIdx].position,
-                                                      indexAnimationProgress);
-            outBoneTransform[boneIdx].orientation = Slerp(boneTransform1[boneIdx].orientation,
-                                                          boneTransform2[boneIdx].orientation,
-                                                          indexAnimationProgress);
-        }
+        posemath::blendBones(&boneTransform1[6],
+                             &boneTransform2[6],
+                             &outBoneTransform[6],
+                             SKELETON_BONE_COUNT - 6,
+                             indexAnimationProgress);
     }
 
     // grip (middle to pinky)
     if (c.gripValue > 0) {
         GetGripClickBoneTransform(withController, isLeftHand, boneTransform2);
-        for (int boneIdx = 11; boneIdx < 26; boneIdx++) {
-            outBoneTransform[boneIdx].position = Lerp(
-                outBoneTransform[boneIdx].position, boneTransform2[boneIdx].position, c.gripValue);
-            outBoneTransform[boneIdx].orientation = Slerp(outBoneTransform[boneIdx].orientation,
-                                                          boneTransform2[boneIdx].orientation,
-                                                          c.gripValue);
-        }
-        for (int boneIdx = 28; boneIdx < SKELETON_BONE_COUNT; boneIdx++) {
-            outBoneTransform[boneIdx].position = Lerp(
-                outBoneTransform[boneIdx].position, boneTransform2[boneIdx].position, c.gripValue);
-            outBoneTransform[boneIdx].orientation = Slerp(outBoneTransform[boneIdx].orientation,
-                                                          boneTransform2[boneIdx].orientation,
-                                                          c.gripValue);
-        }
+        posemath::blendBones(
+            &outBoneTransform[11], &boneTransform2[11], &outBoneTransform[11], 26 - 11, c.gripValue);
+        posemath::blendBones(&outBoneTransform[28],
+                             &boneTransform2[28],
+                             &outBoneTransform[28],
+                             SKELETON_BONE_COUNT - 28,
+                             c.gripValue);
     }
 }
 
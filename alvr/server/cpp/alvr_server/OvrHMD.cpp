@@ -358,6 +358,18 @@ void OvrHmd::OnPoseUpdated(TrackingInfo info) {
     }
 }
 
+void OvrHmd::OnRedundantPose(TrackingInfo info) {
+    if (this->object_id != vr::k_unTrackedDeviceIndexInvalid) {
+        if (Settings::Instance().m_force3DOF) {
+            info.HeadPose_Pose_Position.x = 0;
+            info.HeadPose_Pose_Position.y = 0;
+            info.HeadPose_Pose_Position.z = 0;
+        }
+
+        m_poseHistory->OnPoseUpdated(info);
+    }
+}
+
 void OvrHmd::StartStreaming() {
     if (m_streamComponentsInitialized) {
         return;
@@ -37,6 +37,8 @@ class OvrHmd : public TrackedDevice, vr::IVRDisplayComponent {
     virtual vr::DriverPose_t GetPose();
 
     void OnPoseUpdated(TrackingInfo info);
+    // Pose of a lost input, only added to the pose history: SteamVR already has a newer one
+    void OnRedundantPose(TrackingInfo info);
 
     void StartStreaming();
 
@@ -1,6 +1,8 @@
 #include "PoseHistory.h"
 #include "Utils.h"
+#include "include/pose_math.h"
 #include "Logger.h"
+#include <iterator>
 #include <mutex>
 #include <optional>
 
@@ -10,11 +12,7 @@ void PoseHistory::OnPoseUpdated(const TrackingInfo &info) {
 	history.info = info;
 
 
-	HmdMatrix_QuatToMat(info.HeadPose_Pose_Orientation.w,
-		info.HeadPose_Pose_Orientation.x,
-		info.HeadPose_Pose_Orientation.y,
-		info.HeadPose_Pose_Orientation.z,
-		&history.rotationMatrix);
+	posemath::quatToMat33(info.HeadPose_Pose_Orientation, history.rotationMatrix);
 
 	Debug("Rotation Matrix=(%f, %f, %f, %f) (%f, %f, %f, %f) (%f, %f, %f, %f)\n"
 		, history.rotationMatrix.m[0][0], history.rotationMatrix.m[0][1], history.rotationMatrix.m[0][2], history.rotationMatrix.m[0][3]
@@ -22,45 +20,35 @@ void PoseHistory::OnPoseUpdated(const TrackingInfo &info) {
 		, history.rotationMatrix.m[2][0], history.rotationMatrix.m[2][1], history.rotationMatrix.m[2][2], history.rotationMatrix.m[2][3]);
 
 	std::unique_lock<std::mutex> lock(m_mutex);
-	if (m_poseBuffer.size() == 0) {
-		m_poseBuffer.push_back(history);
+	auto it = m_poseBuffer.end();
+	while (it != m_poseBuffer.begin() && std::prev(it)->info.FrameIndex > info.FrameIndex) {
+		--it;
 	}
-	else {
-		if (m_poseBuffer.back().info.FrameIndex != info.FrameIndex) {
-			// New track info
-			m_poseBuffer.push_back(history);
-		}
+	if (it != m_poseBuffer.begin() && std::prev(it)->info.FrameIndex == info.FrameIndex) {
+		return;
 	}
-	if (m_poseBuffer.size() > 36) {
+	if (m_poseBuffer.size() == MAX_POSES) {
+		if (it == m_poseBuffer.begin()) {
+			// older than the whole history
+			return;
+		}
 		m_poseBuffer.pop_front();
+		m_rotations.erase(0);
 	}
+	m_rotations.insert(std::distance(m_poseBuffer.begin(), it), history.rotationMatrix);
+	m_poseBuffer.insert(it, history);
 }
 
 std::optional<PoseHistory::TrackingHistoryFrame> PoseHistory::GetBestPoseMatch(const vr::HmdMatrix34_t &pose) const
 {
 	std::unique_lock<std::mutex> lock(m_mutex);
-	float minDiff = 100000;
-	auto minIt = m_poseBuffer.begin();
-	for (auto it = m_poseBuffer.begin(); it != m_poseBuffer.end(); ++it) {
-		float distance = 0;
-		// Rotation matrix composes a part of ViewMatrix of TrackingInfo.
-		// Be carefull of transpose.
-		// And bottom side and right side of matrix should not be compared, because pPose does not contain that part of matrix.
-		for (int i = 0; i < 3; i++) {
-			for (int j = 0; j < 3; j++) {
-				distance += pow(it->rotationMatrix.m[j][i] - pose.m[j][i], 2);
-			}
-		}
-		//LogDriver("diff %f %llu", distance, it->info.FrameIndex);
-		if (minDiff > distance) {
-			minIt = it;
-			minDiff = distance;
-		}
-	}
-	if (minIt != m_poseBuffer.end()) {
-		return *minIt;
+	if (m_poseBuffer.empty()) {
+		return {};
 	}
-	return {};
+	// Rotation matrix composes a part of ViewMatrix of TrackingInfo.
+	// Be carefull of transpose.
+	// And bottom side and right side of matrix should not be compared, because pPose does not contain that part of matrix.
+	return *std::next(m_poseBuffer.begin(), posemath::nearest33(m_rotations, pose));
 }
 
 std::optional<PoseHistory::TrackingHistoryFrame> PoseHistory::GetPoseAt(uint64_t client_timestamp_us) const
@@ -73,3 +61,11 @@ std::optional<PoseHistory::TrackingHistoryFrame> PoseHistory::GetPoseAt(uint64_t
 	}
 	return {};
 }
+
+std::optional<PoseHistory::TrackingHistoryFrame> PoseHistory::GetLatest() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_poseBuffer.empty())
+		return {};
+	return m_poseBuffer.back();
+}
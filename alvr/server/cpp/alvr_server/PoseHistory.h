@@ -5,6 +5,7 @@
 #include <openvr_driver.h>
 #include <optional>
 #include "ALVR-common/packet_types.h"
+#include "include/pose_math.h"
 
 class PoseHistory
 {
@@ -14,13 +15,20 @@ public:
 		vr::HmdMatrix34_t rotationMatrix;
 	};
 
+	// Poses are kept in frame index order, a pose can be older than the latest one when it fills
+	// the gap of a lost input. Known frame indices are ignored.
 	void OnPoseUpdated(const TrackingInfo &info);
 
 	std::optional<TrackingHistoryFrame> GetBestPoseMatch(const vr::HmdMatrix34_t &pose) const;
 	// Return the most recent pose known at the given timestamp
 	std::optional<TrackingHistoryFrame> GetPoseAt(uint64_t client_timestamp_us) const;
+	std::optional<TrackingHistoryFrame> GetLatest() const;
 
 private:
+	static const size_t MAX_POSES = 36;
+
 	mutable std::mutex m_mutex;
 	std::list<TrackingHistoryFrame> m_poseBuffer;
+	// rotationMatrix of the frames of m_poseBuffer, in the same order, for GetBestPoseMatch()
+	posemath::Mat33Batch<MAX_POSES> m_rotations;
 };
@@ -98,6 +98,12 @@ void Settings::Load()
 		m_adaptiveBitrateDownRate = (int)config.get("bitrate_down_rate").get<int64_t>();
 		m_adaptiveBitrateLightLoadThreshold = config.get("bitrate_light_load_threshold").get<double>();
 		m_use10bitEncoder = config.get("use_10bit_encoder").get<bool>();
+		m_serverReprojection = config.get("server_reprojection").get<bool>();
+		m_infiniteGop = config.get("infinite_gop").get<bool>();
+		m_encoderInFlightFrames = (uint32_t)config.get("encoder_in_flight_frames").get<int64_t>();
+		m_dropLateFrames = config.get("drop_late_frames").get<bool>();
+		m_enableFrameSizeCap = config.get("enable_frame_size_cap").get<bool>();
+		m_frameSizeCapIntervals = (float)config.get("frame_size_cap_intervals").get<double>();
 
 		m_controllerTrackingSystemName = config.get("controllers_tracking_system_name").get<std::string>();
 		m_controllerManufacturerName = config.get("controllers_manufacturer_name").get<std::string>();
@@ -160,6 +166,7 @@ void Settings::Load()
 		m_sharpening = (float)config.get("sharpening").get<double>();
 
 		m_enableFec = config.get("enable_fec").get<bool>();
+		m_fecCodec = (int32_t)config.get("fec_codec").get<int64_t>();
 		
 		Debug("Config JSON: %hs\n", json.c_str());
 		Info("Serial Number: %hs\n", mSerialNumber.c_str());
@@ -74,6 +74,12 @@ public:
 	uint64_t m_adaptiveBitrateDownRate;
 	float m_adaptiveBitrateLightLoadThreshold;
 	bool m_use10bitEncoder;
+	bool m_serverReprojection;
+	bool m_infiniteGop;
+	uint32_t m_encoderInFlightFrames;
+	bool m_dropLateFrames;
+	bool m_enableFrameSizeCap;
+	float m_frameSizeCapIntervals;
 
 	// Controller configs
 	std::string m_controllerTrackingSystemName;
@@ -124,6 +130,10 @@ public:
 	bool m_enableViveTrackerProxy = false;
 
 	bool m_useHeadsetTrackingSystem = false;
+
+	// Set by the connection when the stream starts, after probing the path MTU.
+	uint32_t m_videoPacketSize = ALVR_DEFAULT_VIDEO_BUFFER_SIZE;
 	
 	bool m_enableFec;
+	int32_t m_fecCodec;
 };
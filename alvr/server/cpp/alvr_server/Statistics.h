@@ -36,6 +36,11 @@ public:
 		m_encodeLatencyMaxPrev = 0;
 
 		m_sendLatency = 0;
+
+		m_framesDroppedEncodeInSecond = 0;
+		m_framesDroppedEncodePrev = 0;
+		m_framesDroppedSendInSecond = 0;
+		m_framesDroppedSendPrev = 0;
 	}
 
 	void CountPacket(int bytes) {
@@ -58,6 +63,15 @@ public:
 		m_encodeSampleCount++;
 	}
 
+	// Frames dropped because they could not be displayed in time anymore, waiting for the encoder
+	// or for the network
+	void LateFramesDropped(uint32_t encodeQueue, uint32_t send) {
+		CheckAndResetSecond();
+
+		m_framesDroppedEncodeInSecond += encodeQueue;
+		m_framesDroppedSendInSecond += send;
+	}
+
 	void NetworkTotal(uint64_t latencyUs) {
 		if (latencyUs > 5e5)
 			latencyUs = 5e5;
@@ -105,6 +119,12 @@ public:
 	uint64_t GetSendLatencyAverage() {
 		return m_sendLatency;
 	}
+	uint32_t GetFramesDroppedEncodeInSecond() {
+		return m_framesDroppedEncodePrev;
+	}
+	uint32_t GetFramesDroppedSendInSecond() {
+		return m_framesDroppedSendPrev;
+	}
 
 	bool CheckBitrateUpdated() {
 		if (m_enableAdaptiveBitrate) {
@@ -171,6 +191,11 @@ private:
 		m_encodeLatencyMin = UINT64_MAX;
 		m_encodeLatencyMax = 0;
 
+		m_framesDroppedEncodePrev = m_framesDroppedEncodeInSecond;
+		m_framesDroppedEncodeInSecond = 0;
+		m_framesDroppedSendPrev = m_framesDroppedSendInSecond;
+		m_framesDroppedSendInSecond = 0;
+
 		if (m_adaptiveBitrateUseFrametime) {
 			if (m_framesPrevious > 0) {
 				m_adaptiveBitrateTarget = 1e6 / m_framesPrevious + m_adaptiveBitrateTargetOffset;
@@ -212,6 +237,11 @@ private:
 	
 	uint64_t m_sendLatency = 0;
 
+	uint32_t m_framesDroppedEncodeInSecond;
+	uint32_t m_framesDroppedEncodePrev;
+	uint32_t m_framesDroppedSendInSecond;
+	uint32_t m_framesDroppedSendPrev;
+
 	uint64_t m_bitrate = Settings::Instance().mEncodeBitrateMBs;
 	uint64_t m_bitrateUpdated = Settings::Instance().mEncodeBitrateMBs;
 
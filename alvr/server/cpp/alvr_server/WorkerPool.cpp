@@ -0,0 +1,106 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+// Leave most of the cores to the game, SteamVR and the encoder
+static const int MAX_THREAD_COUNT = 4;
+
+WorkerPool::WorkerPool(int threadCount) {
+	if (threadCount <= 0) {
+		threadCount = std::min(MAX_THREAD_COUNT, (int)std::thread::hardware_concurrency() / 4);
+	}
+	threadCount = std::max(threadCount, 1);
+
+	for (int i = 0; i < threadCount; i++) {
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+	for (int i = 0; i < threadCount; i++) {
+		m_threads.emplace_back(&WorkerPool::Run, this, (size_t)i);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_taskPushed.notify_all();
+
+	for (auto &thread : m_threads) {
+		thread.join();
+	}
+}
+
+int WorkerPool::GetThreadCount() {
+	return (int)m_threads.size();
+}
+
+void WorkerPool::Push(std::function<void()> task) {
+	auto &queue = *m_queues[m_nextQueue++ % m_queues.size()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	m_pending++;
+
+	// Taking the lock orders the wakeup after the check of a worker going to sleep
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_taskPushed.notify_one();
+}
+
+bool WorkerPool::TryPop(size_t first, std::function<void()> &task) {
+	// Thieves take the oldest task too, parity packets are sent in the order the tasks were pushed
+	for (size_t i = 0; i < m_queues.size(); i++) {
+		auto &queue = *m_queues[(first + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			m_pending--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void WorkerPool::NotifyTaskDone() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_taskDone.notify_all();
+}
+
+void WorkerPool::RunUntil(const std::function<bool()> &done) {
+	size_t first = 0;
+	std::function<void()> task;
+	while (!done()) {
+		if (TryPop(first++, task)) {
+			task();
+			NotifyTaskDone();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_taskDone.wait(lock, [&] { return done() || m_pending > 0; });
+	}
+}
+
+void WorkerPool::Run(size_t index) {
+	std::function<void()> task;
+	while (true) {
+		if (TryPop(index, task)) {
+			task();
+			NotifyTaskDone();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_taskPushed.wait(lock, [&] { return m_exit || m_pending > 0; });
+		if (m_exit) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small persistent work-stealing thread pool for short CPU bound jobs (FEC encoding).
+// Every worker has its own queue, tasks are pushed to them in turn and a worker that runs out of
+// tasks steals from the others, so a worker delayed by the encoder threads does not hold back the
+// tasks queued behind it. The thread that waits for the results also steals tasks, so a job always
+// makes progress even when all the workers are busy, and the pool can be kept small.
+class WorkerPool {
+public:
+	// threadCount = 0 picks a count based on the number of hardware threads
+	explicit WorkerPool(int threadCount = 0);
+	~WorkerPool();
+
+	int GetThreadCount();
+
+	void Push(std::function<void()> task);
+
+	// Execute queued tasks on the calling thread, or wait for the workers to finish some, until
+	// done() returns true. done() must be thread safe, it is called with and without the pool lock.
+	void RunUntil(const std::function<bool()> &done);
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void Run(size_t index);
+	// Take a task from queue `first`, or steal one from the next queues
+	bool TryPop(size_t first, std::function<void()> &task);
+	void NotifyTaskDone();
+
+	std::vector<std::thread> m_threads;
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::atomic_size_t m_nextQueue{0};
+	// queued tasks, not yet taken by any thread
+	std::atomic_int m_pending{0};
+
+	// for sleeping and waking up only, the queues have their own locks
+	std::mutex m_mutex;
+	std::condition_variable m_taskPushed;
+	std::condition_variable m_taskDone;
+	bool m_exit = false;
+};
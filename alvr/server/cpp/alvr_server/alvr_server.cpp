@@ -5,6 +5,7 @@
 #include "platform/macos/CEncoder.h"
 #else
 #include "platform/linux/CEncoder.h"
+#include "platform/linux/EncoderTuner.h"
 #endif
 #include "ClientConnection.h"
 #include "Logger.h"
@@ -32,6 +33,7 @@
 	#include "platform/macos/CEncoder.h"
 #else
 	#include "platform/linux/CEncoder.h"
+	#include "platform/linux/Compositor.h"
 #endif
 
 >>>>>>> libalvr
@@ -162,6 +164,8 @@ class DriverProvider : public vr::IServerTrackedDeviceProvider {
 std::shared_ptr<PoseHistory> g_poseHistory;
 #ifdef _WIN32
 std::shared_ptr<CD3DRender> g_d3dRenderer;
+#endif
+#ifndef __APPLE__
 std::shared_ptr<Compositor> g_compositor;
 #endif
 std::shared_ptr<ClientConnection> g_listener;
@@ -189,6 +193,7 @@ void (*LogInfo)(const char *stringPtr);
 void (*LogDebug)(const char *stringPtr);
 void (*DriverReadyIdle)(bool setDefaultChaprone);
 void (*VideoSend)(VideoFrame header, unsigned char *buf, int len);
+void (*VideoFlush)();
 void (*HapticsSend)(unsigned long long path, float duration_s, float frequency, float amplitude);
 void (*TimeSyncSend)(TimeSync packet);
 void (*ShutdownRuntime)();
@@ -267,6 +272,24 @@ void DeinitializeStreaming() {
     // nothing to do
 }
 
+void SetVideoPacketSize(unsigned int size) {
+    Settings::Instance().m_videoPacketSize = size;
+}
+
+bool TuneEncoders() {
+#if !defined(_WIN32) && !defined(__APPLE__)
+    try {
+        return alvr::tune_encoders();
+    } catch (std::exception &e) {
+        Error("Encoder tuning failed: %s\n", e.what());
+        return false;
+    }
+#else
+    Warn("Encoder tuning is only available on Linux\n");
+    return false;
+#endif
+}
+
 void RequestIDR() {
 <<<<<<< HEAD
     if (g_driver_provider.hmd && g_driver_provider.hmd->m_encoder) {
@@ -395,6 +418,8 @@ void CppInit() {
 		Error("Could not create graphics device for adapter %d.\n", Settings::Instance().m_nAdapterIndex);
 	}
 	g_compositor = std::make_shared<Compositor>(g_d3dRenderer, g_poseHistory);
+#elif !defined(__APPLE__)
+	g_compositor = std::make_shared<Compositor>(g_poseHistory);
 #endif
 }
 
@@ -403,15 +428,16 @@ unsigned long long CreateTexture(unsigned int width,
 								unsigned int format,
 								unsigned int sampleCount,
 								void *texture){
-#ifdef _WIN32
+#ifndef __APPLE__
 	if (g_compositor) {
 		return g_compositor->CreateTexture(width, height, format, sampleCount, texture);
 	}
 #endif
+	return 0;
 }
 
 void DestroyTexture(unsigned long long id) {
-#ifdef _WIN32
+#ifndef __APPLE__
 	if (g_compositor) {
 		g_compositor->DestroyTexture(id);
 	}
@@ -423,6 +449,11 @@ void PresentLayers(void *syncTexture, const Layer *layers, unsigned long long la
 	if (g_compositor) {
 		g_compositor->PresentLayers(syncTexture, layers, layer_count);
 	}
+#elif !defined(__APPLE__)
+	// syncTexture is not used on linux, the client texture memory is shared directly
+	if (g_compositor) {
+		g_compositor->PresentLayers(layers, layer_count);
+	}
 #endif
 >>>>>>> libalvr
 }
\ No newline at end of file
@@ -178,6 +178,8 @@ extern "C" void (*LogInfo)(const char *stringPtr);
 extern "C" void (*LogDebug)(const char *stringPtr);
 extern "C" void (*DriverReadyIdle)(bool setDefaultChaprone);
 extern "C" void (*VideoSend)(VideoFrame header, unsigned char *buf, int len);
+// End of the packets of a frame
+extern "C" void (*VideoFlush)();
 extern "C" void (*HapticsSend)(unsigned long long path,
                                float duration_s,
                                float frequency,
@@ -190,6 +192,9 @@ extern "C" void *CppEntryPoint(const char *pInterfaceName, int *pReturnCode);
 extern "C" void InitializeStreaming();
 extern "C" void DeinitializeStreaming();
 extern "C" void RequestIDR();
+extern "C" void SetVideoPacketSize(unsigned int size);
+// Benchmarks the encoders and saves the best options for this machine. Blocks for minutes.
+extern "C" bool TuneEncoders();
 extern "C" void SetChaperone(const float transform[12],
                              float areaWidth,
                              float areaHeight,
@@ -197,6 +202,12 @@ extern "C" void SetChaperone(const float transform[12],
                              unsigned int perimeterPointsCount);
 extern "C" void SetDefaultChaperone();
 extern "C" void InputReceive(TrackingInfo data);
+// Head pose of an input that was lost, repeated in a later one. Older than the last InputReceive.
+extern "C" void RedundantPoseReceive(unsigned long long frameIndex,
+                                     unsigned long long clientTime,
+                                     double predictedDisplayTime,
+                                     TrackingQuat orientation,
+                                     TrackingVector3 position);
 extern "C" void TimeSyncReceive(TimeSync data);
 extern "C" void VideoErrorReportReceive();
 extern "C" void ShutdownSteamvr();
@@ -2,6 +2,8 @@
 
 #include <cmath>
 
+#include "pose_math.h"
+
 
 inline vr::HmdQuaternion_t operator+(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
 	return {
@@ -24,12 +26,7 @@ inline vr::HmdQuaternion_t operator-(const vr::HmdQuaternion_t& lhs, const vr::H
 
 
 inline vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
-	return {
-		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
-		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
-		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
-		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
-	};
+	return posemath::multiply<vr::HmdQuaternion_t>(lhs, rhs);
 }
 
 
@@ -172,73 +169,32 @@ namespace vrmath {
 	}
 
 	inline vr::HmdQuaternion_t quaternionConjugate(const vr::HmdQuaternion_t& quat) {
-		return {
-			quat.w,
-			-quat.x,
-			-quat.y,
-			-quat.z,
-		};
+		return posemath::conjugate(quat);
 	}
 
-	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t& vector, bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return {pout.x, pout.y, pout.z};
-		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return { pout.x, pout.y, pout.z };
-		}
+	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const double (&vector)[3], bool reverse = false) {
+		posemath::Vec3<double> v = { vector[0], vector[1], vector[2] };
+		auto r = reverse ? posemath::rotateVectorInverse(quat, v) : posemath::rotateVector(quat, v);
+		return { r.x, r.y, r.z };
 	}
 
-	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const vr::HmdVector3d_t& vector, bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
-		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
-		}
+	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t& vector, bool reverse = false) {
+		return quaternionRotateVector(quat, vector.v, reverse);
 	}
 
-	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const double (&vector)[3], bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return{ pout.x, pout.y, pout.z };
-		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return{ pout.x, pout.y, pout.z };
-		}
+	// quatInv is the inverse of quat
+	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const double(&vector)[3], bool reverse = false) {
+		posemath::Vec3<double> v = { vector[0], vector[1], vector[2] };
+		auto r = posemath::rotateVector(reverse ? quatInv : quat, v);
+		return { r.x, r.y, r.z };
 	}
 
-	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const double(&vector)[3], bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
-		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
-		}
+	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const vr::HmdVector3d_t& vector, bool reverse = false) {
+		return quaternionRotateVector(quat, quatInv, vector.v, reverse);
 	}
 
 	inline vr::HmdMatrix34_t matMul33(const vr::HmdMatrix34_t& a, const vr::HmdMatrix34_t& b) {
-		vr::HmdMatrix34_t result;
-		for (unsigned i = 0; i < 3; i++) {
-			for (unsigned j = 0; j < 3; j++) {
-				result.m[i][j] = 0.0f;
-				for (unsigned k = 0; k < 3; k++) {
-					result.m[i][j] += a.m[i][k] * b.m[k][j];
-				}
-			}
-		}
-		return result;
+		return posemath::matMul33(a, b);
 	}
 
 	inline vr::HmdVector3_t matMul33(const vr::HmdMatrix34_t& a, const vr::HmdVector3_t& b) {
@@ -286,16 +242,7 @@ namespace vrmath {
 	}
 
 	inline vr::HmdMatrix34_t transposeMul33(const vr::HmdMatrix34_t& a) {
-		vr::HmdMatrix34_t result;
-		for (unsigned i = 0; i < 3; i++) {
-			for (unsigned k = 0; k < 3; k++) {
-				result.m[i][k] = a.m[k][i];
-			}
-		}
-		result.m[0][3] = a.m[0][3];
-		result.m[1][3] = a.m[1][3];
-		result.m[2][3] = a.m[2][3];
-		return result;
+		return posemath::transposeMul33(a);
 	}
 }
 
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// POSEMATH_NO_SIMD selects the scalar code, to test it on any host
+#if defined(POSEMATH_NO_SIMD)
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define POSEMATH_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define POSEMATH_NEON
+#endif
+
+// Pose math of the tracking, reprojection and skeleton paths.
+// Quaternions are any struct with w, x, y, z members (vr::HmdQuaternion_t, vr::HmdQuaternionf_t,
+// TrackingQuat) and matrices any struct with a float m[3][4] (vr::HmdMatrix34_t), so that the
+// driver and the vulkan layer use the same functions without converting their types. The matrix
+// rows and the bone positions are 4 floats, they are processed with SSE or NEON when available.
+namespace posemath {
+
+	template<typename T> struct Vec3 {
+		T x, y, z;
+	};
+
+	template<typename R, typename T> constexpr R quaternion(T w, T x, T y, T z) {
+		R q{};
+		q.w = w;
+		q.x = x;
+		q.y = y;
+		q.z = z;
+		return q;
+	}
+
+	// a * b, as the type R
+	template<typename R, typename A, typename B> constexpr R multiply(const A& a, const B& b) {
+		R q{};
+		q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+		q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+		q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+		q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+		return q;
+	}
+
+	template<typename Q> constexpr Q conjugate(const Q& q) {
+		Q r = q;
+		r.x = -q.x;
+		r.y = -q.y;
+		r.z = -q.z;
+		return r;
+	}
+
+	template<typename A, typename B> constexpr auto dot(const A& a, const B& b) {
+		return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	template<typename Q> constexpr Q inverse(const Q& q) {
+		auto n = dot(q, q);
+		Q r = q;
+		r.w = q.w / n;
+		r.x = -q.x / n;
+		r.y = -q.y / n;
+		r.z = -q.z / n;
+		return r;
+	}
+
+	template<typename Q> inline Q normalize(const Q& q) {
+		auto n = std::sqrt(dot(q, q));
+		Q r = q;
+		r.w = q.w / n;
+		r.x = q.x / n;
+		r.y = q.y / n;
+		r.z = q.z / n;
+		return r;
+	}
+
+	// q * v * conjugate(q), for a unit quaternion
+	template<typename Q, typename T> constexpr Vec3<T> rotateVector(const Q& q, const Vec3<T>& v) {
+		// t = 2 * cross(q.xyz, v), v' = v + q.w * t + cross(q.xyz, t)
+		T tx = T(2 * (q.y * v.z - q.z * v.y));
+		T ty = T(2 * (q.z * v.x - q.x * v.z));
+		T tz = T(2 * (q.x * v.y - q.y * v.x));
+		return {
+			T(v.x + q.w * tx + q.y * tz - q.z * ty),
+			T(v.y + q.w * ty + q.z * tx - q.x * tz),
+			T(v.z + q.w * tz + q.x * ty - q.y * tx),
+		};
+	}
+
+	// conjugate(q) * v * q, for a unit quaternion
+	template<typename Q, typename T> constexpr Vec3<T> rotateVectorInverse(const Q& q, const Vec3<T>& v) {
+		return rotateVector(conjugate(q), v);
+	}
+
+	// Rotation part of m from q, with no translation. q is not normalized.
+	template<typename Q, typename M> constexpr void quatToMat33(const Q& q, M& m) {
+		double w = q.w, x = q.x, y = q.y, z = q.z;
+		m.m[0][0] = float(1 - 2 * y * y - 2 * z * z);
+		m.m[0][1] = float(2 * x * y - 2 * z * w);
+		m.m[0][2] = float(2 * x * z + 2 * y * w);
+		m.m[0][3] = 0;
+		m.m[1][0] = float(2 * x * y + 2 * z * w);
+		m.m[1][1] = float(1 - 2 * x * x - 2 * z * z);
+		m.m[1][2] = float(2 * y * z - 2 * x * w);
+		m.m[1][3] = 0;
+		m.m[2][0] = float(2 * x * z - 2 * y * w);
+		m.m[2][1] = float(2 * y * z + 2 * x * w);
+		m.m[2][2] = float(1 - 2 * x * x - 2 * y * y);
+		m.m[2][3] = 0;
+	}
+
+	// Product of the 3x3 parts, the translation of the result is 0
+	template<typename M> inline M matMul33(const M& a, const M& b) {
+		M result;
+#if defined(POSEMATH_SSE)
+		__m128 b0 = _mm_loadu_ps(b.m[0]);
+		__m128 b1 = _mm_loadu_ps(b.m[1]);
+		__m128 b2 = _mm_loadu_ps(b.m[2]);
+		for (unsigned i = 0; i < 3; i++) {
+			__m128 row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.m[i][0]), b0),
+			                                   _mm_mul_ps(_mm_set1_ps(a.m[i][1]), b1)),
+			                        _mm_mul_ps(_mm_set1_ps(a.m[i][2]), b2));
+			_mm_storeu_ps(result.m[i], row);
+			result.m[i][3] = 0;
+		}
+#elif defined(POSEMATH_NEON)
+		float32x4_t b0 = vld1q_f32(b.m[0]);
+		float32x4_t b1 = vld1q_f32(b.m[1]);
+		float32x4_t b2 = vld1q_f32(b.m[2]);
+		for (unsigned i = 0; i < 3; i++) {
+			float32x4_t row = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(b0, a.m[i][0]), b1, a.m[i][1]), b2, a.m[i][2]);
+			vst1q_f32(result.m[i], row);
+			result.m[i][3] = 0;
+		}
+#else
+		for (unsigned i = 0; i < 3; i++) {
+			for (unsigned j = 0; j < 3; j++) {
+				result.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+			}
+			result.m[i][3] = 0;
+		}
+#endif
+		return result;
+	}
+
+	// Transpose of the 3x3 part, the translation is kept
+	template<typename M> constexpr M transposeMul33(const M& a) {
+		M result{};
+		for (unsigned i = 0; i < 3; i++) {
+			for (unsigned k = 0; k < 3; k++) {
+				result.m[i][k] = a.m[k][i];
+			}
+			result.m[i][3] = a.m[i][3];
+		}
+		return result;
+	}
+
+	// Sum of the squared differences of the 3x3 parts
+	template<typename M> inline float distance33(const M& a, const M& b) {
+#if defined(POSEMATH_SSE)
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned i = 0; i < 3; i++) {
+			__m128 d = _mm_sub_ps(_mm_loadu_ps(a.m[i]), _mm_loadu_ps(b.m[i]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, sum);
+		return lanes[0] + lanes[1] + lanes[2];
+#elif defined(POSEMATH_NEON)
+		float32x4_t sum = vdupq_n_f32(0);
+		for (unsigned i = 0; i < 3; i++) {
+			float32x4_t d = vsubq_f32(vld1q_f32(a.m[i]), vld1q_f32(b.m[i]));
+			sum = vmlaq_f32(sum, d, d);
+		}
+		return vaddvq_f32(vsetq_lane_f32(0, sum, 3));
+#else
+		float sum = 0;
+		for (unsigned i = 0; i < 3; i++) {
+			for (unsigned j = 0; j < 3; j++) {
+				float d = a.m[i][j] - b.m[i][j];
+				sum += d * d;
+			}
+		}
+		return sum;
+#endif
+	}
+
+	// Structure of arrays of the 3x3 parts of up to N matrices: m[i][j][k] is m[i][j] of the matrix
+	// k. Searches over many matrices process 4 of them per SSE or NEON instruction.
+	template<size_t N> struct Mat33Batch {
+		static_assert(N % 4 == 0, "matrices are processed 4 at a time");
+
+		alignas(16) float m[3][3][N] = {};
+		size_t count = 0;
+
+		// Insert the 3x3 part of matrix at index, the next matrices are moved up by one
+		template<typename M> void insert(size_t index, const M& matrix) {
+			for (unsigned i = 0; i < 3; i++) {
+				for (unsigned j = 0; j < 3; j++) {
+					std::copy_backward(m[i][j] + index, m[i][j] + count, m[i][j] + count + 1);
+					m[i][j][index] = matrix.m[i][j];
+				}
+			}
+			count++;
+		}
+
+		void erase(size_t index) {
+			for (unsigned i = 0; i < 3; i++) {
+				for (unsigned j = 0; j < 3; j++) {
+					std::copy(m[i][j] + index + 1, m[i][j] + count, m[i][j] + index);
+					m[i][j][count - 1] = 0;
+				}
+			}
+			count--;
+		}
+	};
+
+	// Index of the first matrix of the batch with the smallest distance33() to m. The batch must not
+	// be empty.
+	template<size_t N, typename M> inline size_t nearest33(const Mat33Batch<N>& batch, const M& m) {
+#if defined(POSEMATH_SSE) || defined(POSEMATH_NEON)
+		// Each lane keeps the nearest of the matrices k + lane, the lanes are compared at the end
+		float distances[4];
+		uint32_t indices[4];
+#if defined(POSEMATH_SSE)
+		__m128 pose[3][3];
+		for (unsigned i = 0; i < 3; i++) {
+			for (unsigned j = 0; j < 3; j++) {
+				pose[i][j] = _mm_set1_ps(m.m[i][j]);
+			}
+		}
+		__m128 best = _mm_set1_ps(INFINITY);
+		__m128i bestIndex = _mm_setzero_si128();
+		__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128i count = _mm_set1_epi32(int(batch.count));
+		for (size_t k = 0; k < batch.count; k += 4) {
+			__m128 sum = _mm_setzero_ps();
+			for (unsigned i = 0; i < 3; i++) {
+				for (unsigned j = 0; j < 3; j++) {
+					__m128 d = _mm_sub_ps(_mm_load_ps(batch.m[i][j] + k), pose[i][j]);
+					sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+				}
+			}
+			// the lanes past the count are never selected
+			__m128 less = _mm_and_ps(_mm_castsi128_ps(_mm_cmplt_epi32(index, count)), _mm_cmplt_ps(sum, best));
+			best = _mm_or_ps(_mm_and_ps(less, sum), _mm_andnot_ps(less, best));
+			bestIndex = _mm_or_si128(_mm_and_si128(_mm_castps_si128(less), index),
+			                         _mm_andnot_si128(_mm_castps_si128(less), bestIndex));
+			index = _mm_add_epi32(index, _mm_set1_epi32(4));
+		}
+		_mm_storeu_ps(distances, best);
+		_mm_storeu_si128((__m128i*)indices, bestIndex);
+#else
+		float32x4_t pose[3][3];
+		for (unsigned i = 0; i < 3; i++) {
+			for (unsigned j = 0; j < 3; j++) {
+				pose[i][j] = vdupq_n_f32(m.m[i][j]);
+			}
+		}
+		const uint32_t lanes[4] = {0, 1, 2, 3};
+		float32x4_t best = vdupq_n_f32(INFINITY);
+		uint32x4_t bestIndex = vdupq_n_u32(0);
+		uint32x4_t index = vld1q_u32(lanes);
+		const uint32x4_t count = vdupq_n_u32(uint32_t(batch.count));
+		for (size_t k = 0; k < batch.count; k += 4) {
+			float32x4_t sum = vdupq_n_f32(0);
+			for (unsigned i = 0; i < 3; i++) {
+				for (unsigned j = 0; j < 3; j++) {
+					float32x4_t d = vsubq_f32(vld1q_f32(batch.m[i][j] + k), pose[i][j]);
+					sum = vmlaq_f32(sum, d, d);
+				}
+			}
+			// the lanes past the count are never selected
+			uint32x4_t less = vandq_u32(vcltq_u32(index, count), vcltq_f32(sum, best));
+			best = vbslq_f32(less, sum, best);
+			bestIndex = vbslq_u32(less, index, bestIndex);
+			index = vaddq_u32(index, vdupq_n_u32(4));
+		}
+		vst1q_f32(distances, best);
+		vst1q_u32(indices, bestIndex);
+#endif
+		size_t nearest = indices[0];
+		float minDistance = distances[0];
+		for (unsigned l = 1; l < 4; l++) {
+			if (distances[l] < minDistance || (distances[l] == minDistance && indices[l] < nearest)) {
+				minDistance = distances[l];
+				nearest = indices[l];
+			}
+		}
+		return nearest;
+#else
+		size_t nearest = 0;
+		float minDistance = INFINITY;
+		for (size_t k = 0; k < batch.count; k++) {
+			float distance = 0;
+			for (unsigned i = 0; i < 3; i++) {
+				for (unsigned j = 0; j < 3; j++) {
+					float d = batch.m[i][j][k] - m.m[i][j];
+					distance += d * d;
+				}
+			}
+			if (distance < minDistance) {
+				minDistance = distance;
+				nearest = k;
+			}
+		}
+		return nearest;
+#endif
+	}
+
+	// Spherical interpolation from a (t = 0) to b (t = 1), normalized
+	template<typename Q> inline Q slerp(const Q& a, const Q& b, double t) {
+		double theta = std::acos(std::clamp(double(dot(a, b)), -1., 1.));
+		double st = std::sin(theta);
+		double wa = 1 - t, wb = t;
+		// the same rotation, or close to it: linear interpolation is exact enough
+		if (st > 1e-6) {
+			wa = std::sin((1 - t) * theta) / st;
+			wb = std::sin(t * theta) / st;
+		}
+		Q r = a;
+		r.w = decltype(a.w)(wa * a.w + wb * b.w);
+		r.x = decltype(a.x)(wa * a.x + wb * b.x);
+		r.y = decltype(a.y)(wa * a.y + wb * b.y);
+		r.z = decltype(a.z)(wa * a.z + wb * b.z);
+		return normalize(r);
+	}
+
+	// out[i] = a[i] interpolated toward b[i] by t, for bone transforms with a float position.v[4]
+	// (w = 1) and an orientation, as vr::VRBoneTransform_t. out can be a.
+	template<typename B> inline void blendBones(const B* a, const B* b, B* out, size_t count, float t) {
+		for (size_t i = 0; i < count; i++) {
+#if defined(POSEMATH_SSE)
+			__m128 pa = _mm_loadu_ps(a[i].position.v);
+			__m128 pb = _mm_loadu_ps(b[i].position.v);
+			_mm_storeu_ps(out[i].position.v, _mm_add_ps(pa, _mm_mul_ps(_mm_set1_ps(t), _mm_sub_ps(pb, pa))));
+#elif defined(POSEMATH_NEON)
+			float32x4_t pa = vld1q_f32(a[i].position.v);
+			float32x4_t pb = vld1q_f32(b[i].position.v);
+			vst1q_f32(out[i].position.v, vmlaq_n_f32(pa, vsubq_f32(pb, pa), t));
+#else
+			for (unsigned k = 0; k < 3; k++) {
+				out[i].position.v[k] = a[i].position.v[k] + t * (b[i].position.v[k] - a[i].position.v[k]);
+			}
+#endif
+			out[i].position.v[3] = 1;
+			out[i].orientation = slerp(a[i].orientation, b[i].orientation, t);
+		}
+	}
+}
@@ -1,8 +1,11 @@
 #include "CEncoder.h"
 
+#include <algorithm>
 #include <chrono>
 #include <exception>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <stdlib.h>
@@ -10,7 +13,9 @@
 #include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 #include <iostream>
 
 #include "ALVR-common/packet_types.h"
@@ -24,6 +29,7 @@
 #include "protocol.h"
 #include "ffmpeg_helper.h"
 #include "EncodePipeline.h"
+#include "FrameProcessor.h"
 
 extern "C" {
 #include <libavutil/avutil.h>
@@ -77,6 +83,37 @@ void read_latest(int fd, char *out, size_t size, std::atomic_bool &exiting) {
     }
 }
 
+// Same as read_latest, but gives up if nothing is received before the deadline
+bool read_latest_until(int fd,
+                       char *out,
+                       size_t size,
+                       std::atomic_bool &exiting,
+                       std::chrono::steady_clock::time_point deadline) {
+    while (not exiting) {
+        // a frame that is already there is taken even if the deadline has passed
+        auto now = std::chrono::steady_clock::now();
+        auto wait_us = now >= deadline ? 0 : std::min<int64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count(), 15000);
+        timeval timeout{.tv_sec = 0, .tv_usec = wait_us};
+        fd_set read_fd, write_fd, except_fd;
+        FD_ZERO(&read_fd);
+        FD_SET(fd, &read_fd);
+        FD_ZERO(&write_fd);
+        FD_ZERO(&except_fd);
+        // TODO move away from select as it can only take fd < 1024
+        int count = select(fd + 1, &read_fd, &write_fd, &except_fd, &timeout);
+        if (count < 0) {
+            throw MakeException("select failed: %s", strerror(errno));
+        } else if (count == 1) {
+            read_latest(fd, out, size, exiting);
+            return not exiting;
+        } else if (now >= deadline) {
+            return false;
+        }
+    }
+    return false;
+}
+
 int accept_timeout(int socket, std::atomic_bool &exiting) {
     while (not exiting) {
         timeval timeout{.tv_sec = 0, .tv_usec = 15000};
@@ -96,6 +133,69 @@ int accept_timeout(int socket, std::atomic_bool &exiting) {
     return -1;
 }
 
+// Model of the network sending the encoded frames at the current bitrate. It gives the time each
+// frame takes to be fully sent, including the wait behind the previous ones, and the distribution
+// of these times is logged every second. With the frame size cap, frames are skipped while more
+// than a frame interval of data is still queued, which only happens after a frame overshot its
+// budget (an IDR for example): encoding them would only make them wait.
+// Frames are submitted and sent from different threads.
+class LinkModel {
+  public:
+    explicit LinkModel(std::chrono::nanoseconds frame_time) : m_frame_time(frame_time) {}
+
+    bool IsBusy(uint64_t bitrate_mbs) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Drain(bitrate_mbs);
+        if (m_queued_bytes > bytes_per_second(bitrate_mbs) * std::chrono::duration<double>(m_frame_time).count()) {
+            m_skipped++;
+            return true;
+        }
+        return false;
+    }
+
+    void OnFrameSent(size_t size, uint64_t bitrate_mbs) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Drain(bitrate_mbs);
+        m_queued_bytes += size;
+        m_transmit_times_ms.push_back(m_queued_bytes / bytes_per_second(bitrate_mbs) * 1000.);
+
+        if (m_last_update - m_last_report >= std::chrono::seconds(1)) {
+            Report();
+            m_last_report = m_last_update;
+        }
+    }
+
+  private:
+    static double bytes_per_second(uint64_t bitrate_mbs) { return std::max<uint64_t>(bitrate_mbs, 1) * 1'000'000. / 8.; }
+
+    void Drain(uint64_t bitrate_mbs) {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - m_last_update).count();
+        m_queued_bytes = std::max(0., m_queued_bytes - elapsed * bytes_per_second(bitrate_mbs));
+        m_last_update = now;
+    }
+
+    void Report() {
+        auto &times = m_transmit_times_ms;
+        if (times.empty())
+            return;
+        std::sort(times.begin(), times.end());
+        auto percentile = [&](size_t p) { return times[(times.size() - 1) * p / 100]; };
+        Debug("Frame transmit time: p50 %.2fms p90 %.2fms p99 %.2fms max %.2fms, %zu frames, %u skipped\n",
+              percentile(50), percentile(90), percentile(99), times.back(), times.size(), m_skipped);
+        times.clear();
+        m_skipped = 0;
+    }
+
+    const std::chrono::nanoseconds m_frame_time;
+    std::mutex m_mutex;
+    double m_queued_bytes = 0;
+    std::chrono::steady_clock::time_point m_last_update = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point m_last_report = m_last_update;
+    std::vector<double> m_transmit_times_ms;
+    uint32_t m_skipped = 0;
+};
+
 #ifdef DEBUG
 void logfn(void*, int level, const char* data, va_list va)
 {
@@ -211,27 +311,173 @@ void CEncoder::Run() {
       alvr::VkContext vk_ctx(init.device_name.data(), d);
       alvr::VkFrameCtx vk_frame_ctx(vk_ctx, init.image_create_info);
 
+      // Must be created before the encoder imports the fds
+      auto &settings = Settings::Instance();
+      std::unique_ptr<FrameProcessor> processor;
+      if (settings.m_serverReprojection or settings.m_enableColorCorrection) {
+        try {
+          processor = std::make_unique<FrameProcessor>(init, m_fds);
+        } catch (std::exception &e) {
+          Warn("Frame processing disabled: %s\n", e.what());
+        }
+      }
+      const bool process_frames = processor and processor->HasColorCorrection();
+      const bool reproject = processor and settings.m_serverReprojection;
+
       std::vector<alvr::VkFrame> images;
-        images.reserve(3);
+      images.reserve(FrameProcessor::OUTPUT_IMAGES);
+      if (process_frames) {
+        // The encoder reads the processed copies, the shared images are only read by the processor
+        for (uint32_t i = 0; i < FrameProcessor::INPUT_IMAGES; ++i) {
+          images.emplace_back(vk_ctx,
+                              processor->GetOutputCreateInfo(),
+                              processor->GetOutputMemoryIndex(),
+                              processor->ExportOutputMemory(i),
+                              processor->ExportOutputSemaphore(i));
+        }
+        for (int &fd : m_fds) {
+          close(fd);
+          fd = -1;
+        }
+      } else {
         for (size_t i = 0; i < 3; ++i) {
             images.emplace_back(vk_ctx, init.image_create_info, init.mem_index, m_fds[2*i], m_fds[2*i+1]);
         }
+      }
+      // The reprojected frames are encoded from an extra image, after the other ones
+      const uint32_t reprojection_image = images.size();
+      if (reproject) {
+        images.emplace_back(vk_ctx,
+                            processor->GetOutputCreateInfo(),
+                            processor->GetOutputMemoryIndex(),
+                            processor->ExportOutputMemory(FrameProcessor::REPROJECTION_OUTPUT),
+                            processor->ExportOutputSemaphore(FrameProcessor::REPROJECTION_OUTPUT));
+      }
+      // Only the encoder changes the layout of the shared images, when it reads them directly
+      auto input_layout = [&](uint32_t image) {
+        return process_frames ? vk::ImageLayout::eGeneral
+                              : (vk::ImageLayout)((AVVkFrame *)images[image])->layout[0];
+      };
 
-      auto encode_pipeline = alvr::EncodePipeline::Create(images, vk_frame_ctx);
+      auto encode_pipeline = alvr::EncodePipeline::Create(images, vk_frame_ctx, settings.m_encoderInFlightFrames);
 
       fprintf(stderr, "CEncoder starting to read present packets");
       present_packet frame_info;
-      std::vector<uint8_t> encoded_data;
-      double avg_real_encode_time_ms = 0;
+      const auto frame_time = std::chrono::nanoseconds(1'000'000'000 / Settings::Instance().m_refreshRate);
+      // A frame missing by this time is replaced by a reprojection of the last one
+      auto reprojection_deadline = std::chrono::steady_clock::time_point::max();
+      std::optional<PoseHistory::TrackingHistoryFrame> frame_pose;
+      const bool frame_size_cap = Settings::Instance().m_enableFrameSizeCap;
+      LinkModel link(frame_time);
+      // A frame is due at the vsync following the one it was presented for. Once one more frame
+      // interval has passed, the next frame is due too and this one would only delay it.
+      const auto deadline_after_vsync = 2 * frame_time;
+
+      // Encoded frames are sent as soon as they come out of the encoder, tagged with the pose
+      // they were rendered (or reprojected) with
+      std::atomic_bool sending{true};
+      std::thread sender([&] {
+        alvr::EncodePipeline::EncodedFrame encoded;
+        std::chrono::steady_clock::duration convert{}, queue{}, encode{};
+        uint32_t frames = 0;
+        auto last_report = std::chrono::steady_clock::now();
+        // The encoder cannot be told that a frame was not sent, the next ones reference it. After
+        // a late frame is dropped, the frames are dropped until a keyframe comes out, which is
+        // why it happens at most once per resync interval.
+        const auto min_resync_interval = std::chrono::seconds(1);
+        bool resyncing = false;
+        auto last_resync = std::chrono::steady_clock::now() - min_resync_interval;
+        while (sending) {
+          if (not encode_pipeline->GetEncoded(encoded, std::chrono::milliseconds(100)))
+            continue;
+
+          bool drop = false;
+          if (encoded.idr) {
+            resyncing = false;
+          } else if (resyncing) {
+            drop = true;
+          } else if (settings.m_dropLateFrames) {
+            auto now = std::chrono::steady_clock::now();
+            if (now > encoded.deadline and now - last_resync >= min_resync_interval) {
+              Debug("Dropped frame %llu, %.2fms late\n", encoded.tag,
+                    std::chrono::duration<double, std::milli>(now - encoded.deadline).count());
+              m_scheduler.InsertIDR();
+              resyncing = true;
+              last_resync = now;
+              drop = true;
+            }
+          }
+          m_listener->GetStatistics()->LateFramesDropped(encoded.dropped, drop ? 1 : 0);
+          if (drop)
+            continue;
+
+          m_listener->SendVideo(encoded.data.data(), encoded.data.size(), encoded.tag + Settings::Instance().m_trackingFrameOffset);
+          link.OnFrameSent(encoded.data.size(), m_listener->GetStatistics()->GetBitrate());
+
+          auto total = encoded.convert_time + encoded.queue_time + encoded.encode_time;
+          m_listener->GetStatistics()->EncodeOutput(std::chrono::duration_cast<std::chrono::microseconds>(total).count());
+
+          convert += encoded.convert_time;
+          queue += encoded.queue_time;
+          encode += encoded.encode_time;
+          frames++;
+          auto now = std::chrono::steady_clock::now();
+          if (now - last_report >= std::chrono::seconds(1)) {
+            auto avg_ms = [&](std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count() / frames; };
+            Debug("Encode time: convert %.2fms queue %.2fms encode %.2fms, %u frames\n",
+                  avg_ms(convert), avg_ms(queue), avg_ms(encode), frames);
+            convert = queue = encode = {};
+            frames = 0;
+            last_report = now;
+          }
+        }
+      });
+      // joined on every way out, before the pipeline it reads from is destroyed
+      struct SenderJoin {
+        std::atomic_bool &sending;
+        std::thread &sender;
+        ~SenderJoin() {
+          sending = false;
+          sender.join();
+        }
+      } sender_join{sending, sender};
+
       while (not m_exiting) {
-        read_latest(client, (char *)&frame_info, sizeof(frame_info), m_exiting);
+        if (not read_latest_until(client, (char *)&frame_info, sizeof(frame_info), m_exiting, reprojection_deadline)) {
+          if (m_exiting)
+            break;
+
+          reprojection_deadline += frame_time;
+          auto latest_pose = m_poseHistory->GetLatest();
+          if (not latest_pose)
+            continue;
+          if (frame_size_cap and link.IsBusy(m_listener->GetStatistics()->GetBitrate()))
+            continue;
+
+          auto to_quat = [](const TrackingQuat &q) { return vr::HmdQuaternion_t{q.w, q.x, q.y, q.z}; };
+          processor->Reproject(frame_info.image,
+                               input_layout(frame_info.image),
+                               to_quat(frame_pose->info.HeadPose_Pose_Orientation),
+                               to_quat(latest_pose->info.HeadPose_Pose_Orientation));
+          ((AVVkFrame *)images[reprojection_image])->layout[0] = VK_IMAGE_LAYOUT_GENERAL;
+
+          // never an IDR, so that the reprojected frame is a cheap P-frame. The client must
+          // display it with the pose it was reprojected to. It stands for the vsync that was
+          // just missed.
+          encode_pipeline->Submit(reprojection_image, false, latest_pose->info.FrameIndex,
+                                  std::chrono::steady_clock::now() + deadline_after_vsync - frame_time / 2);
+
+          Debug("Reprojected frame %llu to pose %llu\n", frame_pose->info.FrameIndex, latest_pose->info.FrameIndex);
+          continue;
+        }
 
         if (m_listener->GetStatistics()->CheckBitrateUpdated()) {
           encode_pipeline->SetBitrate(m_listener->GetStatistics()->GetBitrate() * 1000000L); // in bits;
         }
 
-        auto encode_start = std::chrono::steady_clock::now();
-        encode_pipeline->PushFrame(frame_info.image, m_scheduler.CheckIDRInsertion());
+        auto frame_start = std::chrono::steady_clock::now();
+        // A skipped frame still goes through the pose matching below, it may be reprojected
+        const bool skip = frame_size_cap and link.IsBusy(m_listener->GetStatistics()->GetBitrate());
 
         static_assert(sizeof(frame_info.pose) == sizeof(vr::HmdMatrix34_t&));
 
@@ -248,18 +494,26 @@ void CEncoder::Run() {
           m_poseSubmitIndex = pose->info.FrameIndex;
         }
 
-        encoded_data.clear();
-        // Encoders can req more then once frame, need to accumulate more data before sending it to the client
-        if (!encode_pipeline->GetEncoded(encoded_data)) {
-          continue;
-        }
-
-        m_listener->SendVideo(encoded_data.data(), encoded_data.size(), m_poseSubmitIndex + Settings::Instance().m_trackingFrameOffset);
+        auto vsync = frame_info.vsync_ns != 0
+                         ? std::chrono::steady_clock::time_point(std::chrono::nanoseconds(frame_info.vsync_ns))
+                         : frame_start;
 
-        auto encode_end = std::chrono::steady_clock::now();
+        // Half a frame of margin after the next vsync, which the vsync time of the frame gives
+        // when it is known
+        if (reproject and pose) {
+          reprojection_deadline = vsync + frame_time + frame_time / 2;
+          frame_pose = pose;
+        }
 
-        m_listener->GetStatistics()->EncodeOutput(std::chrono::duration_cast<std::chrono::microseconds>(encode_end - encode_start).count());
+        if (skip) {
+          continue;
+        }
 
+        if (process_frames) {
+          processor->Process(frame_info.image, input_layout(frame_info.image));
+          ((AVVkFrame *)images[frame_info.image])->layout[0] = VK_IMAGE_LAYOUT_GENERAL;
+        }
+        encode_pipeline->Submit(frame_info.image, m_scheduler.CheckIDRInsertion(), m_poseSubmitIndex, vsync + deadline_after_vsync);
       }
     }
     catch (std::exception &e) {
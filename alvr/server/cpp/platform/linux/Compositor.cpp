@@ -0,0 +1,670 @@
+#include "Compositor.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "alvr_server/Logger.h"
+#include "alvr_server/PoseHistory.h"
+#include "alvr_server/Settings.h"
+#include "alvr_server/Utils.h"
+#include "alvr_server/include/openvr_math.h"
+#include "alvr_server/include/pose_math.h"
+#include "protocol.h"
+
+// generated by build.rs from shader/compositor.comp
+#include "compositor.comp.h"
+
+namespace {
+// std140 layout of the Params block in compositor.comp
+struct ViewParams {
+    float reprojection[3][4];
+    float rect[4];
+};
+
+struct CompositorParams {
+    float fovTan[2][4];
+    uint32_t layerCount;
+    uint32_t pad[3];
+    ViewParams views[Compositor::MAX_LAYERS * 2];
+};
+
+const uint32_t WORKGROUP_SIZE = 16;
+
+int send_fds(int socket, const int *fds, size_t count) {
+    char dummy = '\0';
+    iovec iov{.iov_base = &dummy, .iov_len = 1};
+
+    union {
+        cmsghdr cm;
+        char buf[CMSG_SPACE(sizeof(int) * Compositor::OUTPUT_IMAGES * 2)];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+
+    return sendmsg(socket, &msg, 0);
+}
+} // namespace
+
+Compositor::Compositor(std::shared_ptr<PoseHistory> poseHistory) : m_poseHistory(poseHistory) {}
+
+Compositor::~Compositor() {
+    if (m_socket != -1) {
+        close(m_socket);
+    }
+
+    if (!m_initialized) {
+        return;
+    }
+
+    m_device.waitIdle();
+
+    for (auto &texture : m_textures) {
+        m_device.destroyImageView(texture.second.view);
+        m_device.destroyImage(texture.second.image);
+        m_device.freeMemory(texture.second.memory);
+    }
+    for (auto &output : m_outputs) {
+        if (!output.image) {
+            continue;
+        }
+        m_device.destroyFence(output.fence);
+        m_device.destroyBuffer(output.params);
+        m_device.freeMemory(output.paramsMemory);
+        m_device.destroySemaphore(output.semaphore);
+        m_device.destroyImageView(output.view);
+        m_device.destroyImage(output.image);
+        m_device.freeMemory(output.memory);
+    }
+
+    m_device.destroySampler(m_sampler);
+    m_device.destroyPipeline(m_pipeline);
+    m_device.destroyPipelineLayout(m_pipelineLayout);
+    m_device.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    m_device.destroyDescriptorPool(m_descriptorPool);
+    m_device.destroyCommandPool(m_commandPool);
+    m_device.destroy();
+    m_instance.destroy();
+}
+
+void Compositor::InitVulkan() {
+    vk::ApplicationInfo appInfo("ALVR compositor", 0, "ALVR", 0, VK_API_VERSION_1_1);
+    vk::InstanceCreateInfo instanceInfo;
+    instanceInfo.pApplicationInfo = &appInfo;
+    m_instance = vk::createInstance(instanceInfo);
+
+    auto physicalDevices = m_instance.enumeratePhysicalDevices();
+    if (physicalDevices.empty()) {
+        throw MakeException("No vulkan device found");
+    }
+    int32_t adapterIndex = Settings::Instance().m_nAdapterIndex;
+    if (adapterIndex < 0 || adapterIndex >= (int32_t)physicalDevices.size()) {
+        adapterIndex = 0;
+    }
+    m_physicalDevice = physicalDevices[adapterIndex];
+
+    auto queueFamilies = m_physicalDevice.getQueueFamilyProperties();
+    m_queueFamily = UINT32_MAX;
+    for (uint32_t i = 0; i < queueFamilies.size(); ++i) {
+        if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eCompute) {
+            m_queueFamily = i;
+            break;
+        }
+    }
+    if (m_queueFamily == UINT32_MAX) {
+        throw MakeException("No compute queue found");
+    }
+
+    float queuePriority = 1.0f;
+    vk::DeviceQueueCreateInfo queueInfo({}, m_queueFamily, 1, &queuePriority);
+
+    const char *extensions[] = {
+        VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+        VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+    };
+    vk::DeviceCreateInfo deviceInfo;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    deviceInfo.enabledExtensionCount = sizeof(extensions) / sizeof(extensions[0]);
+    deviceInfo.ppEnabledExtensionNames = extensions;
+    m_device = m_physicalDevice.createDevice(deviceInfo);
+    m_queue = m_device.getQueue(m_queueFamily, 0);
+
+    m_dispatch = vk::DispatchLoaderDynamic(m_instance, vkGetInstanceProcAddr, m_device);
+
+    m_commandPool = m_device.createCommandPool(
+        {vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_queueFamily});
+
+    vk::SamplerCreateInfo samplerInfo;
+    samplerInfo.magFilter = vk::Filter::eLinear;
+    samplerInfo.minFilter = vk::Filter::eLinear;
+    samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    m_sampler = m_device.createSampler(samplerInfo);
+
+    CreatePipeline();
+
+    vk::PhysicalDeviceProperties props = m_physicalDevice.getProperties();
+    Info("Compositor initialized on %s\n", props.deviceName.data());
+}
+
+void Compositor::CreatePipeline() {
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+        vk::DescriptorSetLayoutBinding(0,
+                                       vk::DescriptorType::eCombinedImageSampler,
+                                       MAX_LAYERS * 2,
+                                       vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(
+            1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(
+            2, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+    };
+    vk::DescriptorSetLayoutCreateInfo setLayoutInfo;
+    setLayoutInfo.bindingCount = bindings.size();
+    setLayoutInfo.pBindings = bindings.data();
+    m_descriptorSetLayout = m_device.createDescriptorSetLayout(setLayoutInfo);
+
+    vk::PushConstantRange pushConstants(vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t));
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+    m_pipelineLayout = m_device.createPipelineLayout(pipelineLayoutInfo);
+
+    vk::ShaderModuleCreateInfo moduleInfo;
+    moduleInfo.codeSize = sizeof(COMPOSITOR_COMP_SPV);
+    moduleInfo.pCode = COMPOSITOR_COMP_SPV;
+    vk::ShaderModule module = m_device.createShaderModule(moduleInfo);
+
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.stage = vk::PipelineShaderStageCreateInfo(
+        {}, vk::ShaderStageFlagBits::eCompute, module, "main");
+    pipelineInfo.layout = m_pipelineLayout;
+    m_pipeline = m_device.createComputePipeline(nullptr, pipelineInfo).value;
+    m_device.destroyShaderModule(module);
+
+    std::array<vk::DescriptorPoolSize, 3> poolSizes = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler,
+                               MAX_LAYERS * 2 * OUTPUT_IMAGES),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, OUTPUT_IMAGES),
+        vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, OUTPUT_IMAGES),
+    };
+    vk::DescriptorPoolCreateInfo poolInfo;
+    poolInfo.maxSets = OUTPUT_IMAGES;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    m_descriptorPool = m_device.createDescriptorPool(poolInfo);
+}
+
+uint32_t Compositor::FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags properties) {
+    auto memoryProps = m_physicalDevice.getMemoryProperties();
+    for (uint32_t i = 0; i < memoryProps.memoryTypeCount; ++i) {
+        if ((typeBits & (1 << i)) &&
+            (memoryProps.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw MakeException("No suitable memory type found");
+}
+
+void Compositor::CreateOutputImages() {
+    auto &settings = Settings::Instance();
+
+    // The encoder pipelines expect BGRA input. The storage view is RGBA because storage support
+    // for BGRA is optional, the shader swizzles the output instead. With extended usage the image
+    // can have the storage usage that only the RGBA view supports.
+    m_outputCreateInfo = vk::ImageCreateInfo(
+        vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage,
+        vk::ImageType::e2D,
+        vk::Format::eB8G8R8A8Unorm,
+        vk::Extent3D(settings.m_renderWidth, settings.m_renderHeight, 1),
+        1,
+        1,
+        vk::SampleCountFlagBits::e1,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled |
+            vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+        vk::SharingMode::eExclusive,
+        0,
+        nullptr,
+        vk::ImageLayout::eUndefined);
+
+    auto commandBuffers = m_device.allocateCommandBuffers(
+        {m_commandPool, vk::CommandBufferLevel::ePrimary, OUTPUT_IMAGES});
+
+    for (uint32_t i = 0; i < OUTPUT_IMAGES; ++i) {
+        auto &output = m_outputs[i];
+
+        vk::ExternalMemoryImageCreateInfo extMemImageInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd);
+        vk::ImageCreateInfo imageInfo = m_outputCreateInfo;
+        imageInfo.pNext = &extMemImageInfo;
+        output.image = m_device.createImage(imageInfo);
+
+        auto req = m_device.getImageMemoryRequirements(output.image);
+        m_outputMemoryIndex =
+            FindMemoryType(req.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+        dedicatedInfo.image = output.image;
+        vk::ExportMemoryAllocateInfo exportInfo(vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd);
+        exportInfo.pNext = &dedicatedInfo;
+        vk::MemoryAllocateInfo allocInfo(req.size, m_outputMemoryIndex);
+        allocInfo.pNext = &exportInfo;
+        output.memory = m_device.allocateMemory(allocInfo);
+        m_device.bindImageMemory(output.image, output.memory, 0);
+
+        vk::ImageViewUsageCreateInfo viewUsageInfo(vk::ImageUsageFlagBits::eStorage);
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.pNext = &viewUsageInfo;
+        viewInfo.image = output.image;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format = vk::Format::eR8G8B8A8Unorm;
+        viewInfo.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        output.view = m_device.createImageView(viewInfo);
+
+        vk::ExportSemaphoreCreateInfo exportSemInfo(
+            vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd);
+        vk::SemaphoreCreateInfo semInfo;
+        semInfo.pNext = &exportSemInfo;
+        output.semaphore = m_device.createSemaphore(semInfo);
+
+        // The encoder waits on the semaphore before reading and signals it back afterwards
+        vk::SubmitInfo signalInfo;
+        signalInfo.signalSemaphoreCount = 1;
+        signalInfo.pSignalSemaphores = &output.semaphore;
+        m_queue.submit(signalInfo, nullptr);
+
+        vk::BufferCreateInfo bufferInfo(
+            {}, sizeof(CompositorParams), vk::BufferUsageFlagBits::eUniformBuffer);
+        output.params = m_device.createBuffer(bufferInfo);
+        auto bufferReq = m_device.getBufferMemoryRequirements(output.params);
+        output.paramsMemory = m_device.allocateMemory(
+            {bufferReq.size,
+             FindMemoryType(bufferReq.memoryTypeBits,
+                            vk::MemoryPropertyFlagBits::eHostVisible |
+                                vk::MemoryPropertyFlagBits::eHostCoherent)});
+        m_device.bindBufferMemory(output.params, output.paramsMemory, 0);
+        output.paramsMapped = m_device.mapMemory(output.paramsMemory, 0, sizeof(CompositorParams));
+
+        output.descriptorSet =
+            m_device.allocateDescriptorSets({m_descriptorPool, 1, &m_descriptorSetLayout})[0];
+        output.commandBuffer = commandBuffers[i];
+        output.fence = m_device.createFence({vk::FenceCreateFlagBits::eSignaled});
+    }
+    m_queue.waitIdle();
+}
+
+bool Compositor::TryConnect() {
+    const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir == nullptr) {
+        throw MakeException("XDG_RUNTIME_DIR is not set");
+    }
+    std::string socketPath = runtimeDir;
+    socketPath += "/alvr-ipc";
+
+    // The state of a socket after a failed connect is unspecified, a new one is used each time
+    if (m_socket != -1) {
+        close(m_socket);
+    }
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_socket == -1) {
+        throw MakeException("socket failed: %s", strerror(errno));
+    }
+
+    sockaddr_un name{};
+    name.sun_family = AF_UNIX;
+    strncpy(name.sun_path, socketPath.c_str(), sizeof(name.sun_path) - 1);
+    if (connect(m_socket, (const sockaddr *)&name, sizeof(name)) == -1) {
+        close(m_socket);
+        m_socket = -1;
+        return false; // the encoder is not listening yet, try again next frame
+    }
+
+    vk::PhysicalDeviceProperties props = m_physicalDevice.getProperties();
+    init_packet init{.num_images = OUTPUT_IMAGES,
+                     .device_name = {},
+                     .image_create_info = m_outputCreateInfo,
+                     .mem_index = m_outputMemoryIndex,
+                     .source_pid = getpid()};
+    memcpy(init.device_name.data(), props.deviceName.data(), init.device_name.size());
+    if (write(m_socket, &init, sizeof(init)) == -1) {
+        throw MakeException("write failed: %s", strerror(errno));
+    }
+
+    // same order as the vulkan layer: memory then semaphore of each image
+    int fds[OUTPUT_IMAGES * 2];
+    for (uint32_t i = 0; i < OUTPUT_IMAGES; ++i) {
+        fds[2 * i] = m_device.getMemoryFdKHR(
+            {m_outputs[i].memory, vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd}, m_dispatch);
+        fds[2 * i + 1] = m_device.getSemaphoreFdKHR(
+            {m_outputs[i].semaphore, vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd},
+            m_dispatch);
+    }
+    int ret = send_fds(m_socket, fds, OUTPUT_IMAGES * 2);
+    for (int fd : fds) {
+        close(fd);
+    }
+    if (ret == -1) {
+        throw MakeException("sendmsg failed: %s", strerror(errno));
+    }
+
+    Debug("Compositor connected to encoder\n");
+    return true;
+}
+
+uint64_t Compositor::CreateTexture(
+    uint32_t width, uint32_t height, uint32_t format, uint32_t sampleCount, void *texture) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    try {
+        if (!m_initialized) {
+            InitVulkan();
+            m_initialized = true;
+        }
+
+        // Multisampled images cannot be sampled in the compositor, the client must resolve them
+        if (sampleCount > 1) {
+            Warn("Compositor: ignoring sample count %d for shared texture\n", sampleCount);
+        }
+
+        int *fd = (int *)texture;
+
+        // The client must create its image with the same parameters for the import to be valid
+        vk::ExternalMemoryImageCreateInfo extMemImageInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd);
+        vk::ImageCreateInfo imageInfo({},
+                                      vk::ImageType::e2D,
+                                      (vk::Format)format,
+                                      vk::Extent3D(width, height, 1),
+                                      1,
+                                      1,
+                                      vk::SampleCountFlagBits::e1,
+                                      vk::ImageTiling::eOptimal,
+                                      vk::ImageUsageFlagBits::eSampled |
+                                          vk::ImageUsageFlagBits::eColorAttachment |
+                                          vk::ImageUsageFlagBits::eTransferSrc |
+                                          vk::ImageUsageFlagBits::eTransferDst);
+        imageInfo.pNext = &extMemImageInfo;
+
+        Texture tex;
+        tex.image = m_device.createImage(imageInfo);
+        auto req = m_device.getImageMemoryRequirements(tex.image);
+
+        vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+        dedicatedInfo.image = tex.image;
+        vk::ImportMemoryFdInfoKHR importInfo(vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd, *fd);
+        vk::ExportMemoryAllocateInfo exportInfo(vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd);
+        vk::MemoryAllocateInfo allocInfo(
+            req.size, FindMemoryType(req.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal));
+        bool import = *fd >= 0;
+        if (import) {
+            importInfo.pNext = &dedicatedInfo;
+            allocInfo.pNext = &importInfo;
+        } else {
+            exportInfo.pNext = &dedicatedInfo;
+            allocInfo.pNext = &exportInfo;
+        }
+        tex.memory = m_device.allocateMemory(allocInfo);
+        m_device.bindImageMemory(tex.image, tex.memory, 0);
+
+        if (!import) {
+            *fd = m_device.getMemoryFdKHR(
+                {tex.memory, vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd}, m_dispatch);
+        }
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image = tex.image;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format = (vk::Format)format;
+        viewInfo.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        tex.view = m_device.createImageView(viewInfo);
+
+        auto id = m_nextTextureId++;
+        m_textures.insert({id, tex});
+        return id;
+    } catch (std::exception &e) {
+        Error("Compositor: failed to create texture: %s\n", e.what());
+        return 0;
+    }
+}
+
+void Compositor::DestroyTexture(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_textures.find(id);
+    if (it == m_textures.end()) {
+        return;
+    }
+
+    // the texture may still be referenced by an in flight composition
+    for (auto &output : m_outputs) {
+        if (output.fence) {
+            (void)m_device.waitForFences(output.fence, true, UINT64_MAX);
+        }
+    }
+    m_device.destroyImageView(it->second.view);
+    m_device.destroyImage(it->second.image);
+    m_device.freeMemory(it->second.memory);
+    m_textures.erase(it);
+}
+
+void Compositor::FillParams(OutputImage &output, const Layer *layers, uint32_t layerCount) {
+    auto &settings = Settings::Instance();
+    auto params = (CompositorParams *)output.paramsMapped;
+
+    for (int eye = 0; eye < 2; ++eye) {
+        params->fovTan[eye][0] = tanf(settings.m_eyeFov[eye].left * DEG_TO_RAD);
+        params->fovTan[eye][1] = tanf(settings.m_eyeFov[eye].right * DEG_TO_RAD);
+        params->fovTan[eye][2] = tanf(settings.m_eyeFov[eye].top * DEG_TO_RAD);
+        params->fovTan[eye][3] = tanf(settings.m_eyeFov[eye].bottom * DEG_TO_RAD);
+    }
+    params->layerCount = layerCount;
+
+    std::array<vk::DescriptorImageInfo, MAX_LAYERS * 2> imageInfos;
+    for (uint32_t layer = 0; layer < MAX_LAYERS; ++layer) {
+        for (uint32_t eye = 0; eye < 2; ++eye) {
+            auto &imageInfo = imageInfos[layer * 2 + eye];
+            imageInfo.sampler = m_sampler;
+            imageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+            if (layer >= layerCount) {
+                // unused slots still need a valid descriptor
+                imageInfo.imageView = imageInfos[0].imageView;
+                continue;
+            }
+
+            auto &view = layers[layer].views[eye];
+            imageInfo.imageView = m_textures.at(view.texture_id).view;
+
+            // Rotation from the eye space of the reference (first) layer to the eye space the
+            // layer was rendered with, applied per pixel to reproject older layers.
+            auto delta = posemath::multiply<vr::HmdQuaternion_t>(
+                posemath::conjugate(view.orientation), layers[0].views[eye].orientation);
+            vr::HmdMatrix34_t rotation;
+            posemath::quatToMat33(delta, rotation);
+
+            auto &viewParams = params->views[layer * 2 + eye];
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 4; ++col) {
+                    viewParams.reprojection[row][col] = col < 3 ? rotation.m[row][col] : 0.f;
+                }
+            }
+            viewParams.rect[0] = view.rect_offset.x;
+            viewParams.rect[1] = view.rect_offset.y;
+            viewParams.rect[2] = view.rect_size.x;
+            viewParams.rect[3] = view.rect_size.y;
+        }
+    }
+
+    vk::DescriptorImageInfo outputInfo(nullptr, output.view, vk::ImageLayout::eGeneral);
+    vk::DescriptorBufferInfo paramsInfo(output.params, 0, sizeof(CompositorParams));
+    std::array<vk::WriteDescriptorSet, 3> writes = {
+        vk::WriteDescriptorSet(output.descriptorSet,
+                               0,
+                               0,
+                               imageInfos.size(),
+                               vk::DescriptorType::eCombinedImageSampler,
+                               imageInfos.data()),
+        vk::WriteDescriptorSet(
+            output.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageImage, &outputInfo),
+        vk::WriteDescriptorSet(output.descriptorSet,
+                               2,
+                               0,
+                               1,
+                               vk::DescriptorType::eUniformBuffer,
+                               nullptr,
+                               &paramsInfo),
+    };
+    m_device.updateDescriptorSets(writes, {});
+}
+
+void Compositor::PresentLayers(const Layer *layers, uint64_t layerCount) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_initialized || layerCount == 0) {
+        return;
+    }
+    if (layerCount > MAX_LAYERS) {
+        Warn("Compositor: too many layers (%llu), only the first %d are used\n",
+             layerCount,
+             MAX_LAYERS);
+        layerCount = MAX_LAYERS;
+    }
+
+    try {
+        auto startTime = std::chrono::steady_clock::now();
+
+        if (!m_outputs[0].image) {
+            CreateOutputImages();
+        }
+        if (!m_connected) {
+            m_connected = TryConnect();
+        }
+
+        auto &output = m_outputs[m_outputIndex];
+        (void)m_device.waitForFences(output.fence, true, UINT64_MAX);
+        m_device.resetFences(output.fence);
+
+        FillParams(output, layers, layerCount);
+
+        auto &cmd = output.commandBuffer;
+        cmd.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+        // Acquire the client textures and the output image from the other devices. The content
+        // of the output is fully overwritten, so its previous layout is discarded.
+        std::vector<vk::ImageMemoryBarrier> barriers;
+        for (uint64_t layer = 0; layer < layerCount; ++layer) {
+            for (int eye = 0; eye < 2; ++eye) {
+                vk::ImageMemoryBarrier barrier;
+                barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+                barrier.oldLayout = vk::ImageLayout::eGeneral;
+                barrier.newLayout = vk::ImageLayout::eGeneral;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+                barrier.dstQueueFamilyIndex = m_queueFamily;
+                barrier.image = m_textures.at(layers[layer].views[eye].texture_id).image;
+                barrier.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+                barriers.push_back(barrier);
+            }
+        }
+        vk::ImageMemoryBarrier outputBarrier;
+        outputBarrier.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+        outputBarrier.oldLayout = vk::ImageLayout::eUndefined;
+        outputBarrier.newLayout = vk::ImageLayout::eGeneral;
+        outputBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        outputBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        outputBarrier.image = output.image;
+        outputBarrier.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        barriers.push_back(outputBarrier);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                            vk::PipelineStageFlagBits::eComputeShader,
+                            {},
+                            {},
+                            {},
+                            barriers);
+
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+        cmd.bindDescriptorSets(
+            vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, output.descriptorSet, {});
+        uint32_t eyeWidth = m_outputCreateInfo.extent.width / 2;
+        uint32_t height = m_outputCreateInfo.extent.height;
+        for (uint32_t eye = 0; eye < 2; ++eye) {
+            cmd.pushConstants(m_pipelineLayout,
+                              vk::ShaderStageFlagBits::eCompute,
+                              0,
+                              sizeof(eye),
+                              &eye);
+            cmd.dispatch((eyeWidth + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                         (height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                         1);
+        }
+
+        // Release the output to the encoder device
+        outputBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        outputBarrier.dstAccessMask = {};
+        outputBarrier.oldLayout = vk::ImageLayout::eGeneral;
+        outputBarrier.srcQueueFamilyIndex = m_queueFamily;
+        outputBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                            vk::PipelineStageFlagBits::eBottomOfPipe,
+                            {},
+                            {},
+                            {},
+                            outputBarrier);
+        cmd.end();
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        m_queue.submit(submitInfo, output.fence);
+
+        // The encoder has no way to wait on our fence, so the image must be complete before it is
+        // announced.
+        (void)m_device.waitForFences(output.fence, true, UINT64_MAX);
+
+        Debug("Compositor: %llu layers composited in %lld us\n",
+              layerCount,
+              (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - startTime)
+                  .count());
+
+        if (m_connected) {
+            vr::HmdMatrix34_t pose;
+            posemath::quatToMat33(layers[0].views[0].orientation, pose);
+
+            present_packet packet;
+            packet.image = m_outputIndex;
+            packet.frame = m_frame++;
+            // there is no display in this path, the start of composition stands in for the vsync
+            packet.vsync_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  startTime.time_since_epoch())
+                                  .count();
+            memcpy(&packet.pose, pose.m, sizeof(packet.pose));
+            if (write(m_socket, &packet, sizeof(packet)) == -1) {
+                Warn("Compositor: lost connection to encoder: %s\n", strerror(errno));
+                close(m_socket);
+                m_socket = -1;
+                m_connected = false;
+            }
+        }
+
+        m_outputIndex = (m_outputIndex + 1) % OUTPUT_IMAGES;
+    } catch (std::exception &e) {
+        Error("Compositor: failed to present layers: %s\n", e.what());
+    }
+}
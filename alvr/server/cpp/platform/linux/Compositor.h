@@ -0,0 +1,89 @@
+#pragma once
+
+#include "alvr_server/bindings.h"
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vulkan/vulkan.hpp>
+
+class PoseHistory;
+
+// Composites the layers submitted through PresentLayers into the images consumed by CEncoder.
+// The output images are handed over through the same socket protocol as the vulkan layer, so
+// CEncoder does not need to know who is producing the frames.
+class Compositor {
+  public:
+    static const uint32_t MAX_LAYERS = 10;
+    static const uint32_t OUTPUT_IMAGES = 3;
+
+    Compositor(std::shared_ptr<PoseHistory> poseHistory);
+    ~Compositor();
+
+    // texture points to an int: if it is a valid fd, the memory is imported from it, otherwise
+    // new memory is allocated and its fd is written back.
+    uint64_t CreateTexture(
+        uint32_t width, uint32_t height, uint32_t format, uint32_t sampleCount, void *texture);
+
+    void DestroyTexture(uint64_t id);
+
+    void PresentLayers(const Layer *layers, uint64_t layerCount);
+
+  private:
+    struct Texture {
+        vk::Image image;
+        vk::DeviceMemory memory;
+        vk::ImageView view;
+    };
+
+    struct OutputImage {
+        vk::Image image;
+        vk::DeviceMemory memory;
+        vk::ImageView view;
+        vk::Semaphore semaphore;
+        vk::Buffer params;
+        vk::DeviceMemory paramsMemory;
+        void *paramsMapped = nullptr;
+        vk::DescriptorSet descriptorSet;
+        vk::CommandBuffer commandBuffer;
+        vk::Fence fence;
+    };
+
+    void InitVulkan();
+    void CreatePipeline();
+    void CreateOutputImages();
+    bool TryConnect();
+    uint32_t FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags properties);
+    void FillParams(OutputImage &output, const Layer *layers, uint32_t layerCount);
+
+    std::shared_ptr<PoseHistory> m_poseHistory;
+
+    std::mutex m_mutex;
+    bool m_initialized = false;
+
+    vk::Instance m_instance;
+    vk::PhysicalDevice m_physicalDevice;
+    vk::Device m_device;
+    vk::DispatchLoaderDynamic m_dispatch;
+    uint32_t m_queueFamily = 0;
+    vk::Queue m_queue;
+    vk::CommandPool m_commandPool;
+    vk::DescriptorPool m_descriptorPool;
+    vk::DescriptorSetLayout m_descriptorSetLayout;
+    vk::PipelineLayout m_pipelineLayout;
+    vk::Pipeline m_pipeline;
+    vk::Sampler m_sampler;
+
+    std::map<uint64_t, Texture> m_textures;
+    uint64_t m_nextTextureId = 1;
+
+    vk::ImageCreateInfo m_outputCreateInfo;
+    uint32_t m_outputMemoryIndex = 0;
+    std::array<OutputImage, OUTPUT_IMAGES> m_outputs;
+    uint32_t m_outputIndex = 0;
+    uint32_t m_frame = 0;
+
+    int m_socket = -1;
+    bool m_connected = false;
+};
@@ -7,6 +7,9 @@
 #include "EncodePipelineNvEnc.h"
 #include "ffmpeg_helper.h"
 
+#include <algorithm>
+#include <utility>
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
@@ -62,50 +65,278 @@ void filter_NAL(const uint8_t* input, size_t input_size, std::vector<uint8_t> &o
   }
 }
 
+bool should_keep_obu(uint8_t obu_type)
+{
+  switch (obu_type)
+  {
+    case 2: // temporal delimiter, implied by the frame boundaries
+    case 5: // metadata
+    case 15: // padding
+      return false;
+    default:
+      return true;
+  }
 }
 
-void alvr::EncodePipeline::SetBitrate(int64_t bitrate) {
+// AV1 packets are OBUs in the low overhead format: no start codes, each OBU carries its size.
+void filter_OBU(const uint8_t* input, size_t input_size, std::vector<uint8_t> &out)
+{
+  auto end = input + input_size;
+  auto obu_start = input;
+  while (obu_start < end)
+  {
+    uint8_t header = obu_start[0];
+    uint8_t obu_type = (header >> 3) & 0xF;
+    bool has_extension = header & 0x4;
+    bool has_size = header & 0x2;
+
+    auto payload = obu_start + 1 + has_extension;
+    uint64_t payload_size = 0;
+    if (has_size)
+    {
+      // leb128
+      for (int i = 0; i < 8 and payload < end; i++)
+      {
+        uint8_t byte = *payload++;
+        payload_size |= uint64_t(byte & 0x7F) << (7 * i);
+        if (not (byte & 0x80))
+          break;
+      }
+    }
+    else if (payload <= end)
+    {
+      payload_size = end - payload;
+    }
+    if (payload > end or payload_size > uint64_t(end - payload))
+    {
+      Warn("malformed AV1 OBU of type %d", obu_type);
+      out.insert(out.end(), obu_start, end);
+      return;
+    }
+
+    auto next_obu = payload + payload_size;
+    if (should_keep_obu(obu_type))
+      out.insert(out.end(), obu_start, next_obu);
+    obu_start = next_obu;
+  }
+}
+
+}
+
+void alvr::EncodePipeline::ApplyBitrate(int64_t bitrate) {
   encoder_ctx->bit_rate = bitrate;
+
+  auto &settings = Settings::Instance();
+  if (settings.m_enableFrameSizeCap) {
+    // The VBV buffer is emptied at the bitrate and holds at most the largest frame allowed, so a
+    // single frame can not take longer than the cap to be sent, whatever the previous ones.
+    encoder_ctx->rc_max_rate = bitrate;
+    encoder_ctx->rc_buffer_size = bitrate / settings.m_refreshRate * settings.m_frameSizeCapIntervals;
+  }
 }
 
-std::unique_ptr<alvr::EncodePipeline> alvr::EncodePipeline::Create(std::vector<VkFrame> &input_frames, VkFrameCtx &vk_frame_ctx)
+void alvr::EncodePipeline::SetBitrate(int64_t bitrate) {
+  std::lock_guard<std::mutex> lock(mutex);
+  pending_bitrate = bitrate;
+}
+
+std::unique_ptr<alvr::EncodePipeline> alvr::EncodePipeline::Create(std::vector<VkFrame> &input_frames, VkFrameCtx &vk_frame_ctx, uint32_t in_flight)
 {
+  std::unique_ptr<alvr::EncodePipeline> pipeline;
   try {
-    auto vaapi = std::make_unique<alvr::EncodePipelineVAAPI>(input_frames, vk_frame_ctx);
+    pipeline = std::make_unique<alvr::EncodePipelineVAAPI>(input_frames, vk_frame_ctx);
     Info("using VAAPI encoder");
-    return vaapi;
   } catch (...)
   {
     Info("failed to create VAAPI encoder");
   }
-  try {
-    auto nvenc = std::make_unique<alvr::EncodePipelineNvEnc>(input_frames, vk_frame_ctx);
-    Info("using NvEnc encoder");
-    return nvenc;
-  } catch (...)
+  if (not pipeline)
+  {
+    try {
+      pipeline = std::make_unique<alvr::EncodePipelineNvEnc>(input_frames, vk_frame_ctx);
+      Info("using NvEnc encoder");
+    } catch (...)
+    {
+      Info("failed to create NvEnc encoder");
+    }
+  }
+  if (not pipeline)
   {
-    Info("failed to create NvEnc encoder");
+    pipeline = std::make_unique<alvr::EncodePipelineSW>(input_frames, vk_frame_ctx);
+    Info("using SW encoder");
   }
-  auto sw = std::make_unique<alvr::EncodePipelineSW>(input_frames, vk_frame_ctx);
-  Info("using SW encoder");
-  return sw;
+  pipeline->StartEncodeThread(std::max<uint32_t>(in_flight, 1));
+  return pipeline;
 }
 
 alvr::EncodePipeline::~EncodePipeline()
 {
+  StopEncodeThread();
   AVCODEC.avcodec_free_context(&encoder_ctx);
 }
 
-bool alvr::EncodePipeline::GetEncoded(std::vector<uint8_t> &out)
+void alvr::EncodePipeline::StartEncodeThread(uint32_t in_flight)
 {
-  AVPacket * enc_pkt = AVCODEC.av_packet_alloc();
-  int err = AVCODEC.avcodec_receive_packet(encoder_ctx, enc_pkt);
-  if (err == AVERROR(EAGAIN)) {
+  for (uint32_t slot = in_flight; slot > 0; --slot)
+    free_slots.push_back(slot - 1);
+  encode_thread = std::thread(&EncodePipeline::EncodeLoop, this);
+}
+
+void alvr::EncodePipeline::StopEncodeThread()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    cv.notify_all();
+  }
+  if (encode_thread.joinable())
+    encode_thread.join();
+}
+
+void alvr::EncodePipeline::Submit(uint32_t frame_index, bool idr, uint64_t tag, std::chrono::steady_clock::time_point deadline)
+{
+  Pending pending;
+  pending.submit_time = std::chrono::steady_clock::now();
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return error or not free_slots.empty(); });
+    if (error)
+      std::rethrow_exception(error);
+    pending.slot = free_slots.back();
+    free_slots.pop_back();
+  }
+
+  pending.convert_start = std::chrono::steady_clock::now();
+  try {
+    pending.frame = Convert(frame_index, pending.slot);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex);
+    free_slots.push_back(pending.slot);
+    throw;
+  }
+  pending.convert_end = std::chrono::steady_clock::now();
+  pending.tag = tag;
+  pending.frame_index = frame_index;
+  pending.idr = idr;
+  pending.deadline = deadline;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  to_encode.push_back(pending);
+  cv.notify_all();
+}
+
+bool alvr::EncodePipeline::GetEncoded(EncodedFrame &out, std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (not cv.wait_for(lock, timeout, [this] { return not encoded.empty(); }))
     return false;
-  } else if (err) {
-    throw alvr::AvException("failed to encode", err);
+
+  auto buffer = std::move(out.data);
+  out = std::move(encoded.front());
+  encoded.pop_front();
+  buffer.clear();
+  spare_buffers.push_back(std::move(buffer));
+  return true;
+}
+
+void alvr::EncodePipeline::EncodeLoop()
+{
+  try {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+      cv.wait(lock, [this] { return stopping or not to_encode.empty(); });
+      if (stopping)
+        return;
+      // A keyframe request moves to the frame that replaces the dropped one
+      bool idr = false;
+      while (Settings::Instance().m_dropLateFrames and to_encode.size() > 1
+             and to_encode.front().deadline < std::chrono::steady_clock::now())
+      {
+        idr |= to_encode.front().idr;
+        free_slots.push_back(to_encode.front().slot);
+        to_encode.pop_front();
+        dropped_late++;
+        cv.notify_all();
+      }
+      Pending pending = to_encode.front();
+      to_encode.pop_front();
+      pending.idr |= idr;
+      int64_t bitrate = std::exchange(pending_bitrate, 0);
+      lock.unlock();
+
+      if (bitrate)
+        ApplyBitrate(bitrate);
+
+      pending.encode_start = std::chrono::steady_clock::now();
+      pending.frame->pict_type = pending.idr ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+      pending.frame->pts = pending.submit_time.time_since_epoch().count();
+      int err = AVCODEC.avcodec_send_frame(encoder_ctx, pending.frame);
+      if (err < 0)
+        throw alvr::AvException("avcodec_send_frame failed:", err);
+
+      lock.lock();
+      encoding.push_back(pending);
+      lock.unlock();
+
+      // Encoders read their input at the latest in the first receive after it was sent, the slot
+      // is free after that even if the packet comes later
+      ReceivePackets();
+
+      lock.lock();
+      free_slots.push_back(pending.slot);
+      cv.notify_all();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex);
+    error = std::current_exception();
+    cv.notify_all();
+  }
+}
+
+void alvr::EncodePipeline::ReceivePackets()
+{
+  // avcodec_receive_packet unreferences the previous packet
+  AVPacket * enc_pkt = AVCODEC.av_packet_alloc();
+  while (true)
+  {
+    int err = AVCODEC.avcodec_receive_packet(encoder_ctx, enc_pkt);
+    if (err == AVERROR(EAGAIN)) {
+      break;
+    } else if (err) {
+      AVCODEC.av_packet_free(&enc_pkt);
+      throw alvr::AvException("failed to encode", err);
+    }
+    auto encode_end = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // no B-frames, packets come out in submission order
+    Pending pending = encoding.front();
+    encoding.pop_front();
+    EncodedFrame frame;
+    frame.dropped = std::exchange(dropped_late, 0);
+    if (not spare_buffers.empty())
+    {
+      frame.data = std::move(spare_buffers.back());
+      spare_buffers.pop_back();
+    }
+    lock.unlock();
+
+    frame.tag = pending.tag;
+    frame.frame_index = pending.frame_index;
+    frame.idr = pending.idr;
+    frame.deadline = pending.deadline;
+    frame.convert_time = pending.convert_end - pending.convert_start;
+    frame.queue_time = (pending.convert_start - pending.submit_time) + (pending.encode_start - pending.convert_end);
+    frame.encode_time = encode_end - pending.encode_start;
+    if (Settings::Instance().m_codec == ALVR_CODEC_AV1)
+      filter_OBU(enc_pkt->data, enc_pkt->size, frame.data);
+    else
+      filter_NAL(enc_pkt->data, enc_pkt->size, frame.data);
+
+    lock.lock();
+    encoded.push_back(std::move(frame));
+    cv.notify_all();
   }
-  filter_NAL(enc_pkt->data, enc_pkt->size, out);
   AVCODEC.av_packet_free(&enc_pkt);
-  return true;
 }
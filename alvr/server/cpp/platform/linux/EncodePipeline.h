@@ -1,9 +1,16 @@
 #pragma once
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 extern "C" struct AVCodecContext;
+extern "C" struct AVFrame;
 
 namespace alvr
 {
@@ -11,18 +18,88 @@ namespace alvr
 class VkFrame;
 class VkFrameCtx;
 
+/* Encoding is asynchronous: Submit converts the input image on the calling thread, into one of
+ * in_flight slots, and the encoder runs on a thread of the pipeline. The conversion of a frame can
+ * then overlap with the encoding of the previous ones, up to in_flight frames (1 for the lowest
+ * latency, more for throughput). Encoded frames are queued in submission order, with the tag
+ * given to Submit.
+ *
+ * With drop late frames, a frame still waiting for the encoder after its deadline is dropped when
+ * a newer one is waiting too. It never reaches the encoder, so no other frame references it.
+ */
 class EncodePipeline
 {
 public:
+  struct EncodedFrame
+  {
+    uint64_t tag;
+    uint32_t frame_index;
+    bool idr;
+    std::vector<uint8_t> data;
+    std::chrono::steady_clock::duration convert_time;
+    // waiting for the encode thread, behind the previous frames
+    std::chrono::steady_clock::duration queue_time;
+    std::chrono::steady_clock::duration encode_time;
+    std::chrono::steady_clock::time_point deadline;
+    // late frames dropped before the encoder since the previous encoded frame
+    uint32_t dropped;
+  };
+
   virtual ~EncodePipeline();
 
-  virtual void PushFrame(uint32_t frame_index, bool idr) = 0;
-  bool GetEncoded(std::vector<uint8_t> & out);
+  // Blocks while in_flight frames are already waiting for the encoder. The input image is not
+  // read anymore once it returns. Throws the errors of the encode thread.
+  // The frame is useless after deadline.
+  void Submit(uint32_t frame_index, bool idr, uint64_t tag,
+              std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+  // Oldest encoded frame, waiting up to timeout for one. out.data is reused.
+  bool GetEncoded(EncodedFrame & out, std::chrono::milliseconds timeout);
 
+  // Applied by the encode thread before the next frame
   void SetBitrate(int64_t bitrate);
-  static std::unique_ptr<EncodePipeline> Create(std::vector<VkFrame> &input_frames, VkFrameCtx &vk_frame_ctx);
+  static std::unique_ptr<EncodePipeline> Create(std::vector<VkFrame> &input_frames, VkFrameCtx &vk_frame_ctx, uint32_t in_flight);
 protected:
+  // Converts input image frame_index into the frame of slot, for the encoder. The frame of a slot
+  // is not reused before it has been sent to the encoder.
+  virtual AVFrame *Convert(uint32_t frame_index, uint32_t slot) = 0;
+  void ApplyBitrate(int64_t bitrate);
+  // Must be called first by the destructor of the pipelines, the encode thread uses their frames
+  void StopEncodeThread();
+
   AVCodecContext *encoder_ctx = nullptr; //shall be initialized by child class
+private:
+  struct Pending
+  {
+    uint32_t slot;
+    AVFrame *frame;
+    uint64_t tag;
+    uint32_t frame_index;
+    bool idr;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point submit_time;
+    std::chrono::steady_clock::time_point convert_start;
+    std::chrono::steady_clock::time_point convert_end;
+    std::chrono::steady_clock::time_point encode_start;
+  };
+
+  void StartEncodeThread(uint32_t in_flight);
+  void EncodeLoop();
+  void ReceivePackets();
+
+  std::thread encode_thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping = false;
+  std::exception_ptr error;
+  int64_t pending_bitrate = 0;
+  uint32_t dropped_late = 0;
+
+  std::vector<uint32_t> free_slots;
+  std::deque<Pending> to_encode;
+  // sent to the encoder, waiting for their packet
+  std::deque<Pending> encoding;
+  std::deque<EncodedFrame> encoded;
+  std::vector<std::vector<uint8_t>> spare_buffers;
 };
 
 }
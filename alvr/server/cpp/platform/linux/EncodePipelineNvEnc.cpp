@@ -1,8 +1,10 @@
 #include "EncodePipelineNvEnc.h"
 #include "ALVR-common/packet_types.h"
+#include "EncoderProfile.h"
 #include "alvr_server/Settings.h"
 #include "ffmpeg_helper.h"
 #include <chrono>
+#include <climits>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -18,6 +20,8 @@ const char *encoder(ALVR_CODEC codec) {
         return "h264_nvenc";
     case ALVR_CODEC_H265:
         return "hevc_nvenc";
+    case ALVR_CODEC_AV1:
+        return "av1_nvenc";
     }
     throw std::runtime_error("invalid codec " + std::to_string(codec));
 }
@@ -56,6 +60,12 @@ alvr::EncodePipelineNvEnc::EncodePipelineNvEnc(std::vector<VkFrame> &input_frame
         AVUTIL.av_opt_set(encoder_ctx, "preset", "llhq", 0);
         AVUTIL.av_opt_set(encoder_ctx, "zerolatency", "1", 0);
         break;
+    case ALVR_CODEC_AV1:
+        // av1_nvenc only knows the SDK 10+ presets, llhq maps to p4 with low latency tuning
+        AVUTIL.av_opt_set(encoder_ctx, "preset", "p4", 0);
+        AVUTIL.av_opt_set(encoder_ctx, "tune", "ll", 0);
+        AVUTIL.av_opt_set(encoder_ctx, "zerolatency", "1", 0);
+        break;
     }
 
     /**
@@ -76,34 +86,44 @@ alvr::EncodePipelineNvEnc::EncodePipelineNvEnc(std::vector<VkFrame> &input_frame
     encoder_ctx->framerate = AVRational{settings.m_refreshRate, 1};
     encoder_ctx->sample_aspect_ratio = AVRational{1, 1};
     encoder_ctx->max_b_frames = 0;
-    encoder_ctx->gop_size = 30;
-    encoder_ctx->bit_rate = settings.mEncodeBitrateMBs * 1000 * 1000;
-
-    err = AVCODEC.avcodec_open2(encoder_ctx, codec, NULL);
+    // INT_MAX frames last for months at any refresh rate
+    encoder_ctx->gop_size = settings.m_infiniteGop ? INT_MAX : 30;
+    // keyframes requested by IDRScheduler must be IDR, not just I-frames, for the client to recover
+    AVUTIL.av_opt_set(encoder_ctx, "forced-idr", "1", AV_OPT_SEARCH_CHILDREN);
+    ApplyBitrate(settings.mEncodeBitrateMBs * 1000 * 1000);
+
+    AVDictionary *opt = NULL;
+    apply_encoder_profile(encoder_name, &opt);
+    err = AVCODEC.avcodec_open2(encoder_ctx, codec, &opt);
+    AVUTIL.av_dict_free(&opt);
     if (err < 0) {
         throw alvr::AvException("Cannot open video encoder codec:", err);
     }
-
-    hw_frame = AVUTIL.av_frame_alloc();
 }
 
 alvr::EncodePipelineNvEnc::~EncodePipelineNvEnc() {
+    StopEncodeThread();
     AVUTIL.av_buffer_unref(&hw_ctx);
-    AVUTIL.av_frame_free(&hw_frame);
+    for (auto &hw_frame : hw_frames) {
+        AVUTIL.av_frame_free(&hw_frame);
+    }
 }
 
-void alvr::EncodePipelineNvEnc::PushFrame(uint32_t frame_index, bool idr) {
+AVFrame *alvr::EncodePipelineNvEnc::Convert(uint32_t frame_index, uint32_t slot) {
     assert(frame_index < vk_frames.size());
 
+    if (slot >= hw_frames.size()) {
+        hw_frames.resize(slot + 1, nullptr);
+    }
+    AVFrame *&hw_frame = hw_frames[slot];
+    if (not hw_frame) {
+        hw_frame = AVUTIL.av_frame_alloc();
+    }
+
     int err = AVUTIL.av_hwframe_transfer_data(hw_frame, vk_frames[frame_index].get(), 0);
     if (err) {
         throw alvr::AvException("av_hwframe_transfer_data", err);
     }
 
-    hw_frame->pict_type = idr ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
-    hw_frame->pts = std::chrono::steady_clock::now().time_since_epoch().count();
-
-    if ((err = AVCODEC.avcodec_send_frame(encoder_ctx, hw_frame)) < 0) {
-        throw alvr::AvException("avcodec_send_frame failed:", err);
-    }
+    return hw_frame;
 }
@@ -16,11 +16,13 @@ public:
   ~EncodePipelineNvEnc();
   EncodePipelineNvEnc(std::vector<VkFrame> &input_frames, VkFrameCtx& vk_frame_ctx);
 
-  void PushFrame(uint32_t frame_index, bool idr) override;
+protected:
+  AVFrame *Convert(uint32_t frame_index, uint32_t slot) override;
 
 private:
   AVBufferRef *hw_ctx = nullptr;
   std::vector<std::unique_ptr<AVFrame, std::function<void(AVFrame*)>>> vk_frames;
-  AVFrame * hw_frame = nullptr;
+  // one per slot, allocated on first use
+  std::vector<AVFrame *> hw_frames;
 };
 }
@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <chrono>
+#include <climits>
 
+#include "EncoderProfile.h"
 #include "alvr_server/Settings.h"
 #include "ffmpeg_helper.h"
 
@@ -23,6 +25,11 @@ const char * encoder(ALVR_CODEC codec)
       return "libx264";
     case ALVR_CODEC_H265:
       return "libx265";
+    case ALVR_CODEC_AV1:
+      // SVT-AV1 is much faster at the same quality, libaom is more widely available
+      if (AVCODEC.avcodec_find_encoder_by_name("libsvtav1"))
+        return "libsvtav1";
+      return "libaom-av1";
   }
   throw std::runtime_error("invalid codec " + std::to_string(codec));
 }
@@ -60,16 +67,42 @@ alvr::EncodePipelineSW::EncodePipelineSW(std::vector<VkFrame>& input_frames, VkF
       encoder_ctx->profile = FF_PROFILE_H264_HIGH;
       AVUTIL.av_dict_set(&opt, "preset", "ultrafast", 0);
       AVUTIL.av_dict_set(&opt, "tune", "zerolatency", 0);
-      encoder_ctx->gop_size = 72;
+      if (settings.m_infiniteGop)
+        AVUTIL.av_dict_set(&opt, "x264-params", "keyint=infinite", 0);
+      else
+        encoder_ctx->gop_size = 72;
       break;
     case ALVR_CODEC_H265:
       encoder_ctx->profile = FF_PROFILE_HEVC_MAIN;
       AVUTIL.av_dict_set(&opt, "preset", "ultrafast", 0);
       AVUTIL.av_dict_set(&opt, "tune", "zerolatency", 0);
-      encoder_ctx->gop_size = 72;
+      if (settings.m_infiniteGop)
+        AVUTIL.av_dict_set(&opt, "x265-params", "keyint=-1", 0);
+      else
+        encoder_ctx->gop_size = 72;
+      break;
+    case ALVR_CODEC_AV1:
+      encoder_ctx->profile = FF_PROFILE_AV1_MAIN;
+      if (std::string(encoder_name) == "libsvtav1")
+      {
+        // fastest preset, low delay prediction structure and no lookahead
+        AVUTIL.av_dict_set(&opt, "preset", "12", 0);
+        AVUTIL.av_dict_set(&opt, "svtav1-params", "pred-struct=1:lookahead=0:fast-decode=1", 0);
+      }
+      else
+      {
+        AVUTIL.av_dict_set(&opt, "usage", "realtime", 0);
+        AVUTIL.av_dict_set(&opt, "cpu-used", "8", 0);
+        AVUTIL.av_dict_set(&opt, "lag-in-frames", "0", 0);
+        AVUTIL.av_dict_set(&opt, "row-mt", "1", 0);
+      }
+      // INT_MAX frames last for months at any refresh rate
+      encoder_ctx->gop_size = settings.m_infiniteGop ? INT_MAX : 72;
       break;
   }
-
+  // keyframes requested by IDRScheduler must be IDR, not just I-frames, for the client to recover
+  AVUTIL.av_dict_set(&opt, "forced-idr", "1", 0);
+  apply_encoder_profile(encoder_name, &opt);
 
   encoder_ctx->width = settings.m_renderWidth;
   encoder_ctx->height = settings.m_renderHeight;
@@ -78,7 +111,7 @@ alvr::EncodePipelineSW::EncodePipelineSW(std::vector<VkFrame>& input_frames, VkF
   encoder_ctx->sample_aspect_ratio = AVRational{1, 1};
   encoder_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
   encoder_ctx->max_b_frames = 0;
-  encoder_ctx->bit_rate = settings.mEncodeBitrateMBs * 1000 * 1000;
+  ApplyBitrate(settings.mEncodeBitrateMBs * 1000 * 1000);
 
   int err = AVCODEC.avcodec_open2(encoder_ctx, codec, &opt);
   if (err < 0) {
@@ -86,11 +119,6 @@ alvr::EncodePipelineSW::EncodePipelineSW(std::vector<VkFrame>& input_frames, VkF
   }
 
   transferred_frame = AVUTIL.av_frame_alloc();
-  encoder_frame = AVUTIL.av_frame_alloc();
-  encoder_frame->width = settings.m_renderWidth;
-  encoder_frame->height = settings.m_renderHeight;
-  encoder_frame->format = encoder_ctx->pix_fmt;
-  AVUTIL.av_frame_get_buffer(encoder_frame, 0);
 
   scaler_ctx = SWSCALE.sws_getContext(
           vk_frames[0]->width, vk_frames[0]->height, ((AVHWFramesContext*)vk_frames[0]->hw_frames_ctx->data)->sw_format,
@@ -101,14 +129,28 @@ alvr::EncodePipelineSW::EncodePipelineSW(std::vector<VkFrame>& input_frames, VkF
 
 alvr::EncodePipelineSW::~EncodePipelineSW()
 {
+  StopEncodeThread();
   for (auto &vk_frame: vk_frames)
     AVUTIL.av_frame_free(&vk_frame);
   AVUTIL.av_frame_free(&transferred_frame);
-  AVUTIL.av_frame_free(&encoder_frame);
+  for (auto &encoder_frame: encoder_frames)
+    AVUTIL.av_frame_free(&encoder_frame);
 }
 
-void alvr::EncodePipelineSW::PushFrame(uint32_t frame_index, bool idr)
+AVFrame *alvr::EncodePipelineSW::Convert(uint32_t frame_index, uint32_t slot)
 {
+  if (slot >= encoder_frames.size())
+    encoder_frames.resize(slot + 1, nullptr);
+  AVFrame *&encoder_frame = encoder_frames[slot];
+  if (not encoder_frame)
+  {
+    encoder_frame = AVUTIL.av_frame_alloc();
+    encoder_frame->width = encoder_ctx->width;
+    encoder_frame->height = encoder_ctx->height;
+    encoder_frame->format = encoder_ctx->pix_fmt;
+    AVUTIL.av_frame_get_buffer(encoder_frame, 0);
+  }
+
   int err = AVUTIL.av_hwframe_transfer_data(transferred_frame, vk_frames[frame_index], 0);
   if (err)
     throw alvr::AvException("av_hwframe_transfer_data", err);
@@ -118,10 +160,5 @@ void alvr::EncodePipelineSW::PushFrame(uint32_t frame_index, bool idr)
   if (err == 0)
     throw alvr::AvException("sws_scale failed:", err);
 
-  encoder_frame->pict_type = idr ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
-  encoder_frame->pts = std::chrono::steady_clock::now().time_since_epoch().count();
-
-  if ((err = AVCODEC.avcodec_send_frame(encoder_ctx, encoder_frame)) < 0) {
-    throw alvr::AvException("avcodec_send_frame failed:", err);
-  }
+  return encoder_frame;
 }
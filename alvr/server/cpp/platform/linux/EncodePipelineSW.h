@@ -14,12 +14,14 @@ public:
   ~EncodePipelineSW();
   EncodePipelineSW(std::vector<VkFrame> &input_frames, VkFrameCtx& vk_frame_ctx);
 
-  void PushFrame(uint32_t frame_index, bool idr) override;
+protected:
+  AVFrame *Convert(uint32_t frame_index, uint32_t slot) override;
 
 private:
   std::vector<AVFrame *> vk_frames;
   AVFrame * transferred_frame = nullptr;
-  AVFrame * encoder_frame = nullptr;
+  // one per slot, allocated on first use
+  std::vector<AVFrame *> encoder_frames;
   SwsContext *scaler_ctx = nullptr;
 };
 }
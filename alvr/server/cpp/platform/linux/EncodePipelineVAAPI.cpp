@@ -1,8 +1,10 @@
 #include "EncodePipelineVAAPI.h"
 #include "ALVR-common/packet_types.h"
+#include "EncoderProfile.h"
 #include "ffmpeg_helper.h"
 #include "alvr_server/Settings.h"
 #include <chrono>
+#include <climits>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -24,6 +26,8 @@ const char * encoder(ALVR_CODEC codec)
       return "h264_vaapi";
     case ALVR_CODEC_H265:
       return "hevc_vaapi";
+    case ALVR_CODEC_AV1:
+      return "av1_vaapi";
   }
   throw std::runtime_error("invalid codec " + std::to_string(codec));
 }
@@ -136,6 +140,10 @@ alvr::EncodePipelineVAAPI::EncodePipelineVAAPI(std::vector<VkFrame>& input_frame
       encoder_ctx->profile = FF_PROFILE_HEVC_MAIN;
       AVUTIL.av_opt_set(encoder_ctx, "rc_mode", "2", 0);
       break;
+    case ALVR_CODEC_AV1:
+      encoder_ctx->profile = FF_PROFILE_AV1_MAIN;
+      AVUTIL.av_opt_set(encoder_ctx, "rc_mode", "2", 0);
+      break;
   }
 
   encoder_ctx->width = settings.m_renderWidth;
@@ -145,11 +153,18 @@ alvr::EncodePipelineVAAPI::EncodePipelineVAAPI(std::vector<VkFrame>& input_frame
   encoder_ctx->sample_aspect_ratio = AVRational{1, 1};
   encoder_ctx->pix_fmt = AV_PIX_FMT_VAAPI;
   encoder_ctx->max_b_frames = 0;
-  encoder_ctx->bit_rate = settings.mEncodeBitrateMBs * 1000 * 1000;
+  ApplyBitrate(settings.mEncodeBitrateMBs * 1000 * 1000);
+  // Forced I-frames are always IDR with VAAPI. INT_MAX frames last for months at any refresh
+  // rate.
+  if (settings.m_infiniteGop)
+    encoder_ctx->gop_size = INT_MAX;
 
   set_hwframe_ctx(encoder_ctx, hw_ctx);
 
-  err = AVCODEC.avcodec_open2(encoder_ctx, codec, NULL);
+  AVDictionary *opt = NULL;
+  apply_encoder_profile(encoder_name, &opt);
+  err = AVCODEC.avcodec_open2(encoder_ctx, codec, &opt);
+  AVUTIL.av_dict_free(&opt);
   if (err < 0) {
     throw alvr::AvException("Cannot open video encoder codec:", err);
   }
@@ -209,6 +224,11 @@ alvr::EncodePipelineVAAPI::EncodePipelineVAAPI(std::vector<VkFrame>& input_frame
 
 alvr::EncodePipelineVAAPI::~EncodePipelineVAAPI()
 {
+  StopEncodeThread();
+  for (auto frame: encoder_frames)
+  {
+    AVUTIL.av_frame_free(&frame);
+  }
   AVFILTER.avfilter_graph_free(&filter_graph);
   for (auto frame: mapped_frames)
   {
@@ -217,10 +237,17 @@ alvr::EncodePipelineVAAPI::~EncodePipelineVAAPI()
   AVUTIL.av_buffer_unref(&hw_ctx);
 }
 
-void alvr::EncodePipelineVAAPI::PushFrame(uint32_t frame_index, bool idr)
+AVFrame *alvr::EncodePipelineVAAPI::Convert(uint32_t frame_index, uint32_t slot)
 {
   assert(frame_index < mapped_frames.size());
-  AVFrame *encoder_frame = AVUTIL.av_frame_alloc();
+  if (slot >= encoder_frames.size())
+    encoder_frames.resize(slot + 1, nullptr);
+  AVFrame *&encoder_frame = encoder_frames[slot];
+  if (encoder_frame)
+    AVUTIL.av_frame_unref(encoder_frame);
+  else
+    encoder_frame = AVUTIL.av_frame_alloc();
+
   int err = AVFILTER.av_buffersrc_add_frame_flags(filter_in, mapped_frames[frame_index], AV_BUFFERSRC_FLAG_PUSH | AV_BUFFERSRC_FLAG_KEEP_REF);
   if (err != 0)
   {
@@ -232,11 +259,5 @@ void alvr::EncodePipelineVAAPI::PushFrame(uint32_t frame_index, bool idr)
     throw alvr::AvException("av_buffersink_get_frame failed", err);
   }
 
-  encoder_frame->pict_type = idr ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
-  encoder_frame->pts = std::chrono::steady_clock::now().time_since_epoch().count();
-
-  if ((err = AVCODEC.avcodec_send_frame(encoder_ctx, encoder_frame)) < 0) {
-    throw alvr::AvException("avcodec_send_frame failed: ", err);
-  }
-  AVUTIL.av_frame_unref(encoder_frame);
+  return encoder_frame;
 }
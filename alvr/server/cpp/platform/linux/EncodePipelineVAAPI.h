@@ -17,11 +17,14 @@ public:
   ~EncodePipelineVAAPI();
   EncodePipelineVAAPI(std::vector<VkFrame> &input_frames, VkFrameCtx& vk_frame_ctx);
 
-  void PushFrame(uint32_t frame_index, bool idr) override;
+protected:
+  AVFrame *Convert(uint32_t frame_index, uint32_t slot) override;
 
 private:
   AVBufferRef *hw_ctx = nullptr;
   std::vector<AVFrame *> mapped_frames;
+  // one per slot, holding the output of the filter until the slot is reused
+  std::vector<AVFrame *> encoder_frames;
   AVFilterGraph *filter_graph = nullptr;
   AVFilterContext *filter_in = nullptr;
   AVFilterContext *filter_out = nullptr;
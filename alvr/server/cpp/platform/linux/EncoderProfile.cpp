@@ -0,0 +1,118 @@
+#include "EncoderProfile.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "alvr_server/Logger.h"
+#include "alvr_server/Settings.h"
+#include "alvr_server/bindings.h"
+#include "ffmpeg_helper.h"
+#define PICOJSON_USE_INT64
+#include "alvr_server/include/picojson.h"
+
+extern "C" {
+#include <libavutil/dict.h>
+}
+
+std::string alvr::EncoderProfile::path()
+{
+  return (std::filesystem::path(g_sessionPath).parent_path() / "encoder_profile.json").string();
+}
+
+std::map<std::string, alvr::EncoderProfile> alvr::EncoderProfile::load_all()
+{
+  std::map<std::string, EncoderProfile> profiles;
+
+  std::ifstream file(path());
+  if (not file)
+    return profiles;
+
+  picojson::value root;
+  std::string err = picojson::parse(root, file);
+  if (not err.empty() or not root.is<picojson::object>())
+  {
+    Warn("Invalid encoder profile %s: %s\n", path().c_str(), err.c_str());
+    return profiles;
+  }
+
+  for (const auto & [encoder, value]: root.get<picojson::object>())
+  {
+    if (not value.is<picojson::object>())
+      continue;
+    auto number = [&](const char * key) {
+      auto & v = value.get(key);
+      return v.is<double>() ? v.get<double>() : 0.;
+    };
+    EncoderProfile profile;
+    profile.width = number("width");
+    profile.height = number("height");
+    profile.refresh_rate = number("refresh_rate");
+    profile.encode_ms_p50 = number("encode_ms_p50");
+    profile.encode_ms_p95 = number("encode_ms_p95");
+    profile.encode_ms_p99 = number("encode_ms_p99");
+    profile.bitrate_mbs = number("bitrate_mbs");
+    profile.psnr = number("psnr");
+    profile.ssim = number("ssim");
+    auto & options = value.get("options");
+    if (options.is<picojson::object>())
+    {
+      for (const auto & [key, option]: options.get<picojson::object>())
+        profile.options[key] = option.to_str();
+    }
+    profiles[encoder] = profile;
+  }
+  return profiles;
+}
+
+void alvr::EncoderProfile::save_all(const std::map<std::string, EncoderProfile> & profiles)
+{
+  picojson::object root;
+  for (const auto & [encoder, profile]: profiles)
+  {
+    picojson::object options;
+    for (const auto & [key, option]: profile.options)
+      options[key] = picojson::value(option);
+
+    picojson::object value;
+    value["width"] = picojson::value(int64_t(profile.width));
+    value["height"] = picojson::value(int64_t(profile.height));
+    value["refresh_rate"] = picojson::value(int64_t(profile.refresh_rate));
+    value["options"] = picojson::value(options);
+    value["encode_ms_p50"] = picojson::value(profile.encode_ms_p50);
+    value["encode_ms_p95"] = picojson::value(profile.encode_ms_p95);
+    value["encode_ms_p99"] = picojson::value(profile.encode_ms_p99);
+    value["bitrate_mbs"] = picojson::value(profile.bitrate_mbs);
+    value["psnr"] = picojson::value(profile.psnr);
+    value["ssim"] = picojson::value(profile.ssim);
+    root[encoder] = picojson::value(value);
+  }
+
+  std::ofstream file(path());
+  file << picojson::value(root).serialize(true);
+  if (not file)
+    throw std::runtime_error("failed to write " + path());
+}
+
+void alvr::apply_encoder_profile(const std::string & encoder, AVDictionary **opt)
+{
+  auto profiles = EncoderProfile::load_all();
+  auto it = profiles.find(encoder);
+  if (it == profiles.end())
+    return;
+
+  const auto & profile = it->second;
+  const auto & settings = Settings::Instance();
+  if (profile.width != int(settings.m_renderWidth) or profile.height != int(settings.m_renderHeight)
+      or profile.refresh_rate != settings.m_refreshRate)
+  {
+    Info("Encoder profile of %s was tuned for %dx%d@%dHz, not used\n",
+        encoder.c_str(), profile.width, profile.height, profile.refresh_rate);
+    return;
+  }
+
+  for (const auto & [key, value]: profile.options)
+  {
+    AVUTIL.av_dict_set(opt, key.c_str(), value.c_str(), 0);
+    Info("Encoder profile of %s: %s=%s\n", encoder.c_str(), key.c_str(), value.c_str());
+  }
+}
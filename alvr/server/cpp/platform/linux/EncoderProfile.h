@@ -0,0 +1,39 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+extern "C" struct AVDictionary;
+
+namespace alvr
+{
+
+/* Encoder options measured as the best ones for this machine by the encoder tuner, saved next to
+ * the session, per encoder name. A profile is only valid for the resolution and refresh rate it
+ * was measured with.
+ */
+struct EncoderProfile
+{
+  int width = 0;
+  int height = 0;
+  int refresh_rate = 0;
+  std::map<std::string, std::string> options;
+
+  // measured with the options
+  double encode_ms_p50 = 0;
+  double encode_ms_p95 = 0;
+  double encode_ms_p99 = 0;
+  double bitrate_mbs = 0;
+  double psnr = 0;
+  double ssim = 0;
+
+  static std::string path();
+  static std::map<std::string, EncoderProfile> load_all();
+  static void save_all(const std::map<std::string, EncoderProfile> & profiles);
+};
+
+// Adds the tuned options of encoder to opt, over the ones already set, if the profile matches the
+// current settings.
+void apply_encoder_profile(const std::string & encoder, AVDictionary **opt);
+
+}
@@ -0,0 +1,662 @@
+#include "EncoderTuner.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ALVR-common/packet_types.h"
+#include "EncoderProfile.h"
+#include "alvr_server/Logger.h"
+#include "alvr_server/Settings.h"
+#include "ffmpeg_helper.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+namespace
+{
+
+typedef std::map<std::string, std::string> Options;
+const std::vector<Options> defaults = {Options()};
+
+// measured frames per candidate and bitrate, after the warmup
+const int measured_frames = 90;
+const int warmup_frames = 10;
+// generated once, played back and forth
+const int scene_frames = 16;
+// a candidate that is that much over budget after a few frames is not worth finishing
+const int early_frames = 20;
+const double early_abort_factor = 4;
+
+uint32_t hash(uint32_t x, uint32_t y)
+{
+  uint32_t h = x * 0x8da6b343 ^ y * 0xd8163841;
+  h ^= h >> 15;
+  h *= 0x2c1b3c6d;
+  h ^= h >> 12;
+  return h;
+}
+
+/* Frames of the synthetic sequence, in YUV420P. Each eye sees a room through a round lens mask:
+ * smooth sky and walls with a detailed texture and a tiled floor, with the head turning at 40°/s
+ * and a controller moving in front of it. The right eye is shifted by the disparity.
+ */
+class SyntheticScene
+{
+public:
+  SyntheticScene(int width, int height, int refresh_rate)
+  {
+    const int eye_width = width / 2;
+    // ~100° of horizontal field of view per eye
+    const double pan_per_frame = 40. / refresh_rate * eye_width / 100.;
+    for (int i = 0; i < scene_frames; ++i)
+    {
+      AVFrame *frame = AVUTIL.av_frame_alloc();
+      frame->width = width;
+      frame->height = height;
+      frame->format = AV_PIX_FMT_YUV420P;
+      int err = AVUTIL.av_frame_get_buffer(frame, 0);
+      if (err)
+        throw alvr::AvException("av_frame_get_buffer", err);
+      render(frame, i * pan_per_frame, 2 * M_PI * i / scene_frames);
+      frames.push_back(frame);
+    }
+  }
+
+  ~SyntheticScene()
+  {
+    for (auto &frame: frames)
+      AVUTIL.av_frame_free(&frame);
+  }
+
+  AVFrame *frame(int index)
+  {
+    int period = 2 * scene_frames - 2;
+    int i = index % period;
+    return frames[i < scene_frames ? i : period - i];
+  }
+
+private:
+  static void render(AVFrame *frame, double pan, double phase)
+  {
+    const int width = frame->width;
+    const int height = frame->height;
+    const int eye_width = width / 2;
+    const double radius = 0.45 * std::hypot(eye_width, height);
+    const int horizon = height * 11 / 20;
+    const double object_radius = eye_width / 20.;
+
+    for (int eye = 0; eye < 2; ++eye)
+    {
+      const int x0 = eye * eye_width;
+      const int disparity = eye ? -8 : 8;
+      const double cx = x0 + eye_width / 2.;
+      const double cy = height / 2.;
+      const double object_x = cx + eye_width / 4. * std::cos(phase) + disparity * 2;
+      const double object_y = cy + height / 6. * std::sin(phase);
+
+      for (int y = 0; y < height; ++y)
+      {
+        uint8_t *row = frame->data[0] + y * frame->linesize[0];
+        for (int x = x0; x < x0 + eye_width; ++x)
+        {
+          double d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+          if (d2 > radius * radius)
+          {
+            row[x] = 16;
+            continue;
+          }
+          int u = x - x0 + int(pan) + disparity;
+          double luma;
+          if ((x - object_x) * (x - object_x) + (y - object_y) * (y - object_y) < object_radius * object_radius)
+            luma = 220;
+          else if (y < height / 5)
+            luma = 190 - 40. * y / height;
+          else if (y < horizon)
+            luma = 100 + int(hash(u / 96, y / 96) % 80) + int(hash(u, y) % 16) - 8;
+          else
+            luma = ((u / 64 + (y - horizon) / 48) % 2 ? 140 : 90) + int(hash(u, y) % 8) - 4;
+          // lens falloff
+          row[x] = uint8_t(std::clamp(luma * (1 - 0.3 * d2 / (radius * radius)), 16., 235.));
+        }
+      }
+
+      for (int y = 0; y < height / 2; ++y)
+      {
+        uint8_t *row_u = frame->data[1] + y * frame->linesize[1];
+        uint8_t *row_v = frame->data[2] + y * frame->linesize[2];
+        for (int x = x0 / 2; x < (x0 + eye_width) / 2; ++x)
+        {
+          double d2 = (2 * x - cx) * (2 * x - cx) + (2 * y - cy) * (2 * y - cy);
+          int u = 2 * x - x0 + int(pan) + disparity;
+          bool masked = d2 > radius * radius;
+          row_u[x] = masked ? 128 : uint8_t(128 + 20 * std::sin(u / 200.));
+          row_v[x] = masked ? 128 : uint8_t(128 + 20 * std::cos(2 * y / 150.));
+        }
+      }
+    }
+  }
+
+  std::vector<AVFrame *> frames;
+};
+
+struct Backend
+{
+  const char *name;
+  std::string encoder;
+  Options base_options;
+  std::vector<Options> candidates;
+  bool vaapi = false;
+};
+
+std::vector<Options> combine(const std::vector<Options> &candidates, const std::string &key, const std::vector<std::string> &values)
+{
+  std::vector<Options> result;
+  for (const auto &candidate: candidates)
+  {
+    for (const auto &value: values)
+    {
+      auto options = candidate;
+      options[key] = value;
+      result.push_back(options);
+    }
+  }
+  return result;
+}
+
+std::vector<std::string> thread_counts()
+{
+  unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+  std::vector<std::string> result = {"auto"};
+  if (cores > 2)
+    result.push_back(std::to_string(cores / 2));
+  if (cores > 1)
+    result.push_back(std::to_string(cores));
+  return result;
+}
+
+// Same encoders as the pipelines, and options they set that are not tuned
+std::vector<Backend> backends(ALVR_CODEC codec)
+{
+  std::vector<Backend> result;
+
+  Backend vaapi{"VAAPI"};
+  vaapi.vaapi = true;
+  vaapi.base_options["rc_mode"] = "2";
+  vaapi.candidates = combine(defaults, "low_power", {"0", "1"});
+  switch (codec)
+  {
+    case ALVR_CODEC_H264:
+      vaapi.encoder = "h264_vaapi";
+      vaapi.candidates = combine(vaapi.candidates, "slices", {"1", "2", "4"});
+      break;
+    case ALVR_CODEC_H265:
+      vaapi.encoder = "hevc_vaapi";
+      vaapi.candidates = combine(vaapi.candidates, "slices", {"1", "2", "4"});
+      break;
+    case ALVR_CODEC_AV1:
+      vaapi.encoder = "av1_vaapi";
+      break;
+  }
+  result.push_back(vaapi);
+
+  Backend nvenc{"NvEnc"};
+  nvenc.base_options["zerolatency"] = "1";
+  switch (codec)
+  {
+    case ALVR_CODEC_H264:
+      nvenc.encoder = "h264_nvenc";
+      nvenc.candidates = combine(defaults, "preset", {"llhp", "llhq"});
+      break;
+    case ALVR_CODEC_H265:
+      nvenc.encoder = "hevc_nvenc";
+      nvenc.candidates = combine(defaults, "preset", {"llhp", "llhq"});
+      break;
+    case ALVR_CODEC_AV1:
+      nvenc.encoder = "av1_nvenc";
+      nvenc.base_options["tune"] = "ll";
+      nvenc.candidates = combine(defaults, "preset", {"p1", "p2", "p4"});
+      break;
+  }
+  result.push_back(nvenc);
+
+  Backend sw{"SW"};
+  sw.candidates = defaults;
+  switch (codec)
+  {
+    case ALVR_CODEC_H264:
+    case ALVR_CODEC_H265:
+      sw.encoder = codec == ALVR_CODEC_H264 ? "libx264" : "libx265";
+      sw.base_options["tune"] = "zerolatency";
+      sw.candidates = combine(sw.candidates, "preset", {"ultrafast", "superfast", "veryfast"});
+      sw.candidates = combine(sw.candidates, "slices", {"1", "4"});
+      break;
+    case ALVR_CODEC_AV1:
+      if (AVCODEC.avcodec_find_encoder_by_name("libsvtav1"))
+      {
+        sw.encoder = "libsvtav1";
+        sw.base_options["svtav1-params"] = "pred-struct=1:lookahead=0:fast-decode=1";
+        sw.candidates = combine(sw.candidates, "preset", {"12", "11", "10"});
+      }
+      else
+      {
+        sw.encoder = "libaom-av1";
+        sw.base_options["usage"] = "realtime";
+        sw.base_options["lag-in-frames"] = "0";
+        sw.base_options["row-mt"] = "1";
+        sw.candidates = combine(sw.candidates, "cpu-used", {"8", "7", "6"});
+      }
+      break;
+  }
+  sw.candidates = combine(sw.candidates, "threads", thread_counts());
+  result.push_back(sw);
+
+  return result;
+}
+
+struct Measurement
+{
+  double p50 = 0;
+  double p95 = 0;
+  double p99 = 0;
+  double bitrate_mbs = 0;
+  double psnr = 0;
+  double ssim = 0;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[size_t(p * (values.size() - 1))];
+}
+
+// Luma PSNR, and SSIM over 8x8 blocks
+std::pair<double, double> compare_luma(const AVFrame *a, const AVFrame *b)
+{
+  const int width = a->width;
+  const int height = a->height;
+
+  double squared_error = 0;
+  for (int y = 0; y < height; ++y)
+  {
+    const uint8_t *ra = a->data[0] + y * a->linesize[0];
+    const uint8_t *rb = b->data[0] + y * b->linesize[0];
+    for (int x = 0; x < width; ++x)
+    {
+      int d = ra[x] - rb[x];
+      squared_error += d * d;
+    }
+  }
+  double mse = squared_error / (double(width) * height);
+  double psnr = mse == 0 ? 100 : 10 * std::log10(255. * 255. / mse);
+
+  const double c1 = (0.01 * 255) * (0.01 * 255);
+  const double c2 = (0.03 * 255) * (0.03 * 255);
+  double ssim = 0;
+  int blocks = 0;
+  for (int by = 0; by + 8 <= height; by += 8)
+  {
+    for (int bx = 0; bx + 8 <= width; bx += 8)
+    {
+      double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+      for (int y = by; y < by + 8; ++y)
+      {
+        const uint8_t *ra = a->data[0] + y * a->linesize[0];
+        const uint8_t *rb = b->data[0] + y * b->linesize[0];
+        for (int x = bx; x < bx + 8; ++x)
+        {
+          sa += ra[x];
+          sb += rb[x];
+          saa += ra[x] * ra[x];
+          sbb += rb[x] * rb[x];
+          sab += ra[x] * rb[x];
+        }
+      }
+      double ma = sa / 64, mb = sb / 64;
+      double va = saa / 64 - ma * ma, vb = sbb / 64 - mb * mb, cov = sab / 64 - ma * mb;
+      ssim += (2 * ma * mb + c1) * (2 * cov + c2) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+      blocks++;
+    }
+  }
+  return {psnr, blocks ? ssim / blocks : 0};
+}
+
+class Candidate
+{
+public:
+  Candidate(const Backend &backend, const Options &options, int64_t bitrate, AVBufferRef *hw_device)
+  {
+    try {
+      init(backend, options, bitrate, hw_device);
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+  ~Candidate()
+  {
+    release();
+  }
+
+  std::optional<Measurement> run(SyntheticScene &scene, double budget_ms);
+
+private:
+  void init(const Backend &backend, const Options &options, int64_t bitrate, AVBufferRef *hw_device)
+  {
+    const auto &settings = Settings::Instance();
+
+    const AVCodec *codec = AVCODEC.avcodec_find_encoder_by_name(backend.encoder.c_str());
+    if (not codec)
+      throw std::runtime_error("Failed to find encoder " + backend.encoder);
+
+    encoder_ctx = AVCODEC.avcodec_alloc_context3(codec);
+    encoder_ctx->width = settings.m_renderWidth;
+    encoder_ctx->height = settings.m_renderHeight;
+    encoder_ctx->time_base = AVRational{1, settings.m_refreshRate};
+    encoder_ctx->framerate = AVRational{settings.m_refreshRate, 1};
+    encoder_ctx->sample_aspect_ratio = AVRational{1, 1};
+    encoder_ctx->max_b_frames = 0;
+    encoder_ctx->gop_size = settings.m_infiniteGop ? INT_MAX : 72;
+    encoder_ctx->bit_rate = bitrate;
+    if (settings.m_enableFrameSizeCap)
+    {
+      encoder_ctx->rc_max_rate = bitrate;
+      encoder_ctx->rc_buffer_size = bitrate / settings.m_refreshRate * settings.m_frameSizeCapIntervals;
+    }
+
+    if (backend.vaapi)
+    {
+      encoder_ctx->pix_fmt = AV_PIX_FMT_VAAPI;
+      AVBufferRef *hw_frames_ref = AVUTIL.av_hwframe_ctx_alloc(hw_device);
+      if (not hw_frames_ref)
+        throw std::runtime_error("Failed to create VAAPI frame context.");
+      auto frames_ctx = (AVHWFramesContext *)hw_frames_ref->data;
+      frames_ctx->format = AV_PIX_FMT_VAAPI;
+      frames_ctx->sw_format = AV_PIX_FMT_NV12;
+      frames_ctx->width = encoder_ctx->width;
+      frames_ctx->height = encoder_ctx->height;
+      frames_ctx->initial_pool_size = 3;
+      int err = AVUTIL.av_hwframe_ctx_init(hw_frames_ref);
+      if (err < 0)
+      {
+        AVUTIL.av_buffer_unref(&hw_frames_ref);
+        throw alvr::AvException("Failed to initialize VAAPI frame context:", err);
+      }
+      encoder_ctx->hw_frames_ctx = hw_frames_ref;
+
+      upload_frame = AVUTIL.av_frame_alloc();
+      upload_frame->width = encoder_ctx->width;
+      upload_frame->height = encoder_ctx->height;
+      upload_frame->format = AV_PIX_FMT_NV12;
+      AVUTIL.av_frame_get_buffer(upload_frame, 0);
+      hw_frame = AVUTIL.av_frame_alloc();
+      scaler_ctx = SWSCALE.sws_getContext(
+          encoder_ctx->width, encoder_ctx->height, AV_PIX_FMT_YUV420P,
+          encoder_ctx->width, encoder_ctx->height, AV_PIX_FMT_NV12,
+          SWS_POINT, NULL, NULL, NULL);
+    }
+    else
+    {
+      // NvEnc takes the software frames directly
+      encoder_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    }
+
+    AVDictionary *opt = NULL;
+    for (const auto &[key, value]: backend.base_options)
+      AVUTIL.av_dict_set(&opt, key.c_str(), value.c_str(), 0);
+    for (const auto &[key, value]: options)
+      AVUTIL.av_dict_set(&opt, key.c_str(), value.c_str(), 0);
+    int err = AVCODEC.avcodec_open2(encoder_ctx, codec, &opt);
+    AVUTIL.av_dict_free(&opt);
+    if (err < 0)
+      throw alvr::AvException("Cannot open video encoder codec:", err);
+
+    // quality is not measured when there is no decoder for the codec
+    const AVCodec *decoder = AVCODEC.avcodec_find_decoder(encoder_ctx->codec_id);
+    if (decoder)
+    {
+      decoder_ctx = AVCODEC.avcodec_alloc_context3(decoder);
+      if (AVCODEC.avcodec_open2(decoder_ctx, decoder, NULL) < 0)
+        AVCODEC.avcodec_free_context(&decoder_ctx);
+    }
+
+    packet = AVCODEC.av_packet_alloc();
+    decoded = AVUTIL.av_frame_alloc();
+  }
+
+  void release()
+  {
+    AVCODEC.av_packet_free(&packet);
+    AVUTIL.av_frame_free(&decoded);
+    AVUTIL.av_frame_free(&upload_frame);
+    AVUTIL.av_frame_free(&hw_frame);
+    AVCODEC.avcodec_free_context(&decoder_ctx);
+    AVCODEC.avcodec_free_context(&encoder_ctx);
+    SWSCALE.sws_freeContext(scaler_ctx);
+    scaler_ctx = nullptr;
+  }
+
+  void receive(SyntheticScene &scene);
+
+  AVCodecContext *encoder_ctx = nullptr;
+  AVCodecContext *decoder_ctx = nullptr;
+  AVPacket *packet = nullptr;
+  AVFrame *decoded = nullptr;
+  // VAAPI input
+  AVFrame *upload_frame = nullptr;
+  AVFrame *hw_frame = nullptr;
+  SwsContext *scaler_ctx = nullptr;
+
+  std::deque<std::pair<int, std::chrono::steady_clock::time_point>> in_flight;
+  std::vector<double> latencies_ms;
+  size_t bytes = 0;
+  double psnr_sum = 0;
+  double ssim_sum = 0;
+  int compared_frames = 0;
+};
+
+std::optional<Measurement> Candidate::run(SyntheticScene &scene, double budget_ms)
+{
+  const double frame_s = 1. / Settings::Instance().m_refreshRate;
+  for (int i = 0; i < warmup_frames + measured_frames; ++i)
+  {
+    AVFrame *frame = scene.frame(i);
+    if (upload_frame)
+    {
+      SWSCALE.sws_scale(scaler_ctx, frame->data, frame->linesize, 0, frame->height,
+          upload_frame->data, upload_frame->linesize);
+      AVUTIL.av_frame_unref(hw_frame);
+      int err = AVUTIL.av_hwframe_get_buffer(encoder_ctx->hw_frames_ctx, hw_frame, 0);
+      if (err < 0)
+        throw alvr::AvException("av_hwframe_get_buffer", err);
+      err = AVUTIL.av_hwframe_transfer_data(hw_frame, upload_frame, 0);
+      if (err < 0)
+        throw alvr::AvException("av_hwframe_transfer_data", err);
+      frame = hw_frame;
+    }
+    frame->pts = i;
+
+    in_flight.push_back({i, std::chrono::steady_clock::now()});
+    int err = AVCODEC.avcodec_send_frame(encoder_ctx, frame);
+    if (err < 0)
+      throw alvr::AvException("avcodec_send_frame failed:", err);
+    receive(scene);
+
+    if (latencies_ms.size() >= early_frames and percentile(latencies_ms, 0.5) > early_abort_factor * budget_ms)
+      break;
+  }
+  if (latencies_ms.empty())
+    return std::nullopt;
+
+  Measurement m;
+  m.p50 = percentile(latencies_ms, 0.5);
+  m.p95 = percentile(latencies_ms, 0.95);
+  m.p99 = percentile(latencies_ms, 0.99);
+  m.bitrate_mbs = bytes * 8. / (latencies_ms.size() * frame_s) / 1e6;
+  if (compared_frames)
+  {
+    m.psnr = psnr_sum / compared_frames;
+    m.ssim = ssim_sum / compared_frames;
+  }
+  return m;
+}
+
+void Candidate::receive(SyntheticScene &scene)
+{
+  while (true)
+  {
+    int err = AVCODEC.avcodec_receive_packet(encoder_ctx, packet);
+    if (err == AVERROR(EAGAIN))
+      return;
+    if (err < 0)
+      throw alvr::AvException("failed to encode", err);
+    auto now = std::chrono::steady_clock::now();
+
+    // no B-frames, packets come out in submission order
+    auto [index, send_time] = in_flight.front();
+    in_flight.pop_front();
+    if (index < warmup_frames)
+      continue;
+
+    latencies_ms.push_back(std::chrono::duration<double, std::milli>(now - send_time).count());
+    bytes += packet->size;
+
+    if (decoder_ctx and AVCODEC.avcodec_send_packet(decoder_ctx, packet) == 0)
+    {
+      while (AVCODEC.avcodec_receive_frame(decoder_ctx, decoded) == 0)
+      {
+        auto [psnr, ssim] = compare_luma(scene.frame(index), decoded);
+        psnr_sum += psnr;
+        ssim_sum += ssim;
+        compared_frames++;
+      }
+    }
+  }
+}
+
+
+std::string describe(const Options &options)
+{
+  std::string result;
+  for (const auto &[key, value]: options)
+    result += (result.empty() ? "" : " ") + key + "=" + value;
+  return result.empty() ? "defaults" : result;
+}
+
+}
+
+bool alvr::tune_encoders()
+{
+  const auto &settings = Settings::Instance();
+  const double budget_ms = 1000. / settings.m_refreshRate / 2;
+  const std::vector<int64_t> bitrates = {
+    int64_t(settings.mEncodeBitrateMBs) * 1000 * 1000 / 2,
+    int64_t(settings.mEncodeBitrateMBs) * 1000 * 1000,
+  };
+
+  Info("Encoder tuning at %dx%d@%dHz, budget %.2fms\n",
+      settings.m_renderWidth, settings.m_renderHeight, settings.m_refreshRate, budget_ms);
+  SyntheticScene scene(settings.m_renderWidth, settings.m_renderHeight, settings.m_refreshRate);
+
+  AVBufferRef *vaapi_device = nullptr;
+  if (AVUTIL.av_hwdevice_ctx_create(&vaapi_device, AV_HWDEVICE_TYPE_VAAPI, NULL, NULL, 0) < 0)
+    vaapi_device = nullptr;
+
+  auto profiles = EncoderProfile::load_all();
+  bool tuned = false;
+  for (const auto &backend: backends(ALVR_CODEC(settings.m_codec)))
+  {
+    if (backend.vaapi and not vaapi_device)
+    {
+      Info("Encoder tuning: no VAAPI device\n");
+      continue;
+    }
+
+    std::optional<EncoderProfile> best;
+    bool best_fits = false;
+    for (const auto &options: backend.candidates)
+    {
+      // the worst latency and the mean quality over the bitrates
+      EncoderProfile profile;
+      bool complete = true;
+      for (int64_t bitrate: bitrates)
+      {
+        std::optional<Measurement> m;
+        try {
+          Candidate candidate(backend, options, bitrate, vaapi_device);
+          m = candidate.run(scene, budget_ms);
+        } catch (std::exception &e) {
+          Info("Encoder tuning: %s %s failed: %s\n", backend.encoder.c_str(), describe(options).c_str(), e.what());
+        }
+        if (not m)
+        {
+          complete = false;
+          break;
+        }
+        Info("Encoder tuning: %s %s at %.1fMbps: p50 %.2fms p95 %.2fms p99 %.2fms, %.1fMbps, PSNR %.2fdB SSIM %.4f\n",
+            backend.encoder.c_str(), describe(options).c_str(), bitrate / 1e6,
+            m->p50, m->p95, m->p99, m->bitrate_mbs, m->psnr, m->ssim);
+        profile.encode_ms_p50 = std::max(profile.encode_ms_p50, m->p50);
+        profile.encode_ms_p95 = std::max(profile.encode_ms_p95, m->p95);
+        profile.encode_ms_p99 = std::max(profile.encode_ms_p99, m->p99);
+        // reported at the configured bitrate, the last one
+        profile.bitrate_mbs = m->bitrate_mbs;
+        profile.psnr += m->psnr / bitrates.size();
+        profile.ssim += m->ssim / bitrates.size();
+      }
+      if (not complete)
+        continue;
+
+      // The best quality among the options that fit the budget, or the fastest ones if none fit
+      bool fits = profile.encode_ms_p95 <= budget_ms;
+      bool better = not best
+                    or (fits and not best_fits)
+                    or (fits and profile.ssim > best->ssim)
+                    or (not fits and not best_fits and profile.encode_ms_p95 < best->encode_ms_p95);
+      if (better)
+      {
+        profile.width = settings.m_renderWidth;
+        profile.height = settings.m_renderHeight;
+        profile.refresh_rate = settings.m_refreshRate;
+        profile.options = options;
+        best = profile;
+        best_fits = fits;
+      }
+    }
+
+    if (not best)
+    {
+      Info("Encoder tuning: %s encoder %s not available\n", backend.name, backend.encoder.c_str());
+      continue;
+    }
+    if (not best_fits)
+      Warn("Encoder tuning: %s does not encode within %.2fms, using its fastest options\n", backend.encoder.c_str(), budget_ms);
+    Info("Encoder tuning: %s: %s\n", backend.encoder.c_str(), describe(best->options).c_str());
+    profiles[backend.encoder] = *best;
+    tuned = true;
+  }
+
+  AVUTIL.av_buffer_unref(&vaapi_device);
+
+  if (tuned)
+  {
+    EncoderProfile::save_all(profiles);
+    Info("Encoder profile saved to %s\n", EncoderProfile::path().c_str());
+  }
+  return tuned;
+}
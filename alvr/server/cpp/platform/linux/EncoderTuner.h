@@ -0,0 +1,18 @@
+#pragma once
+
+namespace alvr
+{
+
+/* Benchmarks the encoders of the pipelines that are available on this machine (SW, NvEnc and
+ * VAAPI) across their presets, slice and thread counts, at the configured codec, resolution and
+ * bitrate and at half that bitrate. The input is a synthetic sequence that looks like a VR frame
+ * to an encoder: two lens-masked eye views of a textured room, with the head turning.
+ *
+ * For each encoder, the options with the best SSIM that encode within half a frame time (p95) are
+ * saved in the EncoderProfile, which the pipelines load when they are created. Runs without a GPU
+ * or a headset; it competes with a running stream for the encoder, so is better run without one.
+ * Returns false if no encoder could be benchmarked.
+ */
+bool tune_encoders();
+
+}
@@ -0,0 +1,522 @@
+#include "FrameProcessor.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
+
+#include "alvr_server/Logger.h"
+#include "alvr_server/Settings.h"
+#include "alvr_server/Utils.h"
+#include "alvr_server/include/openvr_math.h"
+#include "alvr_server/include/pose_math.h"
+
+// generated by build.rs from shader/frame_process.comp
+#include "frame_process.comp.h"
+
+namespace {
+// flags of frame_process.comp
+const uint32_t FLAG_SWAP_RED_BLUE = 1;
+const uint32_t FLAG_ENCODE_SRGB = 2;
+const uint32_t FLAG_REPROJECT = 4;
+const uint32_t FLAG_COLOR_CORRECTION = 8;
+
+const uint32_t WORKGROUP_SIZE = 16;
+} // namespace
+
+FrameProcessor::FrameProcessor(const init_packet &init, const int (&fds)[INPUT_IMAGES * 2]) {
+    m_colorCorrection = Settings::Instance().m_enableColorCorrection;
+
+    InitVulkan(init.device_name.data());
+    ImportInputs(init, fds);
+    CreateOutputs(init);
+}
+
+FrameProcessor::~FrameProcessor() {
+    m_device.waitIdle();
+
+    for (auto &output : m_outputs) {
+        m_device.destroySemaphore(output.semaphore);
+        m_device.destroyImageView(output.view);
+        m_device.destroyImage(output.image);
+        m_device.freeMemory(output.memory);
+    }
+    for (auto &input : m_inputs) {
+        m_device.destroySemaphore(input.semaphore);
+        m_device.destroyImageView(input.view);
+        m_device.destroyImage(input.image);
+        m_device.freeMemory(input.memory);
+    }
+
+    m_device.destroySampler(m_sampler);
+    m_device.destroyPipeline(m_pipeline);
+    m_device.destroyPipelineLayout(m_pipelineLayout);
+    m_device.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    m_device.destroyDescriptorPool(m_descriptorPool);
+    m_device.destroyFence(m_fence);
+    m_device.destroyQueryPool(m_queryPool);
+    m_device.destroyCommandPool(m_commandPool);
+    m_device.destroy();
+    m_instance.destroy();
+}
+
+void FrameProcessor::InitVulkan(const char *deviceName) {
+    vk::ApplicationInfo appInfo("ALVR frame processing", 0, "ALVR", 0, VK_API_VERSION_1_1);
+    vk::InstanceCreateInfo instanceInfo;
+    instanceInfo.pApplicationInfo = &appInfo;
+    m_instance = vk::createInstance(instanceInfo);
+
+    // The shared memory can only be imported on the device that exported it
+    for (auto &physicalDevice : m_instance.enumeratePhysicalDevices()) {
+        if (strcmp(physicalDevice.getProperties().deviceName.data(), deviceName) == 0) {
+            m_physicalDevice = physicalDevice;
+            break;
+        }
+    }
+    if (!m_physicalDevice) {
+        throw MakeException("Vulkan device %s not found", deviceName);
+    }
+
+    auto queueFamilies = m_physicalDevice.getQueueFamilyProperties();
+    m_queueFamily = UINT32_MAX;
+    for (uint32_t i = 0; i < queueFamilies.size(); ++i) {
+        if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eCompute) {
+            m_queueFamily = i;
+            break;
+        }
+    }
+    if (m_queueFamily == UINT32_MAX) {
+        throw MakeException("No compute queue found");
+    }
+
+    float queuePriority = 1.0f;
+    vk::DeviceQueueCreateInfo queueInfo({}, m_queueFamily, 1, &queuePriority);
+
+    const char *extensions[] = {
+        VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+        VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+    };
+    vk::DeviceCreateInfo deviceInfo;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    deviceInfo.enabledExtensionCount = sizeof(extensions) / sizeof(extensions[0]);
+    deviceInfo.ppEnabledExtensionNames = extensions;
+    m_device = m_physicalDevice.createDevice(deviceInfo);
+    m_queue = m_device.getQueue(m_queueFamily, 0);
+
+    m_dispatch = vk::DispatchLoaderDynamic(m_instance, vkGetInstanceProcAddr, m_device);
+
+    m_commandPool = m_device.createCommandPool(
+        {vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_queueFamily});
+    m_commandBuffer =
+        m_device.allocateCommandBuffers({m_commandPool, vk::CommandBufferLevel::ePrimary, 1})[0];
+    m_fence = m_device.createFence({});
+
+    // GPU time of the pass, without the waits on the producer and for the fence
+    if (queueFamilies[m_queueFamily].timestampValidBits > 0) {
+        m_queryPool = m_device.createQueryPool({{}, vk::QueryType::eTimestamp, 2});
+        m_timestampPeriod = m_physicalDevice.getProperties().limits.timestampPeriod;
+    }
+
+    vk::SamplerCreateInfo samplerInfo;
+    samplerInfo.magFilter = vk::Filter::eLinear;
+    samplerInfo.minFilter = vk::Filter::eLinear;
+    samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    m_sampler = m_device.createSampler(samplerInfo);
+
+    CreatePipeline();
+}
+
+void FrameProcessor::CreatePipeline() {
+    std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
+        vk::DescriptorSetLayoutBinding(
+            0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(
+            1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute),
+    };
+    vk::DescriptorSetLayoutCreateInfo setLayoutInfo;
+    setLayoutInfo.bindingCount = bindings.size();
+    setLayoutInfo.pBindings = bindings.data();
+    m_descriptorSetLayout = m_device.createDescriptorSetLayout(setLayoutInfo);
+
+    vk::PushConstantRange pushConstants(
+        vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants));
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+    m_pipelineLayout = m_device.createPipelineLayout(pipelineLayoutInfo);
+
+    vk::ShaderModuleCreateInfo moduleInfo;
+    moduleInfo.codeSize = sizeof(FRAME_PROCESS_COMP_SPV);
+    moduleInfo.pCode = FRAME_PROCESS_COMP_SPV;
+    vk::ShaderModule module = m_device.createShaderModule(moduleInfo);
+
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.stage = vk::PipelineShaderStageCreateInfo(
+        {}, vk::ShaderStageFlagBits::eCompute, module, "main");
+    pipelineInfo.layout = m_pipelineLayout;
+    m_pipeline = m_device.createComputePipeline(nullptr, pipelineInfo).value;
+    m_device.destroyShaderModule(module);
+
+    const uint32_t setCount = INPUT_IMAGES * 2;
+    std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, setCount),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, setCount),
+    };
+    vk::DescriptorPoolCreateInfo poolInfo;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    m_descriptorPool = m_device.createDescriptorPool(poolInfo);
+}
+
+uint32_t FrameProcessor::FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags properties) {
+    auto memoryProps = m_physicalDevice.getMemoryProperties();
+    for (uint32_t i = 0; i < memoryProps.memoryTypeCount; ++i) {
+        if ((typeBits & (1 << i)) &&
+            (memoryProps.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw MakeException("No suitable memory type found");
+}
+
+void FrameProcessor::ImportInputs(const init_packet &init, const int (&fds)[INPUT_IMAGES * 2]) {
+    for (uint32_t i = 0; i < INPUT_IMAGES; ++i) {
+        auto &input = m_inputs[i];
+
+        // Must match the image of the producer
+        vk::ExternalMemoryImageCreateInfo extMemImageInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd);
+        vk::ImageCreateInfo imageInfo = init.image_create_info;
+        imageInfo.pNext = &extMemImageInfo;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+        input.image = m_device.createImage(imageInfo);
+
+        auto req = m_device.getImageMemoryRequirements(input.image);
+
+        // A successful import takes ownership of the fd, the encoder imports the original
+        int fd = dup(fds[2 * i]);
+        if (fd == -1) {
+            throw MakeException("dup failed: %s", strerror(errno));
+        }
+        vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+        dedicatedInfo.image = input.image;
+        vk::ImportMemoryFdInfoKHR importInfo(vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd, fd);
+        importInfo.pNext = &dedicatedInfo;
+        vk::MemoryAllocateInfo allocInfo(req.size, init.mem_index);
+        allocInfo.pNext = &importInfo;
+        try {
+            input.memory = m_device.allocateMemory(allocInfo);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        m_device.bindImageMemory(input.image, input.memory, 0);
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image = input.image;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format = imageInfo.format;
+        viewInfo.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        input.view = m_device.createImageView(viewInfo);
+
+        // Shared with the producer and the encoder: each user waits on it and signals it back
+        input.semaphore = m_device.createSemaphore({});
+        fd = dup(fds[2 * i + 1]);
+        if (fd == -1) {
+            throw MakeException("dup failed: %s", strerror(errno));
+        }
+        vk::ImportSemaphoreFdInfoKHR importSemInfo(
+            input.semaphore, {}, vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd, fd);
+        try {
+            m_device.importSemaphoreFdKHR(importSemInfo, m_dispatch);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+}
+
+void FrameProcessor::CreateOutputs(const init_packet &init) {
+    vk::Format format = (vk::Format)init.image_create_info.format;
+    switch (format) {
+    case vk::Format::eB8G8R8A8Unorm:
+        m_formatFlags = FLAG_SWAP_RED_BLUE;
+        break;
+    case vk::Format::eB8G8R8A8Srgb:
+        m_formatFlags = FLAG_SWAP_RED_BLUE | FLAG_ENCODE_SRGB;
+        break;
+    case vk::Format::eR8G8B8A8Unorm:
+        break;
+    case vk::Format::eR8G8B8A8Srgb:
+        m_formatFlags = FLAG_ENCODE_SRGB;
+        break;
+    default:
+        throw MakeException("Unsupported image format %d", (int)format);
+    }
+
+    // Same as the input images, with an RGBA UNORM view for storage writes. sRGB formats usually
+    // don't support storage, the extended usage allows it on the image as long as only the UNORM
+    // view is used for storage.
+    m_outputCreateInfo = init.image_create_info;
+    m_outputCreateInfo.flags |=
+        vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+    m_outputCreateInfo.usage |= vk::ImageUsageFlagBits::eStorage |
+                                vk::ImageUsageFlagBits::eSampled |
+                                vk::ImageUsageFlagBits::eTransferSrc |
+                                vk::ImageUsageFlagBits::eTransferDst;
+    m_outputCreateInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+    for (auto &output : m_outputs) {
+        vk::ExternalMemoryImageCreateInfo extMemImageInfo(
+            vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd);
+        vk::ImageCreateInfo imageInfo = m_outputCreateInfo;
+        imageInfo.pNext = &extMemImageInfo;
+        output.image = m_device.createImage(imageInfo);
+
+        auto req = m_device.getImageMemoryRequirements(output.image);
+        m_outputMemoryIndex =
+            FindMemoryType(req.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+        vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+        dedicatedInfo.image = output.image;
+        vk::ExportMemoryAllocateInfo exportInfo(vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd);
+        exportInfo.pNext = &dedicatedInfo;
+        vk::MemoryAllocateInfo allocInfo(req.size, m_outputMemoryIndex);
+        allocInfo.pNext = &exportInfo;
+        output.memory = m_device.allocateMemory(allocInfo);
+        m_device.bindImageMemory(output.image, output.memory, 0);
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image = output.image;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format = vk::Format::eR8G8B8A8Unorm;
+        viewInfo.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        vk::ImageViewUsageCreateInfo viewUsageInfo(vk::ImageUsageFlagBits::eStorage);
+        viewInfo.pNext = &viewUsageInfo;
+        output.view = m_device.createImageView(viewInfo);
+
+        vk::ExportSemaphoreCreateInfo exportSemInfo(
+            vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd);
+        vk::SemaphoreCreateInfo semInfo;
+        semInfo.pNext = &exportSemInfo;
+        output.semaphore = m_device.createSemaphore(semInfo);
+
+        // The encoder waits on the semaphore before reading and signals it back afterwards
+        vk::SubmitInfo signalInfo;
+        signalInfo.signalSemaphoreCount = 1;
+        signalInfo.pSignalSemaphores = &output.semaphore;
+        m_queue.submit(signalInfo, nullptr);
+    }
+    m_queue.waitIdle();
+
+    auto writeSet = [&](vk::DescriptorSet set, const InputImage &input, const OutputImage &output) {
+        vk::DescriptorImageInfo inputInfo(m_sampler, input.view, vk::ImageLayout::eGeneral);
+        vk::DescriptorImageInfo outputInfo(nullptr, output.view, vk::ImageLayout::eGeneral);
+        std::array<vk::WriteDescriptorSet, 2> writes = {
+            vk::WriteDescriptorSet(
+                set, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &inputInfo),
+            vk::WriteDescriptorSet(set, 1, 0, 1, vk::DescriptorType::eStorageImage, &outputInfo),
+        };
+        m_device.updateDescriptorSets(writes, {});
+    };
+    for (uint32_t i = 0; i < INPUT_IMAGES; ++i) {
+        std::array<vk::DescriptorSetLayout, 2> layouts = {m_descriptorSetLayout,
+                                                          m_descriptorSetLayout};
+        auto sets = m_device.allocateDescriptorSets({m_descriptorPool, layouts.size(), layouts.data()});
+        m_processSets[i] = sets[0];
+        m_reprojectionSets[i] = sets[1];
+        writeSet(m_processSets[i], m_inputs[i], m_outputs[i]);
+        writeSet(m_reprojectionSets[i], m_inputs[i], m_outputs[REPROJECTION_OUTPUT]);
+    }
+}
+
+int FrameProcessor::ExportOutputMemory(uint32_t output) {
+    return m_device.getMemoryFdKHR(
+        {m_outputs.at(output).memory, vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd}, m_dispatch);
+}
+
+int FrameProcessor::ExportOutputSemaphore(uint32_t output) {
+    return m_device.getSemaphoreFdKHR(
+        {m_outputs.at(output).semaphore, vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd},
+        m_dispatch);
+}
+
+void FrameProcessor::Process(uint32_t inputIndex, vk::ImageLayout inputLayout) {
+    PushConstants constants = {};
+    Dispatch(inputIndex, inputLayout, inputIndex, constants);
+}
+
+void FrameProcessor::Reproject(uint32_t inputIndex,
+                               vk::ImageLayout inputLayout,
+                               const vr::HmdQuaternion_t &renderRotation,
+                               const vr::HmdQuaternion_t &newRotation) {
+    auto &settings = Settings::Instance();
+
+    PushConstants constants = {};
+    constants.flags = FLAG_REPROJECT;
+
+    // Rotation from the new eye space to the eye space the frame was rendered with. The eyes
+    // rotate with the head, the translation of the eyes is neglected.
+    auto delta = posemath::multiply<vr::HmdQuaternion_t>(posemath::conjugate(renderRotation), newRotation);
+    vr::HmdMatrix34_t rotation;
+    posemath::quatToMat33(delta, rotation);
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            constants.reprojection[row][col] = col < 3 ? rotation.m[row][col] : 0.f;
+        }
+    }
+    for (int eye = 0; eye < 2; ++eye) {
+        constants.fovTan[eye][0] = tanf(settings.m_eyeFov[eye].left * DEG_TO_RAD);
+        constants.fovTan[eye][1] = tanf(settings.m_eyeFov[eye].right * DEG_TO_RAD);
+        constants.fovTan[eye][2] = tanf(settings.m_eyeFov[eye].top * DEG_TO_RAD);
+        constants.fovTan[eye][3] = tanf(settings.m_eyeFov[eye].bottom * DEG_TO_RAD);
+    }
+
+    Dispatch(inputIndex, inputLayout, REPROJECTION_OUTPUT, constants);
+}
+
+void FrameProcessor::Dispatch(uint32_t inputIndex,
+                              vk::ImageLayout inputLayout,
+                              uint32_t outputIndex,
+                              PushConstants &constants) {
+    auto &settings = Settings::Instance();
+    auto &input = m_inputs.at(inputIndex);
+    auto &output = m_outputs.at(outputIndex);
+    auto descriptorSet =
+        outputIndex == REPROJECTION_OUTPUT ? m_reprojectionSets[inputIndex] : m_processSets[inputIndex];
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // an undefined layout would discard the content
+    if (inputLayout == vk::ImageLayout::eUndefined) {
+        inputLayout = vk::ImageLayout::eGeneral;
+    }
+
+    constants.flags |= m_formatFlags;
+    if (m_colorCorrection) {
+        // same parameters as the Windows driver
+        constants.flags |= FLAG_COLOR_CORRECTION;
+        constants.brightness = settings.m_brightness;
+        constants.contrast = settings.m_contrast + 1.f;
+        constants.saturation = settings.m_saturation + 1.f;
+        constants.gamma = settings.m_gamma;
+        constants.sharpening = settings.m_sharpening;
+    }
+
+    auto &cmd = m_commandBuffer;
+    cmd.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    // Acquire the input from the producer device and the output from the encoder device. The
+    // output is fully overwritten, its previous content is discarded.
+    std::array<vk::ImageMemoryBarrier, 2> barriers;
+    barriers[0].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    barriers[0].oldLayout = inputLayout;
+    barriers[0].newLayout = vk::ImageLayout::eGeneral;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    barriers[0].dstQueueFamilyIndex = m_queueFamily;
+    barriers[0].image = input.image;
+    barriers[0].subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+    barriers[1].dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+    barriers[1].oldLayout = vk::ImageLayout::eUndefined;
+    barriers[1].newLayout = vk::ImageLayout::eGeneral;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = output.image;
+    barriers[1].subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                        vk::PipelineStageFlagBits::eComputeShader,
+                        {},
+                        {},
+                        {},
+                        barriers);
+
+    if (m_queryPool) {
+        cmd.resetQueryPool(m_queryPool, 0, 2);
+        // after the semaphore waits, which block the compute stage
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, m_queryPool, 0);
+    }
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, descriptorSet, {});
+    uint32_t eyeWidth = m_outputCreateInfo.extent.width / 2;
+    uint32_t height = m_outputCreateInfo.extent.height;
+    for (uint32_t eye = 0; eye < 2; ++eye) {
+        constants.eye = eye;
+        cmd.pushConstants(m_pipelineLayout,
+                          vk::ShaderStageFlagBits::eCompute,
+                          0,
+                          sizeof(constants),
+                          &constants);
+        cmd.dispatch((eyeWidth + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                     (height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                     1);
+    }
+
+    if (m_queryPool) {
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, 1);
+    }
+
+    // Give both images back, the input in the layout the encoder expects. The output is left in
+    // the general layout.
+    barriers[0].srcAccessMask = vk::AccessFlagBits::eShaderRead;
+    barriers[0].dstAccessMask = {};
+    barriers[0].oldLayout = vk::ImageLayout::eGeneral;
+    barriers[0].newLayout = inputLayout;
+    barriers[0].srcQueueFamilyIndex = m_queueFamily;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    barriers[1].srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    barriers[1].dstAccessMask = {};
+    barriers[1].oldLayout = vk::ImageLayout::eGeneral;
+    barriers[1].srcQueueFamilyIndex = m_queueFamily;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eBottomOfPipe,
+                        {},
+                        {},
+                        {},
+                        barriers);
+    cmd.end();
+
+    std::array<vk::Semaphore, 2> semaphores = {input.semaphore, output.semaphore};
+    std::array<vk::PipelineStageFlags, 2> waitStages = {vk::PipelineStageFlagBits::eComputeShader,
+                                                        vk::PipelineStageFlagBits::eComputeShader};
+    vk::SubmitInfo submitInfo;
+    submitInfo.waitSemaphoreCount = semaphores.size();
+    submitInfo.pWaitSemaphores = semaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    submitInfo.signalSemaphoreCount = semaphores.size();
+    submitInfo.pSignalSemaphores = semaphores.data();
+    m_queue.submit(submitInfo, m_fence);
+
+    (void)m_device.waitForFences(m_fence, true, UINT64_MAX);
+    m_device.resetFences(m_fence);
+
+    double gpuTimeUs = -1.;
+    uint64_t timestamps[2];
+    if (m_queryPool &&
+        m_device.getQueryPoolResults(m_queryPool,
+                                     0,
+                                     2,
+                                     sizeof(timestamps),
+                                     timestamps,
+                                     sizeof(timestamps[0]),
+                                     vk::QueryResultFlagBits::e64) == vk::Result::eSuccess) {
+        gpuTimeUs = (timestamps[1] - timestamps[0]) * m_timestampPeriod / 1000.;
+    }
+
+    // the wall time includes the waits on the producer and on the fence
+    Debug("FrameProcessor: pass 0x%x GPU time %.0f us, wall time %lld us\n",
+          constants.flags,
+          gpuTimeUs,
+          (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - startTime)
+              .count());
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <vulkan/vulkan.hpp>
+
+#include "openvr_driver.h"
+#include "protocol.h"
+
+// Processing of the frames received by CEncoder before they are encoded: color correction and
+// sharpening of every frame, and rotational reprojection of the last frame when the game misses a
+// vsync. Everything is done in a single compute pass, which also converts to the encoder input
+// format, so each frame is read and written once.
+// It runs on its own Vulkan device, on the same GPU as the game, and reads the images shared with
+// the vulkan layer (or the compositor). The results are written to exported images which are
+// handed to the encode pipeline in place of the shared ones.
+class FrameProcessor {
+  public:
+    static const uint32_t INPUT_IMAGES = 3;
+    // one output per input, and one for reprojection
+    static const uint32_t REPROJECTION_OUTPUT = INPUT_IMAGES;
+    static const uint32_t OUTPUT_IMAGES = INPUT_IMAGES + 1;
+
+    // fds is the list received from the image producer, it is not consumed
+    FrameProcessor(const init_packet &init, const int (&fds)[INPUT_IMAGES * 2]);
+    ~FrameProcessor();
+
+    bool HasColorCorrection() const { return m_colorCorrection; }
+
+    // Parameters of the output images, to import them on the encoder device
+    vk::ImageCreateInfo GetOutputCreateInfo() const { return m_outputCreateInfo; }
+    uint32_t GetOutputMemoryIndex() const { return m_outputMemoryIndex; }
+    // New fds each call, ownership is transferred to the caller
+    int ExportOutputMemory(uint32_t output);
+    int ExportOutputSemaphore(uint32_t output);
+
+    // Color correct the input image into the output of the same index. Blocks until done.
+    // inputLayout is the current layout of the input image.
+    void Process(uint32_t inputIndex, vk::ImageLayout inputLayout);
+
+    // Render the input image seen from newRotation instead of renderRotation into
+    // REPROJECTION_OUTPUT, color corrected if enabled. Blocks until done.
+    void Reproject(uint32_t inputIndex,
+                   vk::ImageLayout inputLayout,
+                   const vr::HmdQuaternion_t &renderRotation,
+                   const vr::HmdQuaternion_t &newRotation);
+
+  private:
+    struct InputImage {
+        vk::Image image;
+        vk::DeviceMemory memory;
+        vk::ImageView view;
+        vk::Semaphore semaphore;
+    };
+
+    struct OutputImage {
+        vk::Image image;
+        vk::DeviceMemory memory;
+        vk::ImageView view;
+        vk::Semaphore semaphore;
+    };
+
+    struct PushConstants {
+        float reprojection[3][4];
+        float fovTan[2][4];
+        float brightness;
+        float contrast;
+        float saturation;
+        float gamma;
+        float sharpening;
+        uint32_t eye;
+        uint32_t flags;
+    };
+
+    void InitVulkan(const char *deviceName);
+    void CreatePipeline();
+    void ImportInputs(const init_packet &init, const int (&fds)[INPUT_IMAGES * 2]);
+    void CreateOutputs(const init_packet &init);
+    uint32_t FindMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags properties);
+    void Dispatch(uint32_t inputIndex,
+                  vk::ImageLayout inputLayout,
+                  uint32_t outputIndex,
+                  PushConstants &constants);
+
+    vk::Instance m_instance;
+    vk::PhysicalDevice m_physicalDevice;
+    vk::Device m_device;
+    vk::DispatchLoaderDynamic m_dispatch;
+    uint32_t m_queueFamily = 0;
+    vk::Queue m_queue;
+    vk::CommandPool m_commandPool;
+    vk::CommandBuffer m_commandBuffer;
+    vk::Fence m_fence;
+    // null when the queue has no timestamp support
+    vk::QueryPool m_queryPool;
+    float m_timestampPeriod = 1.f;
+    vk::DescriptorPool m_descriptorPool;
+    vk::DescriptorSetLayout m_descriptorSetLayout;
+    vk::PipelineLayout m_pipelineLayout;
+    vk::Pipeline m_pipeline;
+    vk::Sampler m_sampler;
+
+    std::array<InputImage, INPUT_IMAGES> m_inputs;
+    std::array<OutputImage, OUTPUT_IMAGES> m_outputs;
+    // input i to output i, and input i to the reprojection output
+    std::array<vk::DescriptorSet, INPUT_IMAGES> m_processSets;
+    std::array<vk::DescriptorSet, INPUT_IMAGES> m_reprojectionSets;
+
+    vk::ImageCreateInfo m_outputCreateInfo;
+    uint32_t m_outputMemoryIndex = 0;
+    uint32_t m_formatFlags = 0;
+    bool m_colorCorrection = false;
+};
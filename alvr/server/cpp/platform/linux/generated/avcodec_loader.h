@@ -23,11 +23,14 @@ class avcodec {
   bool loaded() const { return loaded_; }
 
   decltype(&::avcodec_alloc_context3) avcodec_alloc_context3;
+  decltype(&::avcodec_find_decoder) avcodec_find_decoder;
   decltype(&::avcodec_find_encoder_by_name) avcodec_find_encoder_by_name;
   decltype(&::avcodec_free_context) avcodec_free_context;
   decltype(&::avcodec_open2) avcodec_open2;
+  decltype(&::avcodec_receive_frame) avcodec_receive_frame;
   decltype(&::avcodec_receive_packet) avcodec_receive_packet;
   decltype(&::avcodec_send_frame) avcodec_send_frame;
+  decltype(&::avcodec_send_packet) avcodec_send_packet;
   decltype(&::av_packet_alloc) av_packet_alloc;
   decltype(&::av_packet_free) av_packet_free;
 
@@ -61,6 +61,18 @@ bool avutil::Load(const std::string& library_name) {
     return false;
   }
 
+#if defined(LIBRARY_LOADER_AVUTIL_LOADER_H_DLOPEN)
+  av_dict_free =
+      reinterpret_cast<decltype(this->av_dict_free)>(
+          dlsym(library_, "av_dict_free"));
+#else
+  av_dict_free = &::av_dict_free;
+#endif
+  if (!av_dict_free) {
+    CleanUp(true);
+    return false;
+  }
+
 #if defined(LIBRARY_LOADER_AVUTIL_LOADER_H_DLOPEN)
   av_dict_set =
       reinterpret_cast<decltype(this->av_dict_set)>(
@@ -307,6 +319,7 @@ void avutil::CleanUp(bool unload) {
   av_buffer_alloc = NULL;
   av_buffer_ref = NULL;
   av_buffer_unref = NULL;
+  av_dict_free = NULL;
   av_dict_set = NULL;
   av_frame_alloc = NULL;
   av_frame_free = NULL;
@@ -30,6 +30,7 @@ class avutil {
   decltype(&::av_buffer_alloc) av_buffer_alloc;
   decltype(&::av_buffer_ref) av_buffer_ref;
   decltype(&::av_buffer_unref) av_buffer_unref;
+  decltype(&::av_dict_free) av_dict_free;
   decltype(&::av_dict_set) av_dict_set;
   decltype(&::av_frame_alloc) av_frame_alloc;
   decltype(&::av_frame_free) av_frame_free;
@@ -25,6 +25,18 @@ bool swscale::Load(const std::string& library_name) {
 #endif
 
 
+#if defined(LIBRARY_LOADER_SWSCALE_LOADER_H_DLOPEN)
+  sws_freeContext =
+      reinterpret_cast<decltype(this->sws_freeContext)>(
+          dlsym(library_, "sws_freeContext"));
+#else
+  sws_freeContext = &::sws_freeContext;
+#endif
+  if (!sws_freeContext) {
+    CleanUp(true);
+    return false;
+  }
+
 #if defined(LIBRARY_LOADER_SWSCALE_LOADER_H_DLOPEN)
   sws_getContext =
       reinterpret_cast<decltype(this->sws_getContext)>(
@@ -64,6 +76,7 @@ void swscale::CleanUp(bool unload) {
   (void)unload;
 #endif
   loaded_ = false;
+  sws_freeContext = NULL;
   sws_getContext = NULL;
   sws_scale = NULL;
 
@@ -11,6 +11,8 @@
 struct present_packet {
     uint32_t image;
     uint32_t frame;
+    // CLOCK_MONOTONIC time of the vsync the frame was presented for, in nanoseconds
+    uint64_t vsync_ns;
     float pose[3][4];
 };
 
@@ -58,7 +58,7 @@ void Compositor::PresentLayers(void *syncTexture, const Layer *layers, uint64_t
         auto orientation = layers[0].views[0].orientation;
 
         vr::HmdMatrix34_t pPose;
-        HmdMatrix_QuatToMat(orientation.w, orientation.x, orientation.y, orientation.z, &pPose);
+        posemath::quatToMat33(orientation, pPose);
 
         auto pose = m_poseHistory->GetBestPoseMatch(pPose);
         if (pose) {
@@ -32,6 +32,10 @@ void VideoEncoderNVENC::Initialize()
 	// Initialize Encoder
 	//
 
+	if (m_codec == ALVR_CODEC_AV1) {
+		throw MakeException("AV1 is not supported by NVENC on Windows");
+	}
+
 	NV_ENC_BUFFER_FORMAT format = NV_ENC_BUFFER_FORMAT_ABGR;
 	
 	if (Settings::Instance().m_use10bitEncoder) {
@@ -0,0 +1,288 @@
+// CPU reference of the per-layer reprojection and blending of platform/linux/shader/compositor.comp,
+// checked against the layers reprojected from their poses.
+// Not part of the driver build (build.rs skips the tools directory). From this directory:
+//   c++ -std=c++17 -O2 -I../alvr_server/include compositor_test.cpp -o /tmp/compositor_test
+//   /tmp/compositor_test
+
+#include "pose_math.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+// Must match Compositor::MAX_LAYERS
+const int MAX_LAYERS = 10;
+
+struct Quat {
+	double w, x, y, z;
+};
+
+struct Mat34 {
+	float m[3][4];
+};
+
+struct Color {
+	float r, g, b, a;
+};
+
+// A layer texture as a function of the texture coordinates, so that the expected color of any
+// reprojected pixel is known exactly
+struct Texture {
+	float blue;
+	float alpha;
+
+	Color sample(float s, float t) const { return {s, t, blue, alpha}; }
+};
+
+struct View {
+	Quat orientation;
+	float rect[4];
+	const Texture *texture;
+};
+
+struct Layer {
+	View views[2];
+};
+
+// Same as the Params block of compositor.comp, as filled by Compositor::FillParams()
+struct Params {
+	float fovTan[2][4];
+	uint32_t layerCount;
+	struct {
+		Mat34 reprojection;
+		float rect[4];
+	} views[MAX_LAYERS * 2];
+	const Texture *images[MAX_LAYERS * 2];
+};
+
+int failures = 0;
+
+void check(bool condition, const char *what, int eye, int x, int y) {
+	if (!condition) {
+		printf("FAIL: %s at eye %d pixel (%d, %d)\n", what, eye, x, y);
+		failures++;
+	}
+}
+
+float mix(float a, float b, float t) { return a * (1 - t) + b * t; }
+
+// Same as Compositor::FillParams()
+Params fillParams(const float fovTan[2][4], const Layer *layers, uint32_t layerCount) {
+	Params params = {};
+	for (int eye = 0; eye < 2; eye++) {
+		for (int side = 0; side < 4; side++) {
+			params.fovTan[eye][side] = fovTan[eye][side];
+		}
+	}
+	params.layerCount = layerCount;
+	for (uint32_t layer = 0; layer < layerCount; layer++) {
+		for (int eye = 0; eye < 2; eye++) {
+			auto &view = layers[layer].views[eye];
+			auto delta = posemath::multiply<Quat>(posemath::conjugate(view.orientation),
+			                                      layers[0].views[eye].orientation);
+			auto &viewParams = params.views[layer * 2 + eye];
+			posemath::quatToMat33(delta, viewParams.reprojection);
+			for (int i = 0; i < 4; i++) {
+				viewParams.rect[i] = view.rect[i];
+			}
+			params.images[layer * 2 + eye] = view.texture;
+		}
+	}
+	return params;
+}
+
+// Same as main() of compositor.comp for one eye, in float. Writes the eye into its half of the
+// BGRA output, through the RGBA view of the shader.
+void compositeShader(const Params &params, int eye, int eyeWidth, int eyeHeight, std::vector<uint8_t> &output) {
+	const float *tangents = params.fovTan[eye];
+	for (int y = 0; y < eyeHeight; y++) {
+		for (int x = 0; x < eyeWidth; x++) {
+			float u = (x + 0.5f) / eyeWidth, v = (y + 0.5f) / eyeHeight;
+			float dir[3] = {mix(-tangents[0], tangents[1], u), mix(tangents[2], -tangents[3], v), -1.f};
+
+			Color color = {0, 0, 0, 1};
+			for (uint32_t layer = 0; layer < params.layerCount; layer++) {
+				auto &view = params.views[layer * 2 + eye];
+				float layerDir[3];
+				for (int row = 0; row < 3; row++) {
+					auto &r = view.reprojection.m[row];
+					layerDir[row] = r[0] * dir[0] + r[1] * dir[1] + r[2] * dir[2];
+				}
+				if (layerDir[2] >= 0) {
+					continue;
+				}
+
+				float tanX = layerDir[0] / -layerDir[2], tanY = layerDir[1] / -layerDir[2];
+				float layerU = (tanX + tangents[0]) / (tangents[0] + tangents[1]);
+				float layerV = (tangents[2] - tanY) / (tangents[2] + tangents[3]);
+				if (layerU < 0 || layerV < 0 || layerU > 1 || layerV > 1) {
+					continue;
+				}
+
+				auto layerColor = params.images[layer * 2 + eye]->sample(view.rect[0] + layerU * view.rect[2],
+				                                                         view.rect[1] + layerV * view.rect[3]);
+				if (layer == 0) {
+					color = {layerColor.r, layerColor.g, layerColor.b, color.a};
+				} else {
+					color.r = mix(color.r, layerColor.r, layerColor.a);
+					color.g = mix(color.g, layerColor.g, layerColor.a);
+					color.b = mix(color.b, layerColor.b, layerColor.a);
+				}
+			}
+
+			// imageStore(output_image, ..., color.bgra) on the rgba8 view of the BGRA image
+			const float stored[4] = {color.b, color.g, color.r, color.a};
+			uint8_t *texel = &output[((size_t)y * eyeWidth * 2 + eye * eyeWidth + x) * 4];
+			for (int i = 0; i < 4; i++) {
+				texel[i] = (uint8_t)std::lround(std::min(std::max(stored[i], 0.f), 1.f) * 255);
+			}
+		}
+	}
+}
+
+struct Sample {
+	bool visible;
+	double s, t;
+};
+
+// The view direction of the output pixel, rotated to the world with the pose of the first layer and
+// back to the eye space of the layer with its own pose, in double
+Sample sampleLayer(const View &reference, const View &view, const float *tangents, double u, double v) {
+	posemath::Vec3<double> dir = {-tangents[0] + (tangents[0] + tangents[1]) * u,
+	                              tangents[2] - (tangents[2] + tangents[3]) * v,
+	                              -1};
+	auto world = posemath::rotateVector(reference.orientation, dir);
+	auto layerDir = posemath::rotateVectorInverse(view.orientation, world);
+
+	double layerU = (layerDir.x / -layerDir.z + tangents[0]) / (tangents[0] + tangents[1]);
+	double layerV = (tangents[2] - layerDir.y / -layerDir.z) / (tangents[2] + tangents[3]);
+	Sample sample = {layerDir.z < 0 && layerU >= 0 && layerV >= 0 && layerU <= 1 && layerV <= 1,
+	                 view.rect[0] + layerU * view.rect[2],
+	                 view.rect[1] + layerV * view.rect[3]};
+	return sample;
+}
+
+// The expected BGRA output, blending the layers in double. Returns false for the pixels that are
+// on the border of a layer, which can go either way.
+bool compositeReference(const Layer *layers, uint32_t layerCount, const float *tangents, int eye,
+                        double u, double v, double border, double bgra[4]) {
+	double r = 0, g = 0, b = 0;
+	for (uint32_t layer = 0; layer < layerCount; layer++) {
+		auto &view = layers[layer].views[eye];
+		auto sample = sampleLayer(layers[0].views[eye], view, tangents, u, v);
+		double layerU = (sample.s - view.rect[0]) / view.rect[2];
+		double layerV = (sample.t - view.rect[1]) / view.rect[3];
+		if (std::min({std::abs(layerU), std::abs(layerU - 1), std::abs(layerV), std::abs(layerV - 1)}) < border) {
+			return false;
+		}
+		if (!sample.visible) {
+			continue;
+		}
+
+		auto color = view.texture->sample(sample.s, sample.t);
+		double alpha = layer == 0 ? 1 : color.a;
+		r = r * (1 - alpha) + sample.s * alpha;
+		g = g * (1 - alpha) + sample.t * alpha;
+		b = b * (1 - alpha) + color.b * alpha;
+	}
+	bgra[0] = b;
+	bgra[1] = g;
+	bgra[2] = r;
+	bgra[3] = 1;
+	return true;
+}
+
+Quat axisAngle(double x, double y, double z, double degrees) {
+	double half = degrees * M_PI / 360;
+	double s = std::sin(half) / std::sqrt(x * x + y * y + z * z);
+	return {std::cos(half), x * s, y * s, z * s};
+}
+
+float tanDegrees(float degrees) { return std::tan(float(degrees * M_PI / 180)); }
+} // namespace
+
+int main() {
+	// Quest 2, the right eye mirrors the left one
+	const float fovTan[2][4] = {{tanDegrees(52), tanDegrees(44), tanDegrees(53), tanDegrees(56)},
+	                            {tanDegrees(44), tanDegrees(52), tanDegrees(53), tanDegrees(56)}};
+	const int WIDTH = 96, HEIGHT = 80;
+	// half an 8 bit step, plus the float error of the reprojection
+	const double MAX_ERROR = 0.5 / 255 + 1e-4;
+
+	// The game renders both eyes side by side in one texture, the overlays have their own texture
+	const Texture scene = {0.1f, 0.f}, hud = {0.6f, 0.25f}, dashboard = {0.9f, 0.75f};
+	const Quat head = axisAngle(0.3, 1, 0.2, 40);
+	const struct {
+		const char *name;
+		std::vector<Layer> layers;
+	} cases[] = {
+	    {"no layer", {}},
+	    {"one layer", {{{{head, {0, 0, 0.5f, 1}, &scene}, {head, {0.5f, 0, 0.5f, 1}, &scene}}}}},
+	    // an older frame is reprojected to the pose of the newest layer
+	    {"reprojected layer",
+	     {{{{head, {0, 0, 0.5f, 1}, &scene}, {head, {0.5f, 0, 0.5f, 1}, &scene}}},
+	      {{{posemath::multiply<Quat>(head, axisAngle(0, 1, 0, 12)), {0, 0, 1, 1}, &hud},
+	        {posemath::multiply<Quat>(head, axisAngle(0, 1, 0, 12)), {0, 0, 1, 1}, &hud}}}}},
+	    // the first layer is opaque whatever its alpha, the others are blended in order, and the
+	    // layers that face away from the view are skipped
+	    {"blended layers",
+	     {{{{posemath::multiply<Quat>(head, axisAngle(1, 0, 0, -8)), {0, 0, 0.5f, 1}, &scene},
+	        {posemath::multiply<Quat>(head, axisAngle(1, 0, 0, -8)), {0.5f, 0, 0.5f, 1}, &scene}}},
+	      {{{posemath::multiply<Quat>(head, axisAngle(0, 0, 1, 20)), {0.25f, 0.25f, 0.5f, 0.5f}, &hud},
+	        {posemath::multiply<Quat>(head, axisAngle(0, 0, 1, 20)), {0.25f, 0.25f, 0.5f, 0.5f}, &hud}}},
+	      {{{posemath::multiply<Quat>(head, axisAngle(1, 1, 0, 30)), {0, 0, 1, 1}, &dashboard},
+	        {posemath::multiply<Quat>(head, axisAngle(1, 1, 0, 30)), {0, 0, 1, 1}, &dashboard}}},
+	      {{{posemath::multiply<Quat>(head, axisAngle(0, 1, 0, 180)), {0, 0, 1, 1}, &dashboard},
+	        {posemath::multiply<Quat>(head, axisAngle(0, 1, 0, 180)), {0, 0, 1, 1}, &dashboard}}}}},
+	};
+
+	for (auto &testCase : cases) {
+		auto layerCount = (uint32_t)testCase.layers.size();
+		auto params = fillParams(fovTan, testCase.layers.data(), layerCount);
+		std::vector<uint8_t> output(WIDTH * 2 * HEIGHT * 4, 0xcd);
+		for (int eye = 0; eye < 2; eye++) {
+			compositeShader(params, eye, WIDTH, HEIGHT, output);
+		}
+
+		int blendedPixels = 0;
+		for (int eye = 0; eye < 2; eye++) {
+			for (int y = 0; y < HEIGHT; y++) {
+				for (int x = 0; x < WIDTH; x++) {
+					double u = (x + 0.5) / WIDTH, v = (y + 0.5) / HEIGHT;
+					double expected[4];
+					if (!compositeReference(testCase.layers.data(), layerCount, fovTan[eye], eye, u, v,
+					                        1e-4, expected)) {
+						continue;
+					}
+					const uint8_t *texel = &output[((size_t)y * WIDTH * 2 + eye * WIDTH + x) * 4];
+					bool matches = true;
+					for (int i = 0; i < 4; i++) {
+						matches &= std::abs(texel[i] / 255. - expected[i]) < MAX_ERROR;
+					}
+					if (!matches) {
+						printf("%s: got BGRA %d %d %d %d, expected %.1f %.1f %.1f %.1f\n", testCase.name,
+						       texel[0], texel[1], texel[2], texel[3], expected[0] * 255, expected[1] * 255,
+						       expected[2] * 255, expected[3] * 255);
+					}
+					check(matches, testCase.name, eye, x, y);
+					blendedPixels += std::abs(expected[0] - scene.blue) > 1e-3 && expected[0] != 0;
+				}
+			}
+		}
+
+		// make sure the overlays actually cover part of the view
+		if (layerCount > 1) {
+			check(blendedPixels > WIDTH * HEIGHT / 10, "overlays visible", -1, -1, -1);
+		}
+	}
+
+	if (failures > 0) {
+		printf("%d failures\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all passed\n");
+	return EXIT_SUCCESS;
+}
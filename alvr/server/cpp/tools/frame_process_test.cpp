@@ -0,0 +1,261 @@
+// CPU reference of the sharpening, color correction and output format conversion of
+// platform/linux/shader/frame_process.comp, checked against ColorCorrectionPixelShader.hlsl of the
+// Windows driver.
+// Not part of the driver build (build.rs skips the tools directory). From this directory:
+//   c++ -std=c++17 -O2 frame_process_test.cpp -o /tmp/frame_process_test
+//   /tmp/frame_process_test
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+// Same as FrameProcessor.cpp
+const uint32_t FLAG_SWAP_RED_BLUE = 1;
+const uint32_t FLAG_ENCODE_SRGB = 2;
+const uint32_t FLAG_COLOR_CORRECTION = 8;
+
+struct Rgba {
+	float r, g, b, a;
+};
+
+// The color correction settings, as in the dashboard
+struct ColorCorrection {
+	float brightness, contrast, saturation, gamma, sharpening;
+};
+
+// Both eyes side by side, sampled at the texel centers so that the linear filter of the sampler
+// returns the texels, clamped to the edge
+struct Image {
+	int width, height;
+	std::vector<Rgba> texels;
+
+	Rgba sample(float u, float v) const {
+		int x = std::min(std::max((int)std::floor(u * width), 0), width - 1);
+		int y = std::min(std::max((int)std::floor(v * height), 0), height - 1);
+		return texels[y * width + x];
+	}
+};
+
+int failures = 0;
+
+void check(bool condition, const char *what, int eye, int x, int y) {
+	if (!condition) {
+		printf("FAIL: %s at eye %d pixel (%d, %d)\n", what, eye, x, y);
+		failures++;
+	}
+}
+
+// The push constants, as filled by FrameProcessor::Dispatch()
+struct Constants {
+	float brightness, contrast, saturation, gamma, sharpening;
+	uint32_t flags;
+};
+
+Constants pushConstants(const ColorCorrection *correction, uint32_t formatFlags) {
+	Constants constants = {};
+	constants.flags = formatFlags;
+	if (correction) {
+		constants.flags |= FLAG_COLOR_CORRECTION;
+		constants.brightness = correction->brightness;
+		constants.contrast = correction->contrast + 1.f;
+		constants.saturation = correction->saturation + 1.f;
+		constants.gamma = correction->gamma;
+		constants.sharpening = correction->sharpening;
+	}
+	return constants;
+}
+
+// Same as frame_process.comp, in float
+float mix(float a, float b, float t) { return a * (1 - t) + b * t; }
+
+float linearToSrgb(float c) {
+	return c < 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+}
+
+Rgba sharpen(const Image &input, const Constants &c, float u, float v) {
+	float texelU = 1.f / input.width, texelV = 1.f / input.height;
+	float neighbourWeight = -c.sharpening / 8.f;
+
+	auto center = input.sample(u, v);
+	Rgba color = {center.r * (c.sharpening + 1), center.g * (c.sharpening + 1), center.b * (c.sharpening + 1), 1};
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			if (x != 0 || y != 0) {
+				auto neighbour = input.sample(u + x * texelU, v + y * texelV);
+				color.r += neighbour.r * neighbourWeight;
+				color.g += neighbour.g * neighbourWeight;
+				color.b += neighbour.b * neighbourWeight;
+			}
+		}
+	}
+	return color;
+}
+
+Rgba correctColor(Rgba color, const Constants &c) {
+	float *channels[3] = {&color.r, &color.g, &color.b};
+	for (auto channel : channels) {
+		*channel = (*channel + c.brightness - 0.5f) * c.contrast + 0.5f;
+	}
+	float luma = color.r * 0.299f + color.g * 0.587f + color.b * 0.114f;
+	for (auto channel : channels) {
+		*channel = std::max(mix(luma, *channel, c.saturation), *channel);
+		*channel = std::pow(std::min(std::max(*channel, 0.f), 1.f), 1.f / c.gamma);
+	}
+	return color;
+}
+
+// main() of frame_process.comp without reprojection, which is covered by reprojection_test.cpp
+Rgba processShader(const Image &input, const Constants &c, int eye, int x, int y) {
+	int eyeWidth = input.width / 2;
+	float u = (x + 0.5f) / eyeWidth, v = (y + 0.5f) / input.height;
+	float sampleU = (u + eye) * 0.5f;
+
+	Rgba color;
+	if (c.flags & FLAG_COLOR_CORRECTION) {
+		color = correctColor(sharpen(input, c, sampleU, v), c);
+	} else {
+		color = input.sample(sampleU, v);
+	}
+
+	if (c.flags & FLAG_ENCODE_SRGB) {
+		color = {linearToSrgb(color.r), linearToSrgb(color.g), linearToSrgb(color.b), color.a};
+	}
+	if (c.flags & FLAG_SWAP_RED_BLUE) {
+		color = {color.b, color.g, color.r, color.a};
+	}
+	return color;
+}
+
+// main() of ColorCorrectionPixelShader.hlsl, in double, with the parameters of FrameRender.cpp
+Rgba colorCorrectionHlsl(const Image &input, const ColorCorrection &settings, int eye, int x, int y) {
+	double brightness = settings.brightness, contrast = settings.contrast + 1.,
+	       saturation = settings.saturation + 1., gamma = settings.gamma, sharpening = settings.sharpening;
+
+	int eyeWidth = input.width / 2;
+	auto texel = [&](int dx, int dy) {
+		int tx = std::min(std::max(eye * eyeWidth + x + dx, 0), input.width - 1);
+		int ty = std::min(std::max(y + dy, 0), input.height - 1);
+		auto t = input.texels[ty * input.width + tx];
+		return std::vector<double>{t.r, t.g, t.b};
+	};
+
+	auto center = texel(0, 0);
+	std::vector<double> pixel(3);
+	for (int i = 0; i < 3; i++) {
+		pixel[i] = center[i] * (sharpening + 1.);
+	}
+	const int offsets[8][2] = {{-1, -1}, {0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}};
+	for (auto &offset : offsets) {
+		auto neighbour = texel(offset[0], offset[1]);
+		for (int i = 0; i < 3; i++) {
+			pixel[i] += neighbour[i] * (-sharpening / 8.);
+		}
+	}
+
+	for (auto &p : pixel) {
+		p += brightness;
+		p = (p - 0.5) * contrast + 0.5;
+	}
+	double luma = pixel[0] * 0.299 + pixel[1] * 0.587 + pixel[2] * 0.114;
+	for (auto &p : pixel) {
+		p = std::max(luma + (p - luma) * saturation, p);
+		p = std::pow(std::min(std::max(p, 0.), 1.), 1. / gamma);
+	}
+	return {(float)pixel[0], (float)pixel[1], (float)pixel[2], 1};
+}
+
+bool near(const Rgba &a, const Rgba &b, float tolerance) {
+	return std::abs(a.r - b.r) <= tolerance && std::abs(a.g - b.g) <= tolerance &&
+	       std::abs(a.b - b.b) <= tolerance && std::abs(a.a - b.a) <= tolerance;
+}
+
+Image testImage(int eyeWidth, int height) {
+	Image image = {eyeWidth * 2, height, {}};
+	uint32_t state = 12345;
+	auto next = [&] {
+		state = state * 1664525 + 1013904223;
+		return (state >> 8) / float(1 << 24);
+	};
+	for (int i = 0; i < image.width * image.height; i++) {
+		image.texels.push_back({next(), next(), next(), 1});
+	}
+	return image;
+}
+} // namespace
+
+int main() {
+	const int EYE_WIDTH = 24, HEIGHT = 16;
+	const auto image = testImage(EYE_WIDTH, HEIGHT);
+	const float MAX_ERROR = 1e-5f;
+
+	// The default settings of the dashboard
+	const ColorCorrection defaults = {0, 0, 0.5f, 1, 0};
+	const ColorCorrection cases[] = {
+	    defaults,
+	    {0, 0, 0, 1, 0},
+	    {0.2f, -0.3f, 0.8f, 1.4f, 0},
+	    {-0.1f, 0.5f, -0.5f, 0.7f, 0.8f},
+	    {0, 0, 0, 1, 2},
+	};
+
+	// Same result as the Windows driver, in both eyes
+	for (auto &settings : cases) {
+		auto constants = pushConstants(&settings, 0);
+		for (int eye = 0; eye < 2; eye++) {
+			for (int y = 0; y < HEIGHT; y++) {
+				for (int x = 0; x < EYE_WIDTH; x++) {
+					auto shader = processShader(image, constants, eye, x, y);
+					auto reference = colorCorrectionHlsl(image, settings, eye, x, y);
+					check(near(shader, reference, MAX_ERROR), "same as the Windows driver", eye, x, y);
+				}
+			}
+		}
+	}
+
+	// Neutral settings leave the frame unchanged, and so does sharpening a flat area
+	const ColorCorrection neutral = {0, 0, 0, 1, 0}, sharpenOnly = {0, 0, 0, 1, 1.5f};
+	Image flat = {EYE_WIDTH * 2, HEIGHT, std::vector<Rgba>(EYE_WIDTH * 2 * HEIGHT, Rgba{0.3f, 0.6f, 0.2f, 1})};
+	for (int eye = 0; eye < 2; eye++) {
+		for (int y = 0; y < HEIGHT; y++) {
+			for (int x = 0; x < EYE_WIDTH; x++) {
+				auto input = image.texels[y * image.width + eye * EYE_WIDTH + x];
+				check(near(processShader(image, pushConstants(&neutral, 0), eye, x, y), input, MAX_ERROR),
+				      "neutral settings", eye, x, y);
+				check(near(processShader(image, pushConstants(nullptr, 0), eye, x, y), input, 0),
+				      "no color correction", eye, x, y);
+				check(near(processShader(flat, pushConstants(&sharpenOnly, 0), eye, x, y), flat.texels[0], MAX_ERROR),
+				      "sharpened flat area", eye, x, y);
+
+				// saturation only lightens
+				auto saturated = processShader(image, pushConstants(&defaults, 0), eye, x, y);
+				check(saturated.r >= input.r - MAX_ERROR && saturated.g >= input.g - MAX_ERROR &&
+				          saturated.b >= input.b - MAX_ERROR,
+				      "saturation lightens only", eye, x, y);
+			}
+		}
+	}
+
+	// The output format conversion of sRGB and BGRA encoder inputs
+	const struct {
+		float linear, srgb;
+	} srgbPoints[] = {{0, 0}, {0.002f, 0.002f * 12.92f}, {0.0031308f, 0.040450f}, {0.2f, 0.484529f},
+	                  {0.5f, 0.735357f}, {1, 1}};
+	for (auto &point : srgbPoints) {
+		Image pixel = {2, 1, {{point.linear, 0.5f, 0, 1}, {0, 0, 0, 1}}};
+		auto srgb = processShader(pixel, pushConstants(nullptr, FLAG_ENCODE_SRGB), 0, 0, 0);
+		check(std::abs(srgb.r - point.srgb) < 1e-4f, "sRGB encoding", 0, 0, 0);
+		auto bgra = processShader(pixel, pushConstants(nullptr, FLAG_SWAP_RED_BLUE | FLAG_ENCODE_SRGB), 0, 0, 0);
+		check(bgra.b == srgb.r && bgra.g == srgb.g && bgra.r == srgb.b && bgra.a == 1, "BGRA output", 0, 0, 0);
+	}
+
+	if (failures > 0) {
+		printf("%d failures\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all passed\n");
+	return EXIT_SUCCESS;
+}
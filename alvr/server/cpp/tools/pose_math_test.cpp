@@ -0,0 +1,483 @@
+// Tests of alvr_server/include/pose_math.h against the helpers it replaced (Utils.h, openvr_math.h
+// and the vulkan layer before posemath), and a microbenchmark of both with --bench.
+// Not part of the driver build (build.rs skips the tools directory). From this directory:
+//   c++ -std=c++17 -O2 -I../alvr_server/include pose_math_test.cpp -o /tmp/pose_math_test
+//   /tmp/pose_math_test [--bench]
+// Add -DPOSEMATH_NO_SIMD to test the scalar code.
+
+#include "pose_math.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+// Same layouts as the OpenVR types
+struct HmdQuaternion_t {
+	double w, x, y, z;
+};
+struct HmdQuaternionf_t {
+	float w, x, y, z;
+};
+struct HmdMatrix34_t {
+	float m[3][4];
+};
+struct HmdVector4_t {
+	float v[4];
+};
+struct VRBoneTransform_t {
+	HmdVector4_t position;
+	HmdQuaternionf_t orientation;
+};
+
+namespace old {
+HmdQuaternion_t operator*(const HmdQuaternion_t &lhs, const HmdQuaternion_t &rhs) {
+	return {
+		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
+		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
+		(lhs.w * rhs.y) + (lhs.y * rhs.w) + (lhs.z * rhs.x) - (lhs.x * rhs.z),
+		(lhs.w * rhs.z) + (lhs.z * rhs.w) + (lhs.x * rhs.y) - (lhs.y * rhs.x)
+	};
+}
+
+HmdQuaternion_t HmdQuaternion_Conjugate(const HmdQuaternion_t *q) {
+	return {q->w, -q->x, -q->y, -q->z};
+}
+
+HmdQuaternion_t HmdQuaternion_Inverse(const HmdQuaternion_t *q) {
+	auto res = HmdQuaternion_Conjugate(q);
+	double norm = res.w * res.w + res.x * res.x + res.y * res.y + res.z * res.z;
+	return {res.w / norm, res.x / norm, res.y / norm, res.z / norm};
+}
+
+void HmdMatrix_QuatToMat(double w, double x, double y, double z, HmdMatrix34_t *pMatrix) {
+	pMatrix->m[0][0] = (float)(1.0f - 2.0f * y * y - 2.0f * z * z);
+	pMatrix->m[0][1] = (float)(2.0f * x * y - 2.0f * z * w);
+	pMatrix->m[0][2] = (float)(2.0f * x * z + 2.0f * y * w);
+	pMatrix->m[0][3] = (float)(0.0f);
+	pMatrix->m[1][0] = (float)(2.0f * x * y + 2.0f * z * w);
+	pMatrix->m[1][1] = (float)(1.0f - 2.0f * x * x - 2.0f * z * z);
+	pMatrix->m[1][2] = (float)(2.0f * y * z - 2.0f * x * w);
+	pMatrix->m[1][3] = (float)(0.0f);
+	pMatrix->m[2][0] = (float)(2.0f * x * z - 2.0f * y * w);
+	pMatrix->m[2][1] = (float)(2.0f * y * z + 2.0f * x * w);
+	pMatrix->m[2][2] = (float)(1.0f - 2.0f * x * x - 2.0f * y * y);
+	pMatrix->m[2][3] = (float)(0.0f);
+}
+
+posemath::Vec3<double> quaternionRotateVector(const HmdQuaternion_t &quat, const posemath::Vec3<double> &vector, bool reverse) {
+	HmdQuaternion_t pin = {0.0, vector.x, vector.y, vector.z};
+	auto pout = reverse ? HmdQuaternion_Conjugate(&quat) * pin * quat : quat * pin * HmdQuaternion_Conjugate(&quat);
+	return {pout.x, pout.y, pout.z};
+}
+
+HmdMatrix34_t matMul33(const HmdMatrix34_t &a, const HmdMatrix34_t &b) {
+	HmdMatrix34_t result;
+	for (unsigned i = 0; i < 3; i++) {
+		for (unsigned j = 0; j < 3; j++) {
+			result.m[i][j] = 0.0f;
+			for (unsigned k = 0; k < 3; k++) {
+				result.m[i][j] += a.m[i][k] * b.m[k][j];
+			}
+		}
+	}
+	return result;
+}
+
+float distance33(const HmdMatrix34_t &a, const HmdMatrix34_t &b) {
+	float distance = 0;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			distance += powf(a.m[i][j] - b.m[i][j], 2);
+		}
+	}
+	return distance;
+}
+
+HmdVector4_t Lerp(HmdVector4_t &v1, HmdVector4_t &v2, double lambda) {
+	HmdVector4_t res;
+	res.v[0] = (float)((1 - lambda) * v1.v[0] + lambda * v2.v[0]);
+	res.v[1] = (float)((1 - lambda) * v1.v[1] + lambda * v2.v[1]);
+	res.v[2] = (float)((1 - lambda) * v1.v[2] + lambda * v2.v[2]);
+	res.v[3] = 1;
+	return res;
+}
+
+HmdQuaternionf_t Slerp(HmdQuaternionf_t &q1, HmdQuaternionf_t &q2, double lambda) {
+	if (q1.w != q2.w || q1.x != q2.x || q1.y != q2.y || q1.z != q2.z) {
+		float dotproduct = q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+		float theta, st, sut, sout, coeff1, coeff2;
+
+		theta = (float)acos(dotproduct);
+		if (theta < 0.0) theta = -theta;
+
+		st = (float)sin(theta);
+		sut = (float)sin(lambda * theta);
+		sout = (float)sin((1 - lambda) * theta);
+		coeff1 = sout / st;
+		coeff2 = sut / st;
+
+		HmdQuaternionf_t res;
+		res.w = coeff1 * q1.w + coeff2 * q2.w;
+		res.x = coeff1 * q1.x + coeff2 * q2.x;
+		res.y = coeff1 * q1.y + coeff2 * q2.y;
+		res.z = coeff1 * q1.z + coeff2 * q2.z;
+
+		// squared norm, the result is not normalized
+		float norm = res.w * res.w + res.x * res.x + res.y * res.y + res.z * res.z;
+		res.w /= norm;
+		res.x /= norm;
+		res.y /= norm;
+		res.z /= norm;
+
+		return res;
+	} else {
+		return q1;
+	}
+}
+} // namespace old
+
+int failures = 0;
+
+void check(bool condition, const char *what, double value) {
+	if (!condition) {
+		printf("FAIL: %s (%g)\n", what, value);
+		failures++;
+	}
+}
+
+std::mt19937 rng(42);
+
+double uniform(double min, double max) {
+	return std::uniform_real_distribution<double>(min, max)(rng);
+}
+
+HmdQuaternion_t randomRotation() {
+	std::normal_distribution<double> normal;
+	HmdQuaternion_t q = {normal(rng), normal(rng), normal(rng), normal(rng)};
+	return posemath::normalize(q);
+}
+
+HmdQuaternionf_t toFloat(const HmdQuaternion_t &q) {
+	return {float(q.w), float(q.x), float(q.y), float(q.z)};
+}
+
+// The same rotation: q and -q are equivalent
+double rotationDistance(const HmdQuaternion_t &a, const HmdQuaternion_t &b) {
+	double d = std::abs(posemath::dot(posemath::normalize(a), posemath::normalize(b)));
+	return 2 * std::acos(std::min(d, 1.));
+}
+
+double maxDifference(const HmdMatrix34_t &a, const HmdMatrix34_t &b, int columns = 4) {
+	double d = 0;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < columns; j++) {
+			d = std::max(d, double(std::abs(a.m[i][j] - b.m[i][j])));
+		}
+	}
+	return d;
+}
+
+double maxDifference(const posemath::Vec3<double> &a, const posemath::Vec3<double> &b) {
+	return std::max({std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z)});
+}
+
+const int COUNT = 10000;
+
+void TestQuaternions() {
+	double maxMatrix = 0, maxRotate = 0, maxInverse = 0, maxNonUnitInverse = 0;
+	for (int n = 0; n < COUNT; n++) {
+		auto q = randomRotation();
+
+		HmdMatrix34_t newMatrix, oldMatrix;
+		posemath::quatToMat33(q, newMatrix);
+		old::HmdMatrix_QuatToMat(q.w, q.x, q.y, q.z, &oldMatrix);
+		maxMatrix = std::max(maxMatrix, maxDifference(newMatrix, oldMatrix));
+
+		posemath::Vec3<double> v = {uniform(-2, 2), uniform(-2, 2), uniform(-2, 2)};
+		maxRotate = std::max(maxRotate, maxDifference(posemath::rotateVector(q, v), old::quaternionRotateVector(q, v, false)));
+		maxRotate = std::max(maxRotate, maxDifference(posemath::rotateVectorInverse(q, v), old::quaternionRotateVector(q, v, true)));
+
+		// the conjugate is the inverse of a unit quaternion
+		auto oldInverse = old::HmdQuaternion_Inverse(&q);
+		maxInverse = std::max(maxInverse, rotationDistance(posemath::conjugate(q), oldInverse));
+
+		HmdQuaternion_t scaled = {q.w * 3, q.x * 3, q.y * 3, q.z * 3};
+		auto identity = posemath::multiply<HmdQuaternion_t>(posemath::inverse(scaled), scaled);
+		maxNonUnitInverse = std::max({maxNonUnitInverse, std::abs(identity.w - 1), std::abs(identity.x),
+		                              std::abs(identity.y), std::abs(identity.z)});
+		auto oldScaledInverse = old::HmdQuaternion_Inverse(&scaled);
+		auto newScaledInverse = posemath::inverse(scaled);
+		maxNonUnitInverse = std::max({maxNonUnitInverse, std::abs(newScaledInverse.w - oldScaledInverse.w),
+		                              std::abs(newScaledInverse.x - oldScaledInverse.x)});
+	}
+	printf("quatToMat33 %.2g, rotateVector %.2g, conjugate %.2g rad, inverse %.2g\n",
+	       maxMatrix, maxRotate, maxInverse, maxNonUnitInverse);
+	check(maxMatrix < 1e-6, "quatToMat33 differs from HmdMatrix_QuatToMat", maxMatrix);
+	check(maxRotate < 1e-12, "rotateVector differs from quaternionRotateVector", maxRotate);
+	check(maxInverse < 1e-6, "conjugate differs from HmdQuaternion_Inverse", maxInverse);
+	check(maxNonUnitInverse < 1e-12, "inverse of a non unit quaternion", maxNonUnitInverse);
+}
+
+void TestMatrices() {
+	double maxMul = 0, maxTranspose = 0, maxDistance = 0;
+	for (int n = 0; n < COUNT; n++) {
+		HmdMatrix34_t a, b;
+		posemath::quatToMat33(randomRotation(), a);
+		posemath::quatToMat33(randomRotation(), b);
+		a.m[1][3] = 5;
+
+		// the old matMul33 left the translation uninitialized
+		maxMul = std::max(maxMul, maxDifference(posemath::matMul33(a, b), old::matMul33(a, b), 3));
+
+		// rotations are orthonormal
+		auto identity = posemath::matMul33(a, posemath::transposeMul33(a));
+		HmdMatrix34_t expected = {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}};
+		maxTranspose = std::max(maxTranspose, maxDifference(identity, expected));
+		check(posemath::transposeMul33(a).m[1][3] == 5, "transposeMul33 keeps the translation", 0);
+
+		float oldDistance = old::distance33(a, b);
+		maxDistance = std::max(maxDistance, double(std::abs(posemath::distance33(a, b) - oldDistance)) / oldDistance);
+	}
+	printf("matMul33 %.2g, transposeMul33 %.2g, distance33 %.2g relative\n", maxMul, maxTranspose, maxDistance);
+	check(maxMul < 1e-6, "matMul33", maxMul);
+	check(maxTranspose < 1e-6, "transposeMul33", maxTranspose);
+	check(maxDistance < 1e-5, "distance33", maxDistance);
+}
+
+void TestSlerp() {
+	double maxOld = 0, maxOldNormError = 0, maxNormError = 0, maxHalf = 0;
+	for (int n = 0; n < COUNT; n++) {
+		auto a = toFloat(randomRotation());
+		auto b = toFloat(randomRotation());
+		// no shortest path selection, in both versions
+		if (posemath::dot(a, b) < 0) {
+			b = {-b.w, -b.x, -b.y, -b.z};
+		}
+		double t = uniform(0, 1);
+
+		auto r = posemath::slerp(a, b, t);
+		auto o = old::Slerp(a, b, t);
+		HmdQuaternion_t rd = {r.w, r.x, r.y, r.z}, od = {o.w, o.x, o.y, o.z};
+		maxOld = std::max(maxOld, rotationDistance(rd, od));
+		maxNormError = std::max(maxNormError, std::abs(std::sqrt(posemath::dot(rd, rd)) - 1));
+		maxOldNormError = std::max(maxOldNormError, std::abs(std::sqrt(posemath::dot(od, od)) - 1));
+
+		// a rotation at the half angle, within the precision of acos near 1
+		HmdQuaternion_t ad = {a.w, a.x, a.y, a.z}, bd = {b.w, b.x, b.y, b.z};
+		auto half = posemath::slerp(ad, bd, 0.5);
+		maxHalf = std::max(maxHalf, std::abs(rotationDistance(ad, half) - rotationDistance(half, bd)));
+	}
+
+	// near identical rotations: acos of a dot product rounded above 1 must not give NaN
+	auto a = toFloat(randomRotation());
+	auto b = a;
+	b.w = std::nextafter(b.w, 2.f);
+	auto r = posemath::slerp(a, b, 0.3);
+	check(std::isfinite(r.w) && std::isfinite(r.x), "slerp of near identical rotations", r.w);
+
+	auto endA = posemath::slerp(a, toFloat(randomRotation()), 0);
+	check(rotationDistance({endA.w, endA.x, endA.y, endA.z}, {a.w, a.x, a.y, a.z}) < 1e-3, "slerp t = 0", 0);
+
+	printf("slerp: %.2g rad from the old Slerp, norm error %.2g (old Slerp %.2g), half angle %.2g rad\n",
+	       maxOld, maxNormError, maxOldNormError, maxHalf);
+	check(maxOld < 1e-3, "slerp differs from Slerp", maxOld);
+	check(maxNormError < 1e-6, "slerp is normalized", maxNormError);
+	check(maxHalf < 1e-6, "slerp half angle", maxHalf);
+}
+
+void TestBlendBones() {
+	const int BONES = 31;
+	VRBoneTransform_t a[BONES], b[BONES], out[BONES];
+	for (int i = 0; i < BONES; i++) {
+		a[i] = {{{float(uniform(-1, 1)), float(uniform(-1, 1)), float(uniform(-1, 1)), 1}}, toFloat(randomRotation())};
+		b[i] = {{{float(uniform(-1, 1)), float(uniform(-1, 1)), float(uniform(-1, 1)), 1}}, a[i].orientation};
+		b[i].orientation.w += 0.1f;
+		b[i].orientation = posemath::normalize(b[i].orientation);
+	}
+	float t = 0.3f;
+	posemath::blendBones(a, b, out, BONES, t);
+
+	double maxPosition = 0, maxOrientation = 0;
+	for (int i = 0; i < BONES; i++) {
+		auto position = old::Lerp(a[i].position, b[i].position, t);
+		auto orientation = old::Slerp(a[i].orientation, b[i].orientation, t);
+		for (int k = 0; k < 4; k++) {
+			maxPosition = std::max(maxPosition, double(std::abs(position.v[k] - out[i].position.v[k])));
+		}
+		maxOrientation = std::max(maxOrientation,
+		                          rotationDistance({orientation.w, orientation.x, orientation.y, orientation.z},
+		                                           {out[i].orientation.w, out[i].orientation.x, out[i].orientation.y, out[i].orientation.z}));
+	}
+	printf("blendBones: position %.2g, orientation %.2g rad\n", maxPosition, maxOrientation);
+	check(maxPosition < 1e-6, "blendBones position", maxPosition);
+	check(maxOrientation < 1e-3, "blendBones orientation", maxOrientation);
+}
+
+void TestBatch() {
+	const size_t N = 36;
+	posemath::Mat33Batch<N> batch;
+	std::vector<HmdMatrix34_t> model;
+
+	// the same operations as PoseHistory
+	for (int n = 0; n < 500; n++) {
+		HmdMatrix34_t m;
+		posemath::quatToMat33(randomRotation(), m);
+		if (model.size() == N) {
+			model.erase(model.begin());
+			batch.erase(0);
+		}
+		size_t index = std::uniform_int_distribution<size_t>(0, model.size())(rng);
+		model.insert(model.begin() + index, m);
+		batch.insert(index, m);
+
+		check(batch.count == model.size(), "batch size", batch.count);
+		for (size_t k = 0; k < model.size(); k++) {
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) {
+					if (batch.m[i][j][k] != model[k].m[i][j]) {
+						check(false, "batch content", k);
+						return;
+					}
+				}
+			}
+		}
+
+		HmdMatrix34_t pose;
+		posemath::quatToMat33(randomRotation(), pose);
+		// the loop of PoseHistory::GetBestPoseMatch() before the batch
+		float minDistance = INFINITY;
+		for (size_t k = 0; k < model.size(); k++) {
+			float distance = posemath::distance33(model[k], pose);
+			if (distance < minDistance) {
+				minDistance = distance;
+			}
+		}
+		size_t nearest = posemath::nearest33(batch, pose);
+		if (nearest >= model.size()) {
+			check(false, "nearest33 past the count", nearest);
+			return;
+		}
+		check(posemath::distance33(model[nearest], pose) <= minDistance * (1 + 1e-6f), "nearest33", nearest);
+		// the matrix itself is the nearest
+		check(posemath::nearest33(batch, model[index]) == index, "nearest33 of a batch matrix", index);
+	}
+	printf("Mat33Batch: insert, erase and nearest33 match the list\n");
+}
+
+volatile double sink;
+
+template<typename F> void benchmark(const char *name, int iterations, F f) {
+	auto start = std::chrono::steady_clock::now();
+	double sum = 0;
+	for (int i = 0; i < iterations; i++) {
+		sum += f(i);
+	}
+	sink = sum;
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	printf("%-40s %8.2f ns\n", name, ns / iterations);
+}
+
+void Benchmark() {
+	const int ITERATIONS = 2000000;
+	const int SIZE = 1024;
+	std::vector<HmdQuaternion_t> quats(SIZE);
+	std::vector<HmdQuaternionf_t> quatsf(SIZE);
+	std::vector<HmdMatrix34_t> matrices(SIZE);
+	for (int i = 0; i < SIZE; i++) {
+		quats[i] = randomRotation();
+		quatsf[i] = toFloat(quats[i]);
+		posemath::quatToMat33(quats[i], matrices[i]);
+	}
+	posemath::Vec3<double> v = {0.1, 0.2, 0.3};
+
+	benchmark("old HmdMatrix_QuatToMat", ITERATIONS, [&](int i) {
+		HmdMatrix34_t m;
+		auto &q = quats[i % SIZE];
+		old::HmdMatrix_QuatToMat(q.w, q.x, q.y, q.z, &m);
+		return m.m[0][1];
+	});
+	benchmark("quatToMat33", ITERATIONS, [&](int i) {
+		HmdMatrix34_t m;
+		posemath::quatToMat33(quats[i % SIZE], m);
+		return m.m[0][1];
+	});
+	benchmark("old quaternionRotateVector", ITERATIONS, [&](int i) {
+		return old::quaternionRotateVector(quats[i % SIZE], v, false).x;
+	});
+	benchmark("rotateVector", ITERATIONS, [&](int i) {
+		return posemath::rotateVector(quats[i % SIZE], v).x;
+	});
+	benchmark("old matMul33", ITERATIONS, [&](int i) {
+		return old::matMul33(matrices[i % SIZE], matrices[(i + 1) % SIZE]).m[1][1];
+	});
+	benchmark("matMul33", ITERATIONS, [&](int i) {
+		return posemath::matMul33(matrices[i % SIZE], matrices[(i + 1) % SIZE]).m[1][1];
+	});
+	benchmark("old Slerp", ITERATIONS, [&](int i) {
+		return old::Slerp(quatsf[i % SIZE], quatsf[(i + 1) % SIZE], 0.3).w;
+	});
+	benchmark("slerp", ITERATIONS, [&](int i) {
+		return posemath::slerp(quatsf[i % SIZE], quatsf[(i + 1) % SIZE], 0.3).w;
+	});
+
+	// pose history search over 36 poses
+	const size_t POSES = 36;
+	posemath::Mat33Batch<POSES> batch;
+	for (size_t k = 0; k < POSES; k++) {
+		batch.insert(k, matrices[k]);
+	}
+	benchmark("old distance33 loop, 36 poses", ITERATIONS / 10, [&](int i) {
+		auto &pose = matrices[i % SIZE];
+		size_t nearest = 0;
+		float minDistance = 100000;
+		for (size_t k = 0; k < POSES; k++) {
+			float distance = old::distance33(matrices[k], pose);
+			if (minDistance > distance) {
+				minDistance = distance;
+				nearest = k;
+			}
+		}
+		return double(nearest);
+	});
+	benchmark("distance33 loop, 36 poses", ITERATIONS / 10, [&](int i) {
+		auto &pose = matrices[i % SIZE];
+		size_t nearest = 0;
+		float minDistance = 100000;
+		for (size_t k = 0; k < POSES; k++) {
+			float distance = posemath::distance33(matrices[k], pose);
+			if (minDistance > distance) {
+				minDistance = distance;
+				nearest = k;
+			}
+		}
+		return double(nearest);
+	});
+	benchmark("nearest33, 36 poses", ITERATIONS / 10, [&](int i) {
+		return double(posemath::nearest33(batch, matrices[i % SIZE]));
+	});
+}
+} // namespace
+
+int main(int argc, char **argv) {
+	TestQuaternions();
+	TestMatrices();
+	TestSlerp();
+	TestBlendBones();
+	TestBatch();
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		Benchmark();
+	}
+
+	if (failures > 0) {
+		printf("%d failures\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all passed\n");
+	return EXIT_SUCCESS;
+}
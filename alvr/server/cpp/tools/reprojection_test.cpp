@@ -0,0 +1,156 @@
+// CPU reference of the rotational reprojection of platform/linux/shader/frame_process.comp,
+// checked against the reprojection computed from the poses.
+// Not part of the driver build (build.rs skips the tools directory). From this directory:
+//   c++ -std=c++17 -O2 -I../alvr_server/include reprojection_test.cpp -o /tmp/reprojection_test
+//   /tmp/reprojection_test
+
+#include "pose_math.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+struct Quat {
+	double w, x, y, z;
+};
+
+struct Mat34 {
+	float m[3][4];
+};
+
+struct Tangents {
+	float left, right, top, bottom;
+};
+
+struct Uv {
+	float u, v;
+	bool visible;
+};
+
+int failures = 0;
+
+void check(bool condition, const char *what, float u, float v) {
+	if (!condition) {
+		printf("FAIL: %s at uv (%f, %f)\n", what, u, v);
+		failures++;
+	}
+}
+
+// Same as FrameProcessor::Reproject()
+Mat34 reprojectionMatrix(const Quat &renderRotation, const Quat &newRotation) {
+	auto delta = posemath::multiply<Quat>(posemath::conjugate(renderRotation), newRotation);
+	Mat34 rotation;
+	posemath::quatToMat33(delta, rotation);
+	return rotation;
+}
+
+// Same as main() of frame_process.comp, in float
+Uv reprojectShader(const Mat34 &reprojection, const Tangents &t, float u, float v) {
+	float dir[3] = {-t.left + (t.right + t.left) * u, t.top + (-t.bottom - t.top) * v, -1.f};
+	float oldDir[3];
+	for (int row = 0; row < 3; row++) {
+		oldDir[row] = reprojection.m[row][0] * dir[0] + reprojection.m[row][1] * dir[1] +
+		              reprojection.m[row][2] * dir[2];
+	}
+
+	float tanX = oldDir[0] / -oldDir[2];
+	float tanY = oldDir[1] / -oldDir[2];
+	Uv uv = {(tanX + t.left) / (t.left + t.right), (t.top - tanY) / (t.top + t.bottom), false};
+	uv.visible = oldDir[2] < 0 && uv.u >= 0 && uv.v >= 0 && uv.u <= 1 && uv.v <= 1;
+	return uv;
+}
+
+// The view direction of the output pixel, rotated to the world with the new pose and back to the
+// rendered eye space with the old pose, in double
+Uv reprojectPoses(const Quat &renderRotation, const Quat &newRotation, const Tangents &t, double u, double v) {
+	posemath::Vec3<double> dir = {-t.left + (t.right + t.left) * u, t.top - (t.bottom + t.top) * v, -1};
+	auto world = posemath::rotateVector(newRotation, dir);
+	auto oldDir = posemath::rotateVectorInverse(renderRotation, world);
+
+	Uv uv = {float((oldDir.x / -oldDir.z + t.left) / (t.left + t.right)),
+	         float((t.top - oldDir.y / -oldDir.z) / (t.top + t.bottom)),
+	         false};
+	uv.visible = oldDir.z < 0 && uv.u >= 0 && uv.v >= 0 && uv.u <= 1 && uv.v <= 1;
+	return uv;
+}
+
+Quat axisAngle(double x, double y, double z, double degrees) {
+	double half = degrees * M_PI / 360;
+	double s = std::sin(half) / std::sqrt(x * x + y * y + z * z);
+	return {std::cos(half), x * s, y * s, z * s};
+}
+} // namespace
+
+int main() {
+	// Quest 2 left eye
+	const Tangents fov = {std::tan(float(52 * M_PI / 180)),
+	                      std::tan(float(44 * M_PI / 180)),
+	                      std::tan(float(53 * M_PI / 180)),
+	                      std::tan(float(56 * M_PI / 180))};
+	const int GRID = 64;
+
+	// Without motion the frame is unchanged
+	Quat rotation = axisAngle(0.3, 1, 0.2, 40);
+	auto identity = reprojectionMatrix(rotation, rotation);
+	for (int i = 0; i < GRID; i++) {
+		for (int j = 0; j < GRID; j++) {
+			float u = (i + 0.5f) / GRID, v = (j + 0.5f) / GRID;
+			auto uv = reprojectShader(identity, fov, u, v);
+			check(uv.visible && std::abs(uv.u - u) < 1e-5f && std::abs(uv.v - v) < 1e-5f,
+			      "identity", u, v);
+		}
+	}
+
+	// Turning the head left by a moves the image right: the center of the new view was rendered
+	// tan(a) left of the old center
+	const float YAW = 10;
+	auto yaw = reprojectionMatrix(Quat{1, 0, 0, 0}, axisAngle(0, 1, 0, YAW));
+	float centerU = fov.left / (fov.left + fov.right);
+	float centerV = fov.top / (fov.top + fov.bottom);
+	auto center = reprojectShader(yaw, fov, centerU, centerV);
+	float expectedU = (-std::tan(float(YAW * M_PI / 180)) + fov.left) / (fov.left + fov.right);
+	check(center.visible && std::abs(center.u - expectedU) < 1e-5f && std::abs(center.v - centerV) < 1e-5f,
+	      "yaw", centerU, centerV);
+
+	// Any motion: the shader matches the reprojection of the poses, within a tenth of a pixel of a
+	// 2k eye, and the areas that were not rendered are found
+	const Quat renderRotations[] = {{1, 0, 0, 0}, axisAngle(0.3, 1, 0.2, 40), axisAngle(1, 0, 0, -70)};
+	const Quat motions[] = {axisAngle(0, 1, 0, 2), axisAngle(1, 0, 0, -5), axisAngle(0, 0, 1, 15), axisAngle(1, 1, 1, 30)};
+	const float MAX_ERROR = 0.1f / 2048;
+	float maxError = 0;
+	for (auto &renderRotation : renderRotations) {
+		for (auto &motion : motions) {
+			auto newRotation = posemath::multiply<Quat>(renderRotation, motion);
+			auto reprojection = reprojectionMatrix(renderRotation, newRotation);
+			for (int i = 0; i < GRID; i++) {
+				for (int j = 0; j < GRID; j++) {
+					float u = (i + 0.5f) / GRID, v = (j + 0.5f) / GRID;
+					auto shader = reprojectShader(reprojection, fov, u, v);
+					auto reference = reprojectPoses(renderRotation, newRotation, fov, u, v);
+
+					// pixels on the border of the rendered area can go either way
+					bool onBorder = std::min({std::abs(reference.u), std::abs(reference.u - 1),
+					                          std::abs(reference.v), std::abs(reference.v - 1)}) < MAX_ERROR;
+					if (onBorder) {
+						continue;
+					}
+					check(shader.visible == reference.visible, "visibility", u, v);
+					if (shader.visible && reference.visible) {
+						float error = std::max(std::abs(shader.u - reference.u), std::abs(shader.v - reference.v));
+						maxError = std::max(maxError, error);
+						check(error < MAX_ERROR, "reprojected uv", u, v);
+					}
+				}
+			}
+		}
+	}
+
+	printf("max uv error %g (%g pixels of a 2048 wide eye)\n", maxError, maxError * 2048);
+	if (failures > 0) {
+		printf("%d failures\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all passed\n");
+	return EXIT_SUCCESS;
+}
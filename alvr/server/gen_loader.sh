@@ -15,7 +15,7 @@ mkdir -p cpp/platform/linux/generated
 #include <libavutil/hwcontext.h>
 #include <libavutil/hwcontext_vulkan.h>' \
 	--use-extern-c \
-	av_buffer_alloc av_buffer_ref av_buffer_unref av_dict_set av_frame_alloc av_frame_free av_frame_get_buffer av_frame_unref av_free av_hwdevice_ctx_create av_hwframe_ctx_alloc av_hwframe_ctx_init av_hwframe_get_buffer av_hwframe_map av_hwframe_transfer_data av_log_set_callback av_log_set_level av_opt_set av_strdup av_strerror av_vkfmt_from_pixfmt av_vk_frame_alloc
+	av_buffer_alloc av_buffer_ref av_buffer_unref av_dict_free av_dict_set av_frame_alloc av_frame_free av_frame_get_buffer av_frame_unref av_free av_hwdevice_ctx_create av_hwframe_ctx_alloc av_hwframe_ctx_init av_hwframe_get_buffer av_hwframe_map av_hwframe_transfer_data av_log_set_callback av_log_set_level av_opt_set av_strdup av_strerror av_vkfmt_from_pixfmt av_vk_frame_alloc
 
 ./generate_library_loader.py \
 	--name avcodec \
@@ -23,7 +23,7 @@ mkdir -p cpp/platform/linux/generated
 	--output-h cpp/platform/linux/generated/avcodec_loader.h \
 	--header '<libavcodec/avcodec.h>' \
 	--use-extern-c \
-	avcodec_alloc_context3 avcodec_find_encoder_by_name avcodec_free_context avcodec_open2 avcodec_receive_packet avcodec_send_frame av_packet_alloc av_packet_free
+	avcodec_alloc_context3 avcodec_find_decoder avcodec_find_encoder_by_name avcodec_free_context avcodec_open2 avcodec_receive_frame avcodec_receive_packet avcodec_send_frame avcodec_send_packet av_packet_alloc av_packet_free
 
 ./generate_library_loader.py \
 	--name avfilter \
@@ -42,4 +42,4 @@ mkdir -p cpp/platform/linux/generated
 	--output-h cpp/platform/linux/generated/swscale_loader.h \
 	--header '<libswscale/swscale.h>' \
 	--use-extern-c \
-	sws_getContext sws_scale
+	sws_freeContext sws_getContext sws_scale
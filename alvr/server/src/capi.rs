@@ -268,7 +268,15 @@ pub unsafe extern "C" fn alvr_initialize(
                 ptr::copy_nonoverlapping(buffer_ptr, vec_buffer.as_mut_ptr(), len as _);
             }
 
-            sender.send((header, vec_buffer)).ok();
+            sender
+                .send(crate::VideoPacket::Shard(header, vec_buffer))
+                .ok();
+        }
+    }
+
+    extern "C" fn video_flush() {
+        if let Some(sender) = &*crate::VIDEO_SENDER.lock() {
+            sender.send(crate::VideoPacket::EndOfFrame).ok();
         }
     }
 
@@ -319,6 +327,7 @@ pub unsafe extern "C" fn alvr_initialize(
     crate::LogDebug = Some(log_debug);
     crate::DriverReadyIdle = Some(driver_ready_idle);
     crate::VideoSend = Some(video_send);
+    crate::VideoFlush = Some(video_flush);
     crate::HapticsSend = Some(haptics_send);
     crate::TimeSyncSend = Some(time_sync_send);
     crate::ShutdownRuntime = Some(_shutdown_runtime);
@@ -5,8 +5,9 @@ use crate::{
         DRIVER_EVENT_SENDER,
     },
     connection_utils, ClientListAction, EyeFov, TimeSync, TrackingInfo, TrackingInfo_Controller,
-    TrackingInfo_Controller__bindgen_ty_1, TrackingQuat, TrackingVector3, CLIENTS_UPDATED_NOTIFIER,
-    HAPTICS_SENDER, RESTART_NOTIFIER, SESSION_MANAGER, TIME_SYNC_SENDER, VIDEO_SENDER,
+    TrackingInfo_Controller__bindgen_ty_1, TrackingQuat, TrackingVector3, VideoPacket,
+    CLIENTS_UPDATED_NOTIFIER, HAPTICS_SENDER, RESTART_NOTIFIER, SESSION_MANAGER, TIME_SYNC_SENDER,
+    VIDEO_SENDER,
 };
 use alvr_audio::{AudioDevice, AudioDeviceType};
 use alvr_common::{
@@ -16,18 +17,19 @@ use alvr_common::{
     HEAD_ID, LEFT_HAND_ID, RIGHT_HAND_ID,
 };
 use alvr_session::{
-    CodecType, Fov, FrameSize, OpenvrConfig, OpenvrPropValue, OpenvrPropertyKey, ServerEvent,
+    FecCodec, Fov, FrameSize, OpenvrConfig, OpenvrPropValue, OpenvrPropertyKey, ServerEvent,
+    VideoPacketSize,
 };
 <<<<<<< HEAD
-use alvr_session::{
-    CodecType, FrameSize, OpenvrConfig, OpenvrPropValue, OpenvrPropertyKey, ServerEvent,
-};
+use alvr_session::{FrameSize, OpenvrConfig, OpenvrPropValue, OpenvrPropertyKey, ServerEvent};
 =======
 >>>>>>> libalvr
 use alvr_sockets::{
     spawn_cancelable, ClientConfigPacket, ClientControlPacket, ControlSocketReceiver,
     ControlSocketSender, HeadsetInfoPacket, Input, MotionData, PeerType, PlayspaceSyncPacket,
-    ProtoControlSocket, ServerControlPacket, StreamSocketBuilder, AUDIO, HAPTICS, INPUT, VIDEO,
+    ProtoControlSocket, SendPriority, ServerControlPacket, StreamSocketBuilder, VideoHeaderEncoder,
+    AUDIO, DEFAULT_VIDEO_PACKET_SIZE, HAPTICS, INPUT, LEGACY_VIDEO_HEADER_VERSION, VIDEO,
+    VIDEO_HEADER_VERSION,
 };
 use futures::future::{BoxFuture, Either};
 use settings_schema::Switch;
@@ -52,6 +54,11 @@ const CONTROL_CONNECT_RETRY_PAUSE: Duration = Duration::from_millis(500);
 const RETRY_CONNECT_MIN_INTERVAL: Duration = Duration::from_secs(1);
 const NETWORK_KEEPALIVE_INTERVAL: Duration = Duration::from_secs(1);
 const CLEANUP_PAUSE: Duration = Duration::from_millis(500);
+const TRACKING_LOSS_REPORT_INTERVAL: Duration = Duration::from_secs(10);
+const VIDEO_SEND_REPORT_INTERVAL: Duration = Duration::from_secs(10);
+// Packets sent at once if the end of the frame is not reached, to bound the memory and the delay of
+// the first packet
+const MAX_VIDEO_BATCH_PACKETS: usize = 256;
 
 fn align32(value: f32) -> u32 {
     ((value / 32.).floor() * 32.) as u32
@@ -99,6 +106,7 @@ async fn client_discovery(auto_trust_clients: bool) -> StrResult<ClientId> {
 struct ConnectionInfo {
     client_ip: IpAddr,
     version: Option<Version>,
+    video_header_version: u32,
     control_sender: ControlSocketSender<ServerControlPacket>,
     control_receiver: ControlSocketReceiver<ClientControlPacket>,
 }
@@ -199,7 +207,15 @@ async fn client_handshake(
         0
     };
 
-    let version = Version::from_str(&headset_info.reserved).ok();
+    // reserved: client version, followed by the optional features supported by the client
+    let version = headset_info
+        .reserved
+        .split_whitespace()
+        .next()
+        .and_then(|version| Version::from_str(version).ok());
+    let video_header_version = alvr_sockets::video_header_from_str(&headset_info.reserved)
+        .map(|version| version.min(VIDEO_HEADER_VERSION))
+        .unwrap_or(LEGACY_VIDEO_HEADER_VERSION);
 
     let client_config = ClientConfigPacket {
         session_desc: {
@@ -215,7 +231,7 @@ async fn client_handshake(
         eye_resolution_height: video_eye_height,
         fps,
         game_audio_sample_rate,
-        reserved: "".into(),
+        reserved: alvr_sockets::video_header_to_string(video_header_version),
         server_version: version.clone(),
     };
     proto_socket.send(&client_config).await?;
@@ -254,9 +270,19 @@ async fn client_handshake(
         enable_vive_tracker_proxy: settings.headset.enable_vive_tracker_proxy,
         aggressive_keyframe_resend: settings.connection.aggressive_keyframe_resend,
         adapter_index: settings.video.adapter_index,
-        codec: matches!(settings.video.codec, CodecType::HEVC) as _,
+        codec: settings.video.codec as _,
         refresh_rate: fps as _,
         use_10bit_encoder: settings.video.use_10bit_encoder,
+        server_reprojection: settings.video.server_reprojection,
+        infinite_gop: settings.video.infinite_gop,
+        encoder_in_flight_frames: settings.video.encoder_in_flight_frames,
+        drop_late_frames: settings.video.drop_late_frames,
+        enable_frame_size_cap: session_settings.video.frame_size_cap.enabled,
+        frame_size_cap_intervals: session_settings
+            .video
+            .frame_size_cap
+            .content
+            .max_frame_intervals,
         encode_bitrate_mbs: settings.video.encode_bitrate_mbs,
         enable_adaptive_bitrate: session_settings.video.adaptive_bitrate.enabled,
         bitrate_maximum: session_settings
@@ -467,6 +493,7 @@ async fn client_handshake(
         gamma: session_settings.video.color_correction.content.gamma,
         sharpening: session_settings.video.color_correction.content.sharpening,
         enable_fec: session_settings.connection.enable_fec,
+        fec_codec: matches!(settings.connection.fec_codec, FecCodec::ReedSolomon16) as _,
     };
 
     if SESSION_MANAGER.lock().get().openvr_config != new_openvr_config {
@@ -486,6 +513,7 @@ async fn client_handshake(
     Ok(ConnectionInfo {
         client_ip,
         version,
+        video_header_version,
         control_sender,
         control_receiver,
     })
@@ -574,6 +602,7 @@ async fn connection_pipeline() -> StrResult {
     let ConnectionInfo {
         client_ip,
         version: _,
+        video_header_version,
         control_sender,
         mut control_receiver,
     } = connection_info;
@@ -611,6 +640,31 @@ async fn connection_pipeline() -> StrResult {
     };
     let stream_socket = Arc::new(stream_socket);
 
+    let video_packet_size = match settings.connection.video_packet_size {
+        VideoPacketSize::Auto { max_mtu } => {
+            match stream_socket.probe_mtu(max_mtu, client_ip).await {
+                Ok(Some(mtu)) => {
+                    info!("Path MTU: {mtu}");
+                    alvr_sockets::video_packet_size_for_mtu(mtu, client_ip)
+                }
+                Ok(None) => DEFAULT_VIDEO_PACKET_SIZE,
+                Err(e) => {
+                    warn!("MTU probe failed: {e}");
+                    DEFAULT_VIDEO_PACKET_SIZE
+                }
+            }
+        }
+        VideoPacketSize::Custom(size) => size,
+    };
+    control_sender
+        .lock()
+        .await
+        .send(&ServerControlPacket::Reserved(
+            alvr_sockets::video_packet_size_to_string(video_packet_size),
+        ))
+        .await?;
+    unsafe { crate::SetVideoPacketSize(video_packet_size) };
+
     alvr_session::log_event(ServerEvent::ClientConnected);
 
     {
@@ -668,7 +722,9 @@ async fn connection_pipeline() -> StrResult {
     let game_audio_loop: BoxFuture<_> = if let Switch::Enabled(desc) = settings.audio.game_audio {
         let device = AudioDevice::new(desc.device_id, AudioDeviceType::Output)?;
         let sample_rate = alvr_audio::get_sample_rate(&device)?;
-        let sender = stream_socket.request_stream(AUDIO).await?;
+        let sender = stream_socket
+            .request_stream_with_priority(AUDIO, SendPriority::Audio)
+            .await?;
         let mute_when_streaming = desc.mute_when_streaming;
 
         Box::pin(async move {
@@ -767,15 +823,58 @@ async fn connection_pipeline() -> StrResult {
     };
 
     let video_send_loop = {
-        let mut socket_sender = stream_socket.request_stream(VIDEO).await?;
+        // The header is written by VideoHeaderEncoder, the stream header is left empty
+        let mut socket_sender = stream_socket
+            .request_stream_with_priority::<()>(VIDEO, SendPriority::Video)
+            .await?;
+        let mut header_encoder = VideoHeaderEncoder::new(video_header_version);
         async move {
             let (data_sender, mut data_receiver) = tmpsc::unbounded_channel();
             *VIDEO_SENDER.lock() = Some(data_sender);
 
-            while let Some((header, data)) = data_receiver.recv().await {
-                let mut buffer = socket_sender.new_buffer(&header, data.len())?;
-                buffer.get_mut().extend(data);
-                socket_sender.send_buffer(buffer).await.ok();
+            let mut batch = vec![];
+            let mut frames = 0;
+            let mut queue_time = Duration::ZERO;
+            let mut last_report = time::Instant::now();
+            while let Some(packet) = data_receiver.recv().await {
+                match packet {
+                    VideoPacket::Shard(header, data) => {
+                        let mut buffer = socket_sender.new_buffer(&(), 64 + data.len())?;
+                        {
+                            let mut buffer = buffer.get_mut();
+                            header_encoder.encode(&header, data.len(), &mut buffer)?;
+                            buffer.extend(data);
+                        }
+                        batch.push(buffer);
+
+                        if batch.len() < MAX_VIDEO_BATCH_PACKETS {
+                            continue;
+                        }
+                    }
+                    VideoPacket::EndOfFrame => frames += 1,
+                }
+
+                // Waits only if the send queue is full
+                let queue_start = time::Instant::now();
+                socket_sender
+                    .send_buffers(std::mem::take(&mut batch))
+                    .await
+                    .ok();
+                queue_time += queue_start.elapsed();
+
+                if last_report.elapsed() > VIDEO_SEND_REPORT_INTERVAL {
+                    if let Some(stats) = socket_sender.take_send_stats() {
+                        debug!(
+                            "Video send: {} packets in {} system calls, {:.0}us per frame waiting for the queue",
+                            stats.packets,
+                            stats.syscalls,
+                            queue_time.as_secs_f32() * 1e6 / frames.max(1) as f32
+                        );
+                    }
+                    frames = 0;
+                    queue_time = Duration::ZERO;
+                    last_report = time::Instant::now();
+                }
             }
 
             Ok(())
@@ -802,7 +901,9 @@ async fn connection_pipeline() -> StrResult {
     };
 
     let haptics_send_loop = {
-        let mut socket_sender = stream_socket.request_stream(HAPTICS).await?;
+        let mut socket_sender = stream_socket
+            .request_stream_with_priority(HAPTICS, SendPriority::Realtime)
+            .await?;
         async move {
             let (data_sender, mut data_receiver) = tmpsc::unbounded_channel();
             *HAPTICS_SENDER.lock() = Some(data_sender);
@@ -855,9 +956,22 @@ async fn connection_pipeline() -> StrResult {
         async move {
             let mut old_ipd = 0_f32;
             let mut old_fov = Fov::default();
+            let mut last_frame_index = 0;
+            let mut last_client_time = 0;
+            // Inputs that never arrived, the ones whose pose was recovered from the next inputs,
+            // and how much newer the recovered poses are than the pose known before them
+            let mut lost_inputs = 0;
+            let mut recovered_inputs = 0;
+            let mut recovered_pose_age_gain = Duration::ZERO;
+            let mut last_loss_report = time::Instant::now();
             loop {
                 let input = receiver.recv().await?.header;
 
+                // An input arriving after a newer one would move the poses back in time
+                if input.legacy.frame_index <= last_frame_index {
+                    continue;
+                }
+
                 if let Some(sender) = &*DRIVER_EVENT_SENDER.lock() {
                     if f32::abs(input.views_config.ipd_m - old_ipd) > f32::EPSILON
                         || input.views_config.fov[0] != old_fov
@@ -1079,6 +1193,45 @@ async fn connection_pipeline() -> StrResult {
                 };
 
                 unsafe { crate::InputReceive(tracking_info) };
+
+                if last_frame_index != 0 {
+                    lost_inputs += input.legacy.frame_index - last_frame_index - 1;
+
+                    for pose in &input.redundant_poses {
+                        if pose.frame_index > last_frame_index {
+                            unsafe {
+                                crate::RedundantPoseReceive(
+                                    pose.frame_index,
+                                    pose.client_time,
+                                    pose.target_timestamp.as_secs_f64(),
+                                    to_tracking_quat(pose.orientation),
+                                    to_tracking_vector3(pose.position),
+                                )
+                            };
+                            recovered_inputs += 1;
+                            recovered_pose_age_gain += Duration::from_micros(
+                                pose.client_time.saturating_sub(last_client_time),
+                            );
+                        }
+                    }
+                }
+                last_frame_index = input.legacy.frame_index;
+                last_client_time = input.legacy.client_time;
+
+                if last_loss_report.elapsed() >= TRACKING_LOSS_REPORT_INTERVAL {
+                    if lost_inputs > 0 {
+                        debug!(
+                            "Tracking: {lost_inputs} inputs lost, {recovered_inputs} recovered \
+                            from the next ones, {:.1}ms newer on average",
+                            recovered_pose_age_gain.as_secs_f32() * 1000.
+                                / recovered_inputs.max(1) as f32
+                        );
+                    }
+                    lost_inputs = 0;
+                    recovered_inputs = 0;
+                    recovered_pose_age_gain = Duration::ZERO;
+                    last_loss_report = time::Instant::now();
+                }
             }
         }
     };
@@ -1217,6 +1370,13 @@ async fn connection_pipeline() -> StrResult {
         Ok(())
     };
 
+    // Haptics, audio and video packets are sent by this loop, in priority order. Time sync packets
+    // go through the control socket.
+    let send_loop = {
+        let stream_socket = Arc::clone(&stream_socket);
+        async move { stream_socket.send_loop().await }
+    };
+
     let receive_loop = async move { stream_socket.receive_loop().await };
 
     tokio::select! {
@@ -1229,6 +1389,7 @@ async fn connection_pipeline() -> StrResult {
 
             Ok(())
         },
+        res = spawn_cancelable(send_loop) => res,
         res = spawn_cancelable(game_audio_loop) => res,
         res = spawn_cancelable(microphone_loop) => res,
         res = spawn_cancelable(video_send_loop) => res,
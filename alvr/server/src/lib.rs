@@ -36,6 +36,12 @@ use tokio::{
     sync::{broadcast, mpsc, Notify},
 };
 
+// The packets of a frame are followed by EndOfFrame, so that they are sent together
+pub enum VideoPacket {
+    Shard(VideoFrameHeaderPacket, Vec<u8>),
+    EndOfFrame,
+}
+
 lazy_static! {
     // Since ALVR_DIR is needed to initialize logging, if error then just panic
     static ref FILESYSTEM_LAYOUT: Layout =
@@ -45,8 +51,7 @@ lazy_static! {
     static ref RUNTIME: Mutex<Option<Runtime>> = Mutex::new(Runtime::new().ok());
     static ref MAYBE_WINDOW: Mutex<Option<Arc<alcro::UI>>> = Mutex::new(None);
 
-    static ref VIDEO_SENDER: Mutex<Option<mpsc::UnboundedSender<(VideoFrameHeaderPacket, Vec<u8>)>>> =
-        Mutex::new(None);
+    static ref VIDEO_SENDER: Mutex<Option<mpsc::UnboundedSender<VideoPacket>>> = Mutex::new(None);
     static ref HAPTICS_SENDER: Mutex<Option<mpsc::UnboundedSender<Haptics>>> = Mutex::new(None);
     static ref TIME_SYNC_SENDER: Mutex<Option<mpsc::UnboundedSender<TimeSyncPacket>>> =
         Mutex::new(None);
@@ -318,7 +323,13 @@ pub unsafe extern "C" fn HmdDriverFactory(
                 ptr::copy_nonoverlapping(buffer_ptr, vec_buffer.as_mut_ptr(), len as _);
             }
 
-            sender.send((header, vec_buffer)).ok();
+            sender.send(VideoPacket::Shard(header, vec_buffer)).ok();
+        }
+    }
+
+    extern "C" fn video_flush() {
+        if let Some(sender) = &*VIDEO_SENDER.lock() {
+            sender.send(VideoPacket::EndOfFrame).ok();
         }
     }
 
@@ -397,6 +408,7 @@ pub unsafe extern "C" fn HmdDriverFactory(
     LogDebug = Some(log_debug);
     DriverReadyIdle = Some(driver_ready_idle);
     VideoSend = Some(video_send);
+    VideoFlush = Some(video_flush);
     HapticsSend = Some(haptics_send);
     TimeSyncSend = Some(time_sync_send);
     ShutdownRuntime = Some(_shutdown_runtime);
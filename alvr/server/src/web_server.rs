@@ -166,6 +166,13 @@ async fn http_api(
         }
         "/api/audio-devices" => reply_json(&alvr_audio::get_devices_list()?)?,
         "/api/graphics-devices" => reply_json(&graphics::get_gpu_names())?,
+        "/api/encoder/tune" => {
+            if trace_err!(tokio::task::spawn_blocking(|| unsafe { crate::TuneEncoders() }).await)? {
+                reply(StatusCode::OK)?
+            } else {
+                reply(StatusCode::INTERNAL_SERVER_ERROR)?
+            }
+        }
         "/restart-steamvr" => {
             crate::notify_restart_driver();
             reply(StatusCode::OK)?
@@ -62,6 +62,12 @@ pub struct OpenvrConfig {
     pub codec: u32,
     pub refresh_rate: u32,
     pub use_10bit_encoder: bool,
+    pub server_reprojection: bool,
+    pub infinite_gop: bool,
+    pub encoder_in_flight_frames: u32,
+    pub drop_late_frames: bool,
+    pub enable_frame_size_cap: bool,
+    pub frame_size_cap_intervals: f32,
     pub encode_bitrate_mbs: u64,
     pub enable_adaptive_bitrate: bool,
     pub bitrate_maximum: u64,
@@ -113,6 +119,7 @@ pub struct OpenvrConfig {
     pub gamma: f32,
     pub sharpening: f32,
     pub enable_fec: bool,
+    pub fec_codec: u32,
 }
 
 #[derive(Serialize, Deserialize, Clone, Debug)]
@@ -84,6 +84,14 @@ pub struct AdaptiveBitrateDesc {
     pub bitrate_light_load_threshold: f32,
 }
 
+#[derive(SettingsSchema, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+pub struct FrameSizeCapDesc {
+    // Longest transmit time of a single frame at the current bitrate, in frame intervals
+    #[schema(min = 1., max = 4., step = 0.1)]
+    pub max_frame_intervals: f32,
+}
+
 #[derive(SettingsSchema, Serialize, Deserialize)]
 #[serde(rename_all = "camelCase")]
 pub struct FoveatedRenderingDesc {
@@ -135,6 +143,7 @@ pub struct ColorCorrectionDesc {
 pub enum CodecType {
     H264,
     HEVC,
+    AV1,
 }
 
 #[derive(SettingsSchema, Serialize, Deserialize, Debug)]
@@ -183,9 +192,31 @@ pub struct VideoDesc {
 
     pub adaptive_bitrate: Switch<AdaptiveBitrateDesc>,
 
+    // Linux only
+    #[schema(advanced)]
+    pub frame_size_cap: Switch<FrameSizeCapDesc>,
+
     #[schema(advanced)]
     pub seconds_from_vsync_to_photons: f32,
 
+    // Linux only: reproject the last frame when the game misses a vsync
+    #[schema(advanced)]
+    pub server_reprojection: bool,
+
+    // Linux only: no periodic keyframes, only the ones requested after a loss
+    #[schema(advanced)]
+    pub infinite_gop: bool,
+
+    // Linux only: frames converted ahead of the encoder. 1 has the lowest latency, more overlap
+    // the conversion of a frame with the encoding of the previous ones
+    #[schema(advanced, min = 1, max = 4)]
+    pub encoder_in_flight_frames: u32,
+
+    // Frames that cannot be displayed in time anymore are dropped before encoding or sending on
+    // the server (Linux only), and not displayed on the headset
+    #[schema(advanced)]
+    pub drop_late_frames: bool,
+
     pub foveated_rendering: Switch<FoveatedRenderingDesc>,
     pub color_correction: Switch<ColorCorrectionDesc>,
 }
@@ -380,6 +411,11 @@ pub struct HeadsetDesc {
     #[schema(advanced)]
     pub tracking_frame_offset: i32,
 
+    // Head and controller poses sampled by the client per second. Rounded to a whole number of
+    // samples per display frame.
+    #[schema(advanced, min = 60, max = 1000, step = 10)]
+    pub tracking_rate: u32,
+
     #[schema(advanced)]
     pub position_offset: [f32; 3],
 
@@ -414,6 +450,29 @@ pub enum SocketProtocol {
     Tcp,
 }
 
+#[derive(SettingsSchema, Serialize, Deserialize, Clone, Copy, PartialEq, Eq)]
+#[serde(rename_all = "camelCase", tag = "type", content = "content")]
+pub enum FecCodec {
+    // GF(2^8), up to 20 shards per frame: large frames use multiple packets per shard
+    ReedSolomon8,
+    // GF(2^16) with FFT encoding/decoding, one packet per shard
+    ReedSolomon16,
+}
+
+#[derive(SettingsSchema, Serialize, Deserialize, Clone, Copy)]
+#[serde(rename_all = "camelCase", tag = "type", content = "content")]
+pub enum VideoPacketSize {
+    // Probe the path MTU when the stream starts, up to max_mtu
+    #[serde(rename_all = "camelCase")]
+    Auto {
+        #[schema(min = 576, max = 9000)]
+        max_mtu: u32,
+    },
+
+    #[schema(min = 500, max = 8900)]
+    Custom(u32),
+}
+
 #[derive(SettingsSchema, Serialize, Deserialize)]
 #[serde(rename_all = "camelCase")]
 pub struct DiscoveryConfig {
@@ -445,6 +504,17 @@ pub struct ConnectionDesc {
 
     #[schema(advanced)]
     pub enable_fec: bool,
+
+    #[schema(advanced)]
+    pub fec_codec: FecCodec,
+
+    #[schema(advanced)]
+    pub video_packet_size: VideoPacketSize,
+
+    // Head poses of the previous inputs repeated in every input, to fill the pose history of the
+    // server when an input is lost
+    #[schema(advanced, min = 0, max = 8)]
+    pub tracking_redundancy: u32,
 }
 
 #[derive(SettingsSchema, Serialize, Deserialize, Clone, Copy, PartialEq, Eq)]
@@ -570,7 +640,17 @@ pub fn session_settings_default() -> SettingsDefault {
                     bitrate_light_load_threshold: 0.7,
                 },
             },
+            frame_size_cap: SwitchDefault {
+                enabled: false,
+                content: FrameSizeCapDescDefault {
+                    max_frame_intervals: 1.5,
+                },
+            },
             seconds_from_vsync_to_photons: 0.005,
+            server_reprojection: false,
+            infinite_gop: false,
+            encoder_in_flight_frames: 1,
+            drop_late_frames: false,
             foveated_rendering: SwitchDefault {
                 enabled: !cfg!(target_os = "linux"),
                 content: FoveatedRenderingDescDefault {
@@ -583,7 +663,7 @@ pub fn session_settings_default() -> SettingsDefault {
                 },
             },
             color_correction: SwitchDefault {
-                enabled: true,
+                enabled: !cfg!(target_os = "linux"),
                 content: ColorCorrectionDescDefault {
                     brightness: 0.,
                     contrast: 0.,
@@ -641,6 +721,7 @@ pub fn session_settings_default() -> SettingsDefault {
             render_model_name: "generic_hmd".into(),
             registered_device_type: "oculus/1WMGH000XX0000".into(),
             tracking_frame_offset: 0,
+            tracking_rate: 360,
             position_offset: [0., 0., 0.],
             force_3dof: false,
             tracking_ref_only: false,
@@ -702,6 +783,15 @@ pub fn session_settings_default() -> SettingsDefault {
             on_connect_script: "".into(),
             on_disconnect_script: "".into(),
             enable_fec: true,
+            fec_codec: FecCodecDefault {
+                variant: FecCodecDefaultVariant::ReedSolomon8,
+            },
+            video_packet_size: VideoPacketSizeDefault {
+                variant: VideoPacketSizeDefaultVariant::Auto,
+                Auto: VideoPacketSizeAutoDefault { max_mtu: 1500 },
+                Custom: 1400,
+            },
+            tracking_redundancy: 0,
         },
         extra: ExtraDescDefault {
             theme: ThemeDefault {
@@ -1,6 +1,7 @@
 mod control_socket;
 mod packets;
 mod stream_socket;
+mod video_header;
 
 use alvr_common::prelude::*;
 use rand::Rng;
@@ -10,11 +11,13 @@ use std::net::{IpAddr, Ipv4Addr};
 pub use control_socket::*;
 pub use packets::*;
 pub use stream_socket::*;
+pub use video_header::*;
 
 pub const LOCAL_IP: IpAddr = IpAddr::V4(Ipv4Addr::UNSPECIFIED);
 pub const CONTROL_PORT: u16 = 9943;
 pub const MAX_HANDSHAKE_PACKET_SIZE_BYTES: usize = 4_000;
 
+// Framing of the TCP sockets. UDP datagrams are not framed, a datagram is a packet.
 type Ldc = tokio_util::codec::LengthDelimitedCodec;
 
 #[derive(Serialize, Deserialize, Clone)]
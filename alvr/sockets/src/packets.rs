@@ -12,6 +12,7 @@ pub const INPUT: StreamId = 0; // tracking and buttons
 pub const HAPTICS: StreamId = 1;
 pub const AUDIO: StreamId = 2;
 pub const VIDEO: StreamId = 3;
+pub const MTU_PROBE: StreamId = 4;
 
 #[derive(Serialize, Deserialize, Clone)]
 pub struct ClientHandshakePacket {
@@ -178,6 +179,17 @@ pub struct LegacyInput {
     pub hand_finger_confience: [u32; 2],
 }
 
+// Head pose of an earlier input, repeated in the next ones so that the server can fill its pose
+// history when an input is lost
+#[derive(Serialize, Deserialize, Clone)]
+pub struct RedundantPose {
+    pub frame_index: u64,
+    pub client_time: u64,
+    pub target_timestamp: Duration,
+    pub orientation: Quat,
+    pub position: Vec3,
+}
+
 #[derive(Serialize, Deserialize)]
 pub struct Input {
     pub target_timestamp: Duration,
@@ -186,6 +198,7 @@ pub struct Input {
     pub right_hand_tracking: Option<HandTrackingInput>, // unused for now
     pub button_values: HashMap<u64, ButtonValue>,      // unused for now
     pub legacy: LegacyInput,
+    pub redundant_poses: Vec<RedundantPose>, // oldest first
 }
 
 #[derive(Serialize, Deserialize)]
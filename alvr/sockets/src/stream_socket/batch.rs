@@ -0,0 +1,598 @@
+// Batched transmission and reception of datagrams, so that the packets of a video frame cross the
+// kernel boundary in a few system calls instead of one each.
+// On Linux and Android, runs of equal-sized datagrams are sent with a single sendmsg using UDP
+// generic segmentation offload (UDP_SEGMENT), the rest with sendmmsg. GSO is probed when the socket
+// is created and disabled if the kernel later refuses it (no checksum offload on the interface); if
+// sendmmsg is missing too, datagrams are sent one at a time, as on the other platforms.
+// Datagrams are received with recvmmsg into MTU-sized slots of a shared buffer, that is reused once
+// all the received packets have been dropped.
+// The socket must be connected. Each datagram is a packet, there is no framing.
+
+use alvr_common::prelude::*;
+use bytes::{BufMut, Bytes, BytesMut};
+use futures::{ready, Stream};
+use std::{
+    collections::VecDeque,
+    io,
+    pin::Pin,
+    sync::{
+        atomic::{AtomicBool, AtomicU64, Ordering},
+        Arc,
+    },
+    task::{Context, Poll},
+};
+use tokio::net::UdpSocket;
+
+// Size of the receive slots, enough for a datagram of the usual 1500 bytes MTU. It grows if a
+// bigger datagram is truncated (jumbo frames), which is then lost.
+const INITIAL_RECEIVE_SLOT_SIZE: usize = 2048;
+const MAX_RECEIVE_SLOT_SIZE: usize = 64 * 1024;
+const RECEIVE_BATCH: usize = 32;
+
+#[derive(Default, Clone, Copy)]
+pub struct BatchSendStats {
+    pub packets: u64,
+    pub syscalls: u64,
+}
+
+pub struct BatchSender {
+    socket: Arc<UdpSocket>,
+    gso: AtomicBool,
+    mmsg: AtomicBool,
+    packets: AtomicU64,
+    syscalls: AtomicU64,
+}
+
+impl BatchSender {
+    pub fn new(socket: Arc<UdpSocket>) -> Self {
+        #[cfg(any(target_os = "linux", target_os = "android"))]
+        let (gso, mmsg) = (sys::gso_supported(&socket), true);
+        #[cfg(not(any(target_os = "linux", target_os = "android")))]
+        let (gso, mmsg) = (false, false);
+
+        Self {
+            socket,
+            gso: AtomicBool::new(gso),
+            mmsg: AtomicBool::new(mmsg),
+            packets: AtomicU64::new(0),
+            syscalls: AtomicU64::new(0),
+        }
+    }
+
+    // Packets and system calls since the last call
+    pub fn take_stats(&self) -> BatchSendStats {
+        BatchSendStats {
+            packets: self.packets.swap(0, Ordering::Relaxed),
+            syscalls: self.syscalls.swap(0, Ordering::Relaxed),
+        }
+    }
+
+    // Returns once every datagram has been handed to the kernel, in order
+    pub async fn send(&self, datagrams: &[Bytes]) -> io::Result<()> {
+        self.packets
+            .fetch_add(datagrams.len() as u64, Ordering::Relaxed);
+
+        #[cfg(any(target_os = "linux", target_os = "android"))]
+        if self.mmsg.load(Ordering::Relaxed) {
+            return self.send_batched(datagrams).await;
+        }
+
+        for datagram in datagrams {
+            self.syscalls.fetch_add(1, Ordering::Relaxed);
+            match self.socket.send(datagram).await {
+                Ok(_) => (),
+                // The error was for an earlier datagram, this one was not sent
+                Err(e) if is_transient_error(&e) => {
+                    debug!("Ignored send error: {e}");
+                    self.syscalls.fetch_add(1, Ordering::Relaxed);
+                    self.socket.send(datagram).await?;
+                }
+                Err(e) => return Err(e),
+            }
+        }
+
+        Ok(())
+    }
+
+    #[cfg(any(target_os = "linux", target_os = "android"))]
+    async fn send_batched(&self, datagrams: &[Bytes]) -> io::Result<()> {
+        use tokio::io::Interest;
+
+        let mut sent = 0;
+        let mut retrying = false;
+        while sent < datagrams.len() {
+            self.socket.writable().await?;
+
+            match self
+                .socket
+                .try_io(Interest::WRITABLE, || self.send_some(&datagrams[sent..]))
+            {
+                Ok(count) => {
+                    sent += count;
+                    retrying = false;
+                }
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => (),
+                // The error was for an earlier datagram, nothing was sent: retry once
+                Err(e) if is_transient_error(&e) && !retrying => {
+                    debug!("Ignored send error: {e}");
+                    retrying = true;
+                }
+                Err(e) => return Err(e),
+            }
+        }
+
+        Ok(())
+    }
+
+    // Sends a prefix of the datagrams with one system call, returns how many were sent
+    #[cfg(any(target_os = "linux", target_os = "android"))]
+    fn send_some(&self, datagrams: &[Bytes]) -> io::Result<usize> {
+        let fd = std::os::unix::io::AsRawFd::as_raw_fd(&*self.socket);
+
+        if self.gso.load(Ordering::Relaxed) {
+            let (count, segment_size) = sys::gso_run(datagrams);
+            if count > 1 {
+                self.syscalls.fetch_add(1, Ordering::Relaxed);
+                match sys::send_msg(fd, &datagrams[..count], Some(segment_size)) {
+                    Ok(()) => return Ok(count),
+                    Err(e) if sys::is_gso_error(&e) => {
+                        self.gso.store(false, Ordering::Relaxed);
+                    }
+                    Err(e) => return Err(e),
+                }
+            }
+        }
+
+        self.syscalls.fetch_add(1, Ordering::Relaxed);
+        match sys::send_mmsg(fd, datagrams) {
+            Err(e) if e.raw_os_error() == Some(libc::ENOSYS) => {
+                self.mmsg.store(false, Ordering::Relaxed);
+                sys::send_msg(fd, &datagrams[..1], None).map(|_| 1)
+            }
+            res => res,
+        }
+    }
+}
+
+pub struct BatchReceiver {
+    socket: Arc<UdpSocket>,
+    // The received datagrams are split from the front of this buffer. reserve() reuses its
+    // allocation when all of them have been dropped.
+    buffer: BytesMut,
+    slot_size: usize,
+    received: VecDeque<BytesMut>,
+}
+
+impl BatchReceiver {
+    pub fn new(socket: Arc<UdpSocket>) -> Self {
+        // Without truncation detection a datagram bigger than the slot would be an error
+        let slot_size = if cfg!(any(target_os = "linux", target_os = "android")) {
+            INITIAL_RECEIVE_SLOT_SIZE
+        } else {
+            MAX_RECEIVE_SLOT_SIZE
+        };
+
+        Self {
+            socket,
+            buffer: BytesMut::new(),
+            slot_size,
+            received: VecDeque::with_capacity(RECEIVE_BATCH),
+        }
+    }
+
+    #[cfg(any(target_os = "linux", target_os = "android"))]
+    fn receive_batch(&mut self) -> io::Result<()> {
+        use bytes::Buf;
+
+        let slot_size = self.slot_size;
+        self.buffer.reserve(RECEIVE_BATCH * slot_size);
+
+        let lengths = sys::recv_mmsg(
+            std::os::unix::io::AsRawFd::as_raw_fd(&*self.socket),
+            self.buffer.chunk_mut().as_mut_ptr(),
+            slot_size,
+            RECEIVE_BATCH,
+        )?;
+
+        for (idx, size) in lengths.iter().copied().enumerate() {
+            let length = size.min(slot_size);
+            // safety: the kernel wrote the first `length` bytes of the slot
+            unsafe { self.buffer.advance_mut(length) };
+            let datagram = self.buffer.split_to(length);
+
+            // skip the rest of the slot
+            if idx + 1 < lengths.len() {
+                let unused = slot_size - length;
+                self.buffer.resize(unused, 0);
+                self.buffer.advance(unused);
+            }
+
+            if size > slot_size {
+                let new_slot_size = size.next_power_of_two().min(MAX_RECEIVE_SLOT_SIZE);
+                if new_slot_size > self.slot_size {
+                    self.slot_size = new_slot_size;
+                    debug!("Receive slots grown to {new_slot_size} bytes");
+                }
+            } else {
+                self.received.push_back(datagram);
+            }
+        }
+
+        Ok(())
+    }
+}
+
+// Once the socket is connected, an ICMP port unreachable (the peer is not listening yet, or
+// restarted) is reported by the next send or receive. It must not end the stream or drop the
+// datagrams being sent.
+fn is_transient_error(error: &io::Error) -> bool {
+    matches!(
+        error.kind(),
+        io::ErrorKind::ConnectionRefused | io::ErrorKind::ConnectionReset
+    )
+}
+
+impl Stream for BatchReceiver {
+    type Item = io::Result<BytesMut>;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context) -> Poll<Option<Self::Item>> {
+        let this = self.get_mut();
+        let socket = Arc::clone(&this.socket);
+
+        while this.received.is_empty() {
+            #[cfg(any(target_os = "linux", target_os = "android"))]
+            {
+                ready!(socket.poll_recv_ready(cx))?;
+                match socket.try_io(tokio::io::Interest::READABLE, || this.receive_batch()) {
+                    Ok(()) => (),
+                    Err(e) if e.kind() == io::ErrorKind::WouldBlock => (),
+                    Err(e) if is_transient_error(&e) => debug!("Ignored receive error: {e}"),
+                    Err(e) => return Poll::Ready(Some(Err(e))),
+                }
+            }
+
+            #[cfg(not(any(target_os = "linux", target_os = "android")))]
+            {
+                this.buffer.reserve(this.slot_size);
+
+                let length = unsafe {
+                    let buffer = &mut *(this.buffer.chunk_mut() as *mut _
+                        as *mut [std::mem::MaybeUninit<u8>]);
+                    let mut read = tokio::io::ReadBuf::uninit(buffer);
+                    match ready!(socket.poll_recv(cx, &mut read)) {
+                        Ok(()) => read.filled().len(),
+                        Err(e) if is_transient_error(&e) => {
+                            debug!("Ignored receive error: {e}");
+                            continue;
+                        }
+                        Err(e) => return Poll::Ready(Some(Err(e))),
+                    }
+                };
+
+                // safety: poll_recv filled `length` bytes
+                unsafe { this.buffer.advance_mut(length) };
+                let datagram = this.buffer.split_to(length);
+                this.received.push_back(datagram);
+            }
+        }
+
+        Poll::Ready(this.received.pop_front().map(Ok))
+    }
+}
+
+#[cfg(any(target_os = "linux", target_os = "android"))]
+mod sys {
+    use bytes::Bytes;
+    use std::{io, mem, os::unix::io::AsRawFd, ptr};
+    use tokio::net::UdpSocket;
+
+    // Not exported by libc for every target
+    const UDP_SEGMENT: libc::c_int = 103;
+
+    // Kernel limit of segments per GSO send
+    pub const MAX_GSO_SEGMENTS: usize = 64;
+    // The whole datagram, IP header included, must fit in 64 KiB
+    pub const MAX_GSO_BYTES: usize = 63 * 1024;
+    pub const MAX_MMSG_MESSAGES: usize = 64;
+
+    #[repr(C, align(8))]
+    struct ControlBuffer([u8; 32]);
+
+    // Kernels without UDP GSO (before 4.18) silently ignore the UDP_SEGMENT control message and
+    // would send the whole run as one datagram, so it is probed with the socket option
+    pub fn gso_supported(socket: &UdpSocket) -> bool {
+        let mut value: libc::c_int = 0;
+        let mut len = mem::size_of::<libc::c_int>() as libc::socklen_t;
+        unsafe {
+            libc::getsockopt(
+                socket.as_raw_fd(),
+                libc::SOL_UDP,
+                UDP_SEGMENT,
+                &mut value as *mut _ as *mut libc::c_void,
+                &mut len,
+            ) == 0
+        }
+    }
+
+    pub fn is_gso_error(error: &io::Error) -> bool {
+        matches!(
+            error.raw_os_error(),
+            Some(libc::EIO | libc::EINVAL | libc::ENOPROTOOPT | libc::EOPNOTSUPP)
+        )
+    }
+
+    // Length of the run of datagrams at the start that can be sent as GSO segments, and their
+    // segment size. All segments have the same size, only the last one can be shorter.
+    pub fn gso_run(datagrams: &[Bytes]) -> (usize, usize) {
+        let segment_size = datagrams[0].len();
+        if segment_size > u16::MAX as usize {
+            return (1, segment_size);
+        }
+
+        let mut count = 1;
+        let mut total_size = segment_size;
+        while count < datagrams.len().min(MAX_GSO_SEGMENTS) {
+            let size = datagrams[count].len();
+            if size > segment_size || total_size + size > MAX_GSO_BYTES {
+                break;
+            }
+            count += 1;
+            total_size += size;
+            if size < segment_size {
+                break;
+            }
+        }
+
+        (count, segment_size)
+    }
+
+    fn iovecs(datagrams: &[Bytes]) -> Vec<libc::iovec> {
+        datagrams
+            .iter()
+            .map(|datagram| libc::iovec {
+                iov_base: datagram.as_ptr() as *mut libc::c_void,
+                iov_len: datagram.len(),
+            })
+            .collect()
+    }
+
+    fn check(res: isize) -> io::Result<usize> {
+        if res < 0 {
+            Err(io::Error::last_os_error())
+        } else {
+            Ok(res as usize)
+        }
+    }
+
+    // One datagram, or one GSO datagram split by the kernel (or the NIC) in segments
+    pub fn send_msg(
+        fd: libc::c_int,
+        datagrams: &[Bytes],
+        segment_size: Option<usize>,
+    ) -> io::Result<()> {
+        let mut iovecs = iovecs(datagrams);
+        let mut control = ControlBuffer([0; 32]);
+
+        let mut message: libc::msghdr = unsafe { mem::zeroed() };
+        message.msg_iov = iovecs.as_mut_ptr();
+        message.msg_iovlen = iovecs.len() as _;
+
+        if let Some(segment_size) = segment_size {
+            message.msg_control = control.0.as_mut_ptr() as *mut libc::c_void;
+            message.msg_controllen = unsafe { libc::CMSG_SPACE(mem::size_of::<u16>() as _) } as _;
+            unsafe {
+                let cmsg = libc::CMSG_FIRSTHDR(&message);
+                (*cmsg).cmsg_level = libc::SOL_UDP;
+                (*cmsg).cmsg_type = UDP_SEGMENT;
+                (*cmsg).cmsg_len = libc::CMSG_LEN(mem::size_of::<u16>() as _) as _;
+                ptr::write_unaligned(libc::CMSG_DATA(cmsg) as *mut u16, segment_size as u16);
+            }
+        }
+
+        check(unsafe { libc::sendmsg(fd, &message, 0) } as isize).map(|_| ())
+    }
+
+    pub fn send_mmsg(fd: libc::c_int, datagrams: &[Bytes]) -> io::Result<usize> {
+        let count = datagrams.len().min(MAX_MMSG_MESSAGES);
+
+        let mut iovecs = iovecs(&datagrams[..count]);
+        let mut messages = iovecs
+            .iter_mut()
+            .map(|iovec| {
+                let mut message: libc::mmsghdr = unsafe { mem::zeroed() };
+                message.msg_hdr.msg_iov = iovec;
+                message.msg_hdr.msg_iovlen = 1;
+                message
+            })
+            .collect::<Vec<_>>();
+
+        check(unsafe { libc::sendmmsg(fd, messages.as_mut_ptr(), count as _, 0) } as isize)
+    }
+
+    // Receive up to `count` datagrams in consecutive slots from `buffer`. Returns the size of each,
+    // bigger than the slot if it was truncated.
+    pub fn recv_mmsg(
+        fd: libc::c_int,
+        buffer: *mut u8,
+        slot_size: usize,
+        count: usize,
+    ) -> io::Result<Vec<usize>> {
+        let mut iovecs = (0..count)
+            .map(|idx| libc::iovec {
+                iov_base: unsafe { buffer.add(idx * slot_size) } as *mut libc::c_void,
+                iov_len: slot_size,
+            })
+            .collect::<Vec<_>>();
+        let mut messages = iovecs
+            .iter_mut()
+            .map(|iovec| {
+                let mut message: libc::mmsghdr = unsafe { mem::zeroed() };
+                message.msg_hdr.msg_iov = iovec;
+                message.msg_hdr.msg_iovlen = 1;
+                message
+            })
+            .collect::<Vec<_>>();
+
+        let received = check(unsafe {
+            libc::recvmmsg(
+                fd,
+                messages.as_mut_ptr(),
+                count as _,
+                libc::MSG_TRUNC as _,
+                ptr::null_mut(),
+            )
+        } as isize)?;
+
+        Ok(messages[..received]
+            .iter()
+            .map(|message| message.msg_len as usize)
+            .collect())
+    }
+}
+
+#[cfg(all(test, any(target_os = "linux", target_os = "android")))]
+mod tests {
+    use super::*;
+    use futures::StreamExt;
+
+    async fn socket_pair() -> (Arc<UdpSocket>, UdpSocket) {
+        let receiver = UdpSocket::bind("127.0.0.1:0").await.unwrap();
+        let sender = UdpSocket::bind("127.0.0.1:0").await.unwrap();
+        sender
+            .connect(receiver.local_addr().unwrap())
+            .await
+            .unwrap();
+
+        (Arc::new(sender), receiver)
+    }
+
+    // System calls to send count datagrams of the same size: one per GSO run or sendmmsg batch
+    fn expected_syscalls(sender: &BatchSender, count: usize, size: usize) -> u64 {
+        let per_call = if sender.gso.load(Ordering::Relaxed) {
+            sys::MAX_GSO_SEGMENTS.min(sys::MAX_GSO_BYTES / size)
+        } else {
+            sys::MAX_MMSG_MESSAGES
+        };
+
+        ((count + per_call - 1) / per_call) as _
+    }
+
+    #[tokio::test]
+    async fn batch_keeps_datagram_boundaries_and_order() {
+        let (sender, receiver) = socket_pair().await;
+        let sender = BatchSender::new(sender);
+
+        // equal sized packets with a shorter last one, as a video frame. Few enough to fit in the
+        // receive buffer.
+        let datagrams = (0..40_u8)
+            .map(|idx| Bytes::from(vec![idx; if idx == 39 { 300 } else { 1400 }]))
+            .collect::<Vec<_>>();
+        let expected_syscalls = expected_syscalls(&sender, datagrams.len(), 1400);
+        sender.send(&datagrams).await.unwrap();
+
+        let mut buffer = [0; 2048];
+        for datagram in &datagrams {
+            let size = receiver.recv(&mut buffer).await.unwrap();
+            assert_eq!(buffer[..size], datagram[..]);
+        }
+
+        let stats = sender.take_stats();
+        assert_eq!(stats.packets, 40);
+        assert_eq!(stats.syscalls, expected_syscalls);
+    }
+
+    #[tokio::test]
+    async fn batch_splits_at_the_kernel_limits() {
+        let (sender, _receiver) = socket_pair().await;
+        let sender = BatchSender::new(sender);
+
+        // More than fit in the receive buffer, the datagrams that don't fit are dropped by the
+        // kernel without blocking the sender
+        let datagrams = (0..300)
+            .map(|idx| Bytes::from(vec![idx as u8; 1400]))
+            .collect::<Vec<_>>();
+        let expected_syscalls = expected_syscalls(&sender, datagrams.len(), 1400);
+        assert!(expected_syscalls > 1);
+        sender.send(&datagrams).await.unwrap();
+
+        let stats = sender.take_stats();
+        assert_eq!(stats.packets, 300);
+        assert_eq!(stats.syscalls, expected_syscalls);
+    }
+
+    #[tokio::test]
+    async fn receive_continues_after_connection_refused() {
+        let peer = UdpSocket::bind("127.0.0.1:0").await.unwrap();
+        let peer_address = peer.local_addr().unwrap();
+        drop(peer);
+
+        let socket = Arc::new(UdpSocket::bind("127.0.0.1:0").await.unwrap());
+        socket.connect(peer_address).await.unwrap();
+        // The port unreachable error is reported by the next receive
+        socket.send(&[0]).await.unwrap();
+        let mut receiver = BatchReceiver::new(Arc::clone(&socket));
+
+        let peer = UdpSocket::bind(peer_address).await.unwrap();
+        peer.send_to(&[1, 2, 3], socket.local_addr().unwrap())
+            .await
+            .unwrap();
+        assert_eq!(&receiver.next().await.unwrap().unwrap()[..], &[1, 2, 3]);
+    }
+
+    #[tokio::test]
+    async fn send_continues_after_connection_refused() {
+        for batched in [true, false] {
+            let peer = UdpSocket::bind("127.0.0.1:0").await.unwrap();
+            let peer_address = peer.local_addr().unwrap();
+            drop(peer);
+
+            let socket = Arc::new(UdpSocket::bind("127.0.0.1:0").await.unwrap());
+            socket.connect(peer_address).await.unwrap();
+            let sender = BatchSender::new(Arc::clone(&socket));
+            sender.mmsg.store(batched, Ordering::Relaxed);
+            // The port unreachable error is reported by the next send
+            socket.send(&[0]).await.unwrap();
+
+            let peer = UdpSocket::bind(peer_address).await.unwrap();
+            let datagrams = (0..4_u8)
+                .map(|idx| Bytes::from(vec![idx; 100]))
+                .collect::<Vec<_>>();
+            sender.send(&datagrams).await.unwrap();
+
+            let mut buffer = [0; 200];
+            for datagram in &datagrams {
+                let length = peer.recv(&mut buffer).await.unwrap();
+                assert_eq!(&buffer[..length], &datagram[..]);
+            }
+        }
+    }
+
+    #[tokio::test]
+    async fn receive_splits_batches_and_grows_slots() {
+        let (sender, receiver) = socket_pair().await;
+        receiver
+            .connect(sender.local_addr().unwrap())
+            .await
+            .unwrap();
+        let sender = BatchSender::new(sender);
+        let mut receiver = BatchReceiver::new(Arc::new(receiver));
+
+        // The last one is bigger than the initial slots and is lost
+        let mut datagrams = (0..20_u8)
+            .map(|idx| Bytes::from(vec![idx; 1000 + idx as usize]))
+            .collect::<Vec<_>>();
+        datagrams.push(Bytes::from(vec![100; 5000]));
+        sender.send(&datagrams).await.unwrap();
+
+        for datagram in &datagrams[..20] {
+            assert_eq!(&receiver.next().await.unwrap().unwrap()[..], &datagram[..]);
+        }
+
+        let big_datagram = Bytes::from(vec![101; 5000]);
+        sender.send(&[big_datagram.clone()]).await.unwrap();
+        assert_eq!(
+            &receiver.next().await.unwrap().unwrap()[..],
+            &big_datagram[..]
+        );
+    }
+}
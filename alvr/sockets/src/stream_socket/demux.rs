@@ -0,0 +1,140 @@
+// Routing of the received packets to the stream subscribers. The table has a slot per stream ID,
+// set at most once by publishing the queue with an atomic pointer, so the receive loop finds the
+// queue of a packet without locking and a stream never contends with the others. Subscribing can
+// happen after the receive loop started, packets of a stream without subscriber are dropped.
+
+use super::StreamId;
+use alvr_common::prelude::*;
+use bytes::BytesMut;
+use std::{
+    ptr,
+    sync::atomic::{AtomicPtr, Ordering},
+};
+use tokio::sync::mpsc;
+
+// Stream IDs go from 0 to MAX_STREAMS - 1
+pub const MAX_STREAMS: usize = 16;
+
+type Queue = mpsc::UnboundedSender<BytesMut>;
+
+#[derive(Default)]
+pub struct StreamDemux {
+    queues: [AtomicPtr<Queue>; MAX_STREAMS],
+}
+
+impl StreamDemux {
+    pub fn subscribe(&self, stream_id: StreamId) -> StrResult<mpsc::UnboundedReceiver<BytesMut>> {
+        let slot = match self.queues.get(stream_id as usize) {
+            Some(slot) => slot,
+            None => return fmt_e!("Stream ID {stream_id} is out of range"),
+        };
+
+        let (enqueuer, dequeuer) = mpsc::unbounded_channel();
+        let queue = Box::into_raw(Box::new(enqueuer));
+        if slot
+            .compare_exchange(ptr::null_mut(), queue, Ordering::AcqRel, Ordering::Acquire)
+            .is_err()
+        {
+            // safety: the queue was not published
+            drop(unsafe { Box::from_raw(queue) });
+            return fmt_e!("Stream {stream_id} has already a subscriber");
+        }
+
+        Ok(dequeuer)
+    }
+
+    // Fails if the subscriber has been dropped
+    pub fn dispatch(&self, stream_id: StreamId, packet: BytesMut) -> StrResult {
+        let queue = match self.queues.get(stream_id as usize) {
+            Some(slot) => slot.load(Ordering::Acquire),
+            None => return Ok(()),
+        };
+
+        // safety: a published queue is freed only when the table is dropped
+        if let Some(queue) = unsafe { queue.as_ref() } {
+            trace_err!(queue.send(packet))?;
+        }
+
+        Ok(())
+    }
+}
+
+impl Drop for StreamDemux {
+    fn drop(&mut self) {
+        for slot in &mut self.queues {
+            let queue = *slot.get_mut();
+            if !queue.is_null() {
+                drop(unsafe { Box::from_raw(queue) });
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::{
+        thread,
+        time::{Duration, Instant},
+    };
+
+    #[test]
+    fn packets_reach_their_subscriber() {
+        let demux = StreamDemux::default();
+        let mut first = demux.subscribe(1).unwrap();
+
+        demux.dispatch(0, BytesMut::from(&[0][..])).unwrap();
+        demux.dispatch(1, BytesMut::from(&[1][..])).unwrap();
+        demux.dispatch(MAX_STREAMS as _, BytesMut::new()).unwrap();
+
+        // late subscription
+        let mut second = demux.subscribe(2).unwrap();
+        demux.dispatch(2, BytesMut::from(&[2][..])).unwrap();
+
+        assert_eq!(first.try_recv().unwrap()[..], [1]);
+        assert!(first.try_recv().is_err());
+        assert_eq!(second.try_recv().unwrap()[..], [2]);
+
+        assert!(demux.subscribe(1).is_err());
+        assert!(demux.subscribe(MAX_STREAMS as _).is_err());
+
+        drop(first);
+        assert!(demux.dispatch(1, BytesMut::new()).is_err());
+    }
+
+    // Packets per second through the demux, with a consumer thread per stream.
+    // cargo test -p alvr_sockets --release -- --ignored --nocapture demux_throughput
+    #[test]
+    #[ignore]
+    fn demux_throughput() {
+        const PACKETS: usize = 2_000_000;
+
+        for streams in [1, 4, 8] {
+            let demux = StreamDemux::default();
+            let consumers = (0..streams)
+                .map(|stream_id| {
+                    let mut dequeuer = demux.subscribe(stream_id).unwrap();
+                    thread::spawn(move || while dequeuer.blocking_recv().is_some() {})
+                })
+                .collect::<Vec<_>>();
+
+            // the payload is not touched by the demux, it is left empty
+            let start = Instant::now();
+            for idx in 0..PACKETS {
+                let stream_id = (idx % streams as usize) as StreamId;
+                demux.dispatch(stream_id, BytesMut::new()).unwrap();
+            }
+            let elapsed = start.elapsed();
+
+            drop(demux);
+            for consumer in consumers {
+                consumer.join().unwrap();
+            }
+
+            println!(
+                "{streams} streams: {:.1} M packets/s",
+                PACKETS as f64 / elapsed.max(Duration::from_nanos(1)).as_secs_f64() / 1e6
+            );
+        }
+    }
+}
@@ -4,17 +4,28 @@
 // StreamSender and StreamReceiver endpoints allow for convenient conversion of the header to/from
 // bytes while still handling the additional byte buffer with zero copies and extra allocations.
 
+mod batch;
+mod demux;
+mod mtu_probe;
+mod scheduler;
 mod tcp;
 mod throttled_udp;
 mod udp;
 
 use alvr_common::prelude::*;
 use alvr_session::SocketProtocol;
-use bytes::{Buf, BufMut, BytesMut};
+pub use batch::BatchSendStats;
+use bytes::{Buf, BufMut, Bytes, BytesMut};
+use demux::StreamDemux;
 use futures::SinkExt;
+pub use mtu_probe::{
+    video_packet_size_for_mtu, video_packet_size_from_str, video_packet_size_to_string,
+    DEFAULT_VIDEO_PACKET_SIZE, MTU_PROBE_MAX_DURATION,
+};
+pub use scheduler::SendPriority;
+use scheduler::SendScheduler;
 use serde::{de::DeserializeOwned, Serialize};
 use std::{
-    collections::HashMap,
     marker::PhantomData,
     net::IpAddr,
     ops::{Deref, DerefMut},
@@ -36,6 +47,22 @@ enum StreamSendSocket {
     Tcp(TcpStreamSendSocket),
 }
 
+impl StreamSendSocket {
+    async fn send(&self, packets: &[Bytes]) -> StrResult {
+        match self {
+            StreamSendSocket::Udp(socket) => trace_err!(socket.send(packets).await),
+            StreamSendSocket::Tcp(socket) => {
+                let mut socket = socket.lock().await;
+                for packet in packets {
+                    trace_err!(socket.feed(packet.clone()).await)?;
+                }
+                trace_err!(socket.flush().await)
+            }
+            StreamSendSocket::ThrottledUdp(socket) => trace_err!(socket.send(packets).await),
+        }
+    }
+}
+
 enum StreamReceiveSocket {
     Udp(UdpStreamReceiveSocket),
     ThrottledUdp(ThrottledUdpStreamReceiveSocket),
@@ -89,6 +116,8 @@ impl<T> SenderBuffer<T> {
 pub struct StreamSender<T> {
     stream_id: StreamId,
     socket: StreamSendSocket,
+    // queue of the send scheduler, if the stream has a priority
+    queue: Option<mpsc::Sender<Bytes>>,
     // if the packet index overflows the worst that happens is a false positive packet loss
     next_packet_index: u32,
     _phantom: PhantomData<T>,
@@ -97,25 +126,41 @@ pub struct StreamSender<T> {
 impl<T> StreamSender<T> {
     // The buffer is moved into the method. There is no way of reusing the same buffer twice without
     // extra copies/allocations
-    pub async fn send_buffer(&mut self, mut buffer: SenderBuffer<T>) -> StrResult {
-        buffer.inner[2..6].copy_from_slice(&self.next_packet_index.to_be_bytes());
-        self.next_packet_index += 1;
+    pub async fn send_buffer(&mut self, buffer: SenderBuffer<T>) -> StrResult {
+        self.send_buffers(vec![buffer]).await
+    }
 
-        match &self.socket {
-            StreamSendSocket::Udp(socket) => trace_err!(
-                socket
-                    .inner
-                    .lock()
-                    .await
-                    .send((buffer.inner.freeze(), socket.peer_addr))
-                    .await
-            ),
-            StreamSendSocket::Tcp(socket) => {
-                trace_err!(socket.lock().await.send(buffer.inner.freeze()).await)
-            }
-            StreamSendSocket::ThrottledUdp(socket) => {
-                trace_err!(socket.send(buffer.inner.freeze()).await)
+    // Send the buffers in order. With UDP they are handed to the kernel in as few system calls as
+    // possible, so the packets of a whole video frame should be sent together.
+    pub async fn send_buffers(&mut self, buffers: Vec<SenderBuffer<T>>) -> StrResult {
+        let packets = buffers
+            .into_iter()
+            .map(|mut buffer| {
+                buffer.inner[2..6].copy_from_slice(&self.next_packet_index.to_be_bytes());
+                self.next_packet_index += 1;
+
+                buffer.inner.freeze()
+            })
+            .collect::<Vec<Bytes>>();
+
+        if let Some(queue) = &self.queue {
+            for packet in packets {
+                trace_err!(queue.send(packet).await)?;
             }
+
+            Ok(())
+        } else {
+            self.socket.send(&packets).await
+        }
+    }
+
+    // Packets and system calls used to send them since the last call, shared by all the senders
+    // of the socket. None for TCP.
+    pub fn take_send_stats(&self) -> Option<BatchSendStats> {
+        match &self.socket {
+            StreamSendSocket::Udp(socket) => Some(socket.take_stats()),
+            StreamSendSocket::ThrottledUdp(socket) => Some(socket.inner.take_stats()),
+            StreamSendSocket::Tcp(_) => None,
         }
     }
 }
@@ -241,11 +286,7 @@ impl StreamSocketBuilder {
             }
         };
 
-        Ok(StreamSocket {
-            send_socket,
-            receive_socket: Arc::new(Mutex::new(Some(receive_socket))),
-            packet_queues: Arc::new(Mutex::new(HashMap::new())),
-        })
+        Ok(StreamSocket::new(send_socket, receive_socket))
     }
 
     pub async fn connect_to_client(
@@ -285,25 +326,52 @@ impl StreamSocketBuilder {
             }
         };
 
-        Ok(StreamSocket {
-            send_socket,
-            receive_socket: Arc::new(Mutex::new(Some(receive_socket))),
-            packet_queues: Arc::new(Mutex::new(HashMap::new())),
-        })
+        Ok(StreamSocket::new(send_socket, receive_socket))
     }
 }
 
 pub struct StreamSocket {
     send_socket: StreamSendSocket,
     receive_socket: Arc<Mutex<Option<StreamReceiveSocket>>>,
-    packet_queues: Arc<Mutex<HashMap<StreamId, mpsc::UnboundedSender<BytesMut>>>>,
+    demux: Arc<StreamDemux>,
+    // indexed by SendPriority
+    send_queues: Vec<mpsc::Sender<Bytes>>,
+    send_scheduler: Arc<Mutex<Option<SendScheduler>>>,
 }
 
 impl StreamSocket {
+    fn new(send_socket: StreamSendSocket, receive_socket: StreamReceiveSocket) -> Self {
+        let (send_scheduler, send_queues) = SendScheduler::new();
+
+        Self {
+            send_socket,
+            receive_socket: Arc::new(Mutex::new(Some(receive_socket))),
+            demux: Arc::new(StreamDemux::default()),
+            send_queues,
+            send_scheduler: Arc::new(Mutex::new(Some(send_scheduler))),
+        }
+    }
+
     pub async fn request_stream<T>(&self, stream_id: StreamId) -> StrResult<StreamSender<T>> {
         Ok(StreamSender {
             stream_id,
             socket: self.send_socket.clone(),
+            queue: None,
+            next_packet_index: 0,
+            _phantom: PhantomData,
+        })
+    }
+
+    // The packets are sent by send_loop(), which must be running
+    pub async fn request_stream_with_priority<T>(
+        &self,
+        stream_id: StreamId,
+        priority: SendPriority,
+    ) -> StrResult<StreamSender<T>> {
+        Ok(StreamSender {
+            stream_id,
+            socket: self.send_socket.clone(),
+            queue: Some(self.send_queues[priority as usize].clone()),
             next_packet_index: 0,
             _phantom: PhantomData,
         })
@@ -313,8 +381,7 @@ impl StreamSocket {
         &self,
         stream_id: StreamId,
     ) -> StrResult<StreamReceiver<T>> {
-        let (enqueuer, dequeuer) = mpsc::unbounded_channel();
-        self.packet_queues.lock().await.insert(stream_id, enqueuer);
+        let dequeuer = self.demux.subscribe(stream_id)?;
 
         Ok(StreamReceiver {
             stream_id,
@@ -324,16 +391,21 @@ impl StreamSocket {
         })
     }
 
+    pub async fn send_loop(&self) -> StrResult {
+        let scheduler = self.send_scheduler.lock().await.take().unwrap();
+        scheduler.run(self.send_socket.clone()).await
+    }
+
     pub async fn receive_loop(&self) -> StrResult {
         match self.receive_socket.lock().await.take().unwrap() {
             StreamReceiveSocket::Udp(socket) => {
-                udp::receive_loop(socket, Arc::clone(&self.packet_queues)).await
+                udp::receive_loop(socket, Arc::clone(&self.demux)).await
             }
             StreamReceiveSocket::Tcp(socket) => {
-                tcp::receive_loop(socket, Arc::clone(&self.packet_queues)).await
+                tcp::receive_loop(socket, Arc::clone(&self.demux)).await
             }
             StreamReceiveSocket::ThrottledUdp(socket) => {
-                throttled_udp::receive_loop(socket, Arc::clone(&self.packet_queues)).await
+                throttled_udp::receive_loop(socket, Arc::clone(&self.demux)).await
             }
         }
     }
@@ -0,0 +1,203 @@
+// Path MTU probing, done once at the start of the stream. The server sends probe packets of
+// decreasing sizes, the client acknowledges the ones it receives and the largest acknowledged size
+// is used to choose the video packet size.
+// Note: the don't-fragment flag is not set on the probes. Paths that drop fragmented packets (the
+// usual problem with VPNs and tunnels) are detected, but a path that reassembles fragments will
+// accept probes up to `max_mtu`, which must then be set to the real link MTU.
+
+use super::{StreamReceiveSocket, StreamSendSocket, StreamSocket};
+use crate::MTU_PROBE;
+use alvr_common::prelude::*;
+use bytes::{Buf, BytesMut};
+use futures::StreamExt;
+use serde::{Deserialize, Serialize};
+use std::{future, net::IpAddr, time::Duration};
+use tokio::time::{self, Instant};
+
+pub const DEFAULT_VIDEO_PACKET_SIZE: u32 = 1400;
+
+// Smallest MTU every IPv4 host must accept
+const MIN_MTU: u32 = 576;
+// Common link MTUs: jumbo frames, ethernet, PPPoE, typical VPNs and IPv6 minimum
+const PROBE_MTUS: [u32; 6] = [9000, 1500, 1492, 1420, 1280, MIN_MTU];
+const PROBE_ROUNDS: usize = 3;
+const PROBE_TIMEOUT: Duration = Duration::from_millis(500);
+
+// Upper bound of the time spent by the server in probe_mtu() before it sends the video packet size
+pub const MTU_PROBE_MAX_DURATION: Duration = Duration::from_millis(500 * PROBE_ROUNDS as u64);
+
+// Stream ID, packet index and video header (both legacy and compact)
+const STREAM_PACKET_OVERHEAD: u32 = 2 + 4 + 54;
+
+#[derive(Serialize, Deserialize)]
+enum MtuProbePacket {
+    Probe { mtu: u32 },
+    Ack { mtu: u32 },
+}
+
+fn ip_udp_overhead(peer_ip: IpAddr) -> u32 {
+    match peer_ip {
+        IpAddr::V4(_) => 20 + 8,
+        IpAddr::V6(_) => 40 + 8,
+    }
+}
+
+// Largest video payload that fits in a single datagram for the given MTU
+pub fn video_packet_size_for_mtu(mtu: u32, peer_ip: IpAddr) -> u32 {
+    mtu.max(MIN_MTU) - ip_udp_overhead(peer_ip) - STREAM_PACKET_OVERHEAD
+}
+
+pub fn video_packet_size_from_str(value: &str) -> Option<u32> {
+    value
+        .split_whitespace()
+        .find_map(|token| token.strip_prefix("video_packet_size="))
+        .and_then(|size| size.parse().ok())
+}
+
+pub fn video_packet_size_to_string(size: u32) -> String {
+    format!("video_packet_size={size}")
+}
+
+fn probe_mtus(max_mtu: u32) -> Vec<u32> {
+    let max_mtu = max_mtu.max(MIN_MTU);
+
+    let mut mtus = vec![max_mtu];
+    mtus.extend(PROBE_MTUS.iter().filter(|mtu| **mtu < max_mtu));
+
+    mtus
+}
+
+// Receive the next datagram from the peer. Returns None for TCP, where probing is meaningless.
+async fn recv_datagram(socket: &mut StreamReceiveSocket) -> StrResult<Option<BytesMut>> {
+    match socket {
+        StreamReceiveSocket::Udp(socket) | StreamReceiveSocket::ThrottledUdp(socket) => {
+            Ok(Some(trace_err!(trace_none!(socket.next().await)?)?))
+        }
+        StreamReceiveSocket::Tcp(_) => Ok(None),
+    }
+}
+
+impl StreamSocket {
+    // Server side. Returns the largest MTU that reached the client, None if probing is not
+    // supported by the protocol or no probe was acknowledged.
+    // Must be called before receive_loop().
+    pub async fn probe_mtu(&self, max_mtu: u32, peer_ip: IpAddr) -> StrResult<Option<u32>> {
+        if let StreamSendSocket::Tcp(_) = &self.send_socket {
+            return Ok(None);
+        }
+
+        let mtus = probe_mtus(max_mtu);
+
+        let mut sender = self.request_stream(MTU_PROBE).await?;
+        for _ in 0..PROBE_ROUNDS {
+            for &mtu in &mtus {
+                let packet = MtuProbePacket::Probe { mtu };
+                let header_size = 2 + 4 + trace_err!(bincode::serialized_size(&packet))? as u32;
+                let padding = mtu - ip_udp_overhead(peer_ip) - header_size;
+
+                let mut buffer = sender.new_buffer(&packet, padding as _)?;
+                buffer.get_mut().resize(padding as _, 0);
+                // sending a packet bigger than the local interface MTU can fail, it's not an error
+                sender.send_buffer(buffer).await.ok();
+            }
+        }
+
+        let mut receive_socket = self.receive_socket.lock().await;
+        let receive_socket = trace_none!(receive_socket.as_mut())?;
+
+        let deadline = Instant::now() + PROBE_TIMEOUT;
+        let mut best_mtu = None;
+        loop {
+            let mut bytes = tokio::select! {
+                res = recv_datagram(receive_socket) => trace_none!(res?)?,
+                _ = time::sleep_until(deadline) => break,
+            };
+
+            let stream_id = bytes.get_u16();
+            if stream_id != MTU_PROBE {
+                self.demux.dispatch(stream_id, bytes)?;
+                continue;
+            }
+
+            // skip the packet index
+            bytes.advance(4);
+            if let Ok(MtuProbePacket::Ack { mtu }) = bincode::deserialize(&bytes) {
+                if best_mtu.map(|best| mtu > best).unwrap_or(true) {
+                    best_mtu = Some(mtu);
+                }
+                if mtu == mtus[0] {
+                    break;
+                }
+            }
+        }
+
+        Ok(best_mtu)
+    }
+
+    // Client side. Acknowledges the probes until canceled.
+    // Must be called before receive_loop().
+    pub async fn answer_mtu_probes(&self) -> StrResult {
+        let mut sender = self.request_stream(MTU_PROBE).await?;
+
+        let mut receive_socket = self.receive_socket.lock().await;
+        let receive_socket = trace_none!(receive_socket.as_mut())?;
+
+        loop {
+            let mut bytes = if let Some(bytes) = recv_datagram(receive_socket).await? {
+                bytes
+            } else {
+                return future::pending().await;
+            };
+
+            if bytes.get_u16() != MTU_PROBE {
+                continue;
+            }
+
+            bytes.advance(4);
+            if let Ok(MtuProbePacket::Probe { mtu }) = bincode::deserialize(&bytes) {
+                sender.send(&MtuProbePacket::Ack { mtu }).await.ok();
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::net::{Ipv4Addr, Ipv6Addr};
+
+    #[test]
+    fn probe_mtus_are_decreasing() {
+        for max_mtu in [MIN_MTU, 1280, 1400, 1500, 4000, 9000] {
+            let mtus = probe_mtus(max_mtu);
+
+            assert_eq!(mtus[0], max_mtu);
+            assert_eq!(*mtus.last().unwrap(), MIN_MTU);
+            assert!(mtus.windows(2).all(|pair| pair[0] > pair[1]));
+        }
+    }
+
+    #[test]
+    fn video_packet_size_fits_mtu() {
+        let ipv4 = IpAddr::V4(Ipv4Addr::LOCALHOST);
+        let ipv6 = IpAddr::V6(Ipv6Addr::LOCALHOST);
+
+        for mtu in [MIN_MTU, 1280, 1420, 1492, 1500, 9000] {
+            for ip in [ipv4, ipv6] {
+                let size = video_packet_size_for_mtu(mtu, ip);
+                assert!(size > 0);
+                assert!(size + STREAM_PACKET_OVERHEAD + ip_udp_overhead(ip) <= mtu);
+            }
+        }
+
+        // The previous fixed size is kept on standard ethernet
+        assert!(video_packet_size_for_mtu(1500, ipv4) >= DEFAULT_VIDEO_PACKET_SIZE);
+    }
+
+    #[test]
+    fn video_packet_size_string() {
+        let value = video_packet_size_to_string(1408);
+        assert_eq!(video_packet_size_from_str(&value), Some(1408));
+        assert_eq!(video_packet_size_from_str(""), None);
+    }
+}
@@ -0,0 +1,311 @@
+// Scheduling of the packets sent on a connection. The stream senders requested with a priority push
+// their packets to the bounded queue of their class and a single send loop hands them to the socket,
+// so a burst of video packets cannot sit in front of the haptics and audio ones. Realtime packets
+// have strict priority: they are sent as soon as the batch being sent is done. Audio and video
+// share the rest by deficit round robin, each up to a byte quantum per round: an audio packet
+// waits at most for one video quantum, and video keeps most of the bandwidth even if audio floods
+// the socket. A full queue makes its senders wait.
+
+use super::StreamSendSocket;
+use alvr_common::prelude::*;
+use bytes::Bytes;
+use tokio::sync::mpsc;
+
+#[derive(Clone, Copy)]
+pub enum SendPriority {
+    // Haptics
+    Realtime = 0,
+    Audio = 1,
+    Video = 2,
+}
+
+struct SendClass {
+    // in packets
+    capacity: usize,
+    // bytes sent per round. For the realtime class, the biggest batch.
+    quantum: usize,
+}
+
+// In priority order. A video quantum is about 46 packets, sent with one system call with UDP.
+const CLASSES: [SendClass; 3] = [
+    SendClass {
+        capacity: 64,
+        quantum: 16 * 1024,
+    },
+    SendClass {
+        capacity: 128,
+        quantum: 16 * 1024,
+    },
+    // bigger than an IDR frame at high bitrates
+    SendClass {
+        capacity: 1024,
+        quantum: 64 * 1024,
+    },
+];
+
+struct ClassQueue {
+    dequeuer: mpsc::Receiver<Bytes>,
+    // first packet, taken from the queue but not sent yet
+    head: Option<Bytes>,
+    deficit: usize,
+    quantum: usize,
+}
+
+impl ClassQueue {
+    // Packets that fit in the deficit, after adding the quantum
+    fn take_quantum(&mut self) -> Vec<Bytes> {
+        let mut batch = vec![];
+
+        if self.head.is_none() {
+            self.head = self.dequeuer.try_recv().ok();
+        }
+        if self.head.is_none() {
+            // an idle class does not accumulate credit
+            self.deficit = 0;
+            return batch;
+        }
+
+        self.deficit += self.quantum;
+        while let Some(packet) = self.head.take() {
+            if packet.len() > self.deficit {
+                self.head = Some(packet);
+                break;
+            }
+
+            self.deficit -= packet.len();
+            batch.push(packet);
+            self.head = self.dequeuer.try_recv().ok();
+        }
+
+        if self.head.is_none() {
+            self.deficit = 0;
+        }
+
+        batch
+    }
+}
+
+pub struct SendScheduler {
+    // indexed by SendPriority
+    classes: Vec<ClassQueue>,
+    // next class of the round robin, never Realtime
+    next_class: usize,
+}
+
+impl SendScheduler {
+    // The enqueuers are indexed by SendPriority
+    pub fn new() -> (Self, Vec<mpsc::Sender<Bytes>>) {
+        let (enqueuers, classes) = CLASSES
+            .iter()
+            .map(|class| {
+                let (enqueuer, dequeuer) = mpsc::channel(class.capacity);
+                (
+                    enqueuer,
+                    ClassQueue {
+                        dequeuer,
+                        head: None,
+                        deficit: 0,
+                        quantum: class.quantum,
+                    },
+                )
+            })
+            .unzip();
+
+        (
+            Self {
+                classes,
+                next_class: SendPriority::Audio as usize,
+            },
+            enqueuers,
+        )
+    }
+
+    // Next packets to send, all of the same class. None if all the enqueuers have been dropped,
+    // which does not happen while the StreamSocket that holds them exists: the send loop runs
+    // until it is canceled.
+    async fn next_batch(&mut self) -> Option<Vec<Bytes>> {
+        loop {
+            let batch = self.classes[SendPriority::Realtime as usize].take_quantum();
+            if !batch.is_empty() {
+                return Some(batch);
+            }
+
+            for _ in SendPriority::Audio as usize..self.classes.len() {
+                let class_idx = self.next_class;
+                self.next_class = if class_idx + 1 < self.classes.len() {
+                    class_idx + 1
+                } else {
+                    SendPriority::Audio as usize
+                };
+
+                let batch = self.classes[class_idx].take_quantum();
+                if !batch.is_empty() {
+                    return Some(batch);
+                }
+            }
+
+            // Packets bigger than the deficit are sent in a later round
+            if self.classes.iter().all(|class| class.head.is_none()) && !self.wait_packet().await {
+                return None;
+            }
+        }
+    }
+
+    async fn wait_packet(&mut self) -> bool {
+        if let [realtime, audio, video] = &mut self.classes[..] {
+            tokio::select! {
+                biased;
+                Some(packet) = realtime.dequeuer.recv() => realtime.head = Some(packet),
+                Some(packet) = audio.dequeuer.recv() => audio.head = Some(packet),
+                Some(packet) = video.dequeuer.recv() => video.head = Some(packet),
+                else => return false,
+            }
+        }
+
+        true
+    }
+
+    pub async fn run(mut self, socket: StreamSendSocket) -> StrResult {
+        while let Some(batch) = self.next_batch().await {
+            // Send errors are ignored as with the unscheduled senders, a broken connection is
+            // detected by the receive loop
+            socket.send(&batch).await.ok();
+        }
+
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::Ldc;
+    use futures::StreamExt;
+    use std::sync::Arc;
+    use tokio::{
+        net::{TcpSocket, TcpStream},
+        sync::Mutex,
+    };
+    use tokio_util::codec::Framed;
+
+    const REALTIME_MARK: u8 = 0;
+    const AUDIO_MARK: u8 = 1;
+    const VIDEO_MARK: u8 = 2;
+    const VIDEO_PACKET_SIZE: usize = 1400;
+
+    fn packet(mark: u8, size: usize) -> Bytes {
+        Bytes::from(vec![mark; size])
+    }
+
+    fn fill_video_queue(enqueuers: &[mpsc::Sender<Bytes>]) {
+        while enqueuers[SendPriority::Video as usize]
+            .try_send(packet(VIDEO_MARK, VIDEO_PACKET_SIZE))
+            .is_ok()
+        {}
+    }
+
+    #[tokio::test]
+    async fn realtime_packets_are_sent_next() {
+        let (mut scheduler, enqueuers) = SendScheduler::new();
+        fill_video_queue(&enqueuers);
+        for _ in 0..100 {
+            enqueuers[SendPriority::Audio as usize]
+                .try_send(packet(AUDIO_MARK, 1000))
+                .unwrap();
+        }
+
+        for _ in 0..10 {
+            scheduler.next_batch().await.unwrap();
+
+            enqueuers[SendPriority::Realtime as usize]
+                .try_send(packet(REALTIME_MARK, 100))
+                .unwrap();
+            let batch = scheduler.next_batch().await.unwrap();
+            assert_eq!(batch.len(), 1);
+            assert_eq!(batch[0][0], REALTIME_MARK);
+        }
+    }
+
+    #[tokio::test]
+    async fn video_keeps_its_share_under_audio_flood() {
+        let (mut scheduler, enqueuers) = SendScheduler::new();
+        fill_video_queue(&enqueuers);
+
+        let mut audio_bytes = 0;
+        let mut video_bytes = 0;
+        for _ in 0..8 {
+            while enqueuers[SendPriority::Audio as usize]
+                .try_send(packet(AUDIO_MARK, 1000))
+                .is_ok()
+            {}
+
+            for packet in scheduler.next_batch().await.unwrap() {
+                if packet[0] == VIDEO_MARK {
+                    video_bytes += packet.len();
+                } else {
+                    audio_bytes += packet.len();
+                }
+            }
+        }
+
+        assert!(video_bytes >= 3 * audio_bytes);
+    }
+
+    // The burst is sent over loopback TCP with small socket buffers, so that the packets queued in
+    // the kernel do not hide the scheduling and none are lost.
+    #[tokio::test]
+    async fn realtime_packets_overtake_an_idr_burst() {
+        // about 1 MB
+        const BURST_PACKETS: usize = 700;
+        const INJECT_AFTER: usize = 100;
+
+        let listener = TcpSocket::new_v4().unwrap();
+        listener.set_recv_buffer_size(4096).unwrap();
+        listener.bind("127.0.0.1:0".parse().unwrap()).unwrap();
+        let listener = listener.listen(1).unwrap();
+
+        let sender = TcpSocket::new_v4().unwrap();
+        sender.set_send_buffer_size(4096).unwrap();
+        let sender = sender
+            .connect(listener.local_addr().unwrap())
+            .await
+            .unwrap();
+        let (receiver, _) = listener.accept().await.unwrap();
+
+        let (send_socket, _) = Framed::new(sender, Ldc::new()).split();
+        let mut receiver = Framed::<TcpStream, _>::new(receiver, Ldc::new());
+
+        let (scheduler, enqueuers) = SendScheduler::new();
+        for _ in 0..BURST_PACKETS {
+            enqueuers[SendPriority::Video as usize]
+                .send(packet(VIDEO_MARK, VIDEO_PACKET_SIZE))
+                .await
+                .unwrap();
+        }
+        tokio::spawn(scheduler.run(StreamSendSocket::Tcp(Arc::new(Mutex::new(send_socket)))));
+
+        let mut video_packets = 0;
+        while let Some(frame) = receiver.next().await {
+            if frame.unwrap()[0] == REALTIME_MARK {
+                break;
+            }
+
+            video_packets += 1;
+            if video_packets == INJECT_AFTER {
+                enqueuers[SendPriority::Realtime as usize]
+                    .send(packet(REALTIME_MARK, 100))
+                    .await
+                    .unwrap();
+            }
+        }
+
+        // In FIFO order it would wait for the rest of the burst. It only waits for the video batch
+        // that was being sent.
+        let delay = video_packets - INJECT_AFTER;
+        let batch_packets = CLASSES[SendPriority::Video as usize].quantum / VIDEO_PACKET_SIZE;
+        assert!(
+            delay <= batch_packets,
+            "{delay} video packets before the realtime one"
+        );
+    }
+}
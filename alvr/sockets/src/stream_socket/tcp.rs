@@ -1,15 +1,15 @@
-use super::StreamId;
+use super::demux::StreamDemux;
 use crate::{Ldc, LOCAL_IP};
 use alvr_common::prelude::*;
-use bytes::{Buf, Bytes, BytesMut};
+use bytes::{Buf, Bytes};
 use futures::{
     stream::{SplitSink, SplitStream},
     StreamExt,
 };
-use std::{collections::HashMap, net::IpAddr, sync::Arc};
+use std::{net::IpAddr, sync::Arc};
 use tokio::{
     net::{TcpListener, TcpStream},
-    sync::{mpsc, Mutex},
+    sync::Mutex,
 };
 use tokio_util::codec::Framed;
 
@@ -50,15 +50,13 @@ pub async fn connect_to_client(
 
 pub async fn receive_loop(
     mut socket: TcpStreamReceiveSocket,
-    packet_enqueuers: Arc<Mutex<HashMap<StreamId, mpsc::UnboundedSender<BytesMut>>>>,
+    demux: Arc<StreamDemux>,
 ) -> StrResult {
     while let Some(maybe_packet) = socket.next().await {
         let mut packet = trace_err!(maybe_packet)?;
 
         let stream_id = packet.get_u16();
-        if let Some(enqueuer) = packet_enqueuers.lock().await.get_mut(&stream_id) {
-            trace_err!(enqueuer.send(packet))?;
-        }
+        demux.dispatch(stream_id, packet)?;
     }
 
     Ok(())
@@ -1,8 +1,11 @@
-use super::StreamId;
+use super::{
+    batch::{BatchReceiver, BatchSender},
+    demux::StreamDemux,
+};
 use crate::LOCAL_IP;
 use alvr_common::prelude::*;
-use bytes::{Buf, BufMut, Bytes, BytesMut};
-use futures::{Stream, StreamExt};
+use bytes::{Buf, Bytes};
+use futures::StreamExt;
 use governor::{
     clock,
     state::{InMemoryState, NotKeyed},
@@ -10,79 +13,58 @@ use governor::{
 };
 use nonzero_ext::NonZero;
 use std::{
-    collections::HashMap,
     io,
-    mem::MaybeUninit,
     net::{IpAddr, SocketAddr},
-    pin::Pin,
     sync::Arc,
-    task::{Context, Poll},
-};
-use tokio::{
-    io::ReadBuf,
-    net::UdpSocket,
-    sync::{mpsc, Mutex},
 };
-
-const INITIAL_RD_CAPACITY: usize = 64 * 1024;
+use tokio::net::UdpSocket;
 
 // Don't go below this rate, limiting then is unneeded anyway.
 const MINIMUM_BYTERATE: u32 = 30 * 1024 * 1024 * 3 / 2 / 8;
 // Reserve includes audio along with other small fluctuations.
 const RESERVE_BYTERATE: u32 = 5_000_000 / 8;
 
-#[allow(clippy::type_complexity)]
+type Limiter = RateLimiter<NotKeyed, InMemoryState, clock::DefaultClock>;
+
 #[derive(Clone)]
 pub struct ThrottledUdpStreamSendSocket {
-    inner: Arc<UdpSocket>,
-    limiter: Arc<Option<RateLimiter<NotKeyed, InMemoryState, clock::DefaultClock>>>,
+    pub inner: Arc<BatchSender>,
+    // the limiter and its burst size
+    limiter: Arc<Option<(Limiter, u32)>>,
 }
 
 impl ThrottledUdpStreamSendSocket {
-    pub async fn send(&self, data: Bytes) -> io::Result<()> {
-        if let Some(ref limiter) = *self.limiter {
-            if let Some(len) = NonZero::new(data.len() as u32) {
-                limiter.until_n_ready(len).await.ok();
+    pub async fn send(&self, datagrams: &[Bytes]) -> io::Result<()> {
+        if let Some((limiter, burst)) = &*self.limiter {
+            // The limiter cannot wait for more than a burst at a time, so the batch is split in
+            // chunks of at most a burst (or one datagram, if bigger)
+            let mut start = 0;
+            while start < datagrams.len() {
+                let mut end = start;
+                let mut size = 0;
+                while end < datagrams.len()
+                    && (end == start || size + datagrams[end].len() as u32 <= *burst)
+                {
+                    size += datagrams[end].len() as u32;
+                    end += 1;
+                }
+
+                if let Some(size) = NonZero::new(size.min(*burst)) {
+                    limiter.until_n_ready(size).await.ok();
+                }
+                self.inner.send(&datagrams[start..end]).await?;
+
+                start = end;
             }
-        }
-        match self.inner.send(&data).await {
-            Ok(_) => Ok(()),
-            Err(e) => Err(e),
+
+            Ok(())
+        } else {
+            self.inner.send(datagrams).await
         }
     }
 }
 
-pub struct ThrottledUdpStreamReceiveSocket {
-    pub inner: Arc<UdpSocket>,
-    buffer: BytesMut,
-}
-
-// Code taken from https://github.com/tokio-rs/tokio/blob/master/tokio-util/src/udp/frame.rs
-impl Stream for ThrottledUdpStreamReceiveSocket {
-    type Item = io::Result<(BytesMut, SocketAddr)>;
-
-    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
-        let pin = self.get_mut();
-
-        pin.buffer.reserve(INITIAL_RD_CAPACITY);
-
-        let addr = unsafe {
-            let buf = &mut *(pin.buffer.chunk_mut() as *mut _ as *mut [MaybeUninit<u8>]);
-            let mut read = ReadBuf::uninit(buf);
-            let ptr = read.filled().as_ptr();
-            let res = match Pin::new(&mut pin.inner).poll_recv_from(cx, &mut read) {
-                Poll::Ready(res) => res,
-                Poll::Pending => return Poll::Pending,
-            };
-
-            assert_eq!(ptr, read.filled().as_ptr());
-            let addr = res?;
-            pin.buffer.advance_mut(read.filled().len());
-            addr
-        };
-        Poll::Ready(Some(Ok((pin.buffer.split_to(pin.buffer.len()), addr))))
-    }
-}
+pub type ThrottledUdpStreamReceiveSocket = BatchReceiver;
 
 pub async fn connect_to_client(
     client_ip: IpAddr,
@@ -98,7 +80,7 @@ pub async fn connect_to_client(
     trace_err!(socket.connect(client_addr).await)?;
 
     let rx = Arc::new(socket);
-    let tx = Arc::clone(&rx);
+    let tx = Arc::new(BatchSender::new(Arc::clone(&rx)));
 
     let limiter = {
         // The byterate and burst amount computation here is based
@@ -108,7 +90,7 @@ pub async fn connect_to_client(
         let burst = byterate / 1000;
         let quota = Quota::per_second(NonZero::new(byterate).unwrap())
             .allow_burst(NonZero::new(burst).unwrap());
-        Some(RateLimiter::direct(quota))
+        Some((RateLimiter::direct(quota), burst))
     };
 
     Ok((
@@ -116,10 +98,7 @@ pub async fn connect_to_client(
             inner: tx,
             limiter: Arc::new(limiter),
         },
-        ThrottledUdpStreamReceiveSocket {
-            inner: rx,
-            buffer: BytesMut::new(),
-        },
+        BatchReceiver::new(rx),
     ))
 }
 
@@ -139,31 +118,26 @@ pub async fn accept_from_server(
     trace_err!(socket.connect(server_addr).await)?;
 
     let rx = Arc::new(socket);
-    let tx = Arc::clone(&rx);
+    let tx = Arc::new(BatchSender::new(Arc::clone(&rx)));
 
     Ok((
         ThrottledUdpStreamSendSocket {
             inner: tx,
             limiter: Arc::new(None),
         },
-        ThrottledUdpStreamReceiveSocket {
-            inner: rx,
-            buffer: BytesMut::new(),
-        },
+        BatchReceiver::new(rx),
     ))
 }
 
 pub async fn receive_loop(
     mut socket: ThrottledUdpStreamReceiveSocket,
-    packet_enqueuers: Arc<Mutex<HashMap<StreamId, mpsc::UnboundedSender<BytesMut>>>>,
+    demux: Arc<StreamDemux>,
 ) -> StrResult {
     while let Some(maybe_packet) = socket.next().await {
-        let (mut packet_bytes, _) = trace_err!(maybe_packet)?;
+        let mut packet_bytes = trace_err!(maybe_packet)?;
 
         let stream_id = packet_bytes.get_u16();
-        if let Some(enqueuer) = packet_enqueuers.lock().await.get_mut(&stream_id) {
-            trace_err!(enqueuer.send(packet_bytes))?;
-        }
+        demux.dispatch(stream_id, packet_bytes)?;
     }
 
     Ok(())
@@ -0,0 +1,356 @@
+// Video packet header versions. The legacy header is the bincode encoding of the full
+// VideoFrameHeaderPacket, repeated for every packet. The compact header contains only varint
+// encoded per-packet fields, while the per-frame metadata is sent only with the first data packet
+// and the parity packets of each frame, so it is still received if the first packet is lost but
+// the frame can be recovered with FEC.
+//
+// The version is negotiated during the handshake: the client advertises the highest version it
+// supports and the server replies with the one it chose.
+
+use crate::VideoFrameHeaderPacket;
+use alvr_common::prelude::*;
+use bincode::Options;
+use bytes::{Buf, BufMut, BytesMut};
+use serde::{Deserialize, Serialize};
+use std::collections::VecDeque;
+
+pub const LEGACY_VIDEO_HEADER_VERSION: u32 = 0;
+pub const COMPACT_VIDEO_HEADER_VERSION: u32 = 1;
+pub const VIDEO_HEADER_VERSION: u32 = COMPACT_VIDEO_HEADER_VERSION;
+
+// Maximum number of packets buffered while waiting for the metadata of a frame
+const MAX_PENDING_PACKETS: usize = 1024;
+
+#[derive(Serialize, Deserialize, Clone, Copy, PartialEq, Debug)]
+pub struct VideoFrameMetadata {
+    pub tracking_frame_index: u64,
+    pub sent_time: u64,
+    pub frame_byte_size: u32,
+    pub fec_percentage: u16,
+}
+
+#[derive(Serialize, Deserialize, Clone, PartialEq, Debug)]
+pub struct CompactVideoHeader {
+    pub packet_counter: u32,
+    pub video_frame_index: u64,
+    pub fec_index: u32,
+    pub metadata: Option<VideoFrameMetadata>,
+}
+
+// bincode DefaultOptions uses varint encoding for integers
+fn compact_options() -> impl Options {
+    bincode::DefaultOptions::new()
+}
+
+pub fn video_header_from_str(value: &str) -> Option<u32> {
+    value
+        .split_whitespace()
+        .find_map(|token| token.strip_prefix("video_header="))
+        .and_then(|version| version.parse().ok())
+}
+
+pub fn video_header_to_string(version: u32) -> String {
+    format!("video_header={version}")
+}
+
+pub struct VideoHeaderEncoder {
+    version: u32,
+    current_frame_index: Option<u64>,
+    data_packets: u64,
+}
+
+impl VideoHeaderEncoder {
+    pub fn new(version: u32) -> Self {
+        Self {
+            version,
+            current_frame_index: None,
+            data_packets: 0,
+        }
+    }
+
+    // Write the header for a packet into buffer. `payload_len` is the size of the payload that
+    // will follow the header.
+    pub fn encode(
+        &mut self,
+        header: &VideoFrameHeaderPacket,
+        payload_len: usize,
+        buffer: &mut BytesMut,
+    ) -> StrResult {
+        if self.version == LEGACY_VIDEO_HEADER_VERSION {
+            return trace_err!(bincode::serialize_into(buffer.writer(), header));
+        }
+
+        // The first packet of a frame is always full sized (unless the frame is smaller than one
+        // packet), so it can be used to tell data packets from parity packets.
+        if self.current_frame_index != Some(header.video_frame_index) {
+            self.current_frame_index = Some(header.video_frame_index);
+            self.data_packets = if payload_len > 0 {
+                (header.frame_byte_size as u64 + payload_len as u64 - 1) / payload_len as u64
+            } else {
+                1
+            };
+        }
+        let is_first_or_parity =
+            header.fec_index == 0 || header.fec_index as u64 >= self.data_packets;
+
+        let compact_header = CompactVideoHeader {
+            packet_counter: header.packet_counter,
+            video_frame_index: header.video_frame_index,
+            fec_index: header.fec_index,
+            metadata: is_first_or_parity.then(|| VideoFrameMetadata {
+                tracking_frame_index: header.tracking_frame_index,
+                sent_time: header.sent_time,
+                frame_byte_size: header.frame_byte_size,
+                fec_percentage: header.fec_percentage,
+            }),
+        };
+
+        trace_err!(compact_options().serialize_into(buffer.writer(), &compact_header))
+    }
+}
+
+pub struct VideoHeaderDecoder {
+    version: u32,
+    metadata: Option<(u64, VideoFrameMetadata)>,
+    pending_packets: VecDeque<(CompactVideoHeader, BytesMut)>,
+}
+
+impl VideoHeaderDecoder {
+    pub fn new(version: u32) -> Self {
+        Self {
+            version,
+            metadata: None,
+            pending_packets: VecDeque::new(),
+        }
+    }
+
+    // Parse the header of a packet. Returns all packets that are ready to be processed, in order:
+    // packets whose frame metadata has not been received yet are held back.
+    pub fn decode(
+        &mut self,
+        mut buffer: BytesMut,
+    ) -> StrResult<Vec<(VideoFrameHeaderPacket, BytesMut)>> {
+        if self.version == LEGACY_VIDEO_HEADER_VERSION {
+            let mut reader = buffer.reader();
+            let header = trace_err!(bincode::deserialize_from(&mut reader))?;
+            return Ok(vec![(header, reader.into_inner())]);
+        }
+
+        let mut reader = buffer.reader();
+        let header: CompactVideoHeader =
+            trace_err!(compact_options().deserialize_from(&mut reader))?;
+        buffer = reader.into_inner();
+
+        if let Some(metadata) = header.metadata {
+            self.metadata = Some((header.video_frame_index, metadata));
+        }
+
+        match self.metadata {
+            Some((index, metadata)) if index == header.video_frame_index => {
+                let mut ready_packets = vec![];
+                let mut newer_packets = VecDeque::new();
+                for (pending_header, pending_buffer) in self.pending_packets.drain(..) {
+                    // packets of older frames that never got their metadata are dropped, the ones
+                    // of newer frames keep waiting for theirs
+                    if pending_header.video_frame_index == index {
+                        ready_packets.push((to_legacy(&pending_header, &metadata), pending_buffer));
+                    } else if pending_header.video_frame_index > index {
+                        newer_packets.push_back((pending_header, pending_buffer));
+                    }
+                }
+                self.pending_packets = newer_packets;
+                ready_packets.push((to_legacy(&header, &metadata), buffer));
+
+                Ok(ready_packets)
+            }
+            _ => {
+                if self.pending_packets.len() >= MAX_PENDING_PACKETS {
+                    self.pending_packets.pop_front();
+                }
+                self.pending_packets.push_back((header, buffer));
+
+                Ok(vec![])
+            }
+        }
+    }
+}
+
+fn to_legacy(header: &CompactVideoHeader, metadata: &VideoFrameMetadata) -> VideoFrameHeaderPacket {
+    VideoFrameHeaderPacket {
+        packet_counter: header.packet_counter,
+        tracking_frame_index: metadata.tracking_frame_index,
+        video_frame_index: header.video_frame_index,
+        sent_time: metadata.sent_time,
+        frame_byte_size: metadata.frame_byte_size,
+        fec_index: header.fec_index,
+        fec_percentage: metadata.fec_percentage,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const PAYLOAD_SIZE: usize = 1400;
+
+    // A frame of 5 data packets (the last one partial) and 2 parity packets
+    fn frame_headers(video_frame_index: u64) -> Vec<(VideoFrameHeaderPacket, usize)> {
+        let frame_byte_size = 4 * PAYLOAD_SIZE as u32 + 100;
+        let fec_indices = [0, 1, 2, 3, 4, 6, 7];
+
+        fec_indices
+            .iter()
+            .enumerate()
+            .map(|(i, &fec_index)| {
+                let header = VideoFrameHeaderPacket {
+                    packet_counter: video_frame_index as u32 * 7 + i as u32,
+                    tracking_frame_index: 1000 + video_frame_index,
+                    video_frame_index,
+                    sent_time: 1_650_000_000_000_000 + video_frame_index * 11_111,
+                    frame_byte_size,
+                    fec_index,
+                    fec_percentage: 5,
+                };
+                let payload_len = if fec_index == 4 { 100 } else { PAYLOAD_SIZE };
+                (header, payload_len)
+            })
+            .collect()
+    }
+
+    fn encode_all(version: u32, headers: &[(VideoFrameHeaderPacket, usize)]) -> Vec<BytesMut> {
+        let mut encoder = VideoHeaderEncoder::new(version);
+        headers
+            .iter()
+            .map(|(header, payload_len)| {
+                let mut buffer = BytesMut::new();
+                encoder.encode(header, *payload_len, &mut buffer).unwrap();
+                buffer.put_bytes(0xAB, *payload_len);
+                buffer
+            })
+            .collect()
+    }
+
+    fn assert_same(a: &VideoFrameHeaderPacket, b: &VideoFrameHeaderPacket) {
+        assert_eq!(
+            bincode::serialize(a).unwrap(),
+            bincode::serialize(b).unwrap()
+        );
+    }
+
+    #[test]
+    fn legacy_is_wire_compatible() {
+        let headers = frame_headers(1);
+        for ((header, payload_len), buffer) in headers.iter().zip(encode_all(0, &headers)) {
+            let legacy = bincode::serialize(header).unwrap();
+            assert_eq!(&buffer[..legacy.len()], &legacy[..]);
+            assert_eq!(buffer.len(), legacy.len() + payload_len);
+        }
+    }
+
+    #[test]
+    fn compact_roundtrip() {
+        let headers = [frame_headers(1), frame_headers(2)].concat();
+        let mut decoder = VideoHeaderDecoder::new(COMPACT_VIDEO_HEADER_VERSION);
+
+        let mut decoded = vec![];
+        for buffer in encode_all(COMPACT_VIDEO_HEADER_VERSION, &headers) {
+            decoded.extend(decoder.decode(buffer).unwrap());
+        }
+
+        assert_eq!(decoded.len(), headers.len());
+        for ((expected, payload_len), (header, payload)) in headers.iter().zip(&decoded) {
+            assert_same(expected, header);
+            assert_eq!(payload.len(), *payload_len);
+        }
+    }
+
+    #[test]
+    fn compact_first_packet_lost() {
+        let headers = frame_headers(3);
+        let mut decoder = VideoHeaderDecoder::new(COMPACT_VIDEO_HEADER_VERSION);
+
+        let mut decoded = vec![];
+        for buffer in encode_all(COMPACT_VIDEO_HEADER_VERSION, &headers)
+            .into_iter()
+            .skip(1)
+        {
+            decoded.extend(decoder.decode(buffer).unwrap());
+        }
+
+        // data packets are released when the first parity packet arrives
+        assert_eq!(decoded.len(), headers.len() - 1);
+        for ((expected, _), (header, _)) in headers.iter().skip(1).zip(&decoded) {
+            assert_same(expected, header);
+        }
+    }
+
+    #[test]
+    fn compact_keeps_packets_of_newer_frames() {
+        let first_frame = encode_all(COMPACT_VIDEO_HEADER_VERSION, &frame_headers(4));
+        let second_frame = encode_all(COMPACT_VIDEO_HEADER_VERSION, &frame_headers(5));
+        let mut decoder = VideoHeaderDecoder::new(COMPACT_VIDEO_HEADER_VERSION);
+
+        // The first packets of both frames are late, the first frame is completed by its parity
+        let mut decoded = vec![];
+        for buffer in first_frame[1..5].iter().chain(&second_frame[1..5]) {
+            decoded.extend(decoder.decode(buffer.clone()).unwrap());
+        }
+        assert!(decoded.is_empty());
+        decoded.extend(decoder.decode(first_frame[5].clone()).unwrap());
+        assert_eq!(decoded.len(), 5);
+
+        decoded.extend(decoder.decode(second_frame[0].clone()).unwrap());
+        assert_eq!(decoded.len(), 10);
+        assert!(decoded[5..]
+            .iter()
+            .all(|(header, _)| header.video_frame_index == 5));
+    }
+
+    #[test]
+    fn compact_is_smaller() {
+        let headers = frame_headers(100_000);
+        let legacy_size: usize = encode_all(LEGACY_VIDEO_HEADER_VERSION, &headers)
+            .iter()
+            .map(|b| b.len())
+            .sum();
+        let compact_size: usize = encode_all(COMPACT_VIDEO_HEADER_VERSION, &headers)
+            .iter()
+            .map(|b| b.len())
+            .sum();
+
+        let header_count = headers.len();
+        assert!(legacy_size - compact_size >= header_count * 15);
+    }
+
+    // Header bytes and encode + decode time per packet, for both versions.
+    // cargo test -p alvr_sockets --release -- --ignored --nocapture video_header_benchmark
+    #[test]
+    #[ignore]
+    fn video_header_benchmark() {
+        const FRAMES: u64 = 100_000;
+
+        for version in [LEGACY_VIDEO_HEADER_VERSION, COMPACT_VIDEO_HEADER_VERSION] {
+            let headers = (0..FRAMES).flat_map(frame_headers).collect::<Vec<_>>();
+            let mut encoder = VideoHeaderEncoder::new(version);
+            let mut decoder = VideoHeaderDecoder::new(version);
+
+            let mut header_bytes = 0;
+            let mut decoded = 0;
+            let start = std::time::Instant::now();
+            for (header, payload_len) in &headers {
+                let mut buffer = BytesMut::with_capacity(64);
+                encoder.encode(header, *payload_len, &mut buffer).unwrap();
+                header_bytes += buffer.len();
+                decoded += decoder.decode(buffer).unwrap().len();
+            }
+            let elapsed = start.elapsed();
+            assert_eq!(decoded, headers.len());
+
+            println!(
+                "version {version}: {:.1} header bytes, {:.0} ns per packet",
+                header_bytes as f64 / headers.len() as f64,
+                elapsed.as_nanos() as f64 / headers.len() as f64
+            );
+        }
+    }
+}
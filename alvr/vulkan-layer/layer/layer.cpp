@@ -203,6 +203,25 @@ VKAPI_ATTR VkResult create_instance(const VkInstanceCreateInfo *pCreateInfo,
     return VK_SUCCESS;
 }
 
+/* Whether an already signalled sync file can be imported into a fence, to signal it from the host. */
+static bool sync_fd_fence_importable(instance_private_data &inst_data, VkPhysicalDevice physicalDevice) {
+    auto get_properties = inst_data.disp.GetPhysicalDeviceExternalFenceProperties;
+    if (get_properties == nullptr) {
+        get_properties = inst_data.disp.GetPhysicalDeviceExternalFencePropertiesKHR;
+    }
+    if (get_properties == nullptr) {
+        return false;
+    }
+
+    VkPhysicalDeviceExternalFenceInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_FENCE_INFO;
+    info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
+    VkExternalFenceProperties properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_EXTERNAL_FENCE_PROPERTIES;
+    get_properties(physicalDevice, &info, &properties);
+    return (properties.externalFenceFeatures & VK_EXTERNAL_FENCE_FEATURE_IMPORTABLE_BIT) != 0;
+}
+
 VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice,
                                   const VkDeviceCreateInfo *pCreateInfo,
                                   const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
@@ -248,6 +267,25 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice,
         return result;
     }
 
+    /* The vsync fence is signalled from the host by importing a sync file when the driver can import
+     * SYNC_FD fence payloads. */
+    bool host_vsync_signal = false;
+    {
+        util::extension_list device_extensions{allocator};
+        if (device_extensions.add(physicalDevice) == VK_SUCCESS &&
+            device_extensions.contains(VK_KHR_EXTERNAL_FENCE_FD_EXTENSION_NAME) &&
+            sync_fd_fence_importable(inst_data, physicalDevice)) {
+            result = enabled_extensions.add(VK_KHR_EXTERNAL_FENCE_FD_EXTENSION_NAME);
+            if (result == VK_SUCCESS && device_extensions.contains(VK_KHR_EXTERNAL_FENCE_EXTENSION_NAME)) {
+                result = enabled_extensions.add(VK_KHR_EXTERNAL_FENCE_EXTENSION_NAME);
+            }
+            if (result != VK_SUCCESS) {
+                return result;
+            }
+            host_vsync_signal = true;
+        }
+    }
+
     util::vector<const char *> modified_enabled_extensions{allocator};
     if (!enabled_extensions.get_extension_strings(modified_enabled_extensions)) {
         return VK_ERROR_OUT_OF_HOST_MEMORY;
@@ -258,7 +296,8 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice,
     modified_info.ppEnabledExtensionNames = modified_enabled_extensions.data();
     modified_info.enabledExtensionCount = modified_enabled_extensions.size();
 
-    // Add one queue to safely submit vsync from our thread
+    // Add one queue to safely submit vsync from our thread. With host signalling it is only used if
+    // the sync file import fails.
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfo(pCreateInfo->pQueueCreateInfos, pCreateInfo->pQueueCreateInfos + pCreateInfo->queueCreateInfoCount);
     assert(queueCreateInfo.size() > 0);
     std::vector<VkQueueFamilyProperties> props(queueCreateInfo.size());
@@ -291,7 +330,10 @@ VKAPI_ATTR VkResult create_device(VkPhysicalDevice physicalDevice,
 
     std::unique_ptr<device_private_data> device{
         new device_private_data{inst_data, physicalDevice, *pDevice, table, loader_callback}};
-    device->display = std::make_unique<wsi::display>(*device, queueCreateInfo[display_queue].queueFamilyIndex, queueCreateInfo[display_queue].queueCount - 1);
+    if (display_queue < size)
+        device->display = std::make_unique<wsi::display>(*device, queueCreateInfo[display_queue].queueFamilyIndex, queueCreateInfo[display_queue].queueCount - 1, host_vsync_signal);
+    else
+        device->display = std::make_unique<wsi::display>(*device);
     device_private_data::set(*pDevice, std::move(device));
     return VK_SUCCESS;
 }
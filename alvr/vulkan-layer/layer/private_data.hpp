@@ -67,6 +67,8 @@ namespace layer {
     OPTIONAL(CreateHeadlessSurfaceEXT)                                                             \
     OPTIONAL(GetPhysicalDeviceQueueFamilyProperties)                                               \
     OPTIONAL(CreateDisplayModeKHR)                                                                 \
+    OPTIONAL(GetPhysicalDeviceExternalFenceProperties)                                             \
+    OPTIONAL(GetPhysicalDeviceExternalFencePropertiesKHR)                                          \
 
 struct instance_dispatch_table {
     VkResult populate(VkInstance instance, PFN_vkGetInstanceProcAddr get_proc);
@@ -116,6 +118,7 @@ struct instance_dispatch_table {
     OPTIONAL(GetSwapchainCounterEXT)                                                               \
     OPTIONAL(RegisterDisplayEventEXT)                                                              \
     OPTIONAL(GetFenceStatus)                                                                       \
+    OPTIONAL(ImportFenceFdKHR)                                                                     \
     OPTIONAL(GetMemoryFdKHR)                                                                       \
     OPTIONAL(CreateSemaphore)                                                                      \
     OPTIONAL(GetSemaphoreFdKHR)
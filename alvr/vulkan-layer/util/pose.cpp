@@ -3,39 +3,13 @@
 #include <cmath>
 #include <string.h>
 
+#include "alvr_server/include/pose_math.h"
+
 #define UNW_LOCAL_ONLY
 #include <libunwind.h>
 
 namespace {
 
-inline HmdMatrix34_t transposeMul33(const HmdMatrix34_t& a) {
-  HmdMatrix34_t result;
-  for (unsigned i = 0; i < 3; i++) {
-    for (unsigned k = 0; k < 3; k++) {
-      result.m[i][k] = a.m[k][i];
-    }
-  }
-  result.m[0][3] = a.m[0][3];
-  result.m[1][3] = a.m[1][3];
-  result.m[2][3] = a.m[2][3];
-  return result;
-}
-
-
-inline HmdMatrix34_t matMul33(const HmdMatrix34_t& a, const HmdMatrix34_t& b) {
-  HmdMatrix34_t result;
-  for (unsigned i = 0; i < 3; i++) {
-    for (unsigned j = 0; j < 3; j++) {
-      result.m[i][j] = 0.0f;
-      for (unsigned k = 0; k < 3; k++) {
-        result.m[i][j] += a.m[i][k] * b.m[k][j];
-      }
-    }
-  }
-  return result;
-}
-
-
 bool check_pose(const TrackedDevicePose_t & p)
 {
   if (p.bPoseIsValid != 1 or p.bDeviceIsConnected != 1)
@@ -44,7 +18,7 @@ bool check_pose(const TrackedDevicePose_t & p)
   if (p.eTrackingResult != 200)
     return false;
 
-  auto m = matMul33(p.mDeviceToAbsoluteTracking, transposeMul33(p.mDeviceToAbsoluteTracking));
+  auto m = posemath::matMul33(p.mDeviceToAbsoluteTracking, posemath::transposeMul33(p.mDeviceToAbsoluteTracking));
   for (int i = 0 ; i < 3; ++i )
   {
     for (int j = 0 ; j < 3 ; ++j)
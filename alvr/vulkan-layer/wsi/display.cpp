@@ -2,39 +2,125 @@
 #include "layer/private_data.hpp"
 
 #include"layer/settings.h"
+#include "util/logger.h"
 
-#include <chrono>
+#include <cerrno>
+#include <ctime>
+#include <sys/prctl.h>
 
-wsi::display::display(layer::device_private_data& device_data, uint32_t queue_family_index, uint32_t queue_index):
+namespace {
+
+uint64_t monotonic_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+void sleep_until_ns(uint64_t time_ns)
+{
+  timespec ts;
+  ts.tv_sec = time_ns / 1'000'000'000;
+  ts.tv_nsec = time_ns % 1'000'000'000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+    ;
+}
+
+}
+
+wsi::display::display(layer::device_private_data& device_data):
+  m_host_signal(true),
+  m_has_queue(false),
+  m_device_data(device_data)
+{
+}
+
+wsi::display::display(layer::device_private_data& device_data, uint32_t queue_family_index, uint32_t queue_index,
+    bool host_signal):
   m_queue_family_index(queue_family_index),
   m_queue_index(queue_index),
+  m_host_signal(host_signal),
+  m_has_queue(true),
   m_device_data(device_data)
 {
 }
 
+// An already signalled sync file is represented by fd -1. Sync file payloads are always temporary,
+// so the fence returns to its unsignalled permanent payload when the application resets it.
+bool wsi::display::signal_fence_from_host()
+{
+  VkImportFenceFdInfoKHR import_info = {};
+  import_info.sType = VK_STRUCTURE_TYPE_IMPORT_FENCE_FD_INFO_KHR;
+  import_info.fence = vsync_fence;
+  import_info.flags = VK_FENCE_IMPORT_TEMPORARY_BIT;
+  import_info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
+  import_info.fd = -1;
+  return m_device_data.disp.ImportFenceFdKHR != nullptr and
+         m_device_data.disp.ImportFenceFdKHR(m_device_data.device, &import_info) == VK_SUCCESS;
+}
+
+void wsi::display::signal_fence_from_queue(VkQueue queue)
+{
+  m_device_data.disp.QueueSubmit(queue, 0, nullptr, vsync_fence);
+  m_device_data.disp.QueueWaitIdle(queue);
+}
+
 VkFence wsi::display::get_vsync_fence()
 {
   if (not std::atomic_exchange(&m_thread_running, true))
   {
-  VkQueue queue;
+  VkQueue queue = VK_NULL_HANDLE;
   VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, 0};
   m_device_data.disp.CreateFence(m_device_data.device, &fence_info, nullptr, &vsync_fence);
-  m_device_data.disp.GetDeviceQueue(m_device_data.device, m_queue_family_index, m_queue_index, &queue);
-  m_device_data.SetDeviceLoaderData(m_device_data.device, queue);
+  if (m_has_queue)
+  {
+    m_device_data.disp.GetDeviceQueue(m_device_data.device, m_queue_family_index, m_queue_index, &queue);
+    m_device_data.SetDeviceLoaderData(m_device_data.device, queue);
+  }
+
+  if (m_host_signal and m_device_data.disp.ImportFenceFdKHR == nullptr and not m_has_queue)
+    Error("vsync: vkImportFenceFdKHR is not available, the vsync fence will not be signalled\n");
+
+  auto refresh = Settings::Instance().m_refreshRate;
+  m_frame_time_ns = uint64_t(1'000'000'000 / refresh);
+
   m_vsync_thread = std::thread([this, queue]()
       {
-      auto refresh = Settings::Instance().m_refreshRate;
-      auto next_frame = std::chrono::steady_clock::now();
-      auto frame_time = std::chrono::duration_cast<decltype(next_frame)::duration>(std::chrono::duration<double>(1. / refresh));
+      // The default 50us timer slack is a large part of the wakeup jitter
+      prctl(PR_SET_TIMERSLACK, 1);
+
+      uint64_t next_frame = monotonic_ns();
+      bool import_failed = false;
       while (not m_exiting) {
+        sleep_until_ns(next_frame);
+        m_vsync_time_ns = next_frame;
+        m_vsync_count += 1;
+
         if (m_device_data.disp.GetFenceStatus(m_device_data.device, vsync_fence) == VK_NOT_READY)
         {
-          m_device_data.disp.QueueSubmit(queue, 0, nullptr, vsync_fence);
+          if (m_host_signal and not signal_fence_from_host())
+          {
+            if (m_has_queue)
+            {
+              Warn("vsync: sync file import failed, falling back to queue submission\n");
+              m_host_signal = false;
+            }
+            else if (not import_failed)
+            {
+              // There is no queue to fall back to, try again on the next vsync
+              Error("vsync: sync file import failed\n");
+              import_failed = true;
+            }
+          }
+          if (not m_host_signal)
+            signal_fence_from_queue(queue);
         }
-        m_device_data.disp.QueueWaitIdle(queue);
-        std::this_thread::sleep_until(next_frame);
-        m_vsync_count += 1;
-        next_frame += frame_time;
+
+        next_frame += m_frame_time_ns;
+        // don't try to catch up missed vsyncs
+        uint64_t now = monotonic_ns();
+        if (next_frame < now)
+          next_frame = now + m_frame_time_ns - (now - next_frame) % m_frame_time_ns;
       }
       m_device_data.disp.DestroyFence(m_device_data.device, vsync_fence, nullptr);
       });
@@ -11,23 +11,46 @@ class device_private_data;
 
 namespace wsi {
 
+// Virtual display of the headset. A host thread ticks at the configured refresh rate, counts the
+// vsyncs and signals the fence returned by vkRegisterDisplayEventEXT.
+// When the driver can import SYNC_FD fence payloads, the fence is signalled from the host by
+// importing an already signalled sync file, so no work is submitted to the device queues. Otherwise,
+// or if an import fails, an empty submission on a dedicated queue, allocated by the layer at device
+// creation, is used.
 class display {
   public:
-    display(layer::device_private_data& device_data, uint32_t queue_family_index, uint32_t queue_index);
+    // Signal the fence from the host, without a queue to fall back to. Used only when all the queues
+    // of the device are taken by the application.
+    explicit display(layer::device_private_data& device_data);
+    // Signal the fence from the host if host_signal, with submissions on the given dedicated queue
+    // otherwise
+    display(layer::device_private_data& device_data, uint32_t queue_family_index, uint32_t queue_index,
+            bool host_signal);
     ~display();
 
     VkFence get_vsync_fence();
     VkFence peek_vsync_fence() { return vsync_fence;};
 
+    // CLOCK_MONOTONIC time of the last vsync, in nanoseconds
+    uint64_t last_vsync_ns() { return m_vsync_time_ns; }
+    uint64_t frame_time_ns() { return m_frame_time_ns; }
+
     std::atomic<uint64_t> m_vsync_count{0};
 
   private:
+    bool signal_fence_from_host();
+    void signal_fence_from_queue(VkQueue queue);
+
     std::atomic_bool m_thread_running{false};
     std::atomic_bool m_exiting{false};
+    std::atomic<uint64_t> m_vsync_time_ns{0};
+    std::atomic<uint64_t> m_frame_time_ns{0};
     std::thread m_vsync_thread;
     VkFence vsync_fence = VK_NULL_HANDLE;
-    uint32_t m_queue_family_index;
-    uint32_t m_queue_index;
+    uint32_t m_queue_family_index = 0;
+    uint32_t m_queue_index = 0;
+    bool m_host_signal;
+    bool m_has_queue;
     layer::device_private_data& m_device_data;
 };
 
@@ -302,6 +302,7 @@ void swapchain::present_image(uint32_t pending_index) {
         present_packet packet;
         packet.image = pending_index;
         packet.frame = m_display.m_vsync_count;
+        packet.vsync_ns = m_display.last_vsync_ns();
         memcpy(&packet.pose, pose, sizeof(packet.pose));
         ret = write(m_socket, &packet, sizeof(packet));
         if (ret == -1) {